@@ -0,0 +1,145 @@
+/*
+ *  Header file for logq, the host tool that answers queries on SD card logs
+ *  Inputs are memory-mapped, never read line by line:
+ *      text        record.txt as written by the device (user_record.h). Samples carry no time,
+ *                  it is rebuilt from the "Period:" markers and the sample numbers: sample
+ *                  Seq s after a marker is marker time + (s - s0) * period, s0 being the
+ *                  number of the first sample after the marker, so samples which never
+ *                  reached the SD card leave a hole instead of shifting the rest. Samples
+ *                  before the first marker use LOG_DEFAULT_PERIOD_MS from time 0. Logs written
+ *                  before samples were numbered count rows instead.
+ *      columns     file written by "logq columns": one fixed-width array per column, so it is
+ *                  used in place without decoding.
+ *
+ *  A log may span several boots, every boot restarts the device clock. The time of a later boot
+ *  is shifted to start one period after the last sample of the previous one, so the whole log
+ *  is a single increasing timeline and time ranges can be found by binary search.
+ *
+ *  Decoding and queries are split over threads by rows, loops over columns are kept free of
+ *  branches so the compiler vectorizes them.
+ */
+
+#ifndef _LOGQ_H_
+#define _LOGQ_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define LOG_CHANNELS            4           //ADC_CHANNEL_NUMBER of main/user_adc.h
+#define LOG_DEFAULT_PERIOD_MS   2000        //ADC_PERIOD of main/user_timer.h, used before the first Period marker
+#define LOG_THREADS_MAX         64
+#define LOG_SEQ_NONE            UINT32_MAX  //row without Seq field
+
+/* Columnar file: header, then every column aligned to LOG_COLUMN_ALIGN */
+#define LOG_COLUMNS_MAGIC       "DLCOLS1"
+#define LOG_COLUMN_ALIGN        64
+
+typedef struct {
+    char magic[8];                          //LOG_COLUMNS_MAGIC
+    uint32_t header_size;
+    uint32_t channels;                      //LOG_CHANNELS
+    uint64_t count;                         //rows
+    uint32_t segments;
+    uint32_t markers;
+    uint64_t time_offset;                   //offset of int64_t time_us[count]
+    uint64_t voltage_offset[LOG_CHANNELS];  //offset of uint16_t voltage[count], mV
+    uint64_t digital_offset;                //offset of uint8_t digital[count]
+    uint64_t seq_offset;                    //offset of uint32_t seq[count]
+} log_columns_header_t;
+
+/* Decoded log, columns either point into the mapped columnar file or are allocated */
+typedef struct {
+    size_t count;
+    int64_t* time_us;                       //increasing, see above
+    uint16_t* voltage[LOG_CHANNELS];
+    uint8_t* digital;                       //bit n: digital channel n
+    uint32_t* seq;                          //sample number, LOG_SEQ_NONE if the record has none
+    uint32_t segments;                      //boots found in the log
+    uint32_t markers;                       //Period markers found in the log
+    void* map;                              //mapping of the input file
+    size_t map_size;
+    bool owned;                             //columns are allocated and must be freed
+} log_table_t;
+
+/* Row range selected by a query */
+typedef struct {
+    size_t first;
+    size_t last;                            //one past the last row
+} log_range_t;
+
+/* Aggregate of one channel */
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t sum_sq;
+    uint32_t min;
+    uint32_t max;
+} log_stats_t;
+
+/**
+ * @brief Run fn(ctx, i) for i = 0 .. threads - 1, each call on its own thread, and wait for all
+ */
+void logq_parallel(uint32_t threads, void (*fn)(void* ctx, uint32_t index), void* ctx);
+
+/**
+ * @brief Map a log file and decode it, format is detected from its first bytes
+ * 
+ * @param path text log or columnar file
+ * @param threads number of decoding threads
+ * @param table output, release with logq_close
+ * @return true on success, error is printed otherwise
+ */
+bool logq_open(const char* path, uint32_t threads, log_table_t* table);
+
+/**
+ * @brief Release mapping and columns of a table
+ */
+void logq_close(log_table_t* table);
+
+/**
+ * @brief Decode a mapped text log (record.txt), called by logq_open
+ */
+bool logq_decode_text(const char* data, size_t size, uint32_t threads, log_table_t* table);
+
+/**
+ * @brief Use a mapped columnar file in place, called by logq_open
+ */
+bool logq_map_columns(void* data, size_t size, log_table_t* table);
+
+/**
+ * @brief Write table as a columnar file
+ */
+bool logq_write_columns(const log_table_t* table, log_range_t range, const char* path);
+
+/**
+ * @brief Rows with from_us <= time < to_us
+ */
+log_range_t logq_find_range(const log_table_t* table, int64_t from_us, int64_t to_us);
+
+/**
+ * @brief Aggregate every channel over a row range
+ * 
+ * @param stats output, one per channel
+ * @param digital_high output, number of rows with each digital channel high
+ */
+void logq_aggregate(const log_table_t* table, log_range_t range, uint32_t threads,
+                    log_stats_t stats[LOG_CHANNELS], uint64_t digital_high[LOG_CHANNELS]);
+
+/**
+ * @brief Write min, mean and max of every channel per time bucket as CSV
+ * 
+ * @param channel_mask bit n: write channel n
+ */
+void logq_downsample(const log_table_t* table, log_range_t range, int64_t bucket_us, uint32_t threads,
+                     uint32_t channel_mask, FILE* out);
+
+/**
+ * @brief Write rows as CSV, seq is left empty for records without sample number
+ * 
+ * @param channel_mask bit n: write channel n
+ */
+bool logq_write_csv(const log_table_t* table, log_range_t range, uint32_t channel_mask, FILE* out);
+
+#endif
@@ -0,0 +1,162 @@
+/*
+ *  Source file for mapping logs and for the columnar file format
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "logq.h"
+
+static uint64_t column_align(uint64_t offset) {
+    return (offset + LOG_COLUMN_ALIGN - 1) & ~(uint64_t)(LOG_COLUMN_ALIGN - 1);
+}
+
+bool logq_open(const char* path, uint32_t threads, log_table_t* table) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    memset(table, 0, sizeof(log_table_t));
+    if(fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        if(fd >= 0) close(fd);
+        return false;
+    }
+    if(st.st_size == 0) {
+        close(fd);
+        return true;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) {
+        perror(path);
+        return false;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+    table->map = map;
+    table->map_size = st.st_size;
+
+    bool ok;
+    if(st.st_size >= (off_t)sizeof(log_columns_header_t) && memcmp(map, LOG_COLUMNS_MAGIC, sizeof(LOG_COLUMNS_MAGIC)) == 0) {
+        ok = logq_map_columns(map, st.st_size, table);
+    }
+    else {
+        ok = logq_decode_text(map, st.st_size, threads, table);
+        //columns are decoded, text pages are not needed anymore
+        munmap(map, st.st_size);
+        table->map = NULL;
+        table->map_size = 0;
+    }
+    if(!ok) {
+        fprintf(stderr, "%s: cannot decode log\n", path);
+        logq_close(table);
+    }
+    return ok;
+}
+
+void logq_close(log_table_t* table) {
+    if(table->owned) {
+        free(table->time_us);
+        free(table->digital);
+        free(table->seq);
+        for(int ch = 0; ch < LOG_CHANNELS; ch++) {
+            free(table->voltage[ch]);
+        }
+    }
+    if(table->map != NULL) {
+        munmap(table->map, table->map_size);
+    }
+    memset(table, 0, sizeof(log_table_t));
+}
+
+bool logq_map_columns(void* data, size_t size, log_table_t* table) {
+    const log_columns_header_t* header = data;
+    uint8_t* base = data;
+    if(header->header_size < sizeof(log_columns_header_t) || header->channels != LOG_CHANNELS) {
+        fprintf(stderr, "Unsupported columnar file: header %u bytes, %u channels\n", header->header_size, header->channels);
+        return false;
+    }
+    //every column must lie inside the file
+    uint64_t count = header->count;
+    bool ok = header->time_offset + count * sizeof(int64_t) <= size && header->digital_offset + count <= size &&
+              header->seq_offset + count * sizeof(uint32_t) <= size;
+    for(int ch = 0; ch < LOG_CHANNELS; ch++) {
+        ok &= header->voltage_offset[ch] + count * sizeof(uint16_t) <= size;
+    }
+    if(!ok) {
+        fprintf(stderr, "Columnar file truncated\n");
+        return false;
+    }
+    table->count = count;
+    table->segments = header->segments;
+    table->markers = header->markers;
+    table->time_us = (int64_t*)(base + header->time_offset);
+    table->digital = base + header->digital_offset;
+    table->seq = (uint32_t*)(base + header->seq_offset);
+    for(int ch = 0; ch < LOG_CHANNELS; ch++) {
+        table->voltage[ch] = (uint16_t*)(base + header->voltage_offset[ch]);
+    }
+    table->owned = false;
+    return true;
+}
+
+bool logq_write_columns(const log_table_t* table, log_range_t range, const char* path) {
+    size_t count = range.last - range.first;
+    log_columns_header_t header = {
+        .magic = LOG_COLUMNS_MAGIC,
+        .header_size = sizeof(log_columns_header_t),
+        .channels = LOG_CHANNELS,
+        .count = count,
+        .segments = table->segments,
+        .markers = table->markers,
+    };
+    uint64_t offset = column_align(sizeof(header));
+    header.time_offset = offset;
+    offset = column_align(offset + count * sizeof(int64_t));
+    for(int ch = 0; ch < LOG_CHANNELS; ch++) {
+        header.voltage_offset[ch] = offset;
+        offset = column_align(offset + count * sizeof(uint16_t));
+    }
+    header.digital_offset = offset;
+    offset = column_align(offset + count);
+    header.seq_offset = offset;
+
+    FILE* f = fopen(path, "wb");
+    if(f == NULL) {
+        perror(path);
+        return false;
+    }
+    static const uint8_t padding[LOG_COLUMN_ALIGN];
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    const void* columns[LOG_CHANNELS + 3];
+    uint64_t offsets[LOG_CHANNELS + 3];
+    size_t sizes[LOG_CHANNELS + 3];
+    columns[0] = table->time_us + range.first;
+    offsets[0] = header.time_offset;
+    sizes[0] = count * sizeof(int64_t);
+    for(int ch = 0; ch < LOG_CHANNELS; ch++) {
+        columns[ch + 1] = table->voltage[ch] + range.first;
+        offsets[ch + 1] = header.voltage_offset[ch];
+        sizes[ch + 1] = count * sizeof(uint16_t);
+    }
+    columns[LOG_CHANNELS + 1] = table->digital + range.first;
+    offsets[LOG_CHANNELS + 1] = header.digital_offset;
+    sizes[LOG_CHANNELS + 1] = count;
+    columns[LOG_CHANNELS + 2] = table->seq + range.first;
+    offsets[LOG_CHANNELS + 2] = header.seq_offset;
+    sizes[LOG_CHANNELS + 2] = count * sizeof(uint32_t);
+
+    //pad up to the offset of every column, then write it
+    uint64_t position = sizeof(header);
+    for(int i = 0; i < LOG_CHANNELS + 3 && ok; i++) {
+        size_t pad = offsets[i] - position;
+        ok &= fwrite(padding, 1, pad, f) == pad;
+        ok &= fwrite(columns[i], 1, sizes[i], f) == sizes[i];
+        position = offsets[i] + sizes[i];
+    }
+    ok &= fclose(f) == 0;
+    if(!ok) {
+        fprintf(stderr, "%s: write failed\n", path);
+    }
+    return ok;
+}
@@ -0,0 +1,160 @@
+/*
+ *  Command line of logq, see README.md
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include "logq.h"
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: logq [options] COMMAND LOG\n"
+            "  LOG is record.txt of the SD card or a file written by \"logq columns\"\n"
+            "commands:\n"
+            "  info                 rows, boots and time span\n"
+            "  agg                  min, mean, max and deviation per channel, digital high ratio\n"
+            "  downsample SECONDS   min, mean and max per channel and time bucket, CSV\n"
+            "  csv OUT              rows as CSV, - for stdout\n"
+            "  columns OUT          rows as columnar file, opened in place by later queries\n"
+            "options:\n"
+            "  -j N                 threads (default: online CPUs)\n"
+            "  -c CH                only channel CH, may be repeated (default: all)\n"
+            "  -f SECONDS           rows from this time on\n"
+            "  -t SECONDS           rows before this time\n"
+            "  -q                   no timing on stderr\n");
+}
+
+static double elapsed_ms(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static FILE* open_output(const char* path) {
+    if(strcmp(path, "-") == 0) return stdout;
+    FILE* f = fopen(path, "w");
+    if(f == NULL) perror(path);
+    return f;
+}
+
+int main(int argc, char** argv) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t threads = cpus > 0 ? (uint32_t)cpus : 1;
+    uint32_t channel_mask = 0;
+    int64_t from_us = INT64_MIN, to_us = INT64_MAX;
+    bool quiet = false;
+    int opt;
+    while((opt = getopt(argc, argv, "j:c:f:t:qh")) != -1) {
+        switch(opt) {
+        case 'j':
+            threads = strtoul(optarg, NULL, 0);
+            if(threads < 1) threads = 1;
+            if(threads > LOG_THREADS_MAX) threads = LOG_THREADS_MAX;
+            break;
+        case 'c': {
+            int ch = atoi(optarg);
+            if(ch < 0 || ch >= LOG_CHANNELS) {
+                fprintf(stderr, "Channel %d out of 0..%d\n", ch, LOG_CHANNELS - 1);
+                return 2;
+            }
+            channel_mask |= 1 << ch;
+            break;
+        }
+        case 'f':
+            from_us = (int64_t)(strtod(optarg, NULL) * 1e6);
+            break;
+        case 't':
+            to_us = (int64_t)(strtod(optarg, NULL) * 1e6);
+            break;
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            usage();
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if(channel_mask == 0) channel_mask = (1 << LOG_CHANNELS) - 1;
+    if(argc - optind < 2) {
+        usage();
+        return 2;
+    }
+    const char* command = argv[optind];
+    const char* argument = NULL;
+    if(strcmp(command, "downsample") == 0 || strcmp(command, "csv") == 0 || strcmp(command, "columns") == 0) {
+        if(argc - optind < 3) {
+            usage();
+            return 2;
+        }
+        argument = argv[optind + 1];
+    }
+    else if(strcmp(command, "info") != 0 && strcmp(command, "agg") != 0) {
+        fprintf(stderr, "Unknown command %s\n", command);
+        usage();
+        return 2;
+    }
+    const char* path = argv[argc - 1];
+
+    struct timespec start;
+    log_table_t table;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if(!logq_open(path, threads, &table)) return 1;
+    double open_ms = elapsed_ms(&start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    log_range_t range = logq_find_range(&table, from_us, to_us);
+    size_t rows = range.last - range.first;
+    int ret = 0;
+    if(strcmp(command, "info") == 0) {
+        printf("rows      %zu\n", table.count);
+        printf("boots     %u\n", table.segments);
+        printf("markers   %u\n", table.markers);
+        if(table.count > 0) {
+            printf("from      %.3f s\n", table.time_us[0] / 1e6);
+            printf("to        %.3f s\n", table.time_us[table.count - 1] / 1e6);
+        }
+        printf("selected  %zu\n", rows);
+    }
+    else if(strcmp(command, "agg") == 0) {
+        log_stats_t stats[LOG_CHANNELS];
+        uint64_t high[LOG_CHANNELS];
+        logq_aggregate(&table, range, threads, stats, high);
+        printf("rows %zu\n", rows);
+        printf("channel  min_mv   mean_mv  max_mv   stddev_mv  digital_high\n");
+        for(int ch = 0; ch < LOG_CHANNELS; ch++) {
+            if(!(channel_mask & (1 << ch)) || stats[ch].count == 0) continue;
+            double mean = (double)stats[ch].sum / stats[ch].count;
+            double variance = (double)stats[ch].sum_sq / stats[ch].count - mean * mean;
+            printf("%-8d %-8u %-8.1f %-8u %-10.1f %.3f\n", ch, stats[ch].min, mean, stats[ch].max,
+                   sqrt(variance > 0 ? variance : 0), (double)high[ch] / stats[ch].count);
+        }
+    }
+    else if(strcmp(command, "downsample") == 0) {
+        int64_t bucket_us = (int64_t)(strtod(argument, NULL) * 1e6);
+        if(bucket_us <= 0) {
+            fprintf(stderr, "Bucket must be positive\n");
+            ret = 2;
+        }
+        else {
+            logq_downsample(&table, range, bucket_us, threads, channel_mask, stdout);
+        }
+    }
+    else if(strcmp(command, "csv") == 0) {
+        FILE* out = open_output(argument);
+        ret = (out != NULL && logq_write_csv(&table, range, channel_mask, out)) ? 0 : 1;
+        if(out != NULL && out != stdout) fclose(out);
+    }
+    else {
+        ret = logq_write_columns(&table, range, argument) ? 0 : 1;
+    }
+    fflush(stdout);
+    if(!quiet) {
+        fprintf(stderr, "logq: open %.1f ms, %s %.1f ms, %zu rows, %u threads\n",
+                open_ms, command, elapsed_ms(&start), rows, threads);
+    }
+    logq_close(&table);
+    return ret;
+}
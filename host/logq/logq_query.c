@@ -0,0 +1,258 @@
+/*
+ *  Source file for queries on decoded logs
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "logq.h"
+
+typedef struct {
+    void (*fn)(void* ctx, uint32_t index);
+    void* ctx;
+    uint32_t index;
+} parallel_arg_t;
+
+static void* parallel_thread(void* param) {
+    parallel_arg_t* arg = param;
+    arg->fn(arg->ctx, arg->index);
+    return NULL;
+}
+
+void logq_parallel(uint32_t threads, void (*fn)(void* ctx, uint32_t index), void* ctx) {
+    pthread_t handles[LOG_THREADS_MAX];
+    parallel_arg_t args[LOG_THREADS_MAX];
+    bool started[LOG_THREADS_MAX] = {0};
+    if(threads > LOG_THREADS_MAX) threads = LOG_THREADS_MAX;
+    //index 0 runs on the calling thread, also the fallback when a thread cannot be created
+    for(uint32_t i = 1; i < threads; i++) {
+        args[i] = (parallel_arg_t){.fn = fn, .ctx = ctx, .index = i};
+        started[i] = pthread_create(&handles[i], NULL, parallel_thread, &args[i]) == 0;
+    }
+    fn(ctx, 0);
+    for(uint32_t i = 1; i < threads; i++) {
+        if(started[i]) pthread_join(handles[i], NULL);
+        else fn(ctx, i);
+    }
+}
+
+/* First row with time >= time_us */
+static size_t lower_bound(const log_table_t* table, size_t first, size_t last, int64_t time_us) {
+    while(first < last) {
+        size_t mid = first + (last - first) / 2;
+        if(table->time_us[mid] < time_us) first = mid + 1;
+        else last = mid;
+    }
+    return first;
+}
+
+log_range_t logq_find_range(const log_table_t* table, int64_t from_us, int64_t to_us) {
+    log_range_t range;
+    range.first = lower_bound(table, 0, table->count, from_us);
+    range.last = lower_bound(table, range.first, table->count, to_us);
+    return range;
+}
+
+/**** Aggregation ****/
+
+static void stats_clear(log_stats_t stats[LOG_CHANNELS], uint64_t high[LOG_CHANNELS]) {
+    for(int ch = 0; ch < LOG_CHANNELS; ch++) {
+        stats[ch] = (log_stats_t){.min = UINT32_MAX};
+        high[ch] = 0;
+    }
+}
+
+/* Add rows first .. last - 1, the loops have no branches so they are vectorized */
+static void stats_rows(const log_table_t* table, size_t first, size_t last,
+                       log_stats_t stats[LOG_CHANNELS], uint64_t high[LOG_CHANNELS]) {
+    for(int ch = 0; ch < LOG_CHANNELS; ch++) {
+        const uint16_t* restrict v = table->voltage[ch];
+        uint64_t sum = 0, sum_sq = 0;
+        uint32_t min = stats[ch].min, max = stats[ch].max;
+        for(size_t i = first; i < last; i++) {
+            uint32_t mv = v[i];
+            sum += mv;
+            sum_sq += (uint64_t)mv * mv;
+            min = mv < min ? mv : min;
+            max = mv > max ? mv : max;
+        }
+        stats[ch].count += last - first;
+        stats[ch].sum += sum;
+        stats[ch].sum_sq += sum_sq;
+        stats[ch].min = min;
+        stats[ch].max = max;
+    }
+    const uint8_t* restrict d = table->digital;
+    for(int ch = 0; ch < LOG_CHANNELS; ch++) {
+        uint64_t count = 0;
+        for(size_t i = first; i < last; i++) {
+            count += (d[i] >> ch) & 1;
+        }
+        high[ch] += count;
+    }
+}
+
+typedef struct {
+    const log_table_t* table;
+    log_range_t range;
+    uint32_t threads;
+    log_stats_t stats[LOG_THREADS_MAX][LOG_CHANNELS];
+    uint64_t high[LOG_THREADS_MAX][LOG_CHANNELS];
+} aggregate_job_t;
+
+static void aggregate_slice(void* ctx, uint32_t index) {
+    aggregate_job_t* job = ctx;
+    size_t rows = job->range.last - job->range.first;
+    size_t first = job->range.first + rows * index / job->threads;
+    size_t last = job->range.first + rows * (index + 1) / job->threads;
+    stats_clear(job->stats[index], job->high[index]);
+    stats_rows(job->table, first, last, job->stats[index], job->high[index]);
+}
+
+void logq_aggregate(const log_table_t* table, log_range_t range, uint32_t threads,
+                    log_stats_t stats[LOG_CHANNELS], uint64_t digital_high[LOG_CHANNELS]) {
+    aggregate_job_t* job = malloc(sizeof(aggregate_job_t));
+    stats_clear(stats, digital_high);
+    if(job == NULL) {
+        stats_rows(table, range.first, range.last, stats, digital_high);
+        return;
+    }
+    job->table = table;
+    job->range = range;
+    job->threads = threads > LOG_THREADS_MAX ? LOG_THREADS_MAX : (threads ? threads : 1);
+    logq_parallel(job->threads, aggregate_slice, job);
+    for(uint32_t t = 0; t < job->threads; t++) {
+        for(int ch = 0; ch < LOG_CHANNELS; ch++) {
+            log_stats_t* s = &job->stats[t][ch];
+            stats[ch].count += s->count;
+            stats[ch].sum += s->sum;
+            stats[ch].sum_sq += s->sum_sq;
+            stats[ch].min = s->min < stats[ch].min ? s->min : stats[ch].min;
+            stats[ch].max = s->max > stats[ch].max ? s->max : stats[ch].max;
+            digital_high[ch] += job->high[t][ch];
+        }
+    }
+    free(job);
+}
+
+/**** Downsampling ****/
+
+typedef struct {
+    const log_table_t* table;
+    log_range_t range;
+    int64_t bucket_us;
+    uint64_t buckets;
+    uint32_t threads;
+    uint32_t channel_mask;
+    char* text[LOG_THREADS_MAX];        //CSV lines of every thread, written in thread order
+    size_t text_size[LOG_THREADS_MAX];
+} downsample_job_t;
+
+/* Every thread owns a run of buckets, so no bucket is split between threads */
+static void downsample_slice(void* ctx, uint32_t index) {
+    downsample_job_t* job = ctx;
+    const log_table_t* table = job->table;
+    int64_t start_us = table->time_us[job->range.first];
+    uint64_t bucket = job->buckets * index / job->threads;
+    uint64_t bucket_end = job->buckets * (index + 1) / job->threads;
+    size_t row = lower_bound(table, job->range.first, job->range.last, start_us + (int64_t)bucket * job->bucket_us);
+    size_t row_end = lower_bound(table, row, job->range.last, start_us + (int64_t)bucket_end * job->bucket_us);
+    FILE* out = open_memstream(&job->text[index], &job->text_size[index]);
+    if(out == NULL) return;
+
+    while(row < row_end) {
+        //skip empty buckets straight to the one of the next row
+        bucket = (table->time_us[row] - start_us) / job->bucket_us;
+        size_t last = lower_bound(table, row, row_end, start_us + (int64_t)(bucket + 1) * job->bucket_us);
+        log_stats_t stats[LOG_CHANNELS];
+        uint64_t high[LOG_CHANNELS];
+        stats_clear(stats, high);
+        stats_rows(table, row, last, stats, high);
+        fprintf(out, "%.3f,%zu", (start_us + (int64_t)bucket * job->bucket_us) / 1e6, last - row);
+        for(int ch = 0; ch < LOG_CHANNELS; ch++) {
+            if(job->channel_mask & (1 << ch)) {
+                fprintf(out, ",%u,%.1f,%u", stats[ch].min, (double)stats[ch].sum / stats[ch].count, stats[ch].max);
+            }
+        }
+        fputc('\n', out);
+        row = last;
+    }
+    fclose(out);
+}
+
+void logq_downsample(const log_table_t* table, log_range_t range, int64_t bucket_us, uint32_t threads,
+                     uint32_t channel_mask, FILE* out) {
+    fprintf(out, "time_s,rows");
+    for(int ch = 0; ch < LOG_CHANNELS; ch++) {
+        if(channel_mask & (1 << ch)) {
+            fprintf(out, ",ch%d_min_mv,ch%d_mean_mv,ch%d_max_mv", ch, ch, ch);
+        }
+    }
+    fputc('\n', out);
+    if(range.first >= range.last || bucket_us <= 0) return;
+
+    downsample_job_t* job = calloc(1, sizeof(downsample_job_t));
+    if(job == NULL) return;
+    job->table = table;
+    job->range = range;
+    job->bucket_us = bucket_us;
+    job->buckets = (table->time_us[range.last - 1] - table->time_us[range.first]) / bucket_us + 1;
+    job->threads = threads > LOG_THREADS_MAX ? LOG_THREADS_MAX : (threads ? threads : 1);
+    if(job->threads > job->buckets) job->threads = job->buckets;
+    job->channel_mask = channel_mask;
+    logq_parallel(job->threads, downsample_slice, job);
+    for(uint32_t t = 0; t < job->threads; t++) {
+        if(job->text[t] != NULL) fwrite(job->text[t], 1, job->text_size[t], out);
+        free(job->text[t]);
+    }
+    free(job);
+}
+
+/**** CSV ****/
+
+/* Append value in decimal, printf is the bottleneck of large exports otherwise */
+static char* put_uint(char* p, uint64_t value) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while(value);
+    while(n) *p++ = digits[--n];
+    return p;
+}
+
+bool logq_write_csv(const log_table_t* table, log_range_t range, uint32_t channel_mask, FILE* out) {
+    char line[256];
+    fprintf(out, "time_s,seq");
+    for(int ch = 0; ch < LOG_CHANNELS; ch++) {
+        if(channel_mask & (1 << ch)) fprintf(out, ",ch%d_mv,ch%d_digital", ch, ch);
+    }
+    fputc('\n', out);
+    for(size_t i = range.first; i < range.last; i++) {
+        int64_t time_us = table->time_us[i];
+        char* p = line;
+        if(time_us < 0) {
+            *p++ = '-';
+            time_us = -time_us;
+        }
+        p = put_uint(p, time_us / 1000000);
+        *p++ = '.';
+        uint32_t ms = (time_us % 1000000) / 1000;
+        *p++ = '0' + ms / 100;
+        *p++ = '0' + ms / 10 % 10;
+        *p++ = '0' + ms % 10;
+        *p++ = ',';
+        if(table->seq[i] != LOG_SEQ_NONE) p = put_uint(p, table->seq[i]);
+        for(int ch = 0; ch < LOG_CHANNELS; ch++) {
+            if(channel_mask & (1 << ch)) {
+                *p++ = ',';
+                p = put_uint(p, table->voltage[ch][i]);
+                *p++ = ',';
+                *p++ = '0' + ((table->digital[i] >> ch) & 1);
+            }
+        }
+        *p++ = '\n';
+        if(fwrite(line, 1, p - line, out) != (size_t)(p - line)) return false;
+    }
+    return fflush(out) == 0;
+}
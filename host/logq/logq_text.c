@@ -0,0 +1,264 @@
+/*
+ *  Source file for decoding text logs
+ *  The mapped file is cut into one chunk per thread at line starts. Chunks are then processed in
+ *  four passes, only the third one is sequential and it only visits Period markers:
+ *      1. count sample rows and collect markers of every chunk          (parallel)
+ *      2. decode voltages, digital states and sample numbers           (parallel)
+ *      3. carry period, time and boot offset from chunk to chunk        (sequential)
+ *      4. fill sample times                                             (parallel)
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "logq.h"
+
+#define TEXT_NUMBERS_MAX    (2 * LOG_CHANNELS + 1)
+
+typedef struct {
+    size_t row;                 //row of the table the marker applies to
+    int64_t time_us;            //device time, offset of its boot is added in pass 3
+    int64_t position;           //row_position of row, set in pass 3
+    uint32_t period_ms;
+} text_marker_t;
+
+typedef struct {
+    const char* begin;
+    const char* end;
+    size_t rows;
+    size_t first_row;
+    text_marker_t* markers;
+    size_t marker_count;
+    size_t marker_capacity;
+    //timeline at start of chunk, set in pass 3
+    int64_t base_us;            //time of the last marker before the chunk
+    int64_t base_position;      //row_position of the first row after that marker
+    uint32_t period_ms;
+    bool failed;
+} text_chunk_t;
+
+typedef struct {
+    text_chunk_t chunks[LOG_THREADS_MAX];
+    uint32_t count;
+    log_table_t* table;
+} text_job_t;
+
+static bool line_starts(const char* p, const char* end, const char* prefix, size_t len) {
+    return (size_t)(end - p) >= len && memcmp(p, prefix, len) == 0;
+}
+
+static const char* line_end(const char* p, const char* end) {
+    const char* nl = memchr(p, '\n', end - p);
+    return nl != NULL ? nl : end;
+}
+
+/* Parse unsigned numbers of a line in order, return how many were found */
+static int parse_numbers(const char* p, const char* end, int64_t* out, int max) {
+    int n = 0;
+    while(n < max) {
+        while(p < end && (unsigned)(*p - '0') > 9) p++;
+        if(p == end) break;
+        int64_t value = 0;
+        while(p < end && (unsigned)(*p - '0') <= 9) {
+            value = value * 10 + (*p++ - '0');
+        }
+        out[n++] = value;
+    }
+    return n;
+}
+
+/* Place of a row on the time axis in periods: its sample number, or its row for logs written before samples were numbered */
+static inline int64_t row_position(const log_table_t* table, size_t row) {
+    return table->seq[row] != LOG_SEQ_NONE ? (int64_t)table->seq[row] : (int64_t)row;
+}
+
+/* Start of first line at or after pos which is not the Digtal half of a sample */
+static const char* align_chunk(const char* data, const char* end, const char* pos) {
+    if(pos > data) {
+        pos = line_end(pos - 1, end);
+        if(pos < end) pos++;
+    }
+    while(pos < end && line_starts(pos, end, "Digtal:", 7)) {
+        pos = line_end(pos, end);
+        if(pos < end) pos++;
+    }
+    return pos;
+}
+
+/**** Pass 1: rows and markers ****/
+
+static void count_chunk(void* ctx, uint32_t index) {
+    text_chunk_t* chunk = &((text_job_t*)ctx)->chunks[index];
+    int64_t numbers[TEXT_NUMBERS_MAX];
+    for(const char* p = chunk->begin; p < chunk->end; ) {
+        const char* eol = line_end(p, chunk->end);
+        if(*p == 'A' && line_starts(p, eol, "Analog:", 7)) {
+            chunk->rows++;
+        }
+        else if(*p == 'P' && line_starts(p, eol, "Period:", 7) && parse_numbers(p, eol, numbers, 2) == 2) {
+            if(chunk->marker_count == chunk->marker_capacity) {
+                size_t capacity = chunk->marker_capacity ? 2 * chunk->marker_capacity : 64;
+                text_marker_t* markers = realloc(chunk->markers, capacity * sizeof(text_marker_t));
+                if(markers == NULL) {
+                    chunk->failed = true;
+                    return;
+                }
+                chunk->markers = markers;
+                chunk->marker_capacity = capacity;
+            }
+            chunk->markers[chunk->marker_count++] = (text_marker_t){
+                .row = chunk->rows,                     //made absolute once first_row is known
+                .time_us = numbers[1],
+                .period_ms = (uint32_t)numbers[0],
+            };
+        }
+        p = eol + 1;
+    }
+}
+
+/**** Pass 2: values ****/
+
+static void decode_chunk(void* ctx, uint32_t index) {
+    text_job_t* job = ctx;
+    text_chunk_t* chunk = &job->chunks[index];
+    log_table_t* table = job->table;
+    int64_t numbers[TEXT_NUMBERS_MAX];
+    size_t row = chunk->first_row;
+    for(const char* p = chunk->begin; p < chunk->end; ) {
+        const char* eol = line_end(p, chunk->end);
+        //"Analog: Chan 0:<mV>mV, Chan 1:<mV>mV, ... Seq <n>" => channel numbers and values alternate
+        if(*p == 'A' && line_starts(p, eol, "Analog:", 7)) {
+            int n = parse_numbers(p + 7, eol, numbers, TEXT_NUMBERS_MAX);
+            for(int ch = 0; ch < LOG_CHANNELS; ch++) {
+                int64_t mv = (2 * ch + 1 < n) ? numbers[2 * ch + 1] : 0;
+                table->voltage[ch][row] = mv > UINT16_MAX ? UINT16_MAX : (uint16_t)mv;
+            }
+            table->seq[row] = (n == TEXT_NUMBERS_MAX && numbers[n - 1] < LOG_SEQ_NONE) ? (uint32_t)numbers[n - 1] : LOG_SEQ_NONE;
+            table->digital[row] = 0;
+            row++;
+        }
+        //"Digtal: Chan 0: <0/1>, ..." belongs to the Analog line before it
+        else if(*p == 'D' && row > chunk->first_row && line_starts(p, eol, "Digtal:", 7)) {
+            int n = parse_numbers(p + 7, eol, numbers, TEXT_NUMBERS_MAX);
+            uint8_t bits = 0;
+            for(int ch = 0; ch < LOG_CHANNELS && 2 * ch + 1 < n; ch++) {
+                bits |= (numbers[2 * ch + 1] != 0) << ch;
+            }
+            table->digital[row - 1] = bits;
+        }
+        p = eol + 1;
+    }
+}
+
+/**** Pass 3: timeline ****/
+
+static void link_chunks(text_job_t* job) {
+    log_table_t* table = job->table;
+    int64_t base_us = 0, offset_us = 0;
+    int64_t base_position = table->count > 0 ? row_position(table, 0) : 0;
+    int64_t last_us = INT64_MIN;                //time of the last row so far
+    uint32_t period_ms = LOG_DEFAULT_PERIOD_MS;
+    size_t row = 0;                             //first row after the last marker
+
+    table->segments = table->count > 0 ? 1 : 0;
+    for(uint32_t c = 0; c < job->count; c++) {
+        text_chunk_t* chunk = &job->chunks[c];
+        chunk->base_us = base_us;
+        chunk->base_position = base_position;
+        chunk->period_ms = period_ms;
+        for(size_t m = 0; m < chunk->marker_count; m++) {
+            text_marker_t* marker = &chunk->markers[m];
+            //time of the row before the marker, unless there is none since the previous marker
+            if(marker->row > row) {
+                last_us = base_us + (row_position(table, marker->row - 1) - base_position) * period_ms * 1000;
+            }
+            row = marker->row;
+            //device clock went back => device rebooted, continue one period after the last row
+            if(last_us != INT64_MIN && marker->time_us + offset_us <= last_us) {
+                offset_us = last_us + (int64_t)period_ms * 1000 - marker->time_us;
+                table->segments++;
+            }
+            marker->time_us += offset_us;
+            marker->position = row < table->count ? row_position(table, row) : 0;
+            base_us = marker->time_us;
+            base_position = marker->position;
+            period_ms = marker->period_ms ? marker->period_ms : LOG_DEFAULT_PERIOD_MS;
+        }
+        table->markers += chunk->marker_count;
+    }
+}
+
+/**** Pass 4: times ****/
+
+static void time_chunk(void* ctx, uint32_t index) {
+    text_job_t* job = ctx;
+    text_chunk_t* chunk = &job->chunks[index];
+    const log_table_t* table = job->table;
+    int64_t base_us = chunk->base_us;
+    int64_t base_position = chunk->base_position;
+    int64_t period_us = (int64_t)chunk->period_ms * 1000;
+    size_t row = chunk->first_row, last = chunk->first_row + chunk->rows;
+    for(size_t m = 0; m <= chunk->marker_count; m++) {
+        size_t until = (m < chunk->marker_count) ? chunk->markers[m].row : last;
+        for(; row < until; row++) {
+            table->time_us[row] = base_us + (row_position(table, row) - base_position) * period_us;
+        }
+        if(m < chunk->marker_count) {
+            base_us = chunk->markers[m].time_us;
+            base_position = chunk->markers[m].position;
+            period_us = (int64_t)(chunk->markers[m].period_ms ? chunk->markers[m].period_ms : LOG_DEFAULT_PERIOD_MS) * 1000;
+        }
+    }
+}
+
+bool logq_decode_text(const char* data, size_t size, uint32_t threads, log_table_t* table) {
+    text_job_t* job = calloc(1, sizeof(text_job_t));
+    const char* end = data + size;
+    bool ok = true;
+    if(job == NULL) return false;
+    //small files are not worth more than one thread per MB
+    if(threads > size / (1024 * 1024) + 1) threads = size / (1024 * 1024) + 1;
+    if(threads > LOG_THREADS_MAX) threads = LOG_THREADS_MAX;
+    job->count = threads;
+    job->table = table;
+    for(uint32_t i = 0; i < threads; i++) {
+        job->chunks[i].begin = align_chunk(data, end, data + size / threads * i);
+    }
+    for(uint32_t i = 0; i < threads; i++) {
+        job->chunks[i].end = (i + 1 < threads) ? job->chunks[i + 1].begin : end;
+        if(job->chunks[i].end < job->chunks[i].begin) job->chunks[i].end = job->chunks[i].begin;
+    }
+
+    logq_parallel(threads, count_chunk, job);
+    table->count = 0;
+    for(uint32_t i = 0; i < threads; i++) {
+        ok &= !job->chunks[i].failed;
+        job->chunks[i].first_row = table->count;
+        for(size_t m = 0; m < job->chunks[i].marker_count; m++) {
+            job->chunks[i].markers[m].row += table->count;
+        }
+        table->count += job->chunks[i].rows;
+    }
+
+    table->owned = true;
+    table->time_us = malloc(table->count * sizeof(int64_t) + 1);
+    table->digital = malloc(table->count + 1);
+    table->seq = malloc(table->count * sizeof(uint32_t) + 1);
+    ok &= table->time_us != NULL && table->digital != NULL && table->seq != NULL;
+    for(int ch = 0; ch < LOG_CHANNELS; ch++) {
+        table->voltage[ch] = malloc(table->count * sizeof(uint16_t) + 1);
+        ok &= table->voltage[ch] != NULL;
+    }
+    if(ok) {
+        logq_parallel(threads, decode_chunk, job);
+        link_chunks(job);
+        logq_parallel(threads, time_chunk, job);
+    }
+    else {
+        fprintf(stderr, "Not enough memory for %zu rows\n", table->count);
+    }
+
+    for(uint32_t i = 0; i < threads; i++) {
+        free(job->chunks[i].markers);
+    }
+    free(job);
+    return ok;
+}
@@ -0,0 +1,252 @@
+/* Source file for simulated peripherals of the host port: timer, ADC1, GPIO and SD card */
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "driver/timer.h"
+#include "driver/adc.h"
+#include "driver/gpio.h"
+#include "driver/spi_common.h"
+#include "esp_adc_cal.h"
+#include "esp_vfs_fat.h"
+#include "sdmmc_cmd.h"
+#include "sim_port.h"
+
+static const char* TAG = "Host Driver";
+
+atomic_uint_least32_t g_sim_timer_alarms;
+int g_sim_sd_fail_mounts;
+
+/**** Timer ****/
+
+/*
+ *  One thread per started timer sleeps until the next alarm on the virtual clock and calls
+ *  the ISR. With auto reload, the counter restarts at the alarm, so timer_get_counter_value
+ *  read by the woken task is its wake-up latency as on the device.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t thread;
+    uint32_t divider;
+    bool auto_reload;
+    bool running;
+    uint64_t alarm;                 //ticks
+    int64_t reload_us;              //virtual time when counter was last set to 0
+    void (*isr)(void*);
+    void* arg;
+} sim_timer_t;
+
+static sim_timer_t s_timers[TIMER_GROUP_MAX][TIMER_MAX];
+
+static int64_t ticks_to_us(const sim_timer_t* t, uint64_t ticks) {
+    return (int64_t)(ticks * t->divider * 1000000 / TIMER_BASE_CLK);
+}
+
+static void* timer_thread(void* arg) {
+    sim_timer_t* t = arg;
+    struct timespec ts;
+    pthread_mutex_lock(&t->lock);
+    while(t->running) {
+        int64_t due = t->reload_us + ticks_to_us(t, t->alarm);
+        if(sim_time_us() < due) {
+            //a new alarm value wakes the thread to recompute the deadline
+            sim_deadline(due, &ts);
+            pthread_cond_timedwait(&t->changed, &t->lock, &ts);
+            continue;
+        }
+        if(t->auto_reload) {
+            t->reload_us = due;
+        }
+        void (*isr)(void*) = t->isr;
+        void* isr_arg = t->arg;
+        pthread_mutex_unlock(&t->lock);
+        atomic_fetch_add(&g_sim_timer_alarms, 1);
+        if(isr != NULL) isr(isr_arg);
+        pthread_mutex_lock(&t->lock);
+        if(!t->auto_reload) {
+            t->running = false;
+        }
+    }
+    pthread_mutex_unlock(&t->lock);
+    return NULL;
+}
+
+esp_err_t timer_init(timer_group_t group, timer_idx_t idx, const timer_config_t* config) {
+    sim_timer_t* t = &s_timers[group][idx];
+    pthread_condattr_t attr;
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&t->changed, &attr);
+    pthread_condattr_destroy(&attr);
+    t->divider = config->divider;
+    t->auto_reload = config->auto_reload;
+    t->running = false;
+    return ESP_OK;
+}
+
+esp_err_t timer_set_counter_value(timer_group_t group, timer_idx_t idx, uint64_t value) {
+    sim_timer_t* t = &s_timers[group][idx];
+    pthread_mutex_lock(&t->lock);
+    t->reload_us = sim_time_us() - ticks_to_us(t, value);
+    pthread_mutex_unlock(&t->lock);
+    return ESP_OK;
+}
+
+esp_err_t timer_get_counter_value(timer_group_t group, timer_idx_t idx, uint64_t* value) {
+    sim_timer_t* t = &s_timers[group][idx];
+    pthread_mutex_lock(&t->lock);
+    *value = (uint64_t)(sim_time_us() - t->reload_us) * TIMER_BASE_CLK / t->divider / 1000000;
+    pthread_mutex_unlock(&t->lock);
+    return ESP_OK;
+}
+
+esp_err_t timer_set_alarm_value(timer_group_t group, timer_idx_t idx, uint64_t value) {
+    sim_timer_t* t = &s_timers[group][idx];
+    pthread_mutex_lock(&t->lock);
+    t->alarm = value;
+    pthread_cond_signal(&t->changed);
+    pthread_mutex_unlock(&t->lock);
+    return ESP_OK;
+}
+
+esp_err_t timer_enable_intr(timer_group_t group, timer_idx_t idx) {
+    return ESP_OK;
+}
+
+esp_err_t timer_isr_register(timer_group_t group, timer_idx_t idx, void (*fn)(void*), void* arg,
+                             int intr_alloc_flags, timer_isr_handle_t* handle) {
+    sim_timer_t* t = &s_timers[group][idx];
+    pthread_mutex_lock(&t->lock);
+    t->isr = fn;
+    t->arg = arg;
+    pthread_mutex_unlock(&t->lock);
+    return ESP_OK;
+}
+
+esp_err_t timer_start(timer_group_t group, timer_idx_t idx) {
+    sim_timer_t* t = &s_timers[group][idx];
+    pthread_mutex_lock(&t->lock);
+    if(t->running) {
+        pthread_mutex_unlock(&t->lock);
+        return ESP_OK;
+    }
+    t->running = true;
+    pthread_mutex_unlock(&t->lock);
+    if(pthread_create(&t->thread, NULL, timer_thread, t) != 0) {
+        t->running = false;
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_detach(t->thread);
+    return ESP_OK;
+}
+
+/**** ADC1 ****/
+
+esp_err_t adc1_config_width(adc_bits_width_t width) {
+    return ESP_OK;
+}
+
+esp_err_t adc1_config_channel_atten(adc1_channel_t channel, adc_atten_t atten) {
+    return ESP_OK;
+}
+
+int adc1_get_raw(adc1_channel_t channel) {
+    static atomic_uint_least32_t conversions;
+    uint32_t n = atomic_fetch_add(&conversions, 1) + 1;
+    //spikes of the real ADC, independent of the input
+    if(SIM_ADC_SPIKE_EVERY != 0 && n % SIM_ADC_SPIKE_EVERY == 0) {
+        return (n / SIM_ADC_SPIKE_EVERY) & 1 ? SIM_ADC_MAX_CODE : 0;
+    }
+    uint32_t mv = sim_adc_read_mv(channel, sim_time_us());
+    if(mv > SIM_ADC_FULL_SCALE_MV) mv = SIM_ADC_FULL_SCALE_MV;
+    return (int)((mv * SIM_ADC_MAX_CODE + SIM_ADC_FULL_SCALE_MV / 2) / SIM_ADC_FULL_SCALE_MV);
+}
+
+esp_err_t esp_adc_cal_check_efuse(esp_adc_cal_value_t value_type) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t adc_num, adc_atten_t atten, adc_bits_width_t bit_width,
+                                             uint32_t default_vref, esp_adc_cal_characteristics_t* chars) {
+    chars->adc_num = adc_num;
+    chars->atten = atten;
+    chars->bit_width = bit_width;
+    chars->vref = default_vref;
+    return ESP_ADC_CAL_VAL_DEFAULT_VREF;
+}
+
+uint32_t esp_adc_cal_raw_to_voltage(uint32_t adc_reading, const esp_adc_cal_characteristics_t* chars) {
+    return (adc_reading * SIM_ADC_FULL_SCALE_MV + SIM_ADC_MAX_CODE / 2) / SIM_ADC_MAX_CODE;
+}
+
+esp_err_t esp_adc_cal_get_voltage(adc_channel_t channel, const esp_adc_cal_characteristics_t* chars, uint32_t* voltage) {
+    *voltage = esp_adc_cal_raw_to_voltage(adc1_get_raw(channel), chars);
+    return ESP_OK;
+}
+
+/**** GPIO ****/
+
+void gpio_pad_select_gpio(gpio_num_t gpio) {
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio, gpio_mode_t mode) {
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio, gpio_pull_mode_t pull) {
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio) {
+    return sim_gpio_read(gpio, sim_time_us()) ? 1 : 0;
+}
+
+/**** SD card ****/
+
+static sdmmc_card_t s_card = { .name = "HOST" };
+
+esp_err_t spi_bus_initialize(int host, const spi_bus_config_t* config, int dma_chan) {
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_free(int host) {
+    return ESP_OK;
+}
+
+static esp_err_t vfs_mount(const char* base_path, sdmmc_card_t** out_card) {
+    struct statvfs fs;
+    if(g_sim_sd_fail_mounts > 0) {
+        g_sim_sd_fail_mounts--;
+        return ESP_ERR_TIMEOUT;             //what the driver returns when no card answers
+    }
+    if(mkdir(base_path, 0755) != 0 && errno != EEXIST) {
+        ESP_LOGE(TAG, "Cannot create %s: %s", base_path, strerror(errno));
+        return ESP_FAIL;
+    }
+    s_card.capacity = (statvfs(base_path, &fs) == 0) ? (uint64_t)fs.f_bavail * fs.f_frsize : 0;
+    *out_card = &s_card;
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_fat_sdmmc_mount(const char* base_path, const sdmmc_host_t* host, const sdmmc_slot_config_t* slot_config,
+                                  const esp_vfs_fat_sdmmc_mount_config_t* mount_config, sdmmc_card_t** out_card) {
+    return vfs_mount(base_path, out_card);
+}
+
+esp_err_t esp_vfs_fat_sdspi_mount(const char* base_path, const sdmmc_host_t* host, const sdspi_device_config_t* slot_config,
+                                  const esp_vfs_fat_sdmmc_mount_config_t* mount_config, sdmmc_card_t** out_card) {
+    return vfs_mount(base_path, out_card);
+}
+
+esp_err_t esp_vfs_fat_sdcard_unmount(const char* base_path, sdmmc_card_t* card) {
+    return ESP_OK;
+}
+
+void sdmmc_card_print_info(FILE* stream, const sdmmc_card_t* card) {
+    fprintf(stream, "Name: %s\nType: host directory\nFree: %lluMB\n", card->name,
+        (unsigned long long)(card->capacity / (1024 * 1024)));
+}
@@ -0,0 +1,246 @@
+/* Source file for ESP-IDF system services of the host port */
+#include <string.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "nvs_flash.h"
+#include "esp_pm.h"
+#include <esp_http_server.h>
+#include "sim_port.h"
+
+esp_log_level_t g_sim_log_level = CONFIG_LOG_DEFAULT_LEVEL;
+
+esp_event_base_t const IP_EVENT = "IP_EVENT";
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+
+#define EVENT_HANDLERS_MAX      8
+
+typedef struct {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void* arg;
+} event_handler_t;
+
+static event_handler_t s_handlers[EVENT_HANDLERS_MAX];
+static int s_handler_count;
+
+/**** System ****/
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch(code) {
+        case ESP_OK:                return "ESP_OK";
+        case ESP_FAIL:              return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:  return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:       return "ESP_ERR_TIMEOUT";
+        default:                    return "UNKNOWN ERROR";
+    }
+}
+
+void esp_log_level_set(const char* tag, esp_log_level_t level) {
+    g_sim_log_level = level;
+}
+
+uint32_t esp_log_timestamp(void) {
+    return (uint32_t)(sim_time_us() / 1000);
+}
+
+int64_t esp_timer_get_time(void) {
+    return sim_time_us();
+}
+
+//heap of the device is not simulated, heap metrics read 0
+uint32_t esp_get_free_heap_size(void) {
+    return 0;
+}
+
+esp_err_t esp_read_mac(uint8_t* mac, esp_mac_type_t type) {
+    //fixed address with the Espressif OUI, last byte differs by interface as on the device
+    const uint8_t base[6] = { 0x24, 0x0a, 0xc4, 0x00, 0x00, 0x10 };
+    memcpy(mac, base, sizeof(base));
+    mac[5] += type;
+    return ESP_OK;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void) {
+    return 0;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    return 0;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return 0;
+}
+
+esp_err_t nvs_flash_init(void) {
+    return ESP_OK;
+}
+
+/* Handle is the index of the namespace, values are looked up by namespace and key */
+#define SIM_NVS_ENTRIES     16
+
+typedef struct {
+    char ns[16];
+    char key[16];
+    uint32_t value;
+} sim_nvs_entry_t;
+
+static char s_nvs_namespaces[SIM_NVS_ENTRIES][16];
+static sim_nvs_entry_t s_nvs[SIM_NVS_ENTRIES];
+static pthread_mutex_t s_nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+    pthread_mutex_lock(&s_nvs_lock);
+    for(int i = 0; i < SIM_NVS_ENTRIES; i++) {
+        //like the device, a namespace only exists once it is opened for writing
+        if(s_nvs_namespaces[i][0] == '\0' && open_mode == NVS_READWRITE) {
+            sim_strlcpy(s_nvs_namespaces[i], name, sizeof(s_nvs_namespaces[i]));
+        }
+        if(strcmp(s_nvs_namespaces[i], name) == 0) {
+            *out_handle = i;
+            err = ESP_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_nvs_lock);
+    return err;
+}
+
+static sim_nvs_entry_t* sim_nvs_find(nvs_handle_t handle, const char* key, bool create) {
+    sim_nvs_entry_t* free_entry = NULL;
+    for(int i = 0; i < SIM_NVS_ENTRIES; i++) {
+        if(strcmp(s_nvs[i].ns, s_nvs_namespaces[handle]) == 0 && strcmp(s_nvs[i].key, key) == 0) return &s_nvs[i];
+        if(free_entry == NULL && s_nvs[i].ns[0] == '\0') free_entry = &s_nvs[i];
+    }
+    if(!create || free_entry == NULL) return NULL;
+    sim_strlcpy(free_entry->ns, s_nvs_namespaces[handle], sizeof(free_entry->ns));
+    sim_strlcpy(free_entry->key, key, sizeof(free_entry->key));
+    return free_entry;
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char* key, uint32_t* out_value) {
+    pthread_mutex_lock(&s_nvs_lock);
+    sim_nvs_entry_t* entry = sim_nvs_find(handle, key, false);
+    if(entry != NULL) *out_value = entry->value;
+    pthread_mutex_unlock(&s_nvs_lock);
+    return entry != NULL ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value) {
+    pthread_mutex_lock(&s_nvs_lock);
+    sim_nvs_entry_t* entry = sim_nvs_find(handle, key, true);
+    if(entry != NULL) entry->value = value;
+    pthread_mutex_unlock(&s_nvs_lock);
+    return entry != NULL ? ESP_OK : ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+}
+
+size_t sim_strlcpy(char* dst, const char* src, size_t size) {
+    size_t len = strlen(src);
+    if(size > 0) {
+        size_t n = (len < size - 1) ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+
+/**** Power management ****/
+
+struct sim_pm_lock {
+    const char* name;
+    atomic_int count;
+};
+
+esp_err_t esp_pm_configure(const void* config) {
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg, const char* name, esp_pm_lock_handle_t* out_handle) {
+    esp_pm_lock_handle_t lock = calloc(1, sizeof(*lock));
+    if(lock == NULL) return ESP_ERR_NO_MEM;
+    lock->name = name;
+    *out_handle = lock;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle) {
+    atomic_fetch_add(&handle->count, 1);
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle) {
+    //like on the device, releasing a lock which is not held is an error
+    if(atomic_fetch_sub(&handle->count, 1) <= 0) {
+        atomic_fetch_add(&handle->count, 1);
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
+
+/**** Network events ****/
+
+esp_err_t esp_netif_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t esp_event_loop_create_default(void) {
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t handler, void* arg) {
+    if(s_handler_count == EVENT_HANDLERS_MAX) return ESP_ERR_NO_MEM;
+    s_handlers[s_handler_count++] = (event_handler_t){ event_base, event_id, handler, arg };
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id, void* event_data, size_t size, uint32_t ticks) {
+    for(int i = 0; i < s_handler_count; i++) {
+        if(strcmp(s_handlers[i].base, event_base) == 0 && (s_handlers[i].id == event_id || s_handlers[i].id == ESP_EVENT_ANY_ID)) {
+            s_handlers[i].handler(s_handlers[i].arg, event_base, event_id, event_data);
+        }
+    }
+    return ESP_OK;
+}
+
+/**** HTTP server responses ****/
+
+esp_err_t httpd_resp_set_type(httpd_req_t* req, const char* type) {
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t* req, const char* buf, ssize_t len) {
+    if(buf == NULL || len == 0) {
+        fflush(req->out);
+        return ESP_OK;
+    }
+    return fwrite(buf, 1, len, req->out) == (size_t)len ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t* req, httpd_err_code_t error, const char* msg) {
+    fprintf(req->out, "error %d: %s\n", (int)error, msg);
+    return ESP_OK;
+}
@@ -0,0 +1,261 @@
+/* Source file for FreeRTOS of the host port and the virtual clock */
+#define _GNU_SOURCE                 //pthread_setname_np
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "sim_port.h"
+
+double g_sim_time_scale = 1.0;
+static struct timespec s_start;
+static pthread_once_t s_start_once = PTHREAD_ONCE_INIT;
+
+/**** Virtual clock ****/
+
+static void clock_start(void) {
+    clock_gettime(CLOCK_MONOTONIC, &s_start);
+}
+
+int64_t sim_time_us(void) {
+    struct timespec now;
+    pthread_once(&s_start_once, clock_start);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t wall_ns = (int64_t)(now.tv_sec - s_start.tv_sec) * 1000000000 + (now.tv_nsec - s_start.tv_nsec);
+    return (int64_t)(wall_ns * g_sim_time_scale / 1000);
+}
+
+void sim_deadline(int64_t virtual_us, struct timespec* ts) {
+    pthread_once(&s_start_once, clock_start);
+    int64_t wall_ns = (int64_t)(virtual_us * 1000 / g_sim_time_scale);
+    ts->tv_sec = s_start.tv_sec + wall_ns / 1000000000;
+    ts->tv_nsec = s_start.tv_nsec + wall_ns % 1000000000;
+    if(ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+void sim_sleep_until(int64_t virtual_us) {
+    struct timespec ts;
+    sim_deadline(virtual_us, &ts);
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+/* Deadline of a wait of ticks from now, false if the wait has no timeout */
+static bool tick_deadline(TickType_t ticks, struct timespec* ts) {
+    if(ticks == portMAX_DELAY) return false;
+    sim_deadline(sim_time_us() + (int64_t)ticks * portTICK_PERIOD_MS * 1000, ts);
+    return true;
+}
+
+/* Wait on cond until deadline, ETIMEDOUT once it has passed */
+static int cond_wait(pthread_cond_t* cond, pthread_mutex_t* lock, bool timed, const struct timespec* ts) {
+    return timed ? pthread_cond_timedwait(cond, lock, ts) : pthread_cond_wait(cond, lock);
+}
+
+static void cond_init(pthread_cond_t* cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/**** Tasks ****/
+
+static void* task_entry(void* arg) {
+    StaticTask_t* task = arg;
+    task->function(task->param);
+    return NULL;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack, void* param,
+                                           UBaseType_t prio, StackType_t* stack_buffer, StaticTask_t* task, BaseType_t core) {
+    pthread_attr_t attr;
+    task->function = fn;
+    task->param = param;
+    //task stack of the device is far too small for host libc, host default is used instead
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int ret = pthread_create(&task->thread, &attr, task_entry, task);
+    pthread_attr_destroy(&attr);
+    if(ret != 0) return NULL;
+    char thread_name[16];
+    strncpy(thread_name, name, sizeof(thread_name) - 1);
+    thread_name[sizeof(thread_name) - 1] = '\0';
+    pthread_setname_np(task->thread, thread_name);
+    return task;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack, void* param,
+                                   UBaseType_t prio, TaskHandle_t* handle, BaseType_t core) {
+    StaticTask_t* task = malloc(sizeof(StaticTask_t));
+    if(task == NULL) return pdFAIL;
+    TaskHandle_t created = xTaskCreateStaticPinnedToCore(fn, name, stack, param, prio, NULL, task, core);
+    if(created == NULL) {
+        free(task);
+        return pdFAIL;
+    }
+    if(handle != NULL) *handle = created;
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    //only deletion of the calling task is used by the application
+    if(task == NULL) pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    sim_sleep_until(sim_time_us() + (int64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(sim_time_us() / 1000 / portTICK_PERIOD_MS);
+}
+
+/**** Queues and semaphores ****/
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t* storage, StaticQueue_t* queue) {
+    pthread_mutex_init(&queue->lock, NULL);
+    cond_init(&queue->not_empty);
+    cond_init(&queue->not_full);
+    queue->storage = storage;
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->head = 0;
+    queue->count = 0;
+    return queue;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    StaticQueue_t* queue = malloc(sizeof(StaticQueue_t) + length * item_size);
+    if(queue == NULL) return NULL;
+    return xQueueCreateStatic(length, item_size, (uint8_t*)(queue + 1), queue);
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    //static queues are never deleted by the application
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+    struct timespec ts;
+    bool timed = tick_deadline(ticks_to_wait, &ts);
+    pthread_mutex_lock(&queue->lock);
+    while(queue->count == queue->length) {
+        if(ticks_to_wait == 0 || cond_wait(&queue->not_full, &queue->lock, timed, &ts) == ETIMEDOUT) {
+            pthread_mutex_unlock(&queue->lock);
+            return pdFALSE;
+        }
+    }
+    UBaseType_t tail = (queue->head + queue->count) % queue->length;
+    if(queue->item_size > 0) {
+        memcpy(queue->storage + tail * queue->item_size, item, queue->item_size);
+    }
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticks_to_wait) {
+    struct timespec ts;
+    bool timed = tick_deadline(ticks_to_wait, &ts);
+    pthread_mutex_lock(&queue->lock);
+    while(queue->count == 0) {
+        if(ticks_to_wait == 0 || cond_wait(&queue->not_empty, &queue->lock, timed, &ts) == ETIMEDOUT) {
+            pthread_mutex_unlock(&queue->lock);
+            return pdFALSE;
+        }
+    }
+    if(queue->item_size > 0) {
+        memcpy(buffer, queue->storage + queue->head * queue->item_size, queue->item_size);
+    }
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t* mutex) {
+    QueueHandle_t queue = xQueueCreateStatic(1, 0, NULL, mutex);
+    xQueueSend(queue, NULL, 0);             //mutex starts available
+    return queue;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    QueueHandle_t queue = xQueueCreate(1, 0);
+    if(queue != NULL) xQueueSend(queue, NULL, 0);
+    return queue;
+}
+
+/**** Event groups ****/
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t* group) {
+    pthread_mutex_init(&group->lock, NULL);
+    cond_init(&group->changed);
+    group->bits = 0;
+    return group;
+}
+
+EventGroupHandle_t xEventGroupCreate(void) {
+    StaticEventGroup_t* group = malloc(sizeof(StaticEventGroup_t));
+    return group != NULL ? xEventGroupCreateStatic(group) : NULL;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    pthread_mutex_lock(&group->lock);
+    group->bits |= bits;
+    EventBits_t result = group->bits;
+    pthread_cond_broadcast(&group->changed);
+    pthread_mutex_unlock(&group->lock);
+    return result;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    pthread_mutex_lock(&group->lock);
+    EventBits_t prev = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return prev;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    pthread_mutex_lock(&group->lock);
+    EventBits_t bits = group->bits;
+    pthread_mutex_unlock(&group->lock);
+    return bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks_to_wait) {
+    struct timespec ts;
+    bool timed = tick_deadline(ticks_to_wait, &ts);
+    pthread_mutex_lock(&group->lock);
+    while(1) {
+        EventBits_t set = group->bits & bits;
+        if(wait_for_all ? set == bits : set != 0) break;
+        if(ticks_to_wait == 0 || cond_wait(&group->changed, &group->lock, timed, &ts) == ETIMEDOUT) break;
+    }
+    //like FreeRTOS, bits before clearing are returned, also on timeout
+    EventBits_t result = group->bits;
+    if(clear_on_exit && (wait_for_all ? (result & bits) == bits : (result & bits) != 0)) {
+        group->bits &= ~bits;
+    }
+    pthread_mutex_unlock(&group->lock);
+    return result;
+}
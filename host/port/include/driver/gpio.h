@@ -0,0 +1,17 @@
+/* GPIO of the host port, inputs are read from the simulated signals (sim_port.h) */
+#ifndef _DRIVER_GPIO_H_
+#define _DRIVER_GPIO_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef int gpio_num_t;
+typedef enum { GPIO_MODE_DISABLE = 0, GPIO_MODE_INPUT, GPIO_MODE_OUTPUT } gpio_mode_t;
+typedef enum { GPIO_PULLUP_ONLY = 0, GPIO_PULLDOWN_ONLY, GPIO_PULLUP_PULLDOWN, GPIO_FLOATING } gpio_pull_mode_t;
+
+void gpio_pad_select_gpio(gpio_num_t gpio);
+esp_err_t gpio_set_direction(gpio_num_t gpio, gpio_mode_t mode);
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio, gpio_pull_mode_t pull);
+int gpio_get_level(gpio_num_t gpio);
+
+#endif
@@ -0,0 +1 @@
+/* Peripheral clocks are not simulated */
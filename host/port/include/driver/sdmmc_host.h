@@ -0,0 +1,26 @@
+/* SD card host of the host port, the card is a directory (see esp_vfs_fat.h) */
+#ifndef _DRIVER_SDMMC_HOST_H_
+#define _DRIVER_SDMMC_HOST_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+typedef struct {
+    int slot;
+} sdmmc_host_t;
+
+typedef struct {
+    int width;
+} sdmmc_slot_config_t;
+
+typedef struct {
+    char name[8];
+    uint64_t capacity;              //bytes free on the host file system at mount
+} sdmmc_card_t;
+
+#define SDMMC_HOST_DEFAULT()        ((sdmmc_host_t){ .slot = 1 })
+#define SDMMC_SLOT_CONFIG_DEFAULT() ((sdmmc_slot_config_t){ .width = 4 })
+
+#endif
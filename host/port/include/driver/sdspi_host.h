@@ -0,0 +1,14 @@
+#ifndef _DRIVER_SDSPI_HOST_H_
+#define _DRIVER_SDSPI_HOST_H_
+
+#include "driver/sdmmc_host.h"
+
+typedef struct {
+    int host_id;
+    int gpio_cs;
+} sdspi_device_config_t;
+
+#define SDSPI_HOST_DEFAULT()            ((sdmmc_host_t){ .slot = 2 })
+#define SDSPI_DEVICE_CONFIG_DEFAULT()   ((sdspi_device_config_t){ .host_id = 2, .gpio_cs = -1 })
+
+#endif
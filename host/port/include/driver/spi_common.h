@@ -0,0 +1,18 @@
+#ifndef _DRIVER_SPI_COMMON_H_
+#define _DRIVER_SPI_COMMON_H_
+
+#include "esp_err.h"
+
+typedef struct {
+    int mosi_io_num;
+    int miso_io_num;
+    int sclk_io_num;
+    int quadwp_io_num;
+    int quadhd_io_num;
+    int max_transfer_sz;
+} spi_bus_config_t;
+
+esp_err_t spi_bus_initialize(int host, const spi_bus_config_t* config, int dma_chan);
+esp_err_t spi_bus_free(int host);
+
+#endif
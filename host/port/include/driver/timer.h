@@ -0,0 +1,43 @@
+/* General purpose timer of the host port, alarms run on the virtual clock */
+#ifndef _DRIVER_TIMER_H_
+#define _DRIVER_TIMER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define TIMER_BASE_CLK          80000000    //APB clock
+#define ESP_INTR_FLAG_IRAM      (1 << 10)
+
+typedef enum { TIMER_GROUP_0 = 0, TIMER_GROUP_1, TIMER_GROUP_MAX } timer_group_t;
+typedef enum { TIMER_0 = 0, TIMER_1, TIMER_MAX } timer_idx_t;
+typedef enum { TIMER_COUNT_DOWN = 0, TIMER_COUNT_UP } timer_count_dir_t;
+typedef enum { TIMER_PAUSE = 0, TIMER_START } timer_start_t;
+typedef enum { TIMER_ALARM_DIS = 0, TIMER_ALARM_EN } timer_alarm_t;
+
+typedef struct {
+    timer_alarm_t alarm_en;
+    timer_start_t counter_en;
+    timer_count_dir_t counter_dir;
+    bool auto_reload;
+    uint32_t divider;
+} timer_config_t;
+
+typedef void* timer_isr_handle_t;
+
+esp_err_t timer_init(timer_group_t group, timer_idx_t idx, const timer_config_t* config);
+esp_err_t timer_set_counter_value(timer_group_t group, timer_idx_t idx, uint64_t value);
+esp_err_t timer_get_counter_value(timer_group_t group, timer_idx_t idx, uint64_t* value);
+esp_err_t timer_set_alarm_value(timer_group_t group, timer_idx_t idx, uint64_t value);
+esp_err_t timer_enable_intr(timer_group_t group, timer_idx_t idx);
+esp_err_t timer_isr_register(timer_group_t group, timer_idx_t idx, void (*fn)(void*), void* arg,
+                             int intr_alloc_flags, timer_isr_handle_t* handle);
+esp_err_t timer_start(timer_group_t group, timer_idx_t idx);
+
+/* Alarm is re-armed by the host timer itself, ISR helpers have nothing to do */
+#define timer_spinlock_take(group)                          ((void)(group))
+#define timer_spinlock_give(group)                          ((void)(group))
+#define timer_group_clr_intr_status_in_isr(group, idx)      ((void)(group), (void)(idx))
+#define timer_group_enable_alarm_in_isr(group, idx)         ((void)(group), (void)(idx))
+
+#endif
@@ -0,0 +1,32 @@
+/* ADC calibration of the host port: linear, full scale of 11 dB attenuation */
+#ifndef _ESP_ADC_CAL_H_
+#define _ESP_ADC_CAL_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/adc.h"
+
+#define SIM_ADC_FULL_SCALE_MV   3300
+#define SIM_ADC_MAX_CODE        4095
+#define SIM_ADC_SPIKE_EVERY     97          //one conversion in this many reads full scale or zero, 0 = never
+
+typedef enum {
+    ESP_ADC_CAL_VAL_EFUSE_VREF = 0,
+    ESP_ADC_CAL_VAL_EFUSE_TP,
+    ESP_ADC_CAL_VAL_DEFAULT_VREF,
+} esp_adc_cal_value_t;
+
+typedef struct {
+    adc_unit_t adc_num;
+    adc_atten_t atten;
+    adc_bits_width_t bit_width;
+    uint32_t vref;
+} esp_adc_cal_characteristics_t;
+
+esp_err_t esp_adc_cal_check_efuse(esp_adc_cal_value_t value_type);
+esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t adc_num, adc_atten_t atten, adc_bits_width_t bit_width,
+                                             uint32_t default_vref, esp_adc_cal_characteristics_t* chars);
+uint32_t esp_adc_cal_raw_to_voltage(uint32_t adc_reading, const esp_adc_cal_characteristics_t* chars);
+esp_err_t esp_adc_cal_get_voltage(adc_channel_t channel, const esp_adc_cal_characteristics_t* chars, uint32_t* voltage);
+
+#endif
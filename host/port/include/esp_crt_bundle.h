@@ -0,0 +1,8 @@
+#ifndef _ESP_CRT_BUNDLE_H_
+#define _ESP_CRT_BUNDLE_H_
+
+#include "mbedtls/ssl.h"
+
+int esp_crt_bundle_attach(void* conf);
+
+#endif
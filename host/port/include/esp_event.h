@@ -0,0 +1,25 @@
+/* Default event loop of the host port, handlers are called directly from the posting task */
+#ifndef _ESP_EVENT_H_
+#define _ESP_EVENT_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef const char* esp_event_base_t;
+typedef void (*esp_event_handler_t)(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data);
+
+#define ESP_EVENT_ANY_ID        -1
+
+extern esp_event_base_t const IP_EVENT;
+extern esp_event_base_t const WIFI_EVENT;
+
+typedef enum {
+    IP_EVENT_STA_GOT_IP = 0,
+    IP_EVENT_STA_LOST_IP,
+} ip_event_t;
+
+esp_err_t esp_event_loop_create_default(void);
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id, esp_event_handler_t handler, void* arg);
+esp_err_t esp_event_post(esp_event_base_t event_base, int32_t event_id, void* event_data, size_t size, uint32_t ticks);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef _ESP_HEAP_CAPS_H_
+#define _ESP_HEAP_CAPS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_8BIT     (1 << 2)
+
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+
+#endif
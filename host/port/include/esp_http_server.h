@@ -0,0 +1,31 @@
+/*
+ *  HTTP server of the host port
+ *  Handlers of the application can be called directly with a request whose response is
+ *  written to a file, the server itself is not simulated.
+ */
+
+#ifndef _ESP_HTTP_SERVER_H_
+#define _ESP_HTTP_SERVER_H_
+
+#include <stdio.h>
+#include <sys/types.h>
+#include "esp_err.h"
+
+typedef void* httpd_handle_t;
+
+typedef struct httpd_req {
+    const char* uri;
+    FILE* out;                  //response body is written here
+} httpd_req_t;
+
+typedef enum {
+    HTTPD_400_BAD_REQUEST = 0,
+    HTTPD_404_NOT_FOUND,
+    HTTPD_500_INTERNAL_SERVER_ERROR,
+} httpd_err_code_t;
+
+esp_err_t httpd_resp_set_type(httpd_req_t* req, const char* type);
+esp_err_t httpd_resp_send_chunk(httpd_req_t* req, const char* buf, ssize_t len);
+esp_err_t httpd_resp_send_err(httpd_req_t* req, httpd_err_code_t error, const char* msg);
+
+#endif
@@ -0,0 +1,38 @@
+/* Logging of the host port, lines are printed to stdout with virtual time like on the device UART */
+#ifndef _ESP_LOG_H_
+#define _ESP_LOG_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+typedef enum {
+    ESP_LOG_NONE = 0,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+extern esp_log_level_t g_sim_log_level;
+
+/**
+ * @brief Set log level, the host port has one level for every tag
+ */
+void esp_log_level_set(const char* tag, esp_log_level_t level);
+
+uint32_t esp_log_timestamp(void);
+
+#define ESP_LOG_LEVEL(level, letter, tag, format, ...) do { \
+        if(g_sim_log_level >= (level)) { \
+            printf(letter " (%u) %s: " format "\n", esp_log_timestamp(), tag, ##__VA_ARGS__); \
+        } \
+    } while(0)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_ERROR, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_WARN, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_INFO, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_DEBUG, "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESP_LOG_LEVEL(ESP_LOG_VERBOSE, "V", tag, format, ##__VA_ARGS__)
+
+#endif
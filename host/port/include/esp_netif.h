@@ -0,0 +1,22 @@
+/* Network interface of the host port, the host network stack is used as it is */
+#ifndef _ESP_NETIF_H_
+#define _ESP_NETIF_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct esp_netif_obj esp_netif_t;
+
+typedef struct {
+    uint32_t addr;
+} esp_ip4_addr_t;
+
+typedef struct {
+    esp_ip4_addr_t ip;
+    esp_ip4_addr_t netmask;
+    esp_ip4_addr_t gw;
+} esp_netif_ip_info_t;
+
+esp_err_t esp_netif_init(void);
+
+#endif
@@ -0,0 +1,19 @@
+/* System functions of the host port, heap of the device is not simulated */
+#ifndef _ESP_SYSTEM_H_
+#define _ESP_SYSTEM_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_MAC_WIFI_STA = 0,
+    ESP_MAC_WIFI_SOFTAP,
+    ESP_MAC_BT,
+    ESP_MAC_ETH,
+} esp_mac_type_t;
+
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+esp_err_t esp_read_mac(uint8_t* mac, esp_mac_type_t type);
+
+#endif
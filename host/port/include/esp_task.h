@@ -0,0 +1,9 @@
+#ifndef _ESP_TASK_H_
+#define _ESP_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+#define ESP_TASK_PRIO_MAX       (configMAX_PRIORITIES)
+#define ESP_TASKD_EVENT_PRIO    (ESP_TASK_PRIO_MAX - 5)
+
+#endif
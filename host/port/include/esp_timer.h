@@ -0,0 +1,12 @@
+/* esp_timer of the host port, runs on the virtual clock (sim_port.h) */
+#ifndef _ESP_TIMER_H_
+#define _ESP_TIMER_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Virtual microseconds since start of the simulation
+ */
+int64_t esp_timer_get_time(void);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _ESP_TYPES_H_
+#define _ESP_TYPES_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#endif
@@ -0,0 +1,29 @@
+/*
+ *  FAT file system of the host port
+ *  Mounting creates the mount point as a directory of the host file system, so files of the
+ *  application are plain files below it. Set g_sim_sd_fail_mounts to make the first mounts fail.
+ */
+
+#ifndef _ESP_VFS_FAT_H_
+#define _ESP_VFS_FAT_H_
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/sdmmc_host.h"
+#include "driver/sdspi_host.h"
+
+typedef struct {
+    bool format_if_mount_failed;
+    int max_files;
+    size_t allocation_unit_size;
+} esp_vfs_fat_sdmmc_mount_config_t;
+
+extern int g_sim_sd_fail_mounts;                //mount attempts that fail before the card is found
+
+esp_err_t esp_vfs_fat_sdmmc_mount(const char* base_path, const sdmmc_host_t* host, const sdmmc_slot_config_t* slot_config,
+                                  const esp_vfs_fat_sdmmc_mount_config_t* mount_config, sdmmc_card_t** out_card);
+esp_err_t esp_vfs_fat_sdspi_mount(const char* base_path, const sdmmc_host_t* host, const sdspi_device_config_t* slot_config,
+                                  const esp_vfs_fat_sdmmc_mount_config_t* mount_config, sdmmc_card_t** out_card);
+esp_err_t esp_vfs_fat_sdcard_unmount(const char* base_path, sdmmc_card_t* card);
+
+#endif
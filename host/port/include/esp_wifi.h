@@ -0,0 +1,9 @@
+/* Wi-Fi of the host port: the station is connected as soon as wifi_connect is called */
+#ifndef _ESP_WIFI_H_
+#define _ESP_WIFI_H_
+
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+
+#endif
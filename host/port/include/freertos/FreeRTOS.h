@@ -0,0 +1,85 @@
+/*
+ *  FreeRTOS of the host port
+ *  Tasks are POSIX threads, queues, semaphores and event groups are built on a mutex and
+ *  condition variables. Priorities and core affinity are accepted but not enforced: the
+ *  host scheduler runs every task in parallel.
+ */
+
+#ifndef _FREERTOS_H_
+#define _FREERTOS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "sdkconfig.h"
+#include "sim_port.h"
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;            //one byte like ESP-IDF, stack sizes are in bytes
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ      CONFIG_FREERTOS_HZ
+#define configMAX_PRIORITIES    25
+#define portTICK_PERIOD_MS      ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portTICK_RATE_MS        portTICK_PERIOD_MS
+#define pdMS_TO_TICKS(ms)       ((TickType_t)((uint64_t)(ms) * configTICK_RATE_HZ / 1000))
+#define portNUM_PROCESSORS      2
+#define tskNO_AFFINITY          0x7FFFFFFF
+
+/* Critical sections only exclude other tasks entering the same section */
+typedef pthread_mutex_t portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED    PTHREAD_MUTEX_INITIALIZER
+#define portENTER_CRITICAL(mux)         pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL(mux)          pthread_mutex_unlock(mux)
+#define portENTER_CRITICAL_ISR(mux)     pthread_mutex_lock(mux)
+#define portEXIT_CRITICAL_ISR(mux)      pthread_mutex_unlock(mux)
+
+#define IRAM_ATTR
+
+#ifndef BIT0
+#define BIT0    0x00000001
+#define BIT1    0x00000002
+#define BIT2    0x00000004
+#define BIT3    0x00000008
+#define BIT4    0x00000010
+#define BIT5    0x00000020
+#define BIT6    0x00000040
+#define BIT7    0x00000080
+#endif
+
+/* Control blocks, static variants are the host objects themselves */
+typedef struct sim_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint8_t* storage;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+} StaticQueue_t;
+
+typedef StaticQueue_t StaticSemaphore_t;
+
+typedef uint32_t EventBits_t;
+
+typedef struct sim_event_group {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    EventBits_t bits;
+} StaticEventGroup_t;
+
+typedef struct sim_task {
+    pthread_t thread;
+    void (*function)(void*);
+    void* param;
+} StaticTask_t;
+
+#endif
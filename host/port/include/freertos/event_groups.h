@@ -0,0 +1,16 @@
+#ifndef _FREERTOS_EVENT_GROUPS_H_
+#define _FREERTOS_EVENT_GROUPS_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct sim_event_group* EventGroupHandle_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t* group);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks_to_wait);
+
+#endif
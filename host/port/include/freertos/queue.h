@@ -0,0 +1,19 @@
+#ifndef _FREERTOS_QUEUE_H_
+#define _FREERTOS_QUEUE_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct sim_queue* QueueHandle_t;
+typedef QueueHandle_t xQueueHandle;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t* storage, StaticQueue_t* queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticks_to_wait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+void vQueueDelete(QueueHandle_t queue);
+
+#define xQueueSendToBack(queue, item, ticks)    xQueueSend(queue, item, ticks)
+#define xQueueSendFromISR(queue, item, woken)   xQueueSend(queue, item, 0)
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef _FREERTOS_SEMPHR_H_
+#define _FREERTOS_SEMPHR_H_
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+/* A mutex is a queue of one empty item, taking it receives the item */
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t* mutex);
+
+#define xSemaphoreTake(sem, ticks)      xQueueReceive(sem, NULL, ticks)
+#define xSemaphoreGive(sem)             xQueueSend(sem, NULL, 0)
+#define vSemaphoreDelete(sem)           vQueueDelete(sem)
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef _FREERTOS_TASK_H_
+#define _FREERTOS_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct sim_task* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+/* Only used for sizing on the host, runtime statistics are not simulated */
+typedef struct {
+    TaskHandle_t xHandle;
+    const char* pcTaskName;
+    UBaseType_t xTaskNumber;
+    UBaseType_t uxCurrentPriority;
+    uint32_t ulRunTimeCounter;
+    uint32_t usStackHighWaterMark;
+    BaseType_t xCoreID;
+} TaskStatus_t;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack, void* param,
+                                   UBaseType_t prio, TaskHandle_t* handle, BaseType_t core);
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char* name, uint32_t stack, void* param,
+                                           UBaseType_t prio, StackType_t* stack_buffer, StaticTask_t* task, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+
+#define xTaskCreate(fn, name, stack, param, prio, handle) \
+    xTaskCreatePinnedToCore(fn, name, stack, param, prio, handle, tskNO_AFFINITY)
+
+#endif
@@ -0,0 +1 @@
+/* Nothing of lwIP dns is used by the application */
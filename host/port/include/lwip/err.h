@@ -0,0 +1 @@
+/* Nothing of lwIP err is used by the application */
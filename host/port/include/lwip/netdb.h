@@ -0,0 +1,6 @@
+#ifndef _LWIP_NETDB_H_
+#define _LWIP_NETDB_H_
+
+#include <netdb.h>
+
+#endif
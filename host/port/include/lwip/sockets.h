@@ -0,0 +1,13 @@
+/* lwIP socket API of the host port, mapped to the host BSD sockets */
+#ifndef _LWIP_SOCKETS_H_
+#define _LWIP_SOCKETS_H_
+
+#include <errno.h>
+#include <unistd.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#endif
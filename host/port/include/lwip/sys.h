@@ -0,0 +1 @@
+/* Nothing of lwIP sys is used by the application */
@@ -0,0 +1 @@
+#include "mbedtls/ssl.h"
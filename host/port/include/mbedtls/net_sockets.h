@@ -0,0 +1,12 @@
+#ifndef _MBEDTLS_NET_SOCKETS_H_
+#define _MBEDTLS_NET_SOCKETS_H_
+
+#include "mbedtls/ssl.h"
+
+void mbedtls_net_init(mbedtls_net_context* ctx);
+int mbedtls_net_connect(mbedtls_net_context* ctx, const char* host, const char* port, int proto);
+int mbedtls_net_send(void* ctx, const unsigned char* buf, size_t len);
+int mbedtls_net_recv_timeout(void* ctx, unsigned char* buf, size_t len, uint32_t timeout);
+void mbedtls_net_free(mbedtls_net_context* ctx);
+
+#endif
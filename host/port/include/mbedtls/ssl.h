@@ -0,0 +1,112 @@
+/*
+ *  TLS of the host port
+ *  Same API as the mbedtls subset used by https_client.c, but records are sent in clear over
+ *  a plain TCP connection, so the local HTTP stub of the simulation can read them.
+ *  Handshakes take no time. A session offered with mbedtls_ssl_set_session is always resumed,
+ *  so keep-alive and resumption logic of the client runs as on the device. Like mbedtls, a resumed
+ *  handshake goes from the server hello to the server change cipher spec without the certificate.
+ *
+ *  The TLS functions are in port/mbedtls_host.c and the sockets in port/mbedtls_net_host.c.
+ *  test/tls_openssl.c implements the same TLS functions with OpenSSL, to check the client
+ *  against a real TLS server; the impl fields hold its objects.
+ */
+
+#ifndef _MBEDTLS_SSL_H_
+#define _MBEDTLS_SSL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MBEDTLS_SSL_IS_CLIENT               0
+#define MBEDTLS_SSL_TRANSPORT_STREAM        0
+#define MBEDTLS_SSL_PRESET_DEFAULT          0
+#define MBEDTLS_SSL_VERIFY_REQUIRED         2
+#define MBEDTLS_NET_PROTO_TCP               0
+#define MBEDTLS_ERR_SSL_WANT_READ           -0x6900
+#define MBEDTLS_ERR_SSL_WANT_WRITE          -0x6880
+#define MBEDTLS_ERR_NET_CONNECT_FAILED      -0x0044
+#define MBEDTLS_ERR_NET_SEND_FAILED         -0x004E
+#define MBEDTLS_ERR_NET_RECV_FAILED         -0x004C
+#define MBEDTLS_ERR_SSL_TIMEOUT             -0x6800
+#define MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY   -0x7880
+#define MBEDTLS_ERR_SSL_ALLOC_FAILED        -0x7F00
+#define MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE -0x7780
+#define MBEDTLS_ERR_X509_INVALID_FORMAT     -0x2180
+#define MBEDTLS_ERR_X509_CERT_VERIFY_FAILED -0x2700
+
+/* Client handshake states used by the client, values as in mbedtls */
+typedef enum {
+    MBEDTLS_SSL_HELLO_REQUEST = 0,
+    MBEDTLS_SSL_SERVER_CERTIFICATE = 3,
+    MBEDTLS_SSL_SERVER_CHANGE_CIPHER_SPEC = 12,
+    MBEDTLS_SSL_HANDSHAKE_OVER = 16,
+} mbedtls_ssl_states;
+
+typedef int (*mbedtls_ssl_send_t)(void* ctx, const unsigned char* buf, size_t len);
+typedef int (*mbedtls_ssl_recv_t)(void* ctx, unsigned char* buf, size_t len);
+typedef int (*mbedtls_ssl_recv_timeout_t)(void* ctx, unsigned char* buf, size_t len, uint32_t timeout);
+
+typedef struct { int unused; } mbedtls_entropy_context;
+typedef struct { int unused; } mbedtls_ctr_drbg_context;
+typedef struct { void* impl; } mbedtls_x509_crt;
+
+typedef struct {
+    int fd;
+} mbedtls_net_context;
+
+typedef struct {
+    unsigned char id[32];
+    size_t id_len;
+    void* impl;
+} mbedtls_ssl_session;
+
+typedef struct {
+    uint32_t read_timeout;
+    void* impl;
+} mbedtls_ssl_config;
+
+typedef struct {
+    const mbedtls_ssl_config* conf;
+    int state;                              //mbedtls_ssl_states
+    mbedtls_ssl_session* session;           //session of current connection, NULL before handshake
+    mbedtls_ssl_session session_storage;
+    mbedtls_ssl_session offered;
+    void* p_bio;
+    mbedtls_ssl_send_t f_send;
+    mbedtls_ssl_recv_timeout_t f_recv_timeout;
+    void* impl;
+} mbedtls_ssl_context;
+
+int mbedtls_entropy_func(void* data, unsigned char* output, size_t len);
+void mbedtls_entropy_init(mbedtls_entropy_context* ctx);
+void mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context* ctx);
+int mbedtls_ctr_drbg_seed(mbedtls_ctr_drbg_context* ctx, int (*f_entropy)(void*, unsigned char*, size_t), void* p_entropy,
+                          const unsigned char* custom, size_t len);
+int mbedtls_ctr_drbg_random(void* p_rng, unsigned char* output, size_t len);
+void mbedtls_x509_crt_init(mbedtls_x509_crt* crt);
+int mbedtls_x509_crt_parse(mbedtls_x509_crt* chain, const unsigned char* buf, size_t len);
+
+void mbedtls_ssl_config_init(mbedtls_ssl_config* conf);
+int mbedtls_ssl_config_defaults(mbedtls_ssl_config* conf, int endpoint, int transport, int preset);
+void mbedtls_ssl_conf_authmode(mbedtls_ssl_config* conf, int authmode);
+void mbedtls_ssl_conf_ca_chain(mbedtls_ssl_config* conf, mbedtls_x509_crt* ca_chain, void* ca_crl);
+void mbedtls_ssl_conf_rng(mbedtls_ssl_config* conf, int (*f_rng)(void*, unsigned char*, size_t), void* p_rng);
+void mbedtls_ssl_conf_read_timeout(mbedtls_ssl_config* conf, uint32_t timeout);
+
+void mbedtls_ssl_init(mbedtls_ssl_context* ssl);
+int mbedtls_ssl_setup(mbedtls_ssl_context* ssl, const mbedtls_ssl_config* conf);
+int mbedtls_ssl_session_reset(mbedtls_ssl_context* ssl);
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context* ssl, const char* hostname);
+void mbedtls_ssl_set_bio(mbedtls_ssl_context* ssl, void* p_bio, mbedtls_ssl_send_t f_send, mbedtls_ssl_recv_t f_recv,
+                         mbedtls_ssl_recv_timeout_t f_recv_timeout);
+int mbedtls_ssl_set_session(mbedtls_ssl_context* ssl, const mbedtls_ssl_session* session);
+int mbedtls_ssl_get_session(const mbedtls_ssl_context* ssl, mbedtls_ssl_session* session);
+int mbedtls_ssl_handshake(mbedtls_ssl_context* ssl);
+int mbedtls_ssl_handshake_step(mbedtls_ssl_context* ssl);
+int mbedtls_ssl_write(mbedtls_ssl_context* ssl, const unsigned char* buf, size_t len);
+int mbedtls_ssl_read(mbedtls_ssl_context* ssl, unsigned char* buf, size_t len);
+int mbedtls_ssl_close_notify(mbedtls_ssl_context* ssl);
+void mbedtls_ssl_session_init(mbedtls_ssl_session* session);
+void mbedtls_ssl_session_free(mbedtls_ssl_session* session);
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ *  MQTT client of the host port
+ *  Same API as the esp-mqtt subset used by uplink_mqtt.c, with a broker stand-in instead of a
+ *  connection: published messages are kept in memory so tests can read them back, and broker
+ *  events (connection, PUBACK) are raised by the sim_mqtt_* hooks. Event handlers run on the
+ *  thread calling the hook, like they run on the MQTT task of the device.
+ */
+#ifndef _MQTT_CLIENT_H_
+#define _MQTT_CLIENT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_event.h"
+
+#define SIM_MQTT_MAX_MESSAGES   16          //messages kept by the broker stand-in, oldest are dropped
+#define SIM_MQTT_MAX_PAYLOAD    4096
+#define SIM_MQTT_MAX_TOPIC      64
+
+typedef enum {
+    MQTT_EVENT_ANY = -1,
+    MQTT_EVENT_ERROR = 0,
+    MQTT_EVENT_CONNECTED,
+    MQTT_EVENT_DISCONNECTED,
+    MQTT_EVENT_SUBSCRIBED,
+    MQTT_EVENT_UNSUBSCRIBED,
+    MQTT_EVENT_PUBLISHED,
+    MQTT_EVENT_DATA,
+    MQTT_EVENT_BEFORE_CONNECT,
+} esp_mqtt_event_id_t;
+
+typedef struct esp_mqtt_client* esp_mqtt_client_handle_t;
+
+typedef struct {
+    esp_mqtt_event_id_t event_id;
+    esp_mqtt_client_handle_t client;
+    int msg_id;
+    int session_present;
+} esp_mqtt_event_t;
+
+typedef esp_mqtt_event_t* esp_mqtt_event_handle_t;
+
+typedef struct {
+    const char* uri;
+    const char* client_id;
+    bool disable_clean_session;
+    int keepalive;
+} esp_mqtt_client_config_t;
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t* config);
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler, void* event_handler_arg);
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client);
+
+/**
+ * @brief Publish a message, it is stored by the broker stand-in
+ *
+ * @return int message id (> 0 for QoS 1), 0 for QoS 0, -1 if client is not started
+ */
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len, int qos, int retain);
+
+/* One message received by the broker stand-in */
+typedef struct {
+    int msg_id;
+    int qos;
+    char topic[SIM_MQTT_MAX_TOPIC];
+    uint8_t payload[SIM_MQTT_MAX_PAYLOAD];
+    size_t len;
+} sim_mqtt_message_t;
+
+/**
+ * @brief Raise MQTT_EVENT_CONNECTED or MQTT_EVENT_DISCONNECTED
+ */
+void sim_mqtt_set_connected(bool connected);
+
+/**
+ * @brief Raise MQTT_EVENT_PUBLISHED for a QoS 1 message, as when its PUBACK arrives
+ */
+void sim_mqtt_puback(int msg_id);
+
+/**
+ * @brief Messages published since the last sim_mqtt_clear, oldest first
+ *
+ * @return size_t number of messages in *messages
+ */
+size_t sim_mqtt_messages(const sim_mqtt_message_t** messages);
+
+/**
+ * @brief Forget published messages
+ */
+void sim_mqtt_clear(void);
+
+/**
+ * @brief Configuration given to esp_mqtt_client_init, NULL before it is called
+ */
+const esp_mqtt_client_config_t* sim_mqtt_config(void);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _NVS_FLASH_H_
+#define _NVS_FLASH_H_
+
+#include "nvs.h"
+
+esp_err_t nvs_flash_init(void);
+
+#endif
@@ -0,0 +1,16 @@
+/*
+ *  Configuration of the host simulation build, stands in for the generated sdkconfig.h
+ *  Only options read by application code are defined.
+ */
+
+#ifndef _SDKCONFIG_H_
+#define _SDKCONFIG_H_
+
+#define CONFIG_IDF_TARGET_ESP32                     1
+#define CONFIG_FREERTOS_HZ                          100
+#define CONFIG_FREERTOS_SUPPORT_STATIC_ALLOCATION   1
+#define CONFIG_LOG_DEFAULT_LEVEL                    3
+#define CONFIG_PM_ENABLE                            1       //locks are counted, light sleep is not simulated
+//runtime statistics of tasks are not simulated => profiler reports them as disabled
+
+#endif
@@ -0,0 +1,15 @@
+/*
+ *  Included before every source of the host build
+ *  Functions of newlib used by the application which host C libraries may lack.
+ */
+
+#ifndef _SIM_COMPAT_H_
+#define _SIM_COMPAT_H_
+
+#include <stddef.h>
+
+#define strlcpy sim_strlcpy
+
+size_t sim_strlcpy(char* dst, const char* src, size_t size);
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ *  Header file for the host port
+ *  ESP-IDF and FreeRTOS calls of the application are mapped to POSIX threads and files.
+ *  Time of the simulated device runs g_sim_time_scale times faster than wall time: every
+ *  delay, timeout, timer alarm and esp_timer_get_time() uses the same virtual clock, so the
+ *  application behaves as on a device while a day of sampling takes seconds.
+ *
+ *  Simulated peripherals (ADC, GPIO) are read through the sim_* hooks, which are
+ *  implemented by the simulation (host/sim).
+ */
+
+#ifndef _SIM_PORT_H_
+#define _SIM_PORT_H_
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+
+extern double g_sim_time_scale;                 //virtual seconds per wall second, set before app_main
+extern const char* g_sim_net_host;              //every connection goes to this server instead of the real one
+extern const char* g_sim_net_port;
+extern atomic_uint_least32_t g_sim_timer_alarms;    //alarms raised by simulated hardware timers
+
+/**
+ * @brief Virtual time since start of the simulation, microseconds
+ */
+int64_t sim_time_us(void);
+
+/**
+ * @brief Wall clock (CLOCK_MONOTONIC) deadline of a virtual time
+ */
+void sim_deadline(int64_t virtual_us, struct timespec* ts);
+
+/**
+ * @brief Sleep until virtual time
+ */
+void sim_sleep_until(int64_t virtual_us);
+
+/**
+ * @brief Voltage on an ADC1 channel pin at virtual time t_us, mV
+ */
+uint32_t sim_adc_read_mv(int channel, int64_t t_us);
+
+/**
+ * @brief Level of a GPIO input at virtual time t_us
+ */
+int sim_gpio_read(int gpio, int64_t t_us);
+
+#endif
@@ -0,0 +1,159 @@
+/* Source file for the clear-text TLS transport of the host port, see mbedtls/ssl.h */
+#include <stdlib.h>
+#include <string.h>
+#include "mbedtls/ssl.h"
+#include "esp_crt_bundle.h"
+
+static uint32_t s_next_session_id = 1;
+
+/**** Random and certificates, nothing to do without encryption ****/
+
+int mbedtls_entropy_func(void* data, unsigned char* output, size_t len) {
+    memset(output, 0, len);
+    return 0;
+}
+
+void mbedtls_entropy_init(mbedtls_entropy_context* ctx) {
+}
+
+void mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context* ctx) {
+}
+
+int mbedtls_ctr_drbg_seed(mbedtls_ctr_drbg_context* ctx, int (*f_entropy)(void*, unsigned char*, size_t), void* p_entropy,
+                          const unsigned char* custom, size_t len) {
+    return 0;
+}
+
+int mbedtls_ctr_drbg_random(void* p_rng, unsigned char* output, size_t len) {
+    memset(output, 0, len);
+    return 0;
+}
+
+void mbedtls_x509_crt_init(mbedtls_x509_crt* crt) {
+}
+
+int mbedtls_x509_crt_parse(mbedtls_x509_crt* chain, const unsigned char* buf, size_t len) {
+    return 0;
+}
+
+int esp_crt_bundle_attach(void* conf) {
+    return 0;
+}
+
+/**** Configuration ****/
+
+void mbedtls_ssl_config_init(mbedtls_ssl_config* conf) {
+    conf->read_timeout = 0;
+}
+
+int mbedtls_ssl_config_defaults(mbedtls_ssl_config* conf, int endpoint, int transport, int preset) {
+    return 0;
+}
+
+void mbedtls_ssl_conf_authmode(mbedtls_ssl_config* conf, int authmode) {
+}
+
+void mbedtls_ssl_conf_ca_chain(mbedtls_ssl_config* conf, mbedtls_x509_crt* ca_chain, void* ca_crl) {
+}
+
+void mbedtls_ssl_conf_rng(mbedtls_ssl_config* conf, int (*f_rng)(void*, unsigned char*, size_t), void* p_rng) {
+}
+
+void mbedtls_ssl_conf_read_timeout(mbedtls_ssl_config* conf, uint32_t timeout) {
+    conf->read_timeout = timeout;
+}
+
+/**** Sessions ****/
+
+void mbedtls_ssl_session_init(mbedtls_ssl_session* session) {
+    memset(session, 0, sizeof(*session));
+}
+
+void mbedtls_ssl_session_free(mbedtls_ssl_session* session) {
+    memset(session, 0, sizeof(*session));
+}
+
+void mbedtls_ssl_init(mbedtls_ssl_context* ssl) {
+    memset(ssl, 0, sizeof(*ssl));
+}
+
+int mbedtls_ssl_setup(mbedtls_ssl_context* ssl, const mbedtls_ssl_config* conf) {
+    ssl->conf = conf;
+    return 0;
+}
+
+int mbedtls_ssl_session_reset(mbedtls_ssl_context* ssl) {
+    ssl->state = MBEDTLS_SSL_HELLO_REQUEST;
+    ssl->session = NULL;
+    mbedtls_ssl_session_init(&ssl->offered);
+    return 0;
+}
+
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context* ssl, const char* hostname) {
+    return 0;
+}
+
+void mbedtls_ssl_set_bio(mbedtls_ssl_context* ssl, void* p_bio, mbedtls_ssl_send_t f_send, mbedtls_ssl_recv_t f_recv,
+                         mbedtls_ssl_recv_timeout_t f_recv_timeout) {
+    ssl->p_bio = p_bio;
+    ssl->f_send = f_send;
+    ssl->f_recv_timeout = f_recv_timeout;
+}
+
+int mbedtls_ssl_set_session(mbedtls_ssl_context* ssl, const mbedtls_ssl_session* session) {
+    ssl->offered = *session;
+    return 0;
+}
+
+int mbedtls_ssl_get_session(const mbedtls_ssl_context* ssl, mbedtls_ssl_session* session) {
+    if(ssl->session == NULL) return -1;
+    *session = *ssl->session;
+    return 0;
+}
+
+int mbedtls_ssl_handshake(mbedtls_ssl_context* ssl) {
+    int ret = 0;
+    while(ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER && ret == 0) {
+        ret = mbedtls_ssl_handshake_step(ssl);
+    }
+    return ret;
+}
+
+int mbedtls_ssl_handshake_step(mbedtls_ssl_context* ssl) {
+    switch(ssl->state) {
+        case MBEDTLS_SSL_HELLO_REQUEST:
+            //offered session is always accepted, otherwise the server issues a new ID and sends its certificate
+            if(ssl->offered.id_len > 0) {
+                ssl->session_storage = ssl->offered;
+                ssl->state = MBEDTLS_SSL_SERVER_CHANGE_CIPHER_SPEC;
+            }
+            else {
+                mbedtls_ssl_session_init(&ssl->session_storage);
+                memcpy(ssl->session_storage.id, &s_next_session_id, sizeof(s_next_session_id));
+                ssl->session_storage.id_len = sizeof(s_next_session_id);
+                s_next_session_id++;
+                ssl->state = MBEDTLS_SSL_SERVER_CERTIFICATE;
+            }
+            break;
+        case MBEDTLS_SSL_SERVER_CERTIFICATE:
+            ssl->state = MBEDTLS_SSL_SERVER_CHANGE_CIPHER_SPEC;
+            break;
+        default:
+            ssl->session = &ssl->session_storage;
+            ssl->state = MBEDTLS_SSL_HANDSHAKE_OVER;
+            break;
+    }
+    return 0;
+}
+
+int mbedtls_ssl_write(mbedtls_ssl_context* ssl, const unsigned char* buf, size_t len) {
+    return ssl->f_send(ssl->p_bio, buf, len);
+}
+
+int mbedtls_ssl_read(mbedtls_ssl_context* ssl, unsigned char* buf, size_t len) {
+    return ssl->f_recv_timeout(ssl->p_bio, buf, len, ssl->conf->read_timeout);
+}
+
+int mbedtls_ssl_close_notify(mbedtls_ssl_context* ssl) {
+    return 0;
+}
@@ -0,0 +1,70 @@
+/* Source file for the sockets of the TLS transport of the host port, see mbedtls/net_sockets.h */
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "mbedtls/ssl.h"
+#include "mbedtls/net_sockets.h"
+#include "sim_port.h"
+
+const char* g_sim_net_host;
+const char* g_sim_net_port;
+
+void mbedtls_net_init(mbedtls_net_context* ctx) {
+    ctx->fd = -1;
+}
+
+int mbedtls_net_connect(mbedtls_net_context* ctx, const char* host, const char* port, int proto) {
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo* res;
+    //simulation redirects every server to its local stub
+    if(g_sim_net_host != NULL) host = g_sim_net_host;
+    if(g_sim_net_port != NULL) port = g_sim_net_port;
+    if(getaddrinfo(host, port, &hints, &res) != 0) {
+        return MBEDTLS_ERR_NET_CONNECT_FAILED;
+    }
+    for(struct addrinfo* ai = res; ai != NULL; ai = ai->ai_next) {
+        int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if(fd < 0) continue;
+        if(connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            ctx->fd = fd;
+            break;
+        }
+        close(fd);
+    }
+    freeaddrinfo(res);
+    return ctx->fd >= 0 ? 0 : MBEDTLS_ERR_NET_CONNECT_FAILED;
+}
+
+int mbedtls_net_send(void* ctx, const unsigned char* buf, size_t len) {
+    int fd = ((mbedtls_net_context*)ctx)->fd;
+    ssize_t ret = send(fd, buf, len, MSG_NOSIGNAL);
+    if(ret < 0) {
+        return (errno == EINTR || errno == EAGAIN) ? MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_SEND_FAILED;
+    }
+    return (int)ret;
+}
+
+int mbedtls_net_recv_timeout(void* ctx, unsigned char* buf, size_t len, uint32_t timeout) {
+    int fd = ((mbedtls_net_context*)ctx)->fd;
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    int ret = poll(&pfd, 1, timeout == 0 ? -1 : (int)timeout);
+    if(ret == 0) return MBEDTLS_ERR_SSL_TIMEOUT;
+    if(ret < 0) return errno == EINTR ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_RECV_FAILED;
+    ssize_t n = recv(fd, buf, len, 0);
+    if(n < 0) {
+        return (errno == EINTR || errno == EAGAIN) ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_RECV_FAILED;
+    }
+    return (int)n;
+}
+
+void mbedtls_net_free(mbedtls_net_context* ctx) {
+    if(ctx->fd >= 0) close(ctx->fd);
+    ctx->fd = -1;
+}
@@ -0,0 +1,92 @@
+/* Source file for the MQTT client of the host port, see mqtt_client.h */
+#include <string.h>
+#include <pthread.h>
+#include "mqtt_client.h"
+
+struct esp_mqtt_client {
+    esp_mqtt_client_config_t config;
+    esp_event_handler_t handler;
+    void* handler_arg;
+    bool started;
+    bool session;               //broker kept a session of this client
+    int next_msg_id;
+};
+
+static struct esp_mqtt_client s_client;
+static sim_mqtt_message_t s_messages[SIM_MQTT_MAX_MESSAGES];
+static size_t s_message_count;
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void raise_event(esp_mqtt_event_id_t id, int msg_id) {
+    esp_mqtt_event_t event = {
+        .event_id = id,
+        .client = &s_client,
+        .msg_id = msg_id,
+        .session_present = s_client.session,
+    };
+    if(s_client.handler != NULL) {
+        s_client.handler(s_client.handler_arg, "MQTT_EVENTS", id, &event);
+    }
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t* config) {
+    memset(&s_client, 0, sizeof(s_client));
+    s_client.config = *config;
+    s_client.next_msg_id = 1;
+    return &s_client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler, void* event_handler_arg) {
+    client->handler = event_handler;
+    client->handler_arg = event_handler_arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client) {
+    client->started = true;
+    return ESP_OK;
+}
+
+int esp_mqtt_client_publish(esp_mqtt_client_handle_t client, const char* topic, const char* data, int len, int qos, int retain) {
+    if(client == NULL || !client->started || len < 0 || len > SIM_MQTT_MAX_PAYLOAD) return -1;
+    pthread_mutex_lock(&s_lock);
+    int msg_id = (qos > 0) ? client->next_msg_id++ : 0;
+    if(s_message_count == SIM_MQTT_MAX_MESSAGES) {
+        memmove(&s_messages[0], &s_messages[1], (SIM_MQTT_MAX_MESSAGES - 1) * sizeof(sim_mqtt_message_t));
+        s_message_count--;
+    }
+    sim_mqtt_message_t* m = &s_messages[s_message_count++];
+    m->msg_id = msg_id;
+    m->qos = qos;
+    strlcpy(m->topic, topic, sizeof(m->topic));
+    memcpy(m->payload, data, len);
+    m->len = len;
+    pthread_mutex_unlock(&s_lock);
+    return msg_id;
+}
+
+void sim_mqtt_set_connected(bool connected) {
+    raise_event(connected ? MQTT_EVENT_CONNECTED : MQTT_EVENT_DISCONNECTED, 0);
+    //clean session disabled => broker keeps the session for the next connection
+    if(connected) s_client.session = s_client.config.disable_clean_session;
+}
+
+void sim_mqtt_puback(int msg_id) {
+    raise_event(MQTT_EVENT_PUBLISHED, msg_id);
+}
+
+size_t sim_mqtt_messages(const sim_mqtt_message_t** messages) {
+    *messages = s_messages;
+    return s_message_count;
+}
+
+void sim_mqtt_clear(void) {
+    pthread_mutex_lock(&s_lock);
+    s_message_count = 0;
+    pthread_mutex_unlock(&s_lock);
+}
+
+const esp_mqtt_client_config_t* sim_mqtt_config(void) {
+    return s_client.config.uri != NULL ? &s_client.config : NULL;
+}
@@ -0,0 +1,46 @@
+/*
+ *  Source file for network bring-up of the host port
+ *  Replaces user_wifi.c and user_http_server.c: the host is always connected, so the station
+ *  gets its IP address at once. The on-device HTTP server is not started, its handlers can
+ *  be called directly (see esp_http_server.h).
+ *  Switching the radio on between upload windows takes SIM_WIFI_CONNECT_MS of device time,
+ *  about a reconnect to the cached AP.
+ */
+#include "esp_log.h"
+#include "esp_event.h"
+#include "user_wifi.h"
+#include "user_http_server.h"
+
+#define SIM_WIFI_CONNECT_MS     300
+
+static const char* TAG = "Host Net";
+
+esp_err_t wifi_connect(void) {
+    int64_t start = esp_timer_get_time();
+    ESP_LOGI(TAG, "Host network is up, no Wi-Fi to connect");
+    user_metrics_observe(METRIC_WIFI_CONNECT_LATENCY, esp_timer_get_time() - start);
+    return esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, NULL, 0, 0);
+}
+
+esp_err_t wifi_disconnect(void) {
+    return ESP_OK;
+}
+
+esp_err_t wifi_radio_off(void) {
+    return ESP_OK;
+}
+
+esp_err_t wifi_radio_on(void) {
+    int64_t start = esp_timer_get_time();
+    vTaskDelay(SIM_WIFI_CONNECT_MS/portTICK_RATE_MS);
+    user_metrics_observe(METRIC_WIFI_CONNECT_LATENCY, esp_timer_get_time() - start);
+    return esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, NULL, 0, 0);
+}
+
+httpd_handle_t user_http_server_start(SemaphoreHandle_t log_mutex) {
+    ESP_LOGI(TAG, "HTTP server is not simulated");
+    return NULL;
+}
+
+void user_http_server_stop(httpd_handle_t server) {
+}
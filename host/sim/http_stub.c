@@ -0,0 +1,188 @@
+/*
+ *  Source file for the HTTP stub standing in for ThingSpeak
+ *  Reads HTTP/1.1 requests with Content-Length or chunked body on kept-alive connections
+ *  and answers each of them like the bulk update API. One connection is served at a time,
+ *  which is all the uploader opens.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "sim.h"
+
+#define STUB_LINE_MAX       512
+
+static const char s_response[] =
+    "HTTP/1.1 202 Accepted\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: 16\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n"
+    "{\"success\":true}";
+
+//answer during a simulated outage, uploader keeps the batch and retries
+static const char s_outage_response[] =
+    "HTTP/1.1 503 Service Unavailable\r\n"
+    "Content-Length: 0\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+typedef struct {
+    int fd;
+    char buf[4096];
+    size_t pos;
+    size_t len;
+} stub_reader_t;
+
+static int s_listen_fd = -1;
+static uint32_t s_delay_ms;
+static volatile bool s_outage;
+static sim_http_stats_t s_stats;
+static pthread_mutex_t s_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Return next byte of the connection, -1 when it is closed */
+static int stub_read_byte(stub_reader_t* r) {
+    if(r->pos == r->len) {
+        ssize_t n;
+        do {
+            n = recv(r->fd, r->buf, sizeof(r->buf), 0);
+        } while(n < 0 && errno == EINTR);
+        if(n <= 0) return -1;
+        r->pos = 0;
+        r->len = n;
+    }
+    return (unsigned char)r->buf[r->pos++];
+}
+
+/* Read one line without CRLF, return its length or -1 */
+static int stub_read_line(stub_reader_t* r, char* line, int size) {
+    int n = 0, c;
+    while((c = stub_read_byte(r)) >= 0) {
+        if(c == '\n') {
+            if(n > 0 && line[n - 1] == '\r') n--;
+            line[n] = '\0';
+            return n;
+        }
+        if(n < size - 1) line[n++] = c;
+    }
+    return -1;
+}
+
+static bool stub_skip(stub_reader_t* r, uint64_t len) {
+    while(len--) {
+        if(stub_read_byte(r) < 0) return false;
+    }
+    return true;
+}
+
+/* Read one request, count it and return false when connection has to be closed */
+static bool stub_serve_request(stub_reader_t* r) {
+    char line[STUB_LINE_MAX];
+    int n;
+    uint64_t header_bytes = 0, body_bytes = 0;
+    int64_t content_length = 0;
+    bool chunked = false;
+
+    //request line and headers
+    do {
+        n = stub_read_line(r, line, sizeof(line));
+        if(n < 0) return false;
+        header_bytes += n + 2;
+        if(strncasecmp(line, "Content-Length:", 15) == 0) {
+            content_length = atoll(line + 15);
+        }
+        else if(strncasecmp(line, "Transfer-Encoding:", 18) == 0 && strstr(line, "chunked") != NULL) {
+            chunked = true;
+        }
+    } while(n > 0);
+
+    if(chunked) {
+        while(1) {
+            if(stub_read_line(r, line, sizeof(line)) < 0) return false;
+            uint64_t size = strtoull(line, NULL, 16);
+            if(size == 0) {
+                while((n = stub_read_line(r, line, sizeof(line))) > 0);
+                if(n < 0) return false;
+                break;
+            }
+            if(!stub_skip(r, size + 2)) return false;       //data and CRLF
+            body_bytes += size;
+        }
+    }
+    else {
+        if(!stub_skip(r, content_length)) return false;
+        body_bytes = content_length;
+    }
+
+    if(s_delay_ms > 0) usleep(s_delay_ms * 1000);
+    bool outage = s_outage;
+    const char* response = outage ? s_outage_response : s_response;
+    if(send(r->fd, response, strlen(response), MSG_NOSIGNAL) < 0) return false;
+
+    pthread_mutex_lock(&s_stats_lock);
+    s_stats.requests++;
+    s_stats.refused += outage;
+    s_stats.header_bytes += header_bytes;
+    s_stats.body_bytes += body_bytes;
+    pthread_mutex_unlock(&s_stats_lock);
+    return true;
+}
+
+static void* stub_thread(void* arg) {
+    static stub_reader_t reader;
+    while(1) {
+        int fd = accept(s_listen_fd, NULL, NULL);
+        if(fd < 0) {
+            if(errno == EINTR) continue;
+            break;
+        }
+        pthread_mutex_lock(&s_stats_lock);
+        s_stats.connections++;
+        pthread_mutex_unlock(&s_stats_lock);
+        reader.fd = fd;
+        reader.pos = 0;
+        reader.len = 0;
+        while(stub_serve_request(&reader));
+        close(fd);
+    }
+    return NULL;
+}
+
+bool sim_http_stub_start(uint32_t delay_ms, char* port, size_t size) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = 0 };
+    socklen_t addr_len = sizeof(addr);
+    pthread_t thread;
+
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    s_delay_ms = delay_ms;
+    s_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(s_listen_fd < 0) return false;
+    if(bind(s_listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(s_listen_fd, 4) != 0
+        || getsockname(s_listen_fd, (struct sockaddr*)&addr, &addr_len) != 0) {
+        close(s_listen_fd);
+        return false;
+    }
+    snprintf(port, size, "%u", ntohs(addr.sin_port));
+    if(pthread_create(&thread, NULL, stub_thread, NULL) != 0) {
+        close(s_listen_fd);
+        return false;
+    }
+    pthread_detach(thread);
+    return true;
+}
+
+void sim_http_stub_set_outage(bool outage) {
+    s_outage = outage;
+}
+
+void sim_http_stub_stats(sim_http_stats_t* stats) {
+    pthread_mutex_lock(&s_stats_lock);
+    *stats = s_stats;
+    pthread_mutex_unlock(&s_stats_lock);
+}
@@ -0,0 +1,60 @@
+/*
+ *  Header file for the host simulation of the data logger
+ *  The application of main/ runs unchanged on the host port (host/port): the simulated ADC
+ *  and GPIO inputs below feed the acquire stage, SD card writes go to a directory and
+ *  ThingSpeak is replaced by a local HTTP stub. After the run, throughput and per-stage
+ *  latency are read from the pipeline metrics (user_metrics.h) and printed.
+ */
+
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sim_port.h"
+
+/* Signals on the simulated inputs */
+typedef enum {
+    SIM_PROFILE_QUIET = 0,      //flat inputs with a little noise => sampling stays at the floor rate
+    SIM_PROFILE_MIXED,          //slow drift, periodic steps and digital edges => rate switches
+    SIM_PROFILE_ACTIVE,         //noisy inputs => sampling stays at the fastest rate
+    SIM_PROFILE_NUMBER
+} sim_profile_t;
+
+extern sim_profile_t g_sim_profile;
+
+/**
+ * @brief Name of a profile, as accepted on the command line
+ */
+const char* sim_profile_name(sim_profile_t profile);
+
+/* Counters of the HTTP stub */
+typedef struct {
+    uint32_t connections;
+    uint32_t requests;
+    uint32_t refused;           //answered with 503 during an outage
+    uint64_t header_bytes;
+    uint64_t body_bytes;        //as sent on the wire, compressed if Content-Encoding is set
+} sim_http_stats_t;
+
+/**
+ * @brief Start HTTP stub on a free port of 127.0.0.1, every request is answered with 202
+ * 
+ * @param delay_ms wall time the stub waits before answering, stands in for network round trip
+ * @param port output, port number as text
+ * @param size size of port
+ * @return true if stub is listening
+ */
+bool sim_http_stub_start(uint32_t delay_ms, char* port, size_t size);
+
+/**
+ * @brief Answer every request with 503 while outage is set, like an unavailable server
+ */
+void sim_http_stub_set_outage(bool outage);
+
+/**
+ * @brief Read counters of the HTTP stub
+ */
+void sim_http_stub_stats(sim_http_stats_t* stats);
+
+#endif
@@ -0,0 +1,265 @@
+/*
+ *  Source file for the host simulation entry point
+ *  Usage: datalogger_sim [-t wall_seconds] [-s time_scale] [-p quiet|mixed|active] [-d stub_delay_ms]
+ *                        [-x outage_wall_seconds] [-o output_dir] [-v log_level] [-m metrics_file]
+ *
+ *  app_main() of main/ is started like on the device and runs for -t seconds of wall time,
+ *  i.e. t * scale seconds of device time. SD card files are written to <output_dir>/sdcard.
+ *  With -x, the HTTP stub refuses every request for that many seconds from one third of the run,
+ *  to check how uplink catches up afterwards. Exit status is 1 if more samples were read back from
+ *  SD card than went missing from the uplink stream.
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "sim.h"
+#include "esp_log.h"
+#include "user_metrics.h"
+#include "user_deflate.h"
+#include "user_pipeline.h"
+#include "user_boot.h"
+#include "user_bus.h"
+#include "user_timer.h"
+#include "user_seq.h"
+#include "user_power.h"
+#include "thingspeak.h"
+#include "uplink.h"
+
+#define SIM_DEFAULT_SECONDS         10
+#define SIM_DEFAULT_SCALE           100
+#define SIM_DEFAULT_OUTPUT          "sim_out"
+#define SIM_DEFLATE_MIN_CPU_US      500000      //compression benchmark runs at least this long
+
+void app_main(void);
+
+typedef struct {
+    uint32_t seconds;
+    double scale;
+    uint32_t delay_ms;
+    double outage_s;
+    const char* output;
+    const char* metrics_file;
+} sim_options_t;
+
+static int64_t wall_us(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t counter(user_counter_t id) {
+    return atomic_load_explicit(&g_metric_counters[id], memory_order_relaxed);
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-t wall_seconds] [-s time_scale] [-p quiet|mixed|active] [-d stub_delay_ms]\n"
+                    "       [-x outage_wall_seconds] [-o output_dir] [-v log_level 0-5] [-m metrics_file]\n", name);
+}
+
+static bool parse_options(int argc, char** argv, sim_options_t* opt) {
+    int c;
+    while((c = getopt(argc, argv, "t:s:p:d:x:o:v:m:h")) != -1) {
+        switch(c) {
+            case 't': opt->seconds = strtoul(optarg, NULL, 10); break;
+            case 's': opt->scale = strtod(optarg, NULL); break;
+            case 'd': opt->delay_ms = strtoul(optarg, NULL, 10); break;
+            case 'x': opt->outage_s = strtod(optarg, NULL); break;
+            case 'o': opt->output = optarg; break;
+            case 'v': esp_log_level_set("*", (esp_log_level_t)atoi(optarg)); break;
+            case 'm': opt->metrics_file = optarg; break;
+            case 'p':
+                for(c = 0; c < SIM_PROFILE_NUMBER && strcmp(optarg, sim_profile_name(c)) != 0; c++);
+                if(c == SIM_PROFILE_NUMBER) return false;
+                g_sim_profile = c;
+                break;
+            default:
+                return false;
+        }
+    }
+    return opt->seconds > 0 && opt->scale > 0;
+}
+
+/**** Report ****/
+
+static void print_summary(const char* name, user_summary_t id, double scale) {
+    uint64_t sum_us;
+    uint32_t count, max_us;
+    user_metrics_get_summary(id, &sum_us, &count, &max_us);
+    printf("  %-18s %9u %12.1f %12.1f\n", name, count, count ? sum_us / scale / count : 0.0, max_us / scale);
+}
+
+static void print_report(const sim_options_t* opt, double wall_s) {
+    sim_http_stats_t http;
+    power_stats_t power;
+    double device_s = wall_s * opt->scale;
+    uint32_t acquired = counter(METRIC_SAMPLES_ACQUIRED);
+    uint32_t alarms = atomic_load(&g_sim_timer_alarms);
+    uint32_t sd_bytes = counter(METRIC_SD_BYTES_WRITTEN);
+    uint32_t plain = counter(METRIC_UPLINK_BYTES_PLAIN);
+    uint32_t sent = counter(METRIC_UPLINK_BYTES_SENT);
+    sim_http_stub_stats(&http);
+    user_power_stats(&power);
+
+    printf("\nProfile %s, %.2f s wall, time scale %.0f => %.0f s device time\n",
+        sim_profile_name(g_sim_profile), wall_s, opt->scale, device_s);
+    printf("Throughput                      total       /s wall     /s device\n");
+    printf("  %-24s %10u %12.1f %12.3f\n", "samples acquired", acquired, acquired / wall_s, acquired / device_s);
+    //paced by the tick with POWER_SAVE, no timer alarm
+    if(alarms > 0) {
+        printf("  %-24s %10u %12.1f %12.3f\n", "timer alarms", alarms, alarms / wall_s, alarms / device_s);
+    }
+    printf("  %-24s %10u %12.1f %12.3f\n", "SD bytes written", sd_bytes, sd_bytes / wall_s, sd_bytes / device_s);
+    printf("  %-24s %10u %12.1f %12.3f\n", "uplink body bytes sent", sent, sent / wall_s, sent / device_s);
+    printf("  %-24s %10u\n", "samples dropped (SD)", counter(METRIC_SAMPLES_DROPPED));
+    printf("  %-24s %10u\n", "samples dropped (uplink)", counter(METRIC_UPLINK_DROPPED));
+    printf("  %-24s %10u\n", "samples suppressed", counter(METRIC_SAMPLES_SUPPRESSED));
+    printf("  %-24s %10u\n", "rule events", counter(METRIC_RULE_EVENTS));
+    printf("  %-24s %10u\n", "spectrum bursts", counter(METRIC_SPECTRUM_BURSTS));
+    printf("  %-24s %10u ok, %u failed of %u\n", "uploads", counter(METRIC_UPLOADS_SUCCEEDED),
+        counter(METRIC_UPLOADS_FAILED), counter(METRIC_UPLOADS_ATTEMPTED));
+    printf("  %-24s %10u plain, %u sent, ratio %.2f\n", "uplink body bytes", plain, sent, sent ? (double)plain / sent : 0.0);
+    printf("  %-24s %10u connections, %u requests (%u refused), %llu header + %llu body bytes\n", "HTTP stub",
+        http.connections, http.requests, http.refused, (unsigned long long)http.header_bytes, (unsigned long long)http.body_bytes);
+    printf("  %-24s %10u gap samples, %u replayed from SD, %u lost\n", "uplink sequence",
+        counter(METRIC_UPLINK_GAP_SAMPLES), counter(METRIC_UPLINK_REPLAYED), counter(METRIC_UPLINK_LOST));
+    printf("  %-24s %10u acknowledged below, next %u, first of boot %u, %u unacked ranges\n", "uplink watermark",
+        user_metrics_get_gauge(METRIC_UPLINK_ACK_WATERMARK), user_metrics_get_gauge(METRIC_SEQ_NEXT), user_seq_first(),
+        user_metrics_get_gauge(METRIC_UPLINK_UNACKED_RANGES));
+    printf("Power (device time, light sleep %s)\n", POWER_SAVE ? "enabled" : "disabled");
+    printf("  %-24s %10.1f s, %.2f%%\n", "awake", power.awake_us / 1e6, power.elapsed_us ? 100.0 * power.awake_us / power.elapsed_us : 0.0);
+    printf("  %-24s %10.1f s, %.2f%% in %u windows\n", "radio on", power.radio_us / 1e6,
+        power.elapsed_us ? 100.0 * power.radio_us / power.elapsed_us : 0.0, power.windows);
+    printf("  %-24s %10u, %u per hour\n", "wakeups", power.wakeups, power.wakeups_per_hour);
+
+    printf("Latency, wall us (device time = wall * scale)\n");
+    printf("  %-18s %9s %12s %12s\n", "", "count", "mean", "max");
+    print_summary("acquire wait", METRIC_STAGE_ACQUIRE_WAIT, opt->scale);
+    print_summary("condition wait", METRIC_STAGE_CONDITION_WAIT, opt->scale);
+    print_summary("persist wait", METRIC_STAGE_PERSIST_WAIT, opt->scale);
+    print_summary("uplink wait", METRIC_STAGE_UPLINK_WAIT, opt->scale);
+    print_summary("sd write", METRIC_SD_WRITE_LATENCY, opt->scale);
+    print_summary("upload", METRIC_UPLOAD_LATENCY, opt->scale);
+    print_summary("spectrum", METRIC_SPECTRUM_LATENCY, opt->scale);
+    print_summary("adc read", METRIC_ADC_READ_LATENCY, opt->scale);
+    printf("Queue high-water: condition %u/%d, persist %u/%d, uplink %u/%d batches\n",
+        user_metrics_get_gauge(METRIC_STAGE_CONDITION_QUEUE_MAX), STAGE_CONDITION_QUEUE,
+        user_metrics_get_gauge(METRIC_STAGE_PERSIST_QUEUE_MAX), BOOT_BUFFER_SAMPLES / BUS_BATCH_SAMPLES,
+        user_metrics_get_gauge(METRIC_STAGE_UPLINK_QUEUE_MAX), UPLINK_QUEUE_SAMPLES / BUS_BATCH_SAMPLES);
+}
+
+/**** Compression benchmark ****/
+
+static bool count_output(void* ctx, const uint8_t* data, size_t len) {
+    *(size_t*)ctx += len;
+    return true;
+}
+
+/* Compress bulk update bodies of one full uplink batch and report ratio and CPU time per KB of input */
+static void benchmark_compression(void) {
+    static adc_sample_t samples[UPLINK_BATCH_SAMPLES];
+    static char body[UPLINK_BATCH_SAMPLES * THINGSPEAK_BULK_ENTRY_MAX + 32];
+    static deflate_stream_t stream;
+    const int channels[ADC_CHANNEL_NUMBER] = { ADC_CHAN_0, ADC_CHAN_1, ADC_CHAN_2, ADC_CHAN_3 };
+    size_t len, out = 0;
+    uint32_t runs = 0;
+
+    //samples of the floor rate, as they are when most of them are reported
+    for(int i = 0; i < UPLINK_BATCH_SAMPLES; i++) {
+        samples[i].timestamp_us = (int64_t)i * ADC_PERIOD * 1000000;
+        for(int ch = 0; ch < ADC_CHANNEL_NUMBER; ch++) {
+            samples[i].voltage[ch] = sim_adc_read_mv(channels[ch], samples[i].timestamp_us);
+        }
+    }
+    len = snprintf(body, sizeof(body), "{\"updates\":[");
+    for(int i = 0; i < UPLINK_BATCH_SAMPLES; i++) {
+        len += thingspeak_format_entry(body + len, sizeof(body) - len, samples, i);
+    }
+    len += snprintf(body + len, sizeof(body) - len, "]}");
+
+    int64_t start = wall_us(CLOCK_THREAD_CPUTIME_ID), cpu;
+    do {
+        out = 0;
+        deflate_init(&stream, DEFLATE_FORMAT_GZIP, count_output, &out);
+        deflate_write(&stream, body, len);
+        deflate_finish(&stream);
+        runs++;
+        cpu = wall_us(CLOCK_THREAD_CPUTIME_ID) - start;
+    } while(cpu < SIM_DEFLATE_MIN_CPU_US);
+
+    printf("Compression of a %d sample bulk body: %zu -> %zu bytes (ratio %.2f), %.1f us CPU per KB on this host\n",
+        UPLINK_BATCH_SAMPLES, len, out, (double)len / out, (double)cpu / runs / (len / 1024.0));
+}
+
+int main(int argc, char** argv) {
+    sim_options_t opt = {
+        .seconds = SIM_DEFAULT_SECONDS,
+        .scale = SIM_DEFAULT_SCALE,
+        .delay_ms = 0,
+        .outage_s = 0,
+        .output = SIM_DEFAULT_OUTPUT,
+        .metrics_file = NULL,
+    };
+    static char port[8];
+
+    esp_log_level_set("*", ESP_LOG_WARN);
+    if(!parse_options(argc, argv, &opt)) {
+        usage(argv[0]);
+        return 1;
+    }
+    if(mkdir(opt.output, 0755) != 0 && errno != EEXIST) {
+        perror(opt.output);
+        return 1;
+    }
+    //MOUNT_POINT is relative, SD card files end up below the output directory
+    if(chdir(opt.output) != 0) {
+        perror(opt.output);
+        return 1;
+    }
+    if(!sim_http_stub_start(opt.delay_ms, port, sizeof(port))) {
+        fprintf(stderr, "Cannot start HTTP stub\n");
+        return 1;
+    }
+    g_sim_net_host = "127.0.0.1";
+    g_sim_net_port = port;
+    g_sim_time_scale = opt.scale;
+
+    int64_t start = wall_us(CLOCK_MONOTONIC);
+    sim_time_us();                          //virtual clock starts with the application
+    app_main();
+    if(opt.outage_s > 0) {
+        double before_s = opt.seconds / 3.0;
+        usleep(before_s * 1e6);
+        sim_http_stub_set_outage(true);
+        usleep(opt.outage_s * 1e6);
+        sim_http_stub_set_outage(false);
+        if(opt.seconds > before_s + opt.outage_s) usleep((opt.seconds - before_s - opt.outage_s) * 1e6);
+    }
+    else {
+        sleep(opt.seconds);
+    }
+    double wall_s = (wall_us(CLOCK_MONOTONIC) - start) / 1e6;
+
+    print_report(&opt, wall_s);
+    if(opt.metrics_file != NULL) {
+        httpd_req_t req = { .uri = "/metrics", .out = fopen(opt.metrics_file, "w") };
+        if(req.out != NULL) {
+            user_metrics_http_handler(&req);
+            fclose(req.out);
+        }
+    }
+    benchmark_compression();
+    //only samples missing from the uplink stream are read back
+    bool ok = counter(METRIC_UPLINK_REPLAYED) <= counter(METRIC_UPLINK_GAP_SAMPLES);
+    if(!ok) {
+        printf("Error: %u samples replayed from SD card, only %u were missing\n",
+            counter(METRIC_UPLINK_REPLAYED), counter(METRIC_UPLINK_GAP_SAMPLES));
+    }
+    fflush(stdout);
+    //tasks never return, leave without running exit handlers under them
+    _exit(ok ? 0 : 1);
+}
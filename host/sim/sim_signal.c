@@ -0,0 +1,68 @@
+/* Source file for the simulated ADC and GPIO inputs */
+#include <math.h>
+#include "sim.h"
+#include "user_adc.h"
+
+sim_profile_t g_sim_profile = SIM_PROFILE_MIXED;
+
+static const char* s_profile_name[SIM_PROFILE_NUMBER] = {
+    "quiet",
+    "mixed",
+    "active",
+};
+
+const char* sim_profile_name(sim_profile_t profile) {
+    return s_profile_name[profile];
+}
+
+/* Reproducible noise in [-1, 1], changes every millisecond of virtual time */
+static float noise(int channel, int64_t t_us) {
+    uint32_t x = (uint32_t)(t_us / 1000) * 2654435761u ^ (uint32_t)channel * 0x9E3779B9u;
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return (float)x / 2147483648.0f - 1.0f;
+}
+
+/*
+ *  Channel 0: slow drift, channel 1: small 50 Hz hum with a 180 Hz harmonic (seen by spectrum bursts),
+ *  channel 2: level step of 20 s every 90 s, channel 3: flat.
+ */
+uint32_t sim_adc_read_mv(int channel, int64_t t_us) {
+    const float pi = 3.14159265f;
+    float t = t_us / 1e6f;
+    float mv;
+    switch(channel) {
+        case ADC_CHAN_0:
+            mv = 1200 + 400 * sinf(2 * pi * t / 600);
+            break;
+        case ADC_CHAN_1:
+            mv = 1500 + 10 * sinf(2 * pi * 50 * t) + 4 * sinf(2 * pi * 180 * t);
+            break;
+        case ADC_CHAN_2:
+            mv = (fmodf(t, 90) < 20) ? 2000 : 800;
+            break;
+        default:
+            mv = 500;
+            break;
+    }
+    if(g_sim_profile == SIM_PROFILE_QUIET) {
+        mv = 1000 + 2 * noise(channel, t_us);
+    }
+    else if(g_sim_profile == SIM_PROFILE_ACTIVE) {
+        mv += 200 * noise(channel, t_us);
+    }
+    else {
+        mv += 3 * noise(channel, t_us);
+    }
+    return mv < 0 ? 0 : (uint32_t)mv;
+}
+
+/* Digital channel 0 is a square wave, 2 minutes period (10 s when active), the others stay low */
+int sim_gpio_read(int gpio, int64_t t_us) {
+    int64_t half_period_us = (g_sim_profile == SIM_PROFILE_ACTIVE) ? 5000000 : 60000000;
+    if(gpio != DIGITAL_CHAN_0 || g_sim_profile == SIM_PROFILE_QUIET) return 0;
+    return (t_us / half_period_us) & 1;
+}
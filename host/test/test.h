@@ -0,0 +1,62 @@
+/*
+ *  Header file for the host tests
+ *  Each program of host/test checks one module of main/ on the host port. A failed check prints
+ *  its location and the program exits with status 1 after running every case.
+ *      make test       build and run every program
+ */
+
+#ifndef _TEST_H_
+#define _TEST_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+
+static int s_test_checks;
+static int s_test_failures;
+
+static inline bool test_check(bool ok, const char* expr, const char* file, int line) {
+    s_test_checks++;
+    if(!ok) {
+        s_test_failures++;
+        printf("%s:%d: check failed: %s\n", file, line, expr);
+    }
+    return ok;
+}
+
+static inline bool test_check_eq(long long a, long long b, const char* expr_a, const char* expr_b, const char* file, int line) {
+    s_test_checks++;
+    if(a != b) {
+        s_test_failures++;
+        printf("%s:%d: check failed: %s == %s (%lld != %lld)\n", file, line, expr_a, expr_b, a, b);
+    }
+    return a == b;
+}
+
+static inline bool test_check_near(double a, double b, double tolerance, const char* expr_a, const char* expr_b, const char* file, int line) {
+    bool ok = (a > b ? a - b : b - a) <= tolerance;
+    s_test_checks++;
+    if(!ok) {
+        s_test_failures++;
+        printf("%s:%d: check failed: %s == %s within %g (%g != %g)\n", file, line, expr_a, expr_b, tolerance, a, b);
+    }
+    return ok;
+}
+
+#define TEST_CHECK(cond)                test_check((cond), #cond, __FILE__, __LINE__)
+#define TEST_CHECK_EQ(a, b)             test_check_eq((long long)(a), (long long)(b), #a, #b, __FILE__, __LINE__)
+#define TEST_CHECK_NEAR(a, b, tol)      test_check_near((a), (b), (tol), #a, #b, __FILE__, __LINE__)
+
+/* Run one case, its name is printed so a crash can be located */
+#define TEST_RUN(fn)                    do { printf("  %s\n", #fn); fn(); } while(0)
+
+/**
+ * @brief Print summary of the program
+ *
+ * @return int exit status, 0 if every check passed
+ */
+static inline int test_summary(const char* name) {
+    printf("%s: %d checks, %d failed\n", name, s_test_checks, s_test_failures);
+    return s_test_failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,136 @@
+/*
+ *  Tests of the sample bus (user_bus.c): reference counting and drop policies of slow subscribers
+ *  Subscribers cannot be removed, so every test uses the three registered by test_subscribe.
+ */
+#include "user_bus.h"
+#include "test.h"
+
+static bus_subscriber_t s_oldest = {
+    .name = "oldest", .depth = 2, .policy = BUS_DROP_OLDEST, .drop_metric = METRIC_SAMPLES_DROPPED,
+    .wait_metric = METRIC_STAGE_PERSIST_WAIT, .depth_metric = METRIC_STAGE_PERSIST_QUEUE_MAX,
+};
+static bus_subscriber_t s_newest = {
+    .name = "newest", .depth = 2, .policy = BUS_DROP_NEWEST, .drop_metric = METRIC_UPLINK_DROPPED,
+    .wait_metric = METRIC_STAGE_UPLINK_WAIT, .depth_metric = METRIC_STAGE_UPLINK_QUEUE_MAX,
+};
+/* Reads every batch at once */
+static bus_subscriber_t s_fast = {
+    .name = "fast", .depth = 4, .policy = BUS_DROP_OLDEST, .drop_metric = METRIC_SAMPLES_SUPPRESSED,
+    .wait_metric = METRIC_STAGE_CONDITION_WAIT, .depth_metric = METRIC_STAGE_CONDITION_QUEUE_MAX,
+};
+
+static uint32_t counter(user_counter_t id) {
+    return atomic_load(&g_metric_counters[id]);
+}
+
+/* Publish a batch of count samples numbered from first_seq, fast subscriber takes it at once */
+static bus_batch_t* publish(uint32_t count, uint32_t first_seq) {
+    bus_batch_t* batch = bus_batch_alloc();
+    if(batch == NULL) return NULL;
+    for(uint32_t i = 0; i < count; i++) {
+        batch->samples[i].seq = first_seq + i;
+    }
+    batch->count = count;
+    bus_publish(batch);
+    bus_batch_t* got = bus_receive(&s_fast, 0);
+    TEST_CHECK(got == batch);
+    if(got != NULL) bus_release(got);
+    return batch;
+}
+
+static void test_subscribe(void) {
+    bus_subscriber_t bad = s_fast;
+    bad.depth = 0;
+    TEST_CHECK_EQ(bus_subscribe(&bad), ESP_ERR_INVALID_ARG);
+    bad.depth = BUS_MAX_DEPTH + 1;
+    TEST_CHECK_EQ(bus_subscribe(&bad), ESP_ERR_INVALID_ARG);
+    TEST_CHECK_EQ(bus_subscribe(&s_oldest), ESP_OK);
+    TEST_CHECK_EQ(bus_subscribe(&s_newest), ESP_OK);
+    TEST_CHECK_EQ(bus_subscribe(&s_fast), ESP_OK);
+}
+
+/* Every subscriber gets the same batch, it returns to the pool after the last release */
+static void test_shared_batch(void) {
+    bus_batch_t* batch = publish(1, 0);
+    if(!TEST_CHECK(batch != NULL)) return;
+    TEST_CHECK_EQ(pool_free_blocks(&g_bus_pool), BUS_POOL_BLOCKS - 1);
+    bus_batch_t* a = bus_receive(&s_oldest, 0);
+    bus_batch_t* b = bus_receive(&s_newest, 0);
+    TEST_CHECK(a == batch && b == batch);
+    if(a != NULL) bus_release(a);
+    TEST_CHECK_EQ(pool_free_blocks(&g_bus_pool), BUS_POOL_BLOCKS - 1);
+    if(b != NULL) bus_release(b);
+    TEST_CHECK_EQ(pool_free_blocks(&g_bus_pool), BUS_POOL_BLOCKS);
+    TEST_CHECK(bus_receive(&s_oldest, 0) == NULL);
+}
+
+/* Batches of 1..5 samples to slow subscribers of depth 2 */
+static void test_slow_subscribers(void) {
+    uint32_t oldest_dropped = counter(METRIC_SAMPLES_DROPPED);
+    uint32_t newest_dropped = counter(METRIC_UPLINK_DROPPED);
+    uint32_t seq = 100;
+    for(uint32_t count = 1; count <= 5; count++) {
+        TEST_CHECK(publish(count, seq) != NULL);
+        seq += count;
+    }
+    //drop metrics count samples: oldest lost batches 1-3, newest lost batches 3-5
+    TEST_CHECK_EQ(counter(METRIC_SAMPLES_DROPPED) - oldest_dropped, 1 + 2 + 3);
+    TEST_CHECK_EQ(counter(METRIC_UPLINK_DROPPED) - newest_dropped, 3 + 4 + 5);
+    TEST_CHECK_EQ(counter(METRIC_SAMPLES_SUPPRESSED), 0);
+    TEST_CHECK_EQ(user_metrics_get_gauge(METRIC_STAGE_PERSIST_QUEUE_MAX), 2);
+    TEST_CHECK_EQ(user_metrics_get_gauge(METRIC_STAGE_UPLINK_QUEUE_MAX), 2);
+    TEST_CHECK_EQ(user_metrics_get_gauge(METRIC_STAGE_CONDITION_QUEUE_MAX), 1);
+    //dropped batches went back to the pool, queued ones are still held
+    TEST_CHECK_EQ(pool_free_blocks(&g_bus_pool), BUS_POOL_BLOCKS - 4);
+
+    //drop oldest keeps the latest batches, drop newest the first ones
+    static const uint32_t oldest_first[] = { 100 + 1 + 2 + 3, 100 + 1 + 2 + 3 + 4 };
+    static const uint32_t newest_first[] = { 100, 101 };
+    for(int i = 0; i < 2; i++) {
+        bus_batch_t* batch = bus_receive(&s_oldest, 0);
+        if(TEST_CHECK(batch != NULL)) {
+            TEST_CHECK_EQ(batch->samples[0].seq, oldest_first[i]);
+            bus_release(batch);
+        }
+        batch = bus_receive(&s_newest, 0);
+        if(TEST_CHECK(batch != NULL)) {
+            TEST_CHECK_EQ(batch->samples[0].seq, newest_first[i]);
+            bus_release(batch);
+        }
+    }
+    TEST_CHECK(bus_receive(&s_oldest, 0) == NULL);
+    TEST_CHECK(bus_receive(&s_newest, 0) == NULL);
+    TEST_CHECK_EQ(pool_free_blocks(&g_bus_pool), BUS_POOL_BLOCKS);
+}
+
+/* Publisher cannot fill a batch when subscribers hold every block */
+static void test_pool_exhausted(void) {
+    bus_batch_t* held[BUS_POOL_BLOCKS];
+    uint32_t n = 0;
+    while(n < BUS_POOL_BLOCKS && (held[n] = bus_batch_alloc()) != NULL) n++;
+    TEST_CHECK_EQ(n, BUS_POOL_BLOCKS);
+    TEST_CHECK(bus_batch_alloc() == NULL);
+    while(n > 0) bus_release(held[--n]);
+    TEST_CHECK_EQ(pool_free_blocks(&g_bus_pool), BUS_POOL_BLOCKS);
+}
+
+static void test_too_many_subscribers(void) {
+    static bus_subscriber_t extra[2];
+    for(int i = 0; i < 2; i++) {
+        extra[i] = s_fast;
+        extra[i].name = "extra";
+    }
+    TEST_CHECK_EQ(bus_subscribe(&extra[0]), ESP_OK);
+    TEST_CHECK_EQ(bus_subscribe(&extra[1]), ESP_ERR_NO_MEM);
+}
+
+int main(void) {
+    esp_log_level_set("*", ESP_LOG_NONE);
+    printf("test_bus\n");
+    TEST_RUN(test_subscribe);
+    TEST_RUN(test_shared_batch);
+    TEST_RUN(test_slow_subscribers);
+    TEST_RUN(test_pool_exhausted);
+    TEST_RUN(test_too_many_subscribers);
+    return test_summary("test_bus");
+}
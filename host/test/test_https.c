@@ -0,0 +1,288 @@
+/*
+ *  Tests of the HTTPS client (https_client.c) against a local TLS server
+ *  The client runs on the OpenSSL implementation of test/tls_openssl.c. The server is an OpenSSL
+ *  thread with a certificate for localhost signed by a CA made at start, the CA is the one the
+ *  client trusts. It answers every request with 200 and counts handshakes and resumed sessions.
+ */
+#include <pthread.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <openssl/ssl.h>
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+#include "https_client.h"
+#include "test_https.h"
+#include "test.h"
+
+#define TEST_HOST       "localhost"
+
+char g_test_ca_pem[TEST_CA_PEM_MAX];
+
+typedef enum {
+    SERVER_SESSION_ID,              //resumption by session ID cache of the server
+    SERVER_SESSION_TICKET,          //resumption by session ticket, no cache on the server
+} server_resumption_t;
+
+typedef struct {
+    SSL_CTX* ctx;
+    int listen_fd;
+    char port[8];
+    pthread_t thread;
+    atomic_int handshakes;
+    atomic_int resumed;             //handshakes that resumed a session
+    atomic_int requests;
+    atomic_bool close_after_response;   //close next connection after its response, as on idle timeout
+} test_server_t;
+
+static test_server_t s_server;
+static EVP_PKEY* s_ca_key;
+static X509* s_ca;
+static EVP_PKEY* s_server_key;
+static X509* s_server_crt;
+
+static const char s_request[] =
+    "POST /update HTTP/1.1\r\nHost: "TEST_HOST"\r\nContent-Type: text/plain\r\nContent-Length: 5\r\n\r\nfield";
+
+/**** Certificates ****/
+
+static void add_ext(X509* crt, X509* issuer, int nid, const char* value) {
+    X509V3_CTX v3;
+    X509V3_set_ctx_nodb(&v3);
+    X509V3_set_ctx(&v3, issuer, crt, NULL, NULL, 0);
+    X509_EXTENSION* ext = X509V3_EXT_conf_nid(NULL, &v3, nid, value);
+    X509_add_ext(crt, ext, -1);
+    X509_EXTENSION_free(ext);
+}
+
+/* Certificate of key, self-signed if issuer is NULL */
+static X509* make_cert(EVP_PKEY* key, const char* cn, X509* issuer, EVP_PKEY* issuer_key, long serial) {
+    X509* crt = X509_new();
+    X509_set_version(crt, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(crt), serial);
+    X509_gmtime_adj(X509_getm_notBefore(crt), -3600);
+    X509_gmtime_adj(X509_getm_notAfter(crt), 86400);
+    X509_set_pubkey(crt, key);
+    X509_NAME_add_entry_by_txt(X509_get_subject_name(crt), "CN", MBSTRING_ASC, (const unsigned char*)cn, -1, -1, 0);
+    X509_set_issuer_name(crt, X509_get_subject_name(issuer != NULL ? issuer : crt));
+    if(issuer == NULL) {
+        add_ext(crt, crt, NID_basic_constraints, "critical,CA:TRUE");
+        add_ext(crt, crt, NID_key_usage, "critical,keyCertSign,cRLSign");
+    }
+    else {
+        add_ext(crt, issuer, NID_basic_constraints, "CA:FALSE");
+        add_ext(crt, issuer, NID_subject_alt_name, "DNS:"TEST_HOST);
+        add_ext(crt, issuer, NID_ext_key_usage, "serverAuth");
+    }
+    X509_sign(crt, issuer_key != NULL ? issuer_key : key, EVP_sha256());
+    return crt;
+}
+
+static bool make_certs(void) {
+    s_ca_key = EVP_EC_gen("P-256");
+    s_server_key = EVP_EC_gen("P-256");
+    if(s_ca_key == NULL || s_server_key == NULL) return false;
+    s_ca = make_cert(s_ca_key, "Test CA", NULL, NULL, 1);
+    s_server_crt = make_cert(s_server_key, TEST_HOST, s_ca, s_ca_key, 2);
+
+    BIO* bio = BIO_new(BIO_s_mem());
+    PEM_write_bio_X509(bio, s_ca);
+    int len = BIO_read(bio, g_test_ca_pem, sizeof(g_test_ca_pem) - 1);
+    BIO_free(bio);
+    return len > 0;
+}
+
+/**** Server ****/
+
+/* Read one request (headers and Content-Length body), false when connection is closed */
+static bool server_read_request(SSL* ssl) {
+    char buf[1024];
+    int len = 0;
+    char* body;
+    buf[0] = '\0';
+    while((body = strstr(buf, "\r\n\r\n")) == NULL) {
+        int n = (len < (int)sizeof(buf) - 1) ? SSL_read(ssl, buf + len, sizeof(buf) - 1 - len) : 0;
+        if(n <= 0) return false;
+        len += n;
+        buf[len] = '\0';
+    }
+    body += 4;
+    const char* header = strstr(buf, "Content-Length:");
+    int content_length = header != NULL ? atoi(header + 15) : 0;
+    int remaining = content_length - (int)(buf + len - body);
+    while(remaining > 0) {
+        int n = SSL_read(ssl, buf, remaining < (int)sizeof(buf) ? remaining : (int)sizeof(buf));
+        if(n <= 0) return false;
+        remaining -= n;
+    }
+    return true;
+}
+
+static void server_serve(int fd) {
+    static const char response[] = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 1\r\n\r\n1";
+    SSL* ssl = SSL_new(s_server.ctx);
+    SSL_set_fd(ssl, fd);
+    if(SSL_accept(ssl) == 1) {
+        atomic_fetch_add(&s_server.handshakes, 1);
+        if(SSL_session_reused(ssl)) atomic_fetch_add(&s_server.resumed, 1);
+        while(server_read_request(ssl)) {
+            atomic_fetch_add(&s_server.requests, 1);
+            SSL_write(ssl, response, sizeof(response) - 1);
+            if(atomic_exchange(&s_server.close_after_response, false)) break;
+        }
+        SSL_shutdown(ssl);
+    }
+    SSL_free(ssl);
+    close(fd);
+}
+
+/* Connections are served one after the other, the client keeps at most one open */
+static void* server_task(void* arg) {
+    int fd;
+    while((fd = accept(s_server.listen_fd, NULL, NULL)) >= 0) {
+        server_serve(fd);
+    }
+    return NULL;
+}
+
+static bool server_start(server_resumption_t resumption, X509* crt, EVP_PKEY* key) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK), .sin_port = 0 };
+    socklen_t addr_len = sizeof(addr);
+
+    s_server.ctx = SSL_CTX_new(TLS_server_method());
+    SSL_CTX_set_max_proto_version(s_server.ctx, TLS1_2_VERSION);
+    SSL_CTX_use_certificate(s_server.ctx, crt);
+    SSL_CTX_use_PrivateKey(s_server.ctx, key);
+    SSL_CTX_set_session_id_context(s_server.ctx, (const unsigned char*)"test", 4);
+    if(resumption == SERVER_SESSION_ID) {
+        SSL_CTX_set_options(s_server.ctx, SSL_OP_NO_TICKET);
+    }
+    else {
+        SSL_CTX_set_session_cache_mode(s_server.ctx, SSL_SESS_CACHE_OFF);
+    }
+    atomic_store(&s_server.handshakes, 0);
+    atomic_store(&s_server.resumed, 0);
+    atomic_store(&s_server.requests, 0);
+    atomic_store(&s_server.close_after_response, false);
+
+    s_server.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(bind(s_server.listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(s_server.listen_fd, 4) != 0
+        || getsockname(s_server.listen_fd, (struct sockaddr*)&addr, &addr_len) != 0) {
+        return false;
+    }
+    snprintf(s_server.port, sizeof(s_server.port), "%u", ntohs(addr.sin_port));
+    return pthread_create(&s_server.thread, NULL, server_task, NULL) == 0;
+}
+
+/* Client must have closed its connection, the server thread only checks for new ones */
+static void server_stop(void) {
+    shutdown(s_server.listen_fd, SHUT_RDWR);
+    close(s_server.listen_fd);
+    pthread_join(s_server.thread, NULL);
+    SSL_CTX_free(s_server.ctx);
+}
+
+/**** Tests ****/
+
+static uint32_t counter(user_counter_t id) {
+    return atomic_load(&g_metric_counters[id]);
+}
+
+static esp_err_t request(int* status) {
+    *status = 0;
+    return https_client_request(TEST_HOST, s_server.port, s_request, sizeof(s_request) - 1, status);
+}
+
+static void test_full_handshake(void) {
+    int status;
+    TEST_CHECK_EQ(request(&status), ESP_OK);
+    TEST_CHECK_EQ(status, 200);
+    TEST_CHECK_EQ(counter(METRIC_TLS_FULL_HANDSHAKES), 1);
+    TEST_CHECK_EQ(counter(METRIC_TLS_RESUMED_HANDSHAKES), 0);
+    TEST_CHECK_EQ(atomic_load(&s_server.handshakes), 1);
+    TEST_CHECK_EQ(atomic_load(&s_server.resumed), 0);
+}
+
+static void test_keep_alive(void) {
+    int status;
+    TEST_CHECK_EQ(request(&status), ESP_OK);
+    TEST_CHECK_EQ(status, 200);
+    TEST_CHECK_EQ(counter(METRIC_TLS_REUSED_CONNECTIONS), 1);
+    TEST_CHECK_EQ(atomic_load(&s_server.handshakes), 1);
+    TEST_CHECK_EQ(atomic_load(&s_server.requests), 2);
+}
+
+static void test_resumed_after_close(void) {
+    int status;
+    https_client_close();
+    TEST_CHECK_EQ(request(&status), ESP_OK);
+    TEST_CHECK_EQ(status, 200);
+    TEST_CHECK_EQ(counter(METRIC_TLS_FULL_HANDSHAKES), 1);
+    TEST_CHECK_EQ(counter(METRIC_TLS_RESUMED_HANDSHAKES), 1);
+    TEST_CHECK_EQ(atomic_load(&s_server.handshakes), 2);
+    TEST_CHECK_EQ(atomic_load(&s_server.resumed), 1);
+}
+
+/* Server drops the kept-alive connection: the request is sent again on a resumed session */
+static void test_resumed_after_server_close(void) {
+    int status;
+    atomic_store(&s_server.close_after_response, true);
+    TEST_CHECK_EQ(request(&status), ESP_OK);
+    TEST_CHECK_EQ(request(&status), ESP_OK);
+    TEST_CHECK_EQ(status, 200);
+    TEST_CHECK_EQ(counter(METRIC_TLS_RESUMED_HANDSHAKES), 2);
+    TEST_CHECK_EQ(atomic_load(&s_server.handshakes), 3);
+    TEST_CHECK_EQ(atomic_load(&s_server.resumed), 2);
+    TEST_CHECK_EQ(atomic_load(&s_server.requests), 5);
+}
+
+/* Restarted server does not know the session (full handshake), then resumes by ticket */
+static void test_session_ticket(void) {
+    int status;
+    https_client_close();
+    server_stop();
+    if(!TEST_CHECK(server_start(SERVER_SESSION_TICKET, s_server_crt, s_server_key))) return;
+    TEST_CHECK_EQ(request(&status), ESP_OK);
+    TEST_CHECK_EQ(counter(METRIC_TLS_FULL_HANDSHAKES), 2);
+    TEST_CHECK_EQ(atomic_load(&s_server.resumed), 0);
+
+    https_client_close();
+    TEST_CHECK_EQ(request(&status), ESP_OK);
+    TEST_CHECK_EQ(status, 200);
+    TEST_CHECK_EQ(counter(METRIC_TLS_FULL_HANDSHAKES), 2);
+    TEST_CHECK_EQ(counter(METRIC_TLS_RESUMED_HANDSHAKES), 3);
+    TEST_CHECK_EQ(atomic_load(&s_server.resumed), 1);
+}
+
+/* Certificate not signed by the trusted CA: handshake fails and the session is not offered again */
+static void test_untrusted_server(void) {
+    int status;
+    EVP_PKEY* key = EVP_EC_gen("P-256");
+    X509* crt = make_cert(key, TEST_HOST, NULL, NULL, 3);
+    https_client_close();
+    server_stop();
+    if(!TEST_CHECK(server_start(SERVER_SESSION_ID, crt, key))) return;
+    TEST_CHECK_EQ(request(&status), ESP_ERR_HTTPS_HANDSHAKE_FAILED);
+    TEST_CHECK_EQ(atomic_load(&s_server.handshakes), 0);
+    X509_free(crt);
+    EVP_PKEY_free(key);
+}
+
+int main(void) {
+    esp_log_level_set("*", ESP_LOG_NONE);
+    printf("test_https\n");
+    if(!make_certs() || !server_start(SERVER_SESSION_ID, s_server_crt, s_server_key)) {
+        printf("cannot start TLS server\n");
+        return 1;
+    }
+    TEST_RUN(test_full_handshake);
+    TEST_RUN(test_keep_alive);
+    TEST_RUN(test_resumed_after_close);
+    TEST_RUN(test_resumed_after_server_close);
+    TEST_RUN(test_session_ticket);
+    TEST_RUN(test_untrusted_server);
+    https_client_close();
+    server_stop();
+    return test_summary("test_https");
+}
@@ -0,0 +1,14 @@
+/*
+ *  Header file for test_https
+ *  https_client.c is built for the test with HTTPS_CA_CERT_PEM set to g_test_ca_pem and this
+ *  header included first: the CA of the local TLS server is generated when the test starts.
+ */
+
+#ifndef _TEST_HTTPS_H_
+#define _TEST_HTTPS_H_
+
+#define TEST_CA_PEM_MAX     2048
+
+extern char g_test_ca_pem[TEST_CA_PEM_MAX];
+
+#endif
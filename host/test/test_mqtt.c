@@ -0,0 +1,224 @@
+/*
+ *  Tests of the MQTT uplink backend (uplink_mqtt.c) against the broker stand-in of the host port
+ *  Built three times: JSON, binary (MQTT_PAYLOAD_BINARY) and gzip JSON (UPLINK_COMPRESSION) payload.
+ */
+#include <zlib.h>
+#include "uplink_mqtt.h"
+#include "test.h"
+
+#define TEST_TOPIC_PREFIX   MQTT_TOPIC_PREFIX"240ac4000010/"
+
+static const adc_sample_t s_samples[] = {
+    { .timestamp_us = 1000000, .voltage = { 100, 200, 300, 400 }, .digital = 1, .seq = 7 },
+    { .timestamp_us = 1500000, .voltage = { 101, 201, 301, 401 }, .digital = 0, .seq = 8 },
+    { .timestamp_us = 3000000, .voltage = { 102, 202, 302, 402 }, .digital = 3, .seq = 10 },
+};
+#define TEST_SAMPLES (sizeof(s_samples) / sizeof(s_samples[0]))
+
+#if !MQTT_PAYLOAD_BINARY
+static const char s_expected_json[] =
+    "{\"t0\":1000,\"s\":[[0,100,200,300,400,1,7],[500,101,201,301,401,0,8],[2000,102,202,302,402,3,10]]}";
+#endif
+
+static const char s_expected_features[] = "{\"t\":2000,\"fs\":4000.0,\"n\":256,\"ch\":[{\"i\":0,";
+
+static uint32_t counter(user_counter_t id) {
+    return atomic_load(&g_metric_counters[id]);
+}
+
+/* Last message published on topic, NULL if none */
+static const sim_mqtt_message_t* last_message(const char* topic) {
+    const sim_mqtt_message_t* messages;
+    size_t n = sim_mqtt_messages(&messages);
+    while(n-- > 0) {
+        if(strcmp(messages[n].topic, topic) == 0) return &messages[n];
+    }
+    return NULL;
+}
+
+/* Payload as sent before compression */
+static size_t plain_payload(const sim_mqtt_message_t* m, uint8_t* out, size_t size) {
+#if UPLINK_COMPRESSION
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if(inflateInit2(&z, 16 + MAX_WBITS) != Z_OK) return 0;
+    z.next_in = (Bytef*)m->payload;
+    z.avail_in = m->len;
+    z.next_out = out;
+    z.avail_out = size;
+    int ret = inflate(&z, Z_FINISH);
+    size_t len = z.total_out;
+    inflateEnd(&z);
+    return ret == Z_STREAM_END ? len : 0;
+#else
+    if(m->len > size) return 0;
+    memcpy(out, m->payload, m->len);
+    return m->len;
+#endif
+}
+
+static void test_open_without_connection(void) {
+    int id;
+    TEST_CHECK_EQ(uplink_mqtt.open(), ESP_OK);
+    const esp_mqtt_client_config_t* config = sim_mqtt_config();
+    if(!TEST_CHECK(config != NULL)) return;
+    TEST_CHECK(strcmp(config->client_id, "logger-240ac4000010") == 0);
+    TEST_CHECK(config->disable_clean_session);
+    TEST_CHECK(!uplink_mqtt.healthy());
+
+    //batch is kept until the broker is reachable
+    TEST_CHECK_EQ(uplink_mqtt.enqueue(s_samples, TEST_SAMPLES), ESP_OK);
+    TEST_CHECK_EQ(uplink_mqtt.flush(&id), ESP_ERR_INVALID_STATE);
+    const sim_mqtt_message_t* messages;
+    TEST_CHECK_EQ(sim_mqtt_messages(&messages), 0);
+}
+
+static void test_batch_payload(void) {
+    static uint8_t plain[SIM_MQTT_MAX_PAYLOAD];
+    const char* topic = UPLINK_COMPRESSION ? TEST_TOPIC_PREFIX"samples"MQTT_TOPIC_GZIP_SUFFIX : TEST_TOPIC_PREFIX"samples";
+    int id = -1;
+    sim_mqtt_set_connected(true);
+    TEST_CHECK(uplink_mqtt.healthy());
+    TEST_CHECK_EQ(uplink_mqtt.flush(&id), ESP_OK);
+
+    const sim_mqtt_message_t* m = last_message(topic);
+    if(!TEST_CHECK(m != NULL)) return;
+    TEST_CHECK_EQ(m->qos, 1);
+    TEST_CHECK(m->msg_id > 0);
+    TEST_CHECK_EQ(id, m->msg_id);
+    size_t len = plain_payload(m, plain, sizeof(plain));
+#if MQTT_PAYLOAD_BINARY
+    mqtt_batch_header_t header;
+    mqtt_batch_record_t record;
+    if(!TEST_CHECK_EQ(len, sizeof(header) + TEST_SAMPLES * sizeof(record))) return;
+    memcpy(&header, plain, sizeof(header));
+    TEST_CHECK_EQ(header.version, MQTT_BATCH_VERSION);
+    TEST_CHECK_EQ(header.channels, ADC_CHANNEL_NUMBER);
+    TEST_CHECK_EQ(header.count, TEST_SAMPLES);
+    TEST_CHECK_EQ(header.t0_ms, 1000);
+    for(size_t i = 0; i < TEST_SAMPLES; i++) {
+        memcpy(&record, plain + sizeof(header) + i * sizeof(record), sizeof(record));
+        TEST_CHECK_EQ(record.dt_ms, (s_samples[i].timestamp_us - s_samples[0].timestamp_us) / 1000);
+        for(int ch = 0; ch < ADC_CHANNEL_NUMBER; ch++) {
+            TEST_CHECK_EQ(record.voltage[ch], s_samples[i].voltage[ch]);
+        }
+        TEST_CHECK_EQ(record.digital, s_samples[i].digital);
+        TEST_CHECK_EQ(record.seq, s_samples[i].seq);
+    }
+#else
+    TEST_CHECK_EQ(len, strlen(s_expected_json));
+    TEST_CHECK(len == strlen(s_expected_json) && memcmp(plain, s_expected_json, len) == 0);
+#endif
+    TEST_CHECK_EQ(counter(METRIC_UPLINK_BYTES_SENT), m->len);
+    TEST_CHECK_EQ(counter(METRIC_UPLINK_BYTES_PLAIN), len);
+
+    //batch was handed over, an empty flush sends nothing
+    sim_mqtt_clear();
+    TEST_CHECK_EQ(uplink_mqtt.flush(&id), ESP_OK);
+    const sim_mqtt_message_t* messages;
+    TEST_CHECK_EQ(sim_mqtt_messages(&messages), 0);
+}
+
+/* Two batches in flight, acknowledged out of order */
+static void test_puback(void) {
+    uint64_t sum_us;
+    uint32_t count, max_us;
+    int id[2], acked;
+    for(int i = 0; i < 2; i++) {
+        TEST_CHECK_EQ(uplink_mqtt.enqueue(&s_samples[i], 1), ESP_OK);
+        TEST_CHECK_EQ(uplink_mqtt.flush(&id[i]), ESP_OK);
+    }
+    const sim_mqtt_message_t* messages;
+    if(!TEST_CHECK_EQ(sim_mqtt_messages(&messages), 2)) return;
+    TEST_CHECK_EQ(id[0], messages[0].msg_id);
+    TEST_CHECK_EQ(id[1], messages[1].msg_id);
+    TEST_CHECK(id[0] != id[1]);
+    TEST_CHECK_EQ(counter(METRIC_UPLOADS_ATTEMPTED), 3);
+    TEST_CHECK(!uplink_mqtt.acked(&acked));
+
+    //only the PUBACK of a published batch counts
+    sim_mqtt_puback(id[1] + 100);
+    TEST_CHECK(!uplink_mqtt.acked(&acked));
+    TEST_CHECK_EQ(counter(METRIC_UPLOADS_SUCCEEDED), 0);
+    sim_mqtt_puback(id[1]);
+    sim_mqtt_puback(id[0]);
+    TEST_CHECK(uplink_mqtt.acked(&acked));
+    TEST_CHECK_EQ(acked, id[1]);
+    TEST_CHECK(uplink_mqtt.acked(&acked));
+    TEST_CHECK_EQ(acked, id[0]);
+    TEST_CHECK(!uplink_mqtt.acked(&acked));
+    TEST_CHECK_EQ(counter(METRIC_UPLOADS_SUCCEEDED), 2);
+    user_metrics_get_summary(METRIC_UPLOAD_LATENCY, &sum_us, &count, &max_us);
+    TEST_CHECK_EQ(count, 2);
+
+    //a batch is acknowledged once
+    sim_mqtt_puback(id[0]);
+    TEST_CHECK(!uplink_mqtt.acked(&acked));
+    TEST_CHECK_EQ(counter(METRIC_UPLOADS_SUCCEEDED), 2);
+    sim_mqtt_clear();
+}
+
+static void test_features(void) {
+    static spectrum_burst_t burst;
+    memset(&burst, 0, sizeof(burst));
+    burst.timestamp_us = 2000000;
+    burst.sample_rate_hz = 4000;
+    burst.points = 256;
+    burst.channel_mask = 0x01;
+    burst.channel[0].rms_mv = 12.5f;
+    burst.channel[0].peaks[0].freq_hz = 50;
+    burst.channel[0].peaks[0].amplitude_mv = 10;
+    TEST_CHECK_EQ(uplink_mqtt.send_features(&burst), ESP_OK);
+
+    //features are plain JSON on their own topic, also when samples are compressed
+    const sim_mqtt_message_t* m = last_message(TEST_TOPIC_PREFIX"spectrum");
+    if(!TEST_CHECK(m != NULL)) return;
+    TEST_CHECK(m->len > strlen(s_expected_features) && memcmp(m->payload, s_expected_features, strlen(s_expected_features)) == 0);
+    TEST_CHECK(m->len > 0 && m->payload[m->len - 1] == '}');
+}
+
+/* Largest values and a long replay delay do not fit in a JSON record, the batch is dropped */
+static void test_record_too_long(void) {
+    const adc_sample_t samples[] = {
+        { .timestamp_us = 1000000, .voltage = { 1, 2, 3, 4 }, .digital = 1, .seq = 1 },
+        { .timestamp_us = 1000000 + 10000000000000LL, .voltage = { UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX },
+          .digital = 0xFF, .seq = UINT32_MAX },
+    };
+    uint32_t dropped = counter(METRIC_UPLINK_DROPPED);
+    const sim_mqtt_message_t* messages;
+    int id;
+    sim_mqtt_clear();
+    TEST_CHECK_EQ(uplink_mqtt.enqueue(samples, 2), ESP_OK);
+#if MQTT_PAYLOAD_BINARY
+    TEST_CHECK_EQ(uplink_mqtt.flush(&id), ESP_OK);
+    TEST_CHECK_EQ(sim_mqtt_messages(&messages), 1);
+    TEST_CHECK_EQ(counter(METRIC_UPLINK_DROPPED), dropped);
+#else
+    TEST_CHECK_EQ(uplink_mqtt.flush(&id), ESP_ERR_INVALID_SIZE);
+    TEST_CHECK_EQ(sim_mqtt_messages(&messages), 0);
+    TEST_CHECK_EQ(counter(METRIC_UPLINK_DROPPED), dropped + 2);
+#endif
+    sim_mqtt_clear();
+}
+
+static void test_disconnect(void) {
+    int id;
+    sim_mqtt_set_connected(false);
+    TEST_CHECK(!uplink_mqtt.healthy());
+    TEST_CHECK_EQ(uplink_mqtt.enqueue(s_samples, 1), ESP_OK);
+    TEST_CHECK_EQ(uplink_mqtt.flush(&id), ESP_ERR_INVALID_STATE);
+    sim_mqtt_set_connected(true);
+    TEST_CHECK_EQ(uplink_mqtt.flush(&id), ESP_OK);
+}
+
+int main(void) {
+    esp_log_level_set("*", ESP_LOG_NONE);
+    printf("test_mqtt (%s%s payload)\n", MQTT_PAYLOAD_BINARY ? "binary" : "JSON", UPLINK_COMPRESSION ? ", gzip" : "");
+    TEST_RUN(test_open_without_connection);
+    TEST_RUN(test_batch_payload);
+    TEST_RUN(test_puback);
+    TEST_RUN(test_features);
+    TEST_RUN(test_record_too_long);
+    TEST_RUN(test_disconnect);
+    return test_summary("test_mqtt");
+}
@@ -0,0 +1,123 @@
+/*
+ *  Tests of the fixed-block memory pool (user_pool.c)
+ *  Every test uses its own pool, the last one takes and gives blocks from several threads at once.
+ */
+#include <pthread.h>
+#include "user_pool.h"
+#include "test.h"
+
+#define TEST_THREADS        4
+#define TEST_ROUNDS         100000
+
+POOL_DEFINE(s_small, 10, 3);
+POOL_DEFINE(s_full, 16, POOL_MAX_BLOCKS);
+POOL_DEFINE(s_shared, sizeof(uint32_t), 6);
+
+static void test_alloc_free(void) {
+    void* block[3];
+    TEST_CHECK_EQ(s_small.block_size, 16);          //rounded up to POOL_ALIGN
+    TEST_CHECK_EQ(pool_free_blocks(&s_small), 3);
+    for(int i = 0; i < 3; i++) {
+        block[i] = pool_alloc(&s_small);
+        if(!TEST_CHECK(block[i] != NULL)) return;
+        TEST_CHECK_EQ((uintptr_t)block[i] % POOL_ALIGN, 0);
+        TEST_CHECK_EQ((uint8_t*)block[i] - s_small.storage, i * 16);
+    }
+    TEST_CHECK_EQ(pool_free_blocks(&s_small), 0);
+    TEST_CHECK_EQ(atomic_load(&s_small.failures), 0);
+
+    //exhausted: every call fails and is counted
+    TEST_CHECK(pool_alloc(&s_small) == NULL);
+    TEST_CHECK(pool_alloc(&s_small) == NULL);
+    TEST_CHECK_EQ(atomic_load(&s_small.failures), 2);
+
+    //lowest free block is taken again
+    pool_free(&s_small, block[1]);
+    pool_free(&s_small, NULL);
+    TEST_CHECK_EQ(pool_free_blocks(&s_small), 1);
+    TEST_CHECK(pool_alloc(&s_small) == block[1]);
+    pool_free(&s_small, block[2]);
+    pool_free(&s_small, block[0]);
+    TEST_CHECK(pool_alloc(&s_small) == block[0]);
+    pool_free(&s_small, block[0]);
+    pool_free(&s_small, block[1]);
+    TEST_CHECK_EQ(pool_free_blocks(&s_small), 3);
+}
+
+/* min_free keeps the lowest number of free blocks, it does not go up when blocks are given back */
+static void test_min_free(void) {
+    TEST_CHECK_EQ(atomic_load(&s_small.min_free), 0);
+    TEST_CHECK_EQ(atomic_load(&s_full.min_free), POOL_MAX_BLOCKS);
+    void* a = pool_alloc(&s_full);
+    void* b = pool_alloc(&s_full);
+    TEST_CHECK_EQ(atomic_load(&s_full.min_free), POOL_MAX_BLOCKS - 2);
+    pool_free(&s_full, a);
+    pool_free(&s_full, b);
+    TEST_CHECK_EQ(atomic_load(&s_full.min_free), POOL_MAX_BLOCKS - 2);
+    TEST_CHECK_EQ(pool_free_blocks(&s_full), POOL_MAX_BLOCKS);
+}
+
+/* 32 blocks use every bit of the bitmap */
+static void test_full_mask(void) {
+    void* block[POOL_MAX_BLOCKS];
+    for(int i = 0; i < POOL_MAX_BLOCKS; i++) {
+        block[i] = pool_alloc(&s_full);
+        if(!TEST_CHECK(block[i] != NULL)) return;
+    }
+    TEST_CHECK_EQ(atomic_load(&s_full.used), 0xFFFFFFFFu);
+    TEST_CHECK_EQ((uint8_t*)block[POOL_MAX_BLOCKS - 1] - s_full.storage, (POOL_MAX_BLOCKS - 1) * 16);
+    TEST_CHECK(pool_alloc(&s_full) == NULL);
+    TEST_CHECK_EQ(atomic_load(&s_full.failures), 1);
+    TEST_CHECK_EQ(atomic_load(&s_full.min_free), 0);
+
+    //block 31 is the top bit
+    pool_free(&s_full, block[POOL_MAX_BLOCKS - 1]);
+    TEST_CHECK_EQ(atomic_load(&s_full.used), 0x7FFFFFFFu);
+    TEST_CHECK(pool_alloc(&s_full) == block[POOL_MAX_BLOCKS - 1]);
+    for(int i = 0; i < POOL_MAX_BLOCKS; i++) {
+        pool_free(&s_full, block[i]);
+    }
+    TEST_CHECK_EQ(pool_free_blocks(&s_full), POOL_MAX_BLOCKS);
+}
+
+/* Each thread marks the blocks it holds, a block handed out twice would show another mark */
+static void* pool_thread(void* arg) {
+    uint32_t mark = (uint32_t)(uintptr_t)arg;
+    uint32_t collisions = 0;
+    for(int i = 0; i < TEST_ROUNDS; i++) {
+        uint32_t* block = pool_alloc(&s_shared);
+        if(block == NULL) continue;
+        *block = mark;
+        for(volatile int spin = 0; spin < 10; spin++);
+        if(*block != mark) collisions++;
+        pool_free(&s_shared, block);
+    }
+    return (void*)(uintptr_t)collisions;
+}
+
+static void test_concurrent(void) {
+    pthread_t threads[TEST_THREADS];
+    uint32_t collisions = 0;
+    for(int i = 0; i < TEST_THREADS; i++) {
+        pthread_create(&threads[i], NULL, pool_thread, (void*)(uintptr_t)(i + 1));
+    }
+    for(int i = 0; i < TEST_THREADS; i++) {
+        void* ret;
+        pthread_join(threads[i], &ret);
+        collisions += (uint32_t)(uintptr_t)ret;
+    }
+    TEST_CHECK_EQ(collisions, 0);
+    TEST_CHECK_EQ(pool_free_blocks(&s_shared), 6);
+    //fewer threads than blocks: the pool never runs out
+    TEST_CHECK_EQ(atomic_load(&s_shared.failures), 0);
+    TEST_CHECK(atomic_load(&s_shared.min_free) >= 6 - TEST_THREADS);
+}
+
+int main(void) {
+    printf("test_pool\n");
+    TEST_RUN(test_alloc_free);
+    TEST_RUN(test_min_free);
+    TEST_RUN(test_full_mask);
+    TEST_RUN(test_concurrent);
+    return test_summary("test_pool");
+}
@@ -0,0 +1,157 @@
+/*
+ *  Tests of the upload window policy and energy accounting (user_power.c)
+ *  The power_* functions take the time as argument, the clock is a plain variable advanced by the test.
+ */
+#include "user_power.h"
+#include "test.h"
+
+#define MS(x)   ((x) * 1000LL)
+
+static const power_config_t s_config = {
+    .window_period_ms = 60000,
+    .window_max_ms = 20000,
+    .backlog_samples = 24,
+    .min_sleep_ms = 30,
+    .event_window = true,
+};
+
+/* State at t = 1 s after boot with the first scheduled window already skipped */
+static int64_t setup(power_state_t* state) {
+    int64_t now = MS(1000);
+    power_init(&s_config, state, now);
+    TEST_CHECK(!power_window_due(&s_config, state, now, 0, false));
+    TEST_CHECK_EQ(state->next_window_us, now + MS(60000));
+    return now;
+}
+
+static void test_scheduled(void) {
+    power_state_t state;
+    int64_t now = setup(&state);
+    //samples waiting, not enough to open early
+    now += MS(30000);
+    TEST_CHECK(!power_window_due(&s_config, &state, now, 5, false));
+    now += MS(30000);
+    TEST_CHECK(power_window_due(&s_config, &state, now, 5, false));
+    power_window_begin(&state, now);
+    TEST_CHECK(state.radio_on);
+    //no second window while the radio is on
+    TEST_CHECK(!power_window_due(&s_config, &state, now, 50, true));
+    TEST_CHECK(!power_window_done(&s_config, &state, now + MS(1000), 2));
+    TEST_CHECK(power_window_done(&s_config, &state, now + MS(1500), 0));
+    power_window_end(&s_config, &state, now + MS(1500), true);
+    TEST_CHECK(!state.radio_on);
+    TEST_CHECK_EQ(state.windows, 1);
+    TEST_CHECK_EQ(state.radio_us, MS(1500));
+    //period is kept from the start of the window
+    TEST_CHECK_EQ(state.next_window_us, now + MS(60000));
+}
+
+/* A window with nothing to send is skipped and the next one is a period later */
+static void test_skip_empty(void) {
+    power_state_t state;
+    int64_t now = setup(&state);
+    int64_t scheduled = state.next_window_us;
+    now = scheduled + MS(10);
+    TEST_CHECK(!power_window_due(&s_config, &state, now, 0, false));
+    TEST_CHECK_EQ(state.next_window_us, now + MS(60000));
+    //a sample right after does not open the skipped window
+    TEST_CHECK(!power_window_due(&s_config, &state, now + MS(500), 1, false));
+    TEST_CHECK_EQ(state.windows, 0);
+}
+
+static void test_backlog(void) {
+    power_state_t state;
+    int64_t now = setup(&state) + MS(5000);
+    TEST_CHECK(!power_window_due(&s_config, &state, now, 23, false));
+    TEST_CHECK(power_window_due(&s_config, &state, now, 24, false));
+    power_window_begin(&state, now);
+    //link too slow: window closes at its maximum length with samples left
+    TEST_CHECK(!power_window_done(&s_config, &state, now + MS(19999), 10));
+    TEST_CHECK(power_window_done(&s_config, &state, now + MS(20000), 10));
+    power_window_end(&s_config, &state, now + MS(20000), false);
+    TEST_CHECK(state.backoff);
+    TEST_CHECK_EQ(state.next_window_us, now + MS(60000));
+    //backoff: neither backlog nor events open the radio before the scheduled window
+    now += MS(30000);
+    TEST_CHECK(!power_window_due(&s_config, &state, now, 100, false));
+    TEST_CHECK(!power_window_due(&s_config, &state, now, 100, true));
+    now += MS(30000);
+    TEST_CHECK(power_window_due(&s_config, &state, now, 100, false));
+    power_window_begin(&state, now);
+    TEST_CHECK(!state.backoff);
+    power_window_end(&s_config, &state, now + MS(2000), true);
+    TEST_CHECK(!state.backoff);
+    TEST_CHECK(power_window_due(&s_config, &state, now + MS(3000), 24, false));
+
+    //backlog limit 0 never opens a window early
+    power_config_t config = s_config;
+    config.backlog_samples = 0;
+    now = setup(&state) + MS(5000);
+    TEST_CHECK(!power_window_due(&config, &state, now, 1000, false));
+}
+
+static void test_event(void) {
+    power_state_t state;
+    int64_t now = setup(&state) + MS(100);
+    TEST_CHECK(!power_window_due(&s_config, &state, now, 1, false));
+    TEST_CHECK(power_window_due(&s_config, &state, now, 1, true));
+
+    power_config_t config = s_config;
+    config.event_window = false;
+    TEST_CHECK(!power_window_due(&config, &state, now, 1, true));
+}
+
+/* Window longer than a period: the next one is a period after its end, not at once */
+static void test_late_window(void) {
+    power_state_t state;
+    int64_t now = setup(&state) + MS(5000);
+    power_window_begin(&state, now);
+    power_window_end(&s_config, &state, now + MS(70000), true);
+    TEST_CHECK_EQ(state.next_window_us, now + MS(70000) + MS(60000));
+}
+
+static void test_awake(void) {
+    power_state_t state;
+    power_stats_t stats;
+    power_init(&s_config, &state, 0);
+    //boot is the first wakeup, the chip is awake until the first end
+    TEST_CHECK_EQ(state.wakeups, 1);
+    TEST_CHECK(power_awake_end(&state, MS(100)));
+    //nested holders
+    TEST_CHECK(power_awake_begin(&s_config, &state, MS(200)));
+    TEST_CHECK(!power_awake_begin(&s_config, &state, MS(210)));
+    TEST_CHECK(!power_awake_end(&state, MS(220)));
+    TEST_CHECK(power_awake_end(&state, MS(230)));
+    TEST_CHECK_EQ(state.wakeups, 2);
+    TEST_CHECK_EQ(state.awake_us, MS(130));
+    //gap shorter than min_sleep_ms is counted as awake and is no wakeup
+    TEST_CHECK(power_awake_begin(&s_config, &state, MS(250)));
+    TEST_CHECK_EQ(state.wakeups, 2);
+    TEST_CHECK(power_awake_end(&state, MS(260)));
+    TEST_CHECK_EQ(state.awake_us, MS(160));
+    //unbalanced end is ignored
+    TEST_CHECK(!power_awake_end(&state, MS(270)));
+    TEST_CHECK_EQ(state.holders, 0);
+
+    //open awake period and window count up to now
+    power_awake_begin(&s_config, &state, MS(1000));
+    power_window_begin(&state, MS(1000));
+    power_stats(&state, MS(1500), &stats);
+    TEST_CHECK_EQ(stats.elapsed_us, MS(1500));
+    TEST_CHECK_EQ(stats.awake_us, MS(660));
+    TEST_CHECK_EQ(stats.radio_us, MS(500));
+    TEST_CHECK_EQ(stats.wakeups, 3);
+    TEST_CHECK_EQ(stats.windows, 1);
+    TEST_CHECK_EQ(stats.wakeups_per_hour, 3 * 3600 * 2 / 3);
+}
+
+int main(void) {
+    printf("test_power\n");
+    TEST_RUN(test_scheduled);
+    TEST_RUN(test_skip_empty);
+    TEST_RUN(test_backlog);
+    TEST_RUN(test_event);
+    TEST_RUN(test_late_window);
+    TEST_RUN(test_awake);
+    return test_summary("test_power");
+}
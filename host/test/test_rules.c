@@ -0,0 +1,182 @@
+/*
+ *  Tests of the report-by-exception rules (user_rules.c)
+ *  Samples are evaluated one by one with their time, the first one is always reported.
+ */
+#include "user_rules.h"
+#include "test.h"
+
+#define MS(x)   ((x) * 1000LL)
+
+/* Nothing is reported after the first sample: wide deadband, no thresholds, edges or heartbeat */
+static rules_config_t quiet_config(void) {
+    rules_config_t config;
+    for(int ch = 0; ch < RULES_ANALOG_CHANNELS; ch++) {
+        config.analog[ch] = (rule_analog_t){ 1000, RULES_DISABLED, RULES_DISABLED, RULES_DISABLED, 0 };
+    }
+    for(int ch = 0; ch < RULES_DIGITAL_CHANNELS; ch++) {
+        config.digital[ch] = RULE_EDGE_NONE;
+    }
+    config.heartbeat_ms = RULES_DISABLED;
+    return config;
+}
+
+/* Channel 0 set to value, others at 1000 mV */
+static rules_result_t evaluate(const rules_config_t* config, rules_state_t* state, uint32_t value, uint8_t digital, int64_t now_us) {
+    uint32_t voltage[RULES_ANALOG_CHANNELS] = { value, 1000, 1000, 1000 };
+    return rules_evaluate(config, state, voltage, digital, now_us);
+}
+
+static void test_no_deadband(void) {
+    rules_config_t config = quiet_config();
+    rules_state_t state;
+    config.analog[0].deadband_mv = RULES_DISABLED;
+    rules_init(&state);
+    //no deadband at all: every sample, unchanged or not
+    TEST_CHECK(evaluate(&config, &state, 500, 0, 0).report);
+    TEST_CHECK(evaluate(&config, &state, 500, 0, MS(1)).report);
+    TEST_CHECK(!evaluate(&config, &state, 500, 0, MS(2)).event);
+}
+
+static void test_deadband_mv(void) {
+    rules_config_t config = quiet_config();
+    rules_state_t state;
+    config.analog[0].deadband_mv = 20;
+    rules_init(&state);
+    TEST_CHECK(evaluate(&config, &state, 500, 0, 0).report);
+    TEST_CHECK(!evaluate(&config, &state, 519, 0, MS(1)).report);
+    TEST_CHECK(!evaluate(&config, &state, 481, 0, MS(2)).report);
+    TEST_CHECK(evaluate(&config, &state, 480, 0, MS(3)).report);
+    //deadband is relative to the last reported value, not the previous sample
+    TEST_CHECK(!evaluate(&config, &state, 490, 0, MS(4)).report);
+    TEST_CHECK(!evaluate(&config, &state, 499, 0, MS(5)).report);
+    TEST_CHECK(evaluate(&config, &state, 500, 0, MS(6)).report);
+}
+
+static void test_deadband_permille(void) {
+    rules_config_t config = quiet_config();
+    rules_state_t state;
+    config.analog[0].deadband_mv = RULES_DISABLED;
+    config.analog[0].deadband_permille = 50;        //5 %
+    rules_init(&state);
+    TEST_CHECK(evaluate(&config, &state, 1000, 0, 0).report);
+    TEST_CHECK(!evaluate(&config, &state, 1049, 0, MS(1)).report);
+    TEST_CHECK(evaluate(&config, &state, 1050, 0, MS(2)).report);
+    TEST_CHECK(!evaluate(&config, &state, 1000, 0, MS(3)).report);
+    TEST_CHECK(evaluate(&config, &state, 997, 0, MS(4)).report);
+
+    //last report at 0 mV: unchanged samples are not reported, any change is
+    TEST_CHECK(evaluate(&config, &state, 0, 0, MS(5)).report);
+    TEST_CHECK(!evaluate(&config, &state, 0, 0, MS(6)).report);
+    TEST_CHECK(!evaluate(&config, &state, 0, 0, MS(7)).report);
+    TEST_CHECK(evaluate(&config, &state, 1, 0, MS(8)).report);
+
+    //both deadbands: whichever is crossed first
+    config.analog[0].deadband_mv = 20;
+    rules_init(&state);
+    TEST_CHECK(evaluate(&config, &state, 100, 0, 0).report);
+    TEST_CHECK(!evaluate(&config, &state, 104, 0, MS(1)).report);
+    TEST_CHECK(evaluate(&config, &state, 105, 0, MS(2)).report);       //5 %
+    TEST_CHECK(evaluate(&config, &state, 1000, 0, MS(3)).report);
+    TEST_CHECK(!evaluate(&config, &state, 1019, 0, MS(4)).report);
+    TEST_CHECK(evaluate(&config, &state, 1020, 0, MS(5)).report);     //2 %, 20 mV
+}
+
+static void test_high_threshold(void) {
+    rules_config_t config = quiet_config();
+    rules_state_t state;
+    rules_result_t r;
+    config.analog[0].high_mv = 2000;
+    config.analog[0].hysteresis_mv = 100;
+    rules_init(&state);
+    r = evaluate(&config, &state, 1990, 0, 0);
+    TEST_CHECK(r.report && !r.event);
+    r = evaluate(&config, &state, 2000, 0, MS(1));
+    TEST_CHECK(r.report && r.event);
+    TEST_CHECK_EQ(r.high_mask, 0x01);
+    //still above, then inside the hysteresis: no new event
+    r = evaluate(&config, &state, 2500, 0, MS(2));
+    TEST_CHECK(!r.report && !r.event);
+    r = evaluate(&config, &state, 1901, 0, MS(3));
+    TEST_CHECK(!r.report && !r.event);
+    //back below threshold minus hysteresis
+    r = evaluate(&config, &state, 1899, 0, MS(4));
+    TEST_CHECK(r.report && r.event);
+    TEST_CHECK_EQ(r.high_mask, 0x01);
+    r = evaluate(&config, &state, 2000, 0, MS(5));
+    TEST_CHECK(r.event);
+}
+
+/* 0 mV is a valid threshold, only RULES_DISABLED turns the rule off */
+static void test_low_threshold(void) {
+    rules_config_t config = quiet_config();
+    rules_state_t state;
+    rules_result_t r;
+    config.analog[0].low_mv = 0;
+    config.analog[0].hysteresis_mv = 10;
+    rules_init(&state);
+    evaluate(&config, &state, 50, 0, 0);
+    r = evaluate(&config, &state, 0, 0, MS(1));
+    TEST_CHECK(r.report && r.event);
+    TEST_CHECK_EQ(r.low_mask, 0x01);
+    TEST_CHECK(!evaluate(&config, &state, 10, 0, MS(2)).event);
+    r = evaluate(&config, &state, 11, 0, MS(3));
+    TEST_CHECK(r.event);
+    TEST_CHECK_EQ(r.low_mask, 0x01);
+
+    //disabled threshold never fires, at the extremes of the range either
+    config = quiet_config();
+    rules_init(&state);
+    evaluate(&config, &state, 0, 0, 0);
+    TEST_CHECK(!evaluate(&config, &state, UINT32_MAX - 1, 0, MS(1)).event);
+    TEST_CHECK(!evaluate(&config, &state, 0, 0, MS(2)).event);
+}
+
+static void test_digital_edges(void) {
+    rules_config_t config = quiet_config();
+    rules_state_t state;
+    rules_result_t r;
+    config.digital[0] = RULE_EDGE_RISING;
+    config.digital[1] = RULE_EDGE_FALLING;
+    config.digital[2] = RULE_EDGE_BOTH;
+    rules_init(&state);
+    //state at first sample is no edge
+    r = evaluate(&config, &state, 0, 0x0F, 0);
+    TEST_CHECK(r.report && !r.event);
+    r = evaluate(&config, &state, 0, 0x00, MS(1));
+    TEST_CHECK(r.event);
+    TEST_CHECK_EQ(r.edge_mask, 0x06);
+    r = evaluate(&config, &state, 0, 0x0F, MS(2));
+    TEST_CHECK_EQ(r.edge_mask, 0x05);
+    //channel 3 has no edge rule
+    r = evaluate(&config, &state, 0, 0x07, MS(3));
+    TEST_CHECK(!r.report && !r.event);
+    TEST_CHECK_EQ(r.edge_mask, 0);
+}
+
+static void test_heartbeat(void) {
+    rules_config_t config = quiet_config();
+    rules_state_t state;
+    config.analog[0].deadband_mv = 20;
+    config.heartbeat_ms = 1000;
+    rules_init(&state);
+    TEST_CHECK(evaluate(&config, &state, 500, 0, MS(100)).report);
+    TEST_CHECK(!evaluate(&config, &state, 500, 0, MS(1099)).report);
+    TEST_CHECK(evaluate(&config, &state, 500, 0, MS(1100)).report);
+    //a report restarts the period
+    TEST_CHECK(evaluate(&config, &state, 600, 0, MS(1500)).report);
+    TEST_CHECK(!evaluate(&config, &state, 600, 0, MS(2499)).report);
+    rules_result_t r = evaluate(&config, &state, 600, 0, MS(2500));
+    TEST_CHECK(r.report && !r.event);
+}
+
+int main(void) {
+    printf("test_rules\n");
+    TEST_RUN(test_no_deadband);
+    TEST_RUN(test_deadband_mv);
+    TEST_RUN(test_deadband_permille);
+    TEST_RUN(test_high_threshold);
+    TEST_RUN(test_low_threshold);
+    TEST_RUN(test_digital_edges);
+    TEST_RUN(test_heartbeat);
+    return test_summary("test_rules");
+}
@@ -0,0 +1,202 @@
+/*
+ *  Tests of the adaptive sampling rate controller (user_sampling.c) with synthetic signals
+ *  Samples are taken at the period chosen by the controller, on a simulated clock.
+ */
+#include <math.h>
+#include <string.h>
+#include "user_sampling.h"
+#include "test.h"
+
+static const sampling_config_t s_config = {
+    .min_period_ms = 250,
+    .max_period_ms = 2000,
+    .slope_mv_per_s = 100,
+    .stddev_mv = 25,
+    .quiet_samples = 8,
+};
+
+/* Signal of every channel, mV at time t */
+typedef uint32_t (*signal_t)(int ch, int64_t t_us);
+
+typedef struct {
+    sampling_state_t state;
+    int64_t now_us;
+    int changes;
+} controller_t;
+
+static void controller_init(controller_t* c) {
+    sampling_init(&s_config, &c->state);
+    c->now_us = 0;
+    c->changes = 0;
+}
+
+/* Take one sample and wait for the period the controller asks for */
+static uint32_t controller_step(controller_t* c, signal_t signal) {
+    uint32_t voltage[SAMPLING_CHANNELS];
+    for(int ch = 0; ch < SAMPLING_CHANNELS; ch++) {
+        voltage[ch] = signal(ch, c->now_us);
+    }
+    if(sampling_update(&s_config, &c->state, voltage, c->now_us)) c->changes++;
+    c->now_us += c->state.period_ms * 1000LL;
+    return c->state.period_ms;
+}
+
+/* Run until time end_us, true if period stayed at period_ms */
+static bool controller_run(controller_t* c, signal_t signal, int64_t end_us, uint32_t period_ms) {
+    bool constant = true;
+    while(c->now_us < end_us) {
+        constant &= (controller_step(c, signal) == period_ms);
+    }
+    return constant;
+}
+
+/*
+ * Run a quiet signal until the floor rate is back. Every change must double the period (or stop
+ * at the floor) and come after quiet_samples samples. Return the number of samples, -1 on error.
+ */
+static int controller_decay(controller_t* c, signal_t signal, int max_samples) {
+    uint32_t period = c->state.period_ms;
+    int held = 0;
+    for(int n = 1; n <= max_samples; n++) {
+        uint32_t next = controller_step(c, signal);
+        held++;
+        if(next == period) continue;
+        uint32_t expected = period * 2 > s_config.max_period_ms ? s_config.max_period_ms : period * 2;
+        if(!TEST_CHECK_EQ(next, expected) || !TEST_CHECK(held >= s_config.quiet_samples)) return -1;
+        if(next == s_config.max_period_ms) return n;
+        period = next;
+        held = 0;
+    }
+    return -1;
+}
+
+/**** Signals ****/
+
+static int64_t s_event_us;                  //time of step, start of ramp or of noise burst
+
+static uint32_t signal_flat(int ch, int64_t t_us) {
+    return 1000 + 100 * ch;
+}
+
+static uint32_t signal_step(int ch, int64_t t_us) {
+    //only channel 2 moves, one active channel is enough
+    return signal_flat(ch, t_us) + (ch == 2 && t_us >= s_event_us ? 1000 : 0);
+}
+
+/* 500 mV/s for 20 s, then flat */
+static uint32_t signal_ramp(int ch, int64_t t_us) {
+    int64_t t = t_us - s_event_us;
+    if(t < 0) t = 0;
+    if(t > 20000000) t = 20000000;
+    return signal_flat(ch, t_us) + t * 500 / 1000000;
+}
+
+/* Deterministic noise in [-1, 1], same value for the same time and channel */
+static float noise(int ch, int64_t t_us) {
+    uint32_t x = (uint32_t)(t_us / 1000) * 2654435761u ^ (uint32_t)(ch + 1) * 0x9E3779B9u;
+    x ^= x >> 15;
+    x *= 0x2C1B3C6Du;
+    x ^= x >> 12;
+    return (float)x / 2147483648.0f - 1.0f;
+}
+
+/* +-5 mV, deviation about 3 mV: sensor noise that must not raise the rate */
+static uint32_t signal_small_noise(int ch, int64_t t_us) {
+    return signal_flat(ch, t_us) + lroundf(5 * noise(ch, t_us));
+}
+
+/* +-150 mV for 60 s from s_event_us (deviation about 87 mV), then flat */
+static uint32_t signal_noise_burst(int ch, int64_t t_us) {
+    bool burst = t_us >= s_event_us && t_us < s_event_us + 60000000;
+    return signal_flat(ch, t_us) + (burst ? lroundf(150 * noise(ch, t_us)) : 0);
+}
+
+/**** Tests ****/
+
+static void test_flat_stays_at_floor(void) {
+    controller_t c;
+    controller_init(&c);
+    TEST_CHECK_EQ(c.state.period_ms, s_config.max_period_ms);
+    TEST_CHECK(controller_run(&c, signal_flat, 600000000, s_config.max_period_ms));
+    TEST_CHECK_EQ(c.changes, 0);
+}
+
+static void test_small_noise_stays_at_floor(void) {
+    controller_t c;
+    controller_init(&c);
+    TEST_CHECK(controller_run(&c, signal_small_noise, 600000000, s_config.max_period_ms));
+    TEST_CHECK_EQ(c.changes, 0);
+}
+
+/* Step goes to the fast rate on the first sample after it, then decays to the floor */
+static void test_step(void) {
+    controller_t c;
+    controller_init(&c);
+    s_event_us = 60000000;
+    TEST_CHECK(controller_run(&c, signal_step, s_event_us, s_config.max_period_ms));
+    TEST_CHECK_EQ(controller_step(&c, signal_step), s_config.min_period_ms);
+
+    //deviation of the running mean keeps the fast rate longer than quiet_samples after the step,
+    //then min -> 2 min -> 4 min -> floor
+    int decay = controller_decay(&c, signal_step, 200);
+    TEST_CHECK(decay > 4 * s_config.quiet_samples);
+    TEST_CHECK(decay < 100);
+    TEST_CHECK(controller_run(&c, signal_step, c.now_us + 600000000, s_config.max_period_ms));
+}
+
+/* Fast rate during the whole ramp, floor rate after it */
+static void test_ramp(void) {
+    controller_t c;
+    controller_init(&c);
+    s_event_us = 10000000;
+    TEST_CHECK(controller_run(&c, signal_ramp, s_event_us, s_config.max_period_ms));
+    //first sample of the ramp still sees the flat part
+    controller_step(&c, signal_ramp);
+    int64_t ramp_end_us = s_event_us + 20000000;
+    uint32_t first = controller_step(&c, signal_ramp);
+    TEST_CHECK_EQ(first, s_config.min_period_ms);
+    TEST_CHECK(controller_run(&c, signal_ramp, ramp_end_us, s_config.min_period_ms));
+    TEST_CHECK(controller_decay(&c, signal_ramp, 200) > 0);
+    TEST_CHECK_EQ(c.state.period_ms, s_config.max_period_ms);
+}
+
+/* Noise above stddev_mv keeps the fast rate, the floor rate comes back after it */
+static void test_noise_burst(void) {
+    controller_t c;
+    controller_init(&c);
+    s_event_us = 30000000;
+    TEST_CHECK(controller_run(&c, signal_noise_burst, s_event_us, s_config.max_period_ms));
+    int samples = 0;
+    while(controller_step(&c, signal_noise_burst) != s_config.min_period_ms && samples < 10) samples++;
+    TEST_CHECK(samples < 3);
+    TEST_CHECK(controller_run(&c, signal_noise_burst, s_event_us + 60000000, s_config.min_period_ms));
+    TEST_CHECK(controller_decay(&c, signal_noise_burst, 200) > 0);
+    TEST_CHECK(controller_run(&c, signal_noise_burst, c.now_us + 600000000, s_config.max_period_ms));
+}
+
+/* Slope alone, deviation check off: slope_mv_per_s is the threshold */
+static void test_slope_only(void) {
+    sampling_config_t config = s_config;
+    sampling_state_t state;
+    uint32_t voltage[SAMPLING_CHANNELS] = { 1000, 1000, 1000, 1000 };
+    config.stddev_mv = 0;
+    sampling_init(&config, &state);
+    sampling_update(&config, &state, voltage, 0);
+    //99 mV in 1 s is below the threshold, 100 mV is not
+    voltage[0] += 99;
+    TEST_CHECK(!sampling_update(&config, &state, voltage, 1000000));
+    voltage[0] += 100;
+    TEST_CHECK(sampling_update(&config, &state, voltage, 2000000));
+    TEST_CHECK_EQ(state.period_ms, config.min_period_ms);
+}
+
+int main(void) {
+    printf("test_sampling\n");
+    TEST_RUN(test_flat_stays_at_floor);
+    TEST_RUN(test_small_noise_stays_at_floor);
+    TEST_RUN(test_step);
+    TEST_RUN(test_ramp);
+    TEST_RUN(test_noise_burst);
+    TEST_RUN(test_slope_only);
+    return test_summary("test_sampling");
+}
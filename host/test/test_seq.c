@@ -0,0 +1,167 @@
+/*
+ *  Tests of the gap tracker (user_seq.c) and of reading samples back from the log (user_record.c)
+ *  The log is a temporary file written with the record functions of the SD writer.
+ */
+#include "user_seq.h"
+#include "user_record.h"
+#include "test.h"
+
+static void check_range(const seq_tracker_t* t, uint32_t i, uint32_t first, uint32_t last) {
+    if(!TEST_CHECK(i < t->count)) return;
+    TEST_CHECK_EQ(t->gaps[i].first, first);
+    TEST_CHECK_EQ(t->gaps[i].last, last);
+}
+
+/**** Tracker ****/
+
+static void test_receive(void) {
+    seq_tracker_t t;
+    seq_tracker_init(&t, 100);
+    TEST_CHECK_EQ(seq_tracker_receive(&t, 100), 0);
+    TEST_CHECK_EQ(seq_tracker_receive(&t, 101), 0);
+    TEST_CHECK_EQ(seq_tracker_receive(&t, 105), 3);
+    //older numbers are not from the live stream
+    TEST_CHECK_EQ(seq_tracker_receive(&t, 50), 0);
+    TEST_CHECK_EQ(t.next, 106);
+    //missing numbers are only gaps once the caller adds them
+    TEST_CHECK_EQ(t.count, 0);
+    TEST_CHECK_EQ(seq_tracker_watermark(&t, UINT32_MAX), 106);
+}
+
+static void test_gap_merge(void) {
+    seq_tracker_t t;
+    seq_tracker_init(&t, 0);
+    TEST_CHECK(seq_tracker_gap(&t, 20, 29));
+    TEST_CHECK(seq_tracker_gap(&t, 40, 49));
+    //batch not acknowledged in time, older than the gaps
+    TEST_CHECK(seq_tracker_gap(&t, 5, 7));
+    TEST_CHECK_EQ(t.count, 3);
+    check_range(&t, 0, 5, 7);
+    check_range(&t, 1, 20, 29);
+    //touching ranges merge, ranges in between are absorbed
+    TEST_CHECK(seq_tracker_gap(&t, 30, 30));
+    check_range(&t, 1, 20, 30);
+    TEST_CHECK(seq_tracker_gap(&t, 8, 39));
+    TEST_CHECK_EQ(t.count, 1);
+    check_range(&t, 0, 5, 49);
+}
+
+/* Full table: a new range is given up, nothing sent is merged into a gap */
+static void test_gap_full(void) {
+    seq_tracker_t t;
+    seq_tracker_init(&t, 0);
+    for(uint32_t i = 0; i < SEQ_MAX_RANGES; i++) {
+        TEST_CHECK(seq_tracker_gap(&t, 10 * i, 10 * i + 1));
+    }
+    TEST_CHECK(!seq_tracker_gap(&t, 10 * SEQ_MAX_RANGES, 10 * SEQ_MAX_RANGES));
+    TEST_CHECK(!seq_tracker_gap(&t, 5, 6));
+    TEST_CHECK_EQ(t.count, SEQ_MAX_RANGES);
+    check_range(&t, 0, 0, 1);
+    check_range(&t, SEQ_MAX_RANGES - 1, 10 * (SEQ_MAX_RANGES - 1), 10 * (SEQ_MAX_RANGES - 1) + 1);
+    //a range which touches one still fits
+    TEST_CHECK(seq_tracker_gap(&t, 2, 3));
+    check_range(&t, 0, 0, 3);
+}
+
+static void test_remove(void) {
+    seq_tracker_t t;
+    seq_tracker_init(&t, 0);
+    seq_tracker_gap(&t, 10, 19);
+    seq_tracker_gap(&t, 30, 39);
+    //prefix as replay removes it, then a whole range
+    TEST_CHECK_EQ(seq_tracker_remove(&t, 10, 14), 0);
+    check_range(&t, 0, 15, 19);
+    TEST_CHECK_EQ(seq_tracker_remove(&t, 15, 19), 0);
+    TEST_CHECK_EQ(t.count, 1);
+    //middle of a range is split
+    TEST_CHECK_EQ(seq_tracker_remove(&t, 33, 34), 0);
+    check_range(&t, 0, 30, 32);
+    check_range(&t, 1, 35, 39);
+
+    //no room to split => part above is given up
+    seq_tracker_init(&t, 0);
+    for(uint32_t i = 0; i < SEQ_MAX_RANGES; i++) {
+        seq_tracker_gap(&t, 10 * i, 10 * i + 5);
+    }
+    TEST_CHECK_EQ(seq_tracker_remove(&t, 2, 3), 2);
+    check_range(&t, 0, 0, 1);
+    check_range(&t, 1, 10, 15);
+}
+
+static void test_watermark(void) {
+    seq_tracker_t t;
+    seq_tracker_init(&t, 0);
+    seq_tracker_receive(&t, 99);
+    TEST_CHECK_EQ(seq_tracker_watermark(&t, UINT32_MAX), 100);
+    //batch waiting for acknowledgement
+    TEST_CHECK_EQ(seq_tracker_watermark(&t, 64), 64);
+    seq_tracker_gap(&t, 40, 41);
+    TEST_CHECK_EQ(seq_tracker_watermark(&t, 64), 40);
+    TEST_CHECK_EQ(seq_tracker_watermark(&t, 12), 12);
+}
+
+/**** Log ****/
+
+/* Samples 0..19 at 500 ms, every third one suppressed, period 250 ms from sample 10, 14 and 15 never written */
+static FILE* write_log(seq_index_entry_t* start) {
+    FILE* f = tmpfile();
+    if(f == NULL) return NULL;
+    *start = (seq_index_entry_t){ .seq = 0, .offset = 0, .timestamp_us = 1000000, .period_ms = 500 };
+    for(uint32_t seq = 0; seq < 20; seq++) {
+        uint32_t voltage[ADC_CHANNEL_NUMBER] = { seq, seq + 1, seq + 2, seq + 3 };
+        if(seq == 14 || seq == 15) continue;
+        if(seq == 10) user_file_record_period(f, 6000000, 250);
+        user_file_record_value(f, voltage, seq & 0x0F, seq, seq % 3 == 0);
+    }
+    return f;
+}
+
+static void test_read_skips_suppressed(void) {
+    seq_index_entry_t start;
+    adc_sample_t out[20];
+    size_t skipped;
+    FILE* f = write_log(&start);
+    if(!TEST_CHECK(f != NULL)) return;
+
+    //2..11: 3, 6 and 9 are suppressed
+    size_t count = user_file_read_values(f, &start, 2, 11, out, 20, &skipped);
+    TEST_CHECK_EQ(count, 7);
+    TEST_CHECK_EQ(skipped, 3);
+    TEST_CHECK_EQ(out[0].seq, 2);
+    TEST_CHECK_EQ(out[1].seq, 4);
+    TEST_CHECK_EQ(out[0].voltage[3], 5);
+    TEST_CHECK_EQ(out[0].digital, 2);
+    TEST_CHECK_EQ(out[0].timestamp_us, 2000000);
+    //time base of the Period line
+    TEST_CHECK_EQ(out[6].seq, 11);
+    TEST_CHECK_EQ(out[6].timestamp_us, 6250000);
+    TEST_CHECK_EQ(out[6].period_ms, 250);
+
+    //time of a sample after missing numbers follows its number, not its place in the log
+    count = user_file_read_values(f, &start, 16, 16, out, 20, &skipped);
+    TEST_CHECK_EQ(count, 1);
+    TEST_CHECK_EQ(out[0].timestamp_us, 7500000);
+
+    //full output: suppressed records after the last sample read are left for the next read
+    count = user_file_read_values(f, &start, 1, 19, out, 3, &skipped);
+    TEST_CHECK_EQ(count, 3);
+    TEST_CHECK_EQ(out[2].seq, 4);
+    TEST_CHECK_EQ(skipped, 1);
+
+    //only suppressed records
+    count = user_file_read_values(f, &start, 9, 9, out, 20, &skipped);
+    TEST_CHECK_EQ(count, 0);
+    TEST_CHECK_EQ(skipped, 1);
+    fclose(f);
+}
+
+int main(void) {
+    printf("test_seq\n");
+    TEST_RUN(test_receive);
+    TEST_RUN(test_gap_merge);
+    TEST_RUN(test_gap_full);
+    TEST_RUN(test_remove);
+    TEST_RUN(test_watermark);
+    TEST_RUN(test_read_skips_suppressed);
+    return test_summary("test_seq");
+}
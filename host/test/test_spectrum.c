@@ -0,0 +1,195 @@
+/*
+ *  Tests of the burst features (user_spectrum.c) against a naive O(n^2) DFT in double
+ *  Signals are synthetic tones, on and between FFT bins, with an offset.
+ */
+#include <math.h>
+#include <string.h>
+#include "user_spectrum.h"
+#include "test.h"
+
+#define TEST_PI         3.14159265358979323846
+
+typedef struct {
+    double freq_hz;
+    double amplitude_mv;
+} tone_t;
+
+static float s_re[SPECTRUM_MAX_POINTS];
+static float s_im[SPECTRUM_MAX_POINTS];
+static double s_ref_re[SPECTRUM_MAX_POINTS];
+static double s_ref_im[SPECTRUM_MAX_POINTS];
+
+static void make_signal(float* x, size_t n, double rate_hz, double offset_mv, const tone_t* tones, size_t count) {
+    for(size_t i = 0; i < n; i++) {
+        double v = offset_mv;
+        for(size_t t = 0; t < count; t++) {
+            v += tones[t].amplitude_mv * sin(2 * TEST_PI * tones[t].freq_hz * i / rate_hz + 0.3 * t);
+        }
+        x[i] = v;
+    }
+}
+
+/* Reference forward DFT, X[k] = sum x[i] e^(-2 pi j k i / n) */
+static void naive_dft(const float* re, const float* im, size_t n, double* out_re, double* out_im) {
+    for(size_t k = 0; k < n; k++) {
+        double sr = 0, si = 0;
+        for(size_t i = 0; i < n; i++) {
+            double a = -2 * TEST_PI * (double)((k * i) % n) / n;
+            sr += re[i] * cos(a) - im[i] * sin(a);
+            si += re[i] * sin(a) + im[i] * cos(a);
+        }
+        out_re[k] = sr;
+        out_im[k] = si;
+    }
+}
+
+/* Features computed the way spectrum_analyze documents them, in double with the naive DFT */
+static void reference_features(const float* x, size_t n, double rate_hz, spectrum_features_t* out) {
+    static float windowed[SPECTRUM_MAX_POINTS];
+    static float zero[SPECTRUM_MAX_POINTS];
+    static double mag[SPECTRUM_MAX_POINTS / 2 + 1];
+    double sum = 0, sum_sq = 0, peak = 0;
+    memset(out, 0, sizeof(*out));
+    for(size_t i = 0; i < n; i++) sum += x[i];
+    double mean = sum / n;
+    for(size_t i = 0; i < n; i++) {
+        double d = x[i] - mean;
+        sum_sq += d * d;
+        if(fabs(d) > peak) peak = fabs(d);
+        windowed[i] = d * (0.5 - 0.5 * cos(2 * TEST_PI * i / n));
+        zero[i] = 0;
+    }
+    out->mean_mv = mean;
+    out->rms_mv = sqrt(sum_sq / n);
+    out->peak_mv = peak;
+    out->crest = out->rms_mv > 0 ? peak / out->rms_mv : 0;
+
+    naive_dft(windowed, zero, n, s_ref_re, s_ref_im);
+    for(size_t k = 0; k <= n / 2; k++) {
+        mag[k] = 4 * hypot(s_ref_re[k], s_ref_im[k]) / n;
+    }
+    //largest local maxima with the same parabolic interpolation
+    for(size_t k = 1; k < n / 2; k++) {
+        if(mag[k] < SPECTRUM_PEAK_MIN_MV || mag[k] <= mag[k - 1] || mag[k] < mag[k + 1]) continue;
+        double denom = mag[k - 1] - 2 * mag[k] + mag[k + 1];
+        double delta = denom != 0 ? 0.5 * (mag[k - 1] - mag[k + 1]) / denom : 0;
+        double amplitude = mag[k] - 0.25 * (mag[k - 1] - mag[k + 1]) * delta;
+        int i = SPECTRUM_PEAKS - 1;
+        if(amplitude <= out->peaks[i].amplitude_mv) continue;
+        for(; i > 0 && out->peaks[i - 1].amplitude_mv < amplitude; i--) {
+            out->peaks[i] = out->peaks[i - 1];
+        }
+        out->peaks[i].freq_hz = (k + delta) * rate_hz / n;
+        out->peaks[i].amplitude_mv = amplitude;
+    }
+}
+
+/**** Tests ****/
+
+/* FFT of every supported size matches the DFT, error relative to the largest bin */
+static void test_fft_matches_dft(void) {
+    static const tone_t tones[] = { { 50, 400 }, { 123.4, 75 }, { 310, 5 } };
+    for(size_t n = 2; n <= SPECTRUM_MAX_POINTS; n *= 2) {
+        double max_mag = 0, max_err = 0;
+        make_signal(s_re, n, 1000, 800, tones, 3);
+        for(size_t i = 0; i < n; i++) s_im[i] = (i % 3) * 10.0f;       //complex input too
+        naive_dft(s_re, s_im, n, s_ref_re, s_ref_im);
+        if(!TEST_CHECK(spectrum_fft(s_re, s_im, n))) continue;
+        for(size_t k = 0; k < n; k++) {
+            double err = hypot(s_re[k] - s_ref_re[k], s_im[k] - s_ref_im[k]);
+            double mag = hypot(s_ref_re[k], s_ref_im[k]);
+            if(err > max_err) max_err = err;
+            if(mag > max_mag) max_mag = mag;
+        }
+        if(!TEST_CHECK(max_err <= 1e-5 * max_mag)) {
+            printf("    n=%zu: error %g of %g\n", n, max_err, max_mag);
+        }
+    }
+}
+
+static void test_fft_rejects_sizes(void) {
+    TEST_CHECK(!spectrum_fft(s_re, s_im, 1));
+    TEST_CHECK(!spectrum_fft(s_re, s_im, 48));
+    TEST_CHECK(!spectrum_fft(s_re, s_im, SPECTRUM_MAX_POINTS * 2));
+    TEST_CHECK(!spectrum_analyze(s_re, s_im, 100, 1000, &(spectrum_features_t){ 0 }));
+}
+
+/* Every feature matches the double precision reference */
+static void check_against_reference(const tone_t* tones, size_t count, size_t n, double rate_hz, double offset_mv) {
+    static float x[SPECTRUM_MAX_POINTS];
+    spectrum_features_t f, ref;
+    make_signal(x, n, rate_hz, offset_mv, tones, count);
+    reference_features(x, n, rate_hz, &ref);
+    memcpy(s_re, x, n * sizeof(float));
+    if(!TEST_CHECK(spectrum_analyze(s_re, s_im, n, rate_hz, &f))) return;
+
+    TEST_CHECK_NEAR(f.mean_mv, ref.mean_mv, 1e-4 * fabs(ref.mean_mv) + 1e-3);
+    TEST_CHECK_NEAR(f.rms_mv, ref.rms_mv, 1e-4 * ref.rms_mv + 1e-3);
+    TEST_CHECK_NEAR(f.peak_mv, ref.peak_mv, 1e-4 * ref.peak_mv + 1e-2);
+    TEST_CHECK_NEAR(f.crest, ref.crest, 1e-3);
+    for(int p = 0; p < SPECTRUM_PEAKS; p++) {
+        TEST_CHECK_NEAR(f.peaks[p].freq_hz, ref.peaks[p].freq_hz, 1e-3 * rate_hz / n);
+        TEST_CHECK_NEAR(f.peaks[p].amplitude_mv, ref.peaks[p].amplitude_mv, 1e-3 * ref.peaks[0].amplitude_mv);
+    }
+}
+
+/* Tones on bin centres: exact frequency and amplitude */
+static void test_tones_on_bins(void) {
+    const size_t n = 256;
+    const double rate_hz = 1000, bin_hz = rate_hz / n;
+    const tone_t tones[] = { { 16 * bin_hz, 100 }, { 40 * bin_hz, 30 } };
+    spectrum_features_t f;
+    check_against_reference(tones, 2, n, rate_hz, 1200);
+
+    make_signal(s_re, n, rate_hz, 1200, tones, 2);
+    spectrum_analyze(s_re, s_im, n, rate_hz, &f);
+    TEST_CHECK_NEAR(f.mean_mv, 1200, 0.01);
+    TEST_CHECK_NEAR(f.rms_mv, sqrt(100 * 100 / 2.0 + 30 * 30 / 2.0), 0.01);
+    TEST_CHECK_NEAR(f.peaks[0].freq_hz, tones[0].freq_hz, 0.01 * bin_hz);
+    TEST_CHECK_NEAR(f.peaks[0].amplitude_mv, 100, 0.1);
+    TEST_CHECK_NEAR(f.peaks[1].freq_hz, tones[1].freq_hz, 0.01 * bin_hz);
+    TEST_CHECK_NEAR(f.peaks[1].amplitude_mv, 30, 0.1);
+    TEST_CHECK_EQ(f.peaks[2].amplitude_mv, 0);
+}
+
+/* Tones between bins: interpolation is within a tenth of a bin and the Hann scalloping loss */
+static void test_tones_between_bins(void) {
+    const size_t n = 1024;
+    const double rate_hz = 4000, bin_hz = rate_hz / n;
+    const tone_t tones[] = { { 50, 250 }, { 60.3 * bin_hz, 80 }, { 200.5 * bin_hz, 20 } };
+    spectrum_features_t f;
+    check_against_reference(tones, 3, n, rate_hz, 900);
+
+    make_signal(s_re, n, rate_hz, 900, tones, 3);
+    spectrum_analyze(s_re, s_im, n, rate_hz, &f);
+    for(int p = 0; p < 3; p++) {
+        TEST_CHECK_NEAR(f.peaks[p].freq_hz, tones[p].freq_hz, 0.1 * bin_hz);
+        TEST_CHECK_NEAR(f.peaks[p].amplitude_mv, tones[p].amplitude_mv, 0.16 * tones[p].amplitude_mv);
+    }
+}
+
+/* Small sizes and a flat burst */
+static void test_small_and_flat(void) {
+    const tone_t tone = { 125, 10 };
+    spectrum_features_t f;
+    check_against_reference(&tone, 1, 8, 1000, 0);
+    check_against_reference(&tone, 1, 64, 1000, 3300);
+
+    for(size_t i = 0; i < 64; i++) s_re[i] = 1500;
+    TEST_CHECK(spectrum_analyze(s_re, s_im, 64, 1000, &f));
+    TEST_CHECK_NEAR(f.mean_mv, 1500, 1e-3);
+    TEST_CHECK_EQ(f.rms_mv, 0);
+    TEST_CHECK_EQ(f.crest, 0);
+    TEST_CHECK_EQ(f.peaks[0].amplitude_mv, 0);
+}
+
+int main(void) {
+    printf("test_spectrum\n");
+    spectrum_init();
+    TEST_RUN(test_fft_matches_dft);
+    TEST_RUN(test_fft_rejects_sizes);
+    TEST_RUN(test_tones_on_bins);
+    TEST_RUN(test_tones_between_bins);
+    TEST_RUN(test_small_and_flat);
+    return test_summary("test_spectrum");
+}
@@ -0,0 +1,260 @@
+/*
+ *  TLS functions of the mbedtls subset used by https_client.c, implemented with OpenSSL
+ *  Replaces port/mbedtls_host.c in test_https, so the client does real handshakes, certificate
+ *  verification and session resumption. Records go through the send/recv callbacks given to
+ *  mbedtls_ssl_set_bio, as with mbedtls. TLS 1.2 at most, like mbedtls 2.x of the device.
+ */
+#include <string.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include "mbedtls/ssl.h"
+#include "mbedtls/net_sockets.h"
+#include "esp_crt_bundle.h"
+
+static BIO_METHOD* s_bio_method;
+
+/**** Random, OpenSSL seeds its own generator ****/
+
+int mbedtls_entropy_func(void* data, unsigned char* output, size_t len) {
+    return 0;
+}
+
+void mbedtls_entropy_init(mbedtls_entropy_context* ctx) {
+}
+
+void mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context* ctx) {
+}
+
+int mbedtls_ctr_drbg_seed(mbedtls_ctr_drbg_context* ctx, int (*f_entropy)(void*, unsigned char*, size_t), void* p_entropy,
+                          const unsigned char* custom, size_t len) {
+    return 0;
+}
+
+int mbedtls_ctr_drbg_random(void* p_rng, unsigned char* output, size_t len) {
+    return 0;
+}
+
+/**** Certificates ****/
+
+void mbedtls_x509_crt_init(mbedtls_x509_crt* crt) {
+    crt->impl = NULL;
+}
+
+/* One PEM certificate, buf may be followed by zeros (len includes the terminator as with mbedtls) */
+int mbedtls_x509_crt_parse(mbedtls_x509_crt* chain, const unsigned char* buf, size_t len) {
+    BIO* bio = BIO_new_mem_buf(buf, strnlen((const char*)buf, len));
+    chain->impl = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+    BIO_free(bio);
+    return chain->impl != NULL ? 0 : MBEDTLS_ERR_X509_INVALID_FORMAT;
+}
+
+int esp_crt_bundle_attach(void* conf) {
+    return SSL_CTX_set_default_verify_paths(((mbedtls_ssl_config*)conf)->impl) == 1 ? 0 : -1;
+}
+
+/**** Configuration ****/
+
+void mbedtls_ssl_config_init(mbedtls_ssl_config* conf) {
+    conf->read_timeout = 0;
+    conf->impl = NULL;
+}
+
+int mbedtls_ssl_config_defaults(mbedtls_ssl_config* conf, int endpoint, int transport, int preset) {
+    SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+    if(ctx == NULL) return MBEDTLS_ERR_SSL_ALLOC_FAILED;
+    SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+    conf->impl = ctx;
+    return 0;
+}
+
+void mbedtls_ssl_conf_authmode(mbedtls_ssl_config* conf, int authmode) {
+    SSL_CTX_set_verify(conf->impl, authmode == MBEDTLS_SSL_VERIFY_REQUIRED ? SSL_VERIFY_PEER : SSL_VERIFY_NONE, NULL);
+}
+
+void mbedtls_ssl_conf_ca_chain(mbedtls_ssl_config* conf, mbedtls_x509_crt* ca_chain, void* ca_crl) {
+    X509_STORE_add_cert(SSL_CTX_get_cert_store(conf->impl), ca_chain->impl);
+}
+
+void mbedtls_ssl_conf_rng(mbedtls_ssl_config* conf, int (*f_rng)(void*, unsigned char*, size_t), void* p_rng) {
+}
+
+void mbedtls_ssl_conf_read_timeout(mbedtls_ssl_config* conf, uint32_t timeout) {
+    conf->read_timeout = timeout;
+}
+
+/**** Transport: OpenSSL reads and writes through the callbacks of mbedtls_ssl_set_bio ****/
+
+static int bio_write(BIO* bio, const char* data, int len) {
+    mbedtls_ssl_context* ssl = BIO_get_data(bio);
+    BIO_clear_retry_flags(bio);
+    int ret = ssl->f_send(ssl->p_bio, (const unsigned char*)data, len);
+    if(ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        BIO_set_retry_write(bio);
+        return -1;
+    }
+    return ret < 0 ? -1 : ret;
+}
+
+static int bio_read(BIO* bio, char* data, int len) {
+    mbedtls_ssl_context* ssl = BIO_get_data(bio);
+    BIO_clear_retry_flags(bio);
+    int ret = ssl->f_recv_timeout(ssl->p_bio, (unsigned char*)data, len, ssl->conf->read_timeout);
+    if(ret == MBEDTLS_ERR_SSL_WANT_READ) {
+        BIO_set_retry_read(bio);
+        return -1;
+    }
+    return ret < 0 ? -1 : ret;
+}
+
+static long bio_ctrl(BIO* bio, int cmd, long num, void* ptr) {
+    return cmd == BIO_CTRL_FLUSH ? 1 : 0;
+}
+
+static int bio_create(BIO* bio) {
+    BIO_set_init(bio, 1);
+    return 1;
+}
+
+/* mbedtls error code of a failed OpenSSL call */
+static int ssl_error(mbedtls_ssl_context* ssl, int ret) {
+    int err = SSL_get_error(ssl->impl, ret);
+    ERR_clear_error();
+    switch(err) {
+        case SSL_ERROR_WANT_READ:
+            return MBEDTLS_ERR_SSL_WANT_READ;
+        case SSL_ERROR_WANT_WRITE:
+            return MBEDTLS_ERR_SSL_WANT_WRITE;
+        case SSL_ERROR_ZERO_RETURN:
+            return MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY;
+        default:
+            if(SSL_get_verify_result(ssl->impl) != X509_V_OK) return MBEDTLS_ERR_X509_CERT_VERIFY_FAILED;
+            return MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE;
+    }
+}
+
+/**** Sessions ****/
+
+void mbedtls_ssl_session_init(mbedtls_ssl_session* session) {
+    memset(session, 0, sizeof(*session));
+}
+
+void mbedtls_ssl_session_free(mbedtls_ssl_session* session) {
+    SSL_SESSION_free(session->impl);
+    memset(session, 0, sizeof(*session));
+}
+
+void mbedtls_ssl_init(mbedtls_ssl_context* ssl) {
+    memset(ssl, 0, sizeof(*ssl));
+}
+
+/* Certificate message of the server => full handshake, as the state machine of mbedtls shows it */
+static void on_message(int write_p, int version, int content_type, const void* buf, size_t len, SSL* s, void* arg) {
+    mbedtls_ssl_context* ssl = arg;
+    if(!write_p && content_type == SSL3_RT_HANDSHAKE && len > 0 && ((const unsigned char*)buf)[0] == SSL3_MT_CERTIFICATE) {
+        ssl->state = MBEDTLS_SSL_SERVER_CERTIFICATE;
+    }
+}
+
+static int ssl_new(mbedtls_ssl_context* ssl) {
+    ssl->impl = SSL_new(ssl->conf->impl);
+    ssl->state = MBEDTLS_SSL_HELLO_REQUEST;
+    if(ssl->impl == NULL) return MBEDTLS_ERR_SSL_ALLOC_FAILED;
+    SSL_set_msg_callback(ssl->impl, on_message);
+    SSL_set_msg_callback_arg(ssl->impl, ssl);
+    return 0;
+}
+
+int mbedtls_ssl_setup(mbedtls_ssl_context* ssl, const mbedtls_ssl_config* conf) {
+    if(s_bio_method == NULL) {
+        s_bio_method = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "mbedtls callbacks");
+        BIO_meth_set_write(s_bio_method, bio_write);
+        BIO_meth_set_read(s_bio_method, bio_read);
+        BIO_meth_set_ctrl(s_bio_method, bio_ctrl);
+        BIO_meth_set_create(s_bio_method, bio_create);
+    }
+    ssl->conf = conf;
+    return ssl_new(ssl);
+}
+
+/* A new OpenSSL connection, it cannot be reused after close */
+int mbedtls_ssl_session_reset(mbedtls_ssl_context* ssl) {
+    SSL_free(ssl->impl);
+    ssl->session = NULL;
+    mbedtls_ssl_session_init(&ssl->session_storage);
+    return ssl_new(ssl);
+}
+
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context* ssl, const char* hostname) {
+    SSL_set_tlsext_host_name(ssl->impl, hostname);
+    return SSL_set1_host(ssl->impl, hostname) == 1 ? 0 : MBEDTLS_ERR_SSL_ALLOC_FAILED;
+}
+
+void mbedtls_ssl_set_bio(mbedtls_ssl_context* ssl, void* p_bio, mbedtls_ssl_send_t f_send, mbedtls_ssl_recv_t f_recv,
+                         mbedtls_ssl_recv_timeout_t f_recv_timeout) {
+    BIO* bio = BIO_new(s_bio_method);
+    ssl->p_bio = p_bio;
+    ssl->f_send = f_send;
+    ssl->f_recv_timeout = f_recv_timeout;
+    BIO_set_data(bio, ssl);
+    SSL_set_bio(ssl->impl, bio, bio);
+}
+
+int mbedtls_ssl_set_session(mbedtls_ssl_context* ssl, const mbedtls_ssl_session* session) {
+    return SSL_set_session(ssl->impl, session->impl) == 1 ? 0 : MBEDTLS_ERR_SSL_ALLOC_FAILED;
+}
+
+/* Copy holds its own reference to the OpenSSL session */
+int mbedtls_ssl_get_session(const mbedtls_ssl_context* ssl, mbedtls_ssl_session* session) {
+    SSL_SESSION* current = SSL_get1_session(ssl->impl);
+    unsigned int id_len;
+    if(current == NULL) return -1;
+    const unsigned char* id = SSL_SESSION_get_id(current, &id_len);
+    session->id_len = id_len < sizeof(session->id) ? id_len : sizeof(session->id);
+    memcpy(session->id, id, session->id_len);
+    session->impl = current;
+    return 0;
+}
+
+int mbedtls_ssl_handshake(mbedtls_ssl_context* ssl) {
+    int ret = 0;
+    while(ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER && ret == 0) {
+        ret = mbedtls_ssl_handshake_step(ssl);
+    }
+    return ret;
+}
+
+/* OpenSSL runs the whole handshake in the first step, on_message records the server certificate */
+int mbedtls_ssl_handshake_step(mbedtls_ssl_context* ssl) {
+    if(!SSL_is_init_finished(ssl->impl)) {
+        int ret = SSL_connect(ssl->impl);
+        if(ret != 1) return ssl_error(ssl, ret);
+        if(ssl->state != MBEDTLS_SSL_SERVER_CERTIFICATE) ssl->state = MBEDTLS_SSL_SERVER_CHANGE_CIPHER_SPEC;
+        return 0;
+    }
+    //session of the connection as mbedtls exposes it, SSL object keeps the reference
+    SSL_SESSION* current = SSL_get0_session(ssl->impl);
+    unsigned int id_len;
+    const unsigned char* id = SSL_SESSION_get_id(current, &id_len);
+    ssl->session_storage.id_len = id_len < sizeof(ssl->session_storage.id) ? id_len : sizeof(ssl->session_storage.id);
+    memcpy(ssl->session_storage.id, id, ssl->session_storage.id_len);
+    ssl->session_storage.impl = NULL;
+    ssl->session = &ssl->session_storage;
+    ssl->state = MBEDTLS_SSL_HANDSHAKE_OVER;
+    return 0;
+}
+
+int mbedtls_ssl_write(mbedtls_ssl_context* ssl, const unsigned char* buf, size_t len) {
+    int ret = SSL_write(ssl->impl, buf, len);
+    return ret > 0 ? ret : ssl_error(ssl, ret);
+}
+
+int mbedtls_ssl_read(mbedtls_ssl_context* ssl, unsigned char* buf, size_t len) {
+    int ret = SSL_read(ssl->impl, buf, len);
+    return ret > 0 ? ret : ssl_error(ssl, ret);
+}
+
+int mbedtls_ssl_close_notify(mbedtls_ssl_context* ssl) {
+    SSL_shutdown(ssl->impl);
+    return 0;
+}
@@ -0,0 +1,278 @@
+/* Source file for HTTPS client with keep-alive and TLS session resumption */
+#include "https_client.h"
+
+static const char* TAG = "HTTPS";
+
+static mbedtls_entropy_context s_entropy;
+static mbedtls_ctr_drbg_context s_ctr_drbg;
+static mbedtls_ssl_config s_conf;
+static mbedtls_ssl_context s_ssl;
+static mbedtls_net_context s_net;
+static mbedtls_ssl_session s_session;       //session of last connection, offered on reconnect
+#ifdef HTTPS_CA_CERT_PEM
+static mbedtls_x509_crt s_ca;
+#endif
+static bool s_initialized = false;
+static bool s_session_valid = false;
+static bool s_connected = false;
+static char s_host[64];
+static bool s_reused = false;               //current request is sent on a kept-alive connection
+static bool s_got_response = false;         //some bytes of response to current request were received
+
+/* Buffered reader for response, headers and chunk sizes are parsed byte by byte */
+typedef struct {
+    unsigned char buf[HTTPS_HEADER_MAX];
+    int pos;
+    int len;
+} https_reader_t;
+
+static esp_err_t https_init(void) {
+    int ret;
+    mbedtls_entropy_init(&s_entropy);
+    mbedtls_ctr_drbg_init(&s_ctr_drbg);
+    mbedtls_ssl_config_init(&s_conf);
+    mbedtls_ssl_init(&s_ssl);
+    mbedtls_ssl_session_init(&s_session);
+
+    ret = mbedtls_ctr_drbg_seed(&s_ctr_drbg, mbedtls_entropy_func, &s_entropy, NULL, 0);
+    if(ret != 0) goto fail;
+    ret = mbedtls_ssl_config_defaults(&s_conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+    if(ret != 0) goto fail;
+    mbedtls_ssl_conf_authmode(&s_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+#ifdef HTTPS_CA_CERT_PEM
+    mbedtls_x509_crt_init(&s_ca);
+    ret = mbedtls_x509_crt_parse(&s_ca, (const unsigned char*)HTTPS_CA_CERT_PEM, sizeof(HTTPS_CA_CERT_PEM));
+    if(ret != 0) goto fail;
+    mbedtls_ssl_conf_ca_chain(&s_conf, &s_ca, NULL);
+#else
+    ret = esp_crt_bundle_attach(&s_conf);
+    if(ret != 0) goto fail;
+#endif
+    mbedtls_ssl_conf_rng(&s_conf, mbedtls_ctr_drbg_random, &s_ctr_drbg);
+    mbedtls_ssl_conf_read_timeout(&s_conf, HTTPS_READ_TIMEOUT_MS);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&s_conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+    //context is allocated once and reset between connections to avoid fragmenting heap
+    ret = mbedtls_ssl_setup(&s_ssl, &s_conf);
+    if(ret != 0) goto fail;
+    s_initialized = true;
+    return ESP_OK;
+
+fail:
+    ESP_LOGE(TAG, "TLS init failed: -0x%x", (unsigned)-ret);
+    return ESP_ERR_HTTPS_INIT_FAILED;
+}
+
+static esp_err_t https_connect(const char* host, const char* port) {
+    int ret;
+    mbedtls_ssl_session_reset(&s_ssl);
+    mbedtls_net_init(&s_net);
+    ret = mbedtls_net_connect(&s_net, host, port, MBEDTLS_NET_PROTO_TCP);
+    if(ret != 0) {
+        ESP_LOGE(TAG, "Connect to %s:%s failed: -0x%x", host, port, (unsigned)-ret);
+        return ESP_ERR_HTTPS_CONNECT_FAILED;
+    }
+    mbedtls_ssl_set_hostname(&s_ssl, host);
+    mbedtls_ssl_set_bio(&s_ssl, &s_net, mbedtls_net_send, NULL, mbedtls_net_recv_timeout);
+    //offer previous session only to the same server
+    bool offered = s_session_valid && strcmp(host, s_host) == 0;
+    if(offered) {
+        mbedtls_ssl_set_session(&s_ssl, &s_session);
+    }
+    else {
+        s_session_valid = false;
+    }
+
+    /* A resumed handshake goes from server hello to change cipher spec, only a full one has the
+     * server certificate. The session ID cannot tell: with a ticket the client sends a random ID
+     * and the server may echo anything. */
+    bool resumed = true;
+    int64_t start = esp_timer_get_time();
+    while(s_ssl.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+        ret = mbedtls_ssl_handshake_step(&s_ssl);
+        if(s_ssl.state == MBEDTLS_SSL_SERVER_CERTIFICATE) resumed = false;
+        if(ret != 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            ESP_LOGE(TAG, "Handshake failed: -0x%x", (unsigned)-ret);
+            mbedtls_net_free(&s_net);
+            //a broken session must not be offered again
+            s_session_valid = false;
+            return ESP_ERR_HTTPS_HANDSHAKE_FAILED;
+        }
+    }
+    uint32_t handshake_us = esp_timer_get_time() - start;
+    if(offered && resumed) {
+        user_metrics_inc(METRIC_TLS_RESUMED_HANDSHAKES);
+        user_metrics_observe(METRIC_TLS_RESUMED_HANDSHAKE_LATENCY, handshake_us);
+        ESP_LOGI(TAG, "Session resumed in %u ms", handshake_us / 1000);
+    }
+    else {
+        user_metrics_inc(METRIC_TLS_FULL_HANDSHAKES);
+        user_metrics_observe(METRIC_TLS_FULL_HANDSHAKE_LATENCY, handshake_us);
+        ESP_LOGI(TAG, "Full handshake in %u ms", handshake_us / 1000);
+    }
+
+    //keep session (with ticket if server sent one) for next reconnect
+    mbedtls_ssl_session_free(&s_session);
+    mbedtls_ssl_session_init(&s_session);
+    s_session_valid = (mbedtls_ssl_get_session(&s_ssl, &s_session) == 0);
+    strlcpy(s_host, host, sizeof(s_host));
+    s_connected = true;
+    return ESP_OK;
+}
+
+void https_client_close(void) {
+    if(!s_connected) return;
+    mbedtls_ssl_close_notify(&s_ssl);
+    mbedtls_net_free(&s_net);
+    s_connected = false;
+}
+
+static esp_err_t https_write_all(const char* data, size_t len) {
+    size_t done = 0;
+    while(done < len) {
+        int ret = mbedtls_ssl_write(&s_ssl, (const unsigned char*)data + done, len - done);
+        if(ret > 0) {
+            done += ret;
+        }
+        else if(ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            return ESP_ERR_HTTPS_SEND_FAILED;
+        }
+    }
+    return ESP_OK;
+}
+
+/* Return next byte of response, -1 on error or end of stream */
+static int https_read_byte(https_reader_t* reader) {
+    if(reader->pos == reader->len) {
+        int ret;
+        do {
+            ret = mbedtls_ssl_read(&s_ssl, reader->buf, sizeof(reader->buf));
+        } while(ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE);
+        if(ret <= 0) return -1;
+        reader->pos = 0;
+        reader->len = ret;
+    }
+    return reader->buf[reader->pos++];
+}
+
+/* Read one line without CRLF, return its length or -1 */
+static int https_read_line(https_reader_t* reader, char* line, int size) {
+    int n = 0, c;
+    while((c = https_read_byte(reader)) >= 0) {
+        if(c == '\n') {
+            if(n > 0 && line[n - 1] == '\r') n--;
+            line[n] = '\0';
+            return n;
+        }
+        if(n < size - 1) line[n++] = c;
+    }
+    return -1;
+}
+
+static bool https_skip(https_reader_t* reader, uint32_t len) {
+    while(len--) {
+        if(https_read_byte(reader) < 0) return false;
+    }
+    return true;
+}
+
+/* Read response and discard body, keep_alive is cleared if connection cannot be reused */
+static esp_err_t https_read_response(int* status, bool* keep_alive, bool* got_any) {
+    https_reader_t reader = { .pos = 0, .len = 0 };
+    char line[128];
+    int n;
+    int32_t content_length = -1;
+    bool chunked = false;
+
+    *got_any = false;
+    if(https_read_line(&reader, line, sizeof(line)) < 0) return ESP_ERR_HTTPS_RECEIVE_FAILED;
+    *got_any = true;
+    if(sscanf(line, "HTTP/1.%*d %d", status) != 1) return ESP_ERR_HTTPS_BAD_RESPONSE;
+    *keep_alive = (strncmp(line, "HTTP/1.1", 8) == 0);
+
+    while(1) {
+        n = https_read_line(&reader, line, sizeof(line));
+        if(n < 0) return ESP_ERR_HTTPS_RECEIVE_FAILED;
+        if(n == 0) break;                           //end of headers
+        if(strncasecmp(line, "Content-Length:", 15) == 0) {
+            content_length = atoi(line + 15);
+        }
+        else if(strncasecmp(line, "Transfer-Encoding:", 18) == 0 && strstr(line, "chunked") != NULL) {
+            chunked = true;
+        }
+        else if(strncasecmp(line, "Connection:", 11) == 0 && strstr(line, "close") != NULL) {
+            *keep_alive = false;
+        }
+    }
+
+    if(chunked) {
+        while(1) {
+            if(https_read_line(&reader, line, sizeof(line)) < 0) return ESP_ERR_HTTPS_RECEIVE_FAILED;
+            uint32_t size = strtoul(line, NULL, 16);
+            if(size == 0) {
+                //trailer headers until empty line
+                while((n = https_read_line(&reader, line, sizeof(line))) > 0);
+                return (n == 0) ? ESP_OK : ESP_ERR_HTTPS_RECEIVE_FAILED;
+            }
+            if(!https_skip(&reader, size + 2)) return ESP_ERR_HTTPS_RECEIVE_FAILED;     //data and CRLF
+        }
+    }
+    if(content_length >= 0) {
+        return https_skip(&reader, content_length) ? ESP_OK : ESP_ERR_HTTPS_RECEIVE_FAILED;
+    }
+    //no framing => body ends when server closes connection
+    *keep_alive = false;
+    while(https_read_byte(&reader) >= 0);
+    return ESP_OK;
+}
+
+esp_err_t https_client_begin(const char* host, const char* port) {
+    if(!s_initialized && https_init() != ESP_OK) {
+        return ESP_ERR_HTTPS_INIT_FAILED;
+    }
+    if(s_connected && strcmp(host, s_host) != 0) {
+        https_client_close();
+    }
+    s_reused = s_connected;
+    s_got_response = false;
+    if(s_reused) {
+        user_metrics_inc(METRIC_TLS_REUSED_CONNECTIONS);
+        return ESP_OK;
+    }
+    return https_connect(host, port);
+}
+
+esp_err_t https_client_write(const char* data, size_t len) {
+    if(!s_connected) return ESP_ERR_HTTPS_SEND_FAILED;
+    esp_err_t err = https_write_all(data, len);
+    if(err != ESP_OK) https_client_close();
+    return err;
+}
+
+esp_err_t https_client_finish(int* status) {
+    bool keep_alive = false;
+    if(!s_connected) return ESP_ERR_HTTPS_RECEIVE_FAILED;
+    esp_err_t err = https_read_response(status, &keep_alive, &s_got_response);
+    if(err != ESP_OK || !keep_alive) https_client_close();
+    return err;
+}
+
+esp_err_t https_client_request(const char* host, const char* port, const char* request, size_t len, int* status) {
+    esp_err_t err = ESP_ERR_HTTPS_CONNECT_FAILED;
+    //at most one retry: a reused connection may have been closed by server while idle
+    for(int attempt = 0; attempt < 2; attempt++) {
+        err = https_client_begin(host, port);
+        if(err != ESP_OK) return err;
+        err = https_client_write(request, len);
+        if(err == ESP_OK) {
+            err = https_client_finish(status);
+        }
+        if(err == ESP_OK || !s_reused || s_got_response) {
+            //done, fresh connection failed, or server has seen the request => do not send it twice
+            break;
+        }
+        ESP_LOGW(TAG, "Kept-alive connection was closed by server, reconnecting");
+    }
+    return err;
+}
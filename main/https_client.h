@@ -0,0 +1,89 @@
+/*
+ *  Header file for HTTPS client used by the uploader
+ *  One TLS connection is kept open between requests (HTTP keep-alive). When it has to be
+ *  opened again (server closed it, network was lost), the TLS session of the previous
+ *  connection is offered to the server (session ticket or session ID), so the expensive
+ *  full handshake is only done when the server refuses to resume.
+ *
+ *  Full and resumed handshakes are counted and timed in user_metrics. A handshake is resumed when
+ *  the server skips its certificate, which holds for session IDs and tickets alike.
+ *
+ *  mbedtls is used directly because esp-tls of this IDF version has no API to resume a
+ *  client session.
+ */
+
+#ifndef _HTTPS_CLIENT_H_
+#define _HTTPS_CLIENT_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/x509_crt.h"
+#include "esp_crt_bundle.h"
+#include "user_metrics.h"
+
+#define HTTPS_READ_TIMEOUT_MS       60000   //ThingSpeak can take long to respond
+#define HTTPS_HEADER_MAX            512     //response status line and headers must fit in this buffer
+
+//By default server certificate is verified with the IDF certificate bundle.
+//To test against a local TLS stub with a self-signed CA, define its certificate here.
+// #define HTTPS_CA_CERT_PEM "-----BEGIN CERTIFICATE-----\n...\n-----END CERTIFICATE-----\n"
+
+#define ESP_ERR_HTTPS_BASE                  0x70000
+#define ESP_ERR_HTTPS_INIT_FAILED           (ESP_ERR_HTTPS_BASE + 1)
+#define ESP_ERR_HTTPS_CONNECT_FAILED        (ESP_ERR_HTTPS_BASE + 2)
+#define ESP_ERR_HTTPS_HANDSHAKE_FAILED      (ESP_ERR_HTTPS_BASE + 3)
+#define ESP_ERR_HTTPS_SEND_FAILED           (ESP_ERR_HTTPS_BASE + 4)
+#define ESP_ERR_HTTPS_RECEIVE_FAILED        (ESP_ERR_HTTPS_BASE + 5)
+#define ESP_ERR_HTTPS_BAD_RESPONSE          (ESP_ERR_HTTPS_BASE + 6)
+
+/**
+ * @brief Send a complete HTTP request and read the whole response
+ * 
+ * Connection is reused if it is still open to the same host, otherwise a new one is made
+ * (resuming previous TLS session if possible). Response body is discarded.
+ * 
+ * @param host server name, used for DNS and certificate verification
+ * @param port server port, usually "443"
+ * @param request request line, headers and body
+ * @param len length of request
+ * @param status HTTP status code of response
+ * @return esp_err_t ESP_OK if a response has been received (check status), ESP_ERR_HTTPS_xxx otherwise
+ */
+esp_err_t https_client_request(const char* host, const char* port, const char* request, size_t len, int* status);
+
+/**
+ * @brief Start a streamed request: make sure a connection to host is open
+ * 
+ * Request is then sent with any number of https_client_write and completed by https_client_finish.
+ * Unlike https_client_request, a streamed request is not retried.
+ * 
+ * @return esp_err_t ESP_OK if connection is ready
+ */
+esp_err_t https_client_begin(const char* host, const char* port);
+
+/**
+ * @brief Send part of a streamed request, connection is closed on error
+ */
+esp_err_t https_client_write(const char* data, size_t len);
+
+/**
+ * @brief Read response of a streamed request and discard its body
+ * 
+ * @param status HTTP status code of response
+ */
+esp_err_t https_client_finish(int* status);
+
+/**
+ * @brief Close connection, TLS session is kept for resumption
+ */
+void https_client_close(void);
+
+#endif
@@ -11,15 +11,108 @@
 #include "sd_card.h"
 #include "user_adc.h"
 #include "user_timer.h"
+#include "user_http_server.h"
+#include "user_metrics.h"
+#include "user_profiler.h"
+#include "user_boot.h"
+#include "user_memory.h"
+#include "user_bus.h"
+#include "user_pipeline.h"
+#include "user_rules.h"
+#include "user_sampling.h"
+#include "user_spectrum.h"
+#include "user_seq.h"
+#include "user_power.h"
 
 #include "thingspeak.h"
+#include "uplink.h"
 
 static const char* TAG = "Main Tag";
-/* Sempahore used to transfer data from adc_measure_task to thingspea_task */
-static SemaphoreHandle_t xSemaphoreADC;
-static uint16_t xSemaphoreADC_value[4];
+/* Subscribers of sample bus, SD card keeps everything buffered while it is mounted at boot */
+static bus_subscriber_t s_sd_subscriber = {
+    .name = "sd",
+    .depth = BOOT_BUFFER_SAMPLES / BUS_BATCH_SAMPLES,
+    .policy = BUS_DROP_OLDEST,
+    .drop_metric = METRIC_SAMPLES_DROPPED,
+    .wait_metric = METRIC_STAGE_PERSIST_WAIT,
+    .depth_metric = METRIC_STAGE_PERSIST_QUEUE_MAX,
+};
+static bus_subscriber_t s_uplink_subscriber = {
+    .name = "uplink",
+    .depth = UPLINK_QUEUE_SAMPLES / BUS_BATCH_SAMPLES,
+    .policy = BUS_DROP_OLDEST,
+    .drop_metric = METRIC_UPLINK_DROPPED,
+    .wait_metric = METRIC_STAGE_UPLINK_WAIT,
+    .depth_metric = METRIC_STAGE_UPLINK_QUEUE_MAX,
+};
+//every sample of a backend batch may be a range of its own when reports are sparse, gaps need some more
+_Static_assert(SEQ_MAX_RANGES >= UPLINK_BATCH_SAMPLES + 8, "SEQ_MAX_RANGES is too small for UPLINK_BATCH_SAMPLES");
+//each subscriber holds its queue plus one batch in process, publisher fills one more
+_Static_assert(BOOT_BUFFER_SAMPLES / BUS_BATCH_SAMPLES + UPLINK_QUEUE_SAMPLES / BUS_BATCH_SAMPLES + 2 + 1 <= BUS_POOL_BLOCKS,
+               "BUS_POOL_BLOCKS is too small for subscriber queues");
+/* Queue used to transfer samples from adc_measure_task (acquire stage) to condition_task */
+static QueueHandle_t xQueueAcquire;
+USER_QUEUE_DEFINE(xQueueAcquire, STAGE_CONDITION_QUEUE, sizeof(adc_sample_t));
+/* Queue used to transfer spectral features from spectrum_task to uplink_task */
+static QueueHandle_t xQueueSpectrum;
+USER_QUEUE_DEFINE(xQueueSpectrum, UPLINK_QUEUE_BURSTS, sizeof(spectrum_burst_t));
 /* Event which is used for timer to control the frequency of adc */
 static EventGroupHandle_t xEventGroupADC;
+USER_EVENT_GROUP_DEFINE(xEventGroupADC);
+#if POWER_SAVE
+/* Hardware timer stops in light sleep, sampling is paced by the tick instead */
+static int64_t s_sample_start_us;           //start of current period, adc_measure_task only
+static volatile uint32_t s_sample_period_ms = ADC_PERIOD*1000;
+#endif
+/* Stacks and control blocks of tasks, see user_memory.h */
+USER_TASK_DEFINE(adc_measure_task, ADC_TASK_STACK);
+USER_TASK_DEFINE(condition_task, CONDITION_TASK_STACK);
+USER_TASK_DEFINE(sd_task, SD_TASK_STACK);
+USER_TASK_DEFINE(spectrum_task, SPECTRUM_TASK_STACK);
+USER_TASK_DEFINE(net_boot_task, NET_BOOT_TASK_STACK);
+USER_TASK_DEFINE(uplink_task, UPLINK_TASK_STACK);
+/* Information about SD card, filled by sd_task */
+static sdmmc_card_t* s_card;
+/* Log file is written by sd_task and read back by uplink_task to fill gaps */
+static SemaphoreHandle_t xMutexSd;
+USER_MUTEX_DEFINE(xMutexSd);
+/* Log positions of records and next sequence number to be written, guarded by xMutexSd */
+static seq_index_t s_seq_index;
+static volatile uint32_t s_sd_next_seq;
+/* Gaps of the uplink stream, sequence numbers of the backend batch and of batches waiting for
+ * acknowledgement, uplink_task only */
+static seq_tracker_t s_tracker;
+static uint32_t s_pending_seq[UPLINK_BATCH_SAMPLES];
+static uplink_inflight_t s_inflight[UPLINK_INFLIGHT_BATCHES];
+/* Report-by-exception rules applied to samples before they go to uplink */
+static const rules_config_t s_rules_config = {
+    .analog = {
+        //deadband_mv, deadband_permille, high_mv, low_mv, hysteresis_mv
+        { 20, RULES_DISABLED, RULES_DISABLED, RULES_DISABLED, 0 },
+        { 20, RULES_DISABLED, RULES_DISABLED, RULES_DISABLED, 0 },
+        { 20, RULES_DISABLED, RULES_DISABLED, RULES_DISABLED, 0 },
+        { 20, RULES_DISABLED, RULES_DISABLED, RULES_DISABLED, 0 },
+    },
+    .digital = { RULE_EDGE_BOTH, RULE_EDGE_BOTH, RULE_EDGE_BOTH, RULE_EDGE_BOTH },
+    .heartbeat_ms = 10*60*1000,
+};
+/* Analog channels of a sample and their oversampling, see user_adc.h */
+static const adc_channel_config_t s_adc_channels[ADC_CHANNEL_NUMBER] = {
+    //channel, samples, filter, trim
+    { ADC_CHAN_0, ADC_OVERSAMPLE, ADC_FILTER_MEDIAN, 0 },
+    //small hum on this input => average the middle half instead of picking one read
+    { ADC_CHAN_1, ADC_OVERSAMPLE, ADC_FILTER_TRIMMED_MEAN, ADC_OVERSAMPLE / 4 },
+    { ADC_CHAN_2, ADC_OVERSAMPLE, ADC_FILTER_MEDIAN, 0 },
+    { ADC_CHAN_3, ADC_OVERSAMPLE, ADC_FILTER_MEDIAN, 0 },
+};
+/* Adaptive sampling: fast while any analog channel moves, back to ADC_PERIOD when quiet */
+static const sampling_config_t s_sampling_config = {
+    .min_period_ms = ADC_MIN_PERIOD_MS,
+    .max_period_ms = ADC_PERIOD*1000,
+    .slope_mv_per_s = 100,
+    .stddev_mv = 25,
+    .quiet_samples = 8,
+};
 
 /*********** Timer Function *********************/
 
@@ -71,162 +164,773 @@ void group0_timer_init(int timer_idx, double time_interval_sec) {
     /* Configure the alarm value and the interrupt on alarm. */
     timer_set_alarm_value(TIMER_GROUP_0, timer_idx, time_interval_sec*TIMER_SCALE);
     timer_enable_intr(TIMER_GROUP_0, timer_idx);
-    timer_isr_register(TIMER_GROUP_0, timer_idx, timer_group0_isr, (void*) timer_idx, ESP_INTR_FLAG_IRAM, NULL);
+    timer_isr_register(TIMER_GROUP_0, timer_idx, timer_group0_isr, (void*)(intptr_t)timer_idx, ESP_INTR_FLAG_IRAM, NULL);
 
     //Start timer
     timer_start(TIMER_GROUP_0, timer_idx);
 }
 
+void group0_timer_set_period(int timer_idx, double time_interval_sec) {
+    //auto reload restarts counter from 0 on each alarm, so new value applies from the current period
+    timer_set_alarm_value(TIMER_GROUP_0, timer_idx, time_interval_sec*TIMER_SCALE);
+}
+
+/**
+ * @brief Start pacing of samples, the first sample is taken at once
+ */
+static void sample_timer_start(void) {
+#if POWER_SAVE
+    s_sample_start_us = esp_timer_get_time() - s_sample_period_ms*1000LL;
+#else
+    group0_timer_init(0, ADC_PERIOD);
+    //take the first sample now instead of waiting for one full period
+    xEventGroupSetBits(xEventGroupADC, TIMER_FINISH_BIT);
+#endif
+}
+
+/**
+ * @brief Wait for the start of the next sampling period
+ * 
+ * @param late_us output, delay from start of the period to wake up
+ * @return true if a period has started
+ */
+static bool sample_timer_wait(int64_t* late_us) {
+#if POWER_SAVE
+    int64_t deadline, now;
+    while(1) {
+        deadline = s_sample_start_us + s_sample_period_ms*1000LL;
+        now = esp_timer_get_time();
+        if(now >= deadline) break;
+        //tickless idle sleeps until the tick of the deadline, a new period wakes the task to compute it again
+        xEventGroupWaitBits(xEventGroupADC, TIMER_PERIOD_BIT, pdTRUE, pdFALSE,
+                            (deadline - now + portTICK_PERIOD_MS*1000 - 1) / (portTICK_PERIOD_MS*1000));
+    }
+    *late_us = now - deadline;
+    //more than one period late => next period starts now instead of catching up
+    s_sample_start_us = (now - deadline >= s_sample_period_ms*1000LL) ? now : deadline;
+    return true;
+#else
+    uint64_t alarm_ticks;           //timer counter at wake up = time since alarm
+    //waiting until timer has expired => TIMER_FINISH_BIT is set
+    EventBits_t bits = xEventGroupWaitBits(xEventGroupADC, TIMER_FINISH_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
+    /* xEventGroupWaitBits() returns the bits before the call returned, hence we can test which event actually
+     * happened. */
+    if(!(bits & TIMER_FINISH_BIT)) return false;
+    //counter restarts from 0 at each alarm
+    timer_get_counter_value(TIMER_GROUP_0, 0, &alarm_ticks);
+    *late_us = alarm_ticks * 1000000 / TIMER_SCALE;
+    //clear bits, timer restarts by itself
+    xEventGroupClearBits(xEventGroupADC, TIMER_FINISH_BIT);
+    return true;
+#endif
+}
+
+/**
+ * @brief Change sampling period, applies from the current period
+ */
+static void sample_timer_set_period(uint32_t period_ms) {
+#if POWER_SAVE
+    s_sample_period_ms = period_ms;
+    xEventGroupSetBits(xEventGroupADC, TIMER_PERIOD_BIT);
+#else
+    group0_timer_set_period(0, period_ms/1000.0);
+#endif
+}
+
 /************* END TIMER FUNCTION ********************/
 
+/*********** SD Record Function *********************/
+
+/**
+ * @brief Write every sample of a batch to SD card
+ * 
+ * @param batch batch received from sample bus
+ */
+static void record_batch(const bus_batch_t* batch) {
+    int64_t write_start = esp_timer_get_time();         //used for latency metric
+    xSemaphoreTake(xMutexSd, portMAX_DELAY);
+    //samples of the batch are on SD card now or never => uplink may read them back or give them up
+    s_sd_next_seq = batch->samples[batch->count - 1].seq + 1;
+    FILE* file = fopen(MOUNT_POINT"/record.txt", "a+");
+    if(file == NULL) {
+        xSemaphoreGive(xMutexSd);
+        ESP_LOGE(TAG, "Cannot open file.");
+        user_metrics_add(METRIC_SAMPLES_DROPPED, batch->count);
+        return;
+    }
+    else ESP_LOGI(TAG, "Open file successfully.");
+
+    //position of first record, used to find gaps of the uplink stream in the log
+    if(fseek(file, 0, SEEK_END) == 0) {
+        seq_index_entry_t entry = {
+            .seq = batch->samples[0].seq,
+            .offset = ftell(file),
+            .timestamp_us = batch->samples[0].timestamp_us,
+            .period_ms = batch->samples[0].period_ms,
+        };
+        seq_index_add(&s_seq_index, &entry);
+    }
+
+    /* Start writing to file */
+    for(uint32_t i = 0; i < batch->count; i++) {
+        const adc_sample_t* sample = &batch->samples[i];
+        if(sample->flags & SAMPLE_FLAG_RATE_CHANGE) {
+            user_file_record_period(file, sample->timestamp_us, sample->period_ms);
+        }
+        user_file_record_value(file, sample->voltage, sample->digital, sample->seq, (sample->flags & SAMPLE_FLAG_SUPPRESSED) != 0);
+    }
+    /* Finish writing to file */
+    fclose(file);
+    xSemaphoreGive(xMutexSd);
+    user_metrics_observe(METRIC_SD_WRITE_LATENCY, esp_timer_get_time() - write_start);
+}
+
+/**
+ * @brief Read samples back from SD card log by sequence number
+ * 
+ * @param count output, number of samples found. Numbers which are neither found nor skipped are not in the log
+ * @param skipped output, number of records not meant for upload
+ * @return true if the log could be searched
+ */
+static bool sd_read_samples(uint32_t first, uint32_t last, adc_sample_t* out, size_t max, size_t* count, size_t* skipped) {
+    seq_index_entry_t start;
+    bool ok = true;
+    *count = 0;
+    *skipped = 0;
+    xSemaphoreTake(xMutexSd, portMAX_DELAY);
+    if(seq_index_find(&s_seq_index, first, &start)) {
+        FILE* file = fopen(MOUNT_POINT"/record.txt", "r");
+        if(file != NULL) {
+            *count = user_file_read_values(file, &start, first, last, out, max, skipped);
+            fclose(file);
+        }
+        else ok = false;
+    }
+    xSemaphoreGive(xMutexSd);
+    return ok;
+}
+
+/************* END SD RECORD FUNCTION ********************/
+
 /*
- *  @brief: this task will read adc value and write to sd card
+ *  @brief: this task mounts SD card, retrying until it succeeds, then writes every batch of the sample bus
+ *          batches published before mount wait in the subscriber queue
  *
  */
 
-void adc_measure_task(void* pvParameters) {
-    /*  Create Semaphore */
-    xSemaphoreADC = xSemaphoreCreateBinary();
-    if(xSemaphoreADC == NULL) {
-        ESP_LOGE(TAG, "There is not enough Heap Memory for Semaphore");
+void sd_task(void* pvParameters) {
+    esp_err_t ret;
+#ifndef USE_SPI_MODE
+    //if use SDMMC
+    sdmmc_host_t host = SDMMC_HOST_DEFAULT();
+#else
+    //use SPI
+    sdmmc_host_t host = SDSPI_HOST_DEFAULT();
+#endif
+    while(1) {
+#ifndef USE_SPI_MODE
+        ret = user_sdmmc_card_init(&s_card, host);
+#else
+        ret = user_sdspi_card_init(&s_card, host);
+#endif
+        if(ret == ESP_OK) break;
+        vTaskDelay(BOOT_SD_RETRY_MS/portTICK_RATE_MS);
+    }
+
+    sdmmc_card_print_info(stdout, s_card);        //print card properties
+#ifdef SD_RUN_BENCHMARK
+    user_sd_benchmark(SD_BENCHMARK_FILE, SD_BENCHMARK_SIZE);
+#endif
+    user_boot_set_ready(BOOT_SD_READY_BIT);
+
+    while(1) {
+        bus_batch_t* batch = bus_receive(&s_sd_subscriber, portMAX_DELAY);
+        if(batch != NULL) {
+            user_power_awake_begin();
+            record_batch(batch);
+            bus_release(batch);
+            user_power_awake_end();
+        }
     }
+}
 
+/*
+ *  @brief: this task brings up network stack, Wi-Fi and HTTP server, then deletes itself
+ *
+ */
+
+void net_boot_task(void* pvParameters) {
+    if(user_boot_net_init() != ESP_OK) {
+        //samples are still written to SD card, only the network is missing
+        ESP_LOGE(TAG, "Network stack not started, logging to SD card only");
+        vTaskDelete(NULL);
+    }
+    //connection at boot is the first upload window
+    user_power_radio_on();
+    if(wifi_connect() != ESP_OK) {
+        ESP_LOGE(TAG, "Wi-Fi not started, logging to SD card only");
+        user_power_radio_off(false);
+        vTaskDelete(NULL);
+    }
+    user_http_server_start(xMutexSd);
+    vTaskDelete(NULL);
+}
+
+/*
+ *  @brief: acquire stage, this task only reads adc and digital values on every timer period
+ *          and hands them to condition_task, so nothing else can delay the next read
+ *
+ */
+
+void adc_measure_task(void* pvParameters) {
     /* Create Event Group Bit */
-    xEventGroupADC = xEventGroupCreate();
+    xEventGroupADC = USER_EVENT_GROUP_CREATE(xEventGroupADC);
     if(xEventGroupADC == NULL) {
         ESP_LOGE(TAG, "There is not enough heap memory for Event Group");
     }
 
-    uint32_t voltage[4];            //stored value of 4 analog channel
-    uint8_t digital_value;          //bit 0: channel 0 ...
+    adc_sample_t sample;            //stored value of 4 analog channel and digital channels
+    uint32_t* voltage = sample.voltage;
+    int64_t late_us;                //delay from start of period to wake up
+    int64_t start;
 
     esp_adc_cal_characteristics_t characteristic;       //store description of adc
-    FILE* file;
-    sdmmc_card_t* card;                                 //store information about sd card
-    static EventBits_t bits;           //bit used to mark event of adc timer period
 
     /* Start init ADC and DI */    
     user_adc_init(&characteristic);
     user_digital_input_init();
     /* Finish init ADC and DI*/
 
-    /* Start init SD card */
-#ifndef USE_SPI_MODE
-    //if use SDMMC
-    sdmmc_host_t host = SDMMC_HOST_DEFAULT();
-    user_sdmmc_card_init(&card, host);
-#else
-    //use SPI
-    sdmmc_host_t host = SDSPI_HOST_DEFAULT();
-    user_sdspi_card_init(&card, host);
-#endif
-
-    sdmmc_card_print_info(stdout, card);        //print card properties
-//     /* Finish init SD card */
-
-    group0_timer_init(0, ADC_PERIOD);
+    /* Samples go to condition_task, then on the sample bus to SD card and uplink */
+    sample_timer_start();
+    user_boot_mark(BOOT_PHASE_SAMPLING_START);
     while(1) {
         /* Start Measure ADC */
-    
-        //waiting until timer has expired => TIMER_FINISH_BIT is set
-        bits = xEventGroupWaitBits(xEventGroupADC, TIMER_FINISH_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
-        /* xEventGroupWaitBits() returns the bits before the call returned, hence we can test which event actually
-         * happened. */
-        if(bits & TIMER_FINISH_BIT) {
+        if(sample_timer_wait(&late_us)) {
+            user_power_awake_begin();
             //finish one period => get adc value
-            esp_adc_cal_get_voltage(ADC_CHAN_0, &characteristic, &voltage[0]);
-            esp_adc_cal_get_voltage(ADC_CHAN_1, &characteristic, &voltage[1]);
-            esp_adc_cal_get_voltage(ADC_CHAN_2, &characteristic, &voltage[2]);
-            esp_adc_cal_get_voltage(ADC_CHAN_3, &characteristic, &voltage[3]);
-            ESP_LOGI(TAG, "ADC Channel 0 measures: %d mV", voltage[0]);
-            ESP_LOGI(TAG, "ADC Channel 1 measures: %d mV", voltage[1]);
-            ESP_LOGI(TAG, "ADC Channel 2 measures: %d mV", voltage[2]);
-            ESP_LOGI(TAG, "ADC Channel 3 measures: %d mV", voltage[3]);
-
+            start = esp_timer_get_time();
+            for(int ch = 0; ch < ADC_CHANNEL_NUMBER; ch++) {
+                voltage[ch] = user_adc_read(&s_adc_channels[ch], &characteristic);
+            }
+            user_metrics_observe(METRIC_ADC_READ_LATENCY, esp_timer_get_time() - start);
             //now read digital value
-            digital_value = user_read_digital_channel();
-            ESP_LOGI(TAG, "Digital Value: %x", digital_value);
+            sample.digital = user_read_digital_channel();
+            sample.timestamp_us = esp_timer_get_time();
+            sample.flags = 0;
+            user_metrics_inc(METRIC_SAMPLES_ACQUIRED);
+            user_metrics_observe(METRIC_STAGE_ACQUIRE_WAIT, late_us);
+            user_boot_mark(BOOT_PHASE_FIRST_SAMPLE);
+        }
+        else continue;          //if period has not started, return to start
+        /* Finish Measure ADC */
+
+        //never wait for condition stage, a full queue means it is stalled
+        if(xQueueSend(xQueueAcquire, &sample, 0) != pdTRUE) {
+            user_metrics_inc(METRIC_SAMPLES_DROPPED);
+            user_metrics_set_max(METRIC_STAGE_CONDITION_QUEUE_MAX, STAGE_CONDITION_QUEUE);
+        }
+        else {
+            user_metrics_set_max(METRIC_STAGE_CONDITION_QUEUE_MAX, uxQueueMessagesWaiting(xQueueAcquire));
         }
-        else continue;          //if TIMER_FINISH_BIT is not set, return to start
+        user_power_awake_end();
+    }
+}
+
+/*
+ *  @brief: condition stage, this task adapts sampling rate, applies report rules,
+ *          then collects samples into batches published on the sample bus
+ *
+ */
+
+void condition_task(void* pvParameters) {
+    adc_sample_t sample;
+    bus_batch_t* batch = NULL;      //batch being filled, published when full
+    rules_state_t rules;            //state of report-by-exception rules
+    rules_result_t decision;
+    sampling_state_t sampling;      //state of adaptive sampling controller
+    bool rate_changed = true;       //period of this sample differs from previous one
 
-        //Checking semaphore
-        if(xSemaphoreADC != NULL) {
-            if(uxSemaphoreGetCount(xSemaphoreADC) == 0) {
-                //Semaphore has not been taken yet => take semaphore to edit value
-                xSemaphoreTake(xSemaphoreADC, 0);
+    rules_init(&rules);
+    sampling_init(&s_sampling_config, &sampling);
+    while(1) {
+        if(xQueueReceive(xQueueAcquire, &sample, portMAX_DELAY) != pdTRUE) continue;
+        user_power_awake_begin();
+        user_metrics_observe(METRIC_STAGE_CONDITION_WAIT, esp_timer_get_time() - sample.timestamp_us);
+        ESP_LOGI(TAG, "ADC Channel 0 measures: %u mV", sample.voltage[0]);
+        ESP_LOGI(TAG, "ADC Channel 1 measures: %u mV", sample.voltage[1]);
+        ESP_LOGI(TAG, "ADC Channel 2 measures: %u mV", sample.voltage[2]);
+        ESP_LOGI(TAG, "ADC Channel 3 measures: %u mV", sample.voltage[3]);
+        ESP_LOGI(TAG, "Digital Value: %x", sample.digital);
+
+        if(batch == NULL) {
+            batch = bus_batch_alloc();
+        }
+        if(batch == NULL) {
+            //every batch is held by subscribers => sample cannot be stored anywhere
+            user_metrics_inc(METRIC_SAMPLES_DROPPED);
+            user_power_awake_end();
+            continue;
+        }
+        //only samples which go on the bus are numbered, so a missing number is a sample lost after this point
+        sample.seq = user_seq_next();
+
+        //first sample always carries the period so the log starts with it
+        rate_changed |= sampling_update(&s_sampling_config, &sampling, sample.voltage, sample.timestamp_us);
+        if(rate_changed) {
+            ESP_LOGI(TAG, "Sampling period: %u ms", sampling.period_ms);
+            sample_timer_set_period(sampling.period_ms);
+        }
+        sample.period_ms = sampling.period_ms;
+
+        //Only samples which changed enough are sent, SD card keeps all of them
+        decision = rules_evaluate(&s_rules_config, &rules, sample.voltage, sample.digital, sample.timestamp_us);
+        sample.flags = (decision.event ? SAMPLE_FLAG_EVENT : 0) | (rate_changed ? SAMPLE_FLAG_RATE_CHANGE : 0)
+                        | (decision.report ? 0 : SAMPLE_FLAG_SUPPRESSED);
+        rate_changed = false;
+        if(decision.event) {
+            ESP_LOGW(TAG, "Rule event: high %x low %x edge %x", decision.high_mask, decision.low_mask, decision.edge_mask);
+            user_metrics_inc(METRIC_RULE_EVENTS);
+        }
+        if(!decision.report) {
+            user_metrics_inc(METRIC_SAMPLES_SUPPRESSED);
+        }
+
+        //Publish full, old or event batches, subscribers never block this stage
+        batch->samples[batch->count++] = sample;
+        if(batch->count == BUS_BATCH_SAMPLES || (sample.flags & SAMPLE_FLAG_EVENT)
+            || sample.timestamp_us - batch->samples[0].timestamp_us >= BUS_BATCH_MAX_AGE_MS*1000LL) {
+            bus_publish(batch);
+            batch = NULL;
+        }
+        user_power_awake_end();
+    }
+}
+
+/*
+ *  @brief: this task periodically captures a high rate burst of each selected channel
+ *          and reduces it to spectral features, which go to SD card and uplink
+ *
+ */
+
+void spectrum_task(void* pvParameters) {
+    //buffers are too large for the task stack
+    static float re[ADC_BURST_POINTS], im[ADC_BURST_POINTS];
+    static spectrum_burst_t burst;
+    const adc1_channel_t channels[ADC_CHANNEL_NUMBER] = { ADC_CHAN_0, ADC_CHAN_1, ADC_CHAN_2, ADC_CHAN_3 };
+    esp_adc_cal_characteristics_t characteristic;
+    int64_t start;
+
+    //width and attenuation are configured by adc_measure_task, only calibration is needed here
+    esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, VREF, &characteristic);
+    spectrum_init();
+    while(1) {
+        vTaskDelay(ADC_BURST_PERIOD_MS/portTICK_RATE_MS);
+        user_power_awake_begin();
+        start = esp_timer_get_time();
+        memset(&burst, 0, sizeof(burst));
+        burst.timestamp_us = start;
+        burst.points = ADC_BURST_POINTS;
+        for(int ch = 0; ch < ADC_CHANNEL_NUMBER; ch++) {
+            if(!(ADC_BURST_CHANNEL_MASK & (1 << ch))) continue;
+            //adc1_get_raw is locked by the driver, bursts may interleave with adc_measure_task safely
+            burst.sample_rate_hz = user_adc_burst(channels[ch], &characteristic, re, ADC_BURST_POINTS, ADC_BURST_RATE_HZ);
+            if(spectrum_analyze(re, im, ADC_BURST_POINTS, burst.sample_rate_hz, &burst.channel[ch])) {
+                burst.channel_mask |= 1 << ch;
+                ESP_LOGI(TAG, "Spectrum channel %d: rms %.1f mV, crest %.2f, main peak %.1f Hz", ch,
+                    burst.channel[ch].rms_mv, burst.channel[ch].crest, burst.channel[ch].peaks[0].freq_hz);
             }
-            /*  Start access to resources safely  */
-            for(uint8_t i = 0; i < 4; i++) {
-                xSemaphoreADC_value[i] = voltage[i];
+        }
+        user_metrics_observe(METRIC_SPECTRUM_LATENCY, esp_timer_get_time() - start);
+        user_metrics_inc(METRIC_SPECTRUM_BURSTS);
+
+        if(user_boot_is_ready(BOOT_SD_READY_BIT)) {
+            FILE* file = fopen(MOUNT_POINT"/spectrum.txt", "a");
+            if(file != NULL) {
+                user_file_record_spectrum(file, &burst);
+                fclose(file);
             }
-            /*  Finish editing value  */
+            else ESP_LOGE(TAG, "Cannot open spectrum file.");
+        }
+        if(xQueueSpectrum != NULL) {
+            xQueueSend(xQueueSpectrum, &burst, 0);
+        }
+        user_power_awake_end();
+    }
+}
+
+/**
+ * @brief Record missing samples as a gap, they are given up if the tracker has no room
+ */
+static void uplink_gap(uint32_t first, uint32_t last) {
+    user_metrics_add(METRIC_UPLINK_GAP_SAMPLES, last - first + 1);
+    if(!seq_tracker_gap(&s_tracker, first, last)) {
+        user_metrics_add(METRIC_UPLINK_LOST, last - first + 1);
+    }
+}
+
+/**
+ * @brief Publish acknowledgement watermark and number of gaps
+ * 
+ * @param pending samples in backend batch
+ */
+static void uplink_update_metrics(size_t pending) {
+    uint32_t oldest = pending > 0 ? s_pending_seq[0] : UINT32_MAX;
+    for(int i = 0; i < UPLINK_INFLIGHT_BATCHES; i++) {
+        if(s_inflight[i].count > 0 && s_inflight[i].seq[0] < oldest) oldest = s_inflight[i].seq[0];
+    }
+    user_metrics_set(METRIC_UPLINK_ACK_WATERMARK, seq_tracker_watermark(&s_tracker, oldest));
+    user_metrics_set(METRIC_UPLINK_UNACKED_RANGES, s_tracker.count);
+}
+
+/**
+ * @brief Free slot for a batch waiting for acknowledgement, NULL if every slot is in use
+ */
+static uplink_inflight_t* uplink_inflight_slot(void) {
+    for(int i = 0; i < UPLINK_INFLIGHT_BATCHES; i++) {
+        if(s_inflight[i].count == 0) return &s_inflight[i];
+    }
+    return NULL;
+}
 
-            xSemaphoreGive(xSemaphoreADC);          //release Semaphore
+/**
+ * @brief True if backend batch cannot be flushed before an acknowledgement frees a slot
+ */
+static bool uplink_inflight_full(const uplink_backend_t* backend) {
+    return backend->replay && backend->acked != NULL && uplink_inflight_slot() == NULL;
+}
+
+/**
+ * @brief Flush backend batch. Its samples are acknowledged when flush succeeds, or wait in a
+ *        slot until the backend reports the acknowledgement (acked)
+ * 
+ * @param pending samples in backend batch, cleared on success or when the backend dropped the batch
+ * @return ESP_ERR_INVALID_STATE if every slot is in use, or result of the backend
+ */
+static esp_err_t uplink_flush(const uplink_backend_t* backend, size_t* pending) {
+    uplink_inflight_t* slot = NULL;
+    int id;
+    if(*pending == 0) return ESP_OK;
+    if(uplink_inflight_full(backend)) return ESP_ERR_INVALID_STATE;
+    if(backend->replay && backend->acked != NULL) {
+        slot = uplink_inflight_slot();
+    }
+    esp_err_t err = backend->flush(&id);
+    if(err == ESP_OK && slot != NULL) {
+        slot->id = id;
+        slot->flushed_us = esp_timer_get_time();
+        slot->count = *pending;
+        memcpy(slot->seq, s_pending_seq, *pending * sizeof(uint32_t));
+    }
+    else if(err == ESP_ERR_INVALID_SIZE) {
+        //batch can never be sent, reading it back would fail the same way
+        user_metrics_add(METRIC_UPLINK_LOST, *pending);
+    }
+    if(err == ESP_OK || err == ESP_ERR_INVALID_SIZE) {
+        *pending = 0;
+    }
+    if(backend->replay) uplink_update_metrics(*pending);
+    return err;
+}
+
+/**
+ * @brief Take acknowledgements from the backend. Batches waiting longer than UPLINK_ACK_TIMEOUT_MS
+ *        become gaps, if they are acknowledged later the server gets them twice
+ * 
+ * @param pending samples in backend batch
+ */
+static void uplink_poll_acks(const uplink_backend_t* backend, size_t pending) {
+    int64_t now = esp_timer_get_time();
+    int id;
+    if(backend->acked == NULL) return;
+    while(backend->acked(&id)) {
+        for(int i = 0; i < UPLINK_INFLIGHT_BATCHES; i++) {
+            if(s_inflight[i].count > 0 && s_inflight[i].id == id) s_inflight[i].count = 0;
         }
-        //After finish, clear bits and restart timer
-        xEventGroupClearBits(xEventGroupADC, TIMER_FINISH_BIT);
-        /* Finish Measure ADC */
+    }
+    for(int i = 0; i < UPLINK_INFLIGHT_BATCHES; i++) {
+        uplink_inflight_t* batch = &s_inflight[i];
+        if(batch->count == 0 || now - batch->flushed_us < UPLINK_ACK_TIMEOUT_MS * 1000LL) continue;
+        ESP_LOGW(TAG, "Batch %d of %zu samples was not acknowledged, it is read back from SD card", batch->id, batch->count);
+        //runs of consecutive numbers at once
+        for(size_t j = 0, k; j < batch->count; j = k) {
+            for(k = j + 1; k < batch->count && batch->seq[k] == batch->seq[k - 1] + 1; k++);
+            uplink_gap(batch->seq[j], batch->seq[k - 1]);
+        }
+        batch->count = 0;
+    }
+    if(backend->replay) uplink_update_metrics(pending);
+}
+
+/**
+ * @brief Read gaps of the uplink stream back from SD card and send them, one backend batch at a time
+ * 
+ * @note Called with an empty backend batch, so replayed samples are never mixed with live ones.
+ * If sending fails, the batch stays in the backend and is flushed again like a live one.
+ * @return number of missing samples which were sent, skipped or given up
+ */
+static uint32_t uplink_replay(const uplink_backend_t* backend, size_t* pending) {
+    static adc_sample_t samples[UPLINK_BATCH_SAMPLES];
+    seq_range_t gap;
+    size_t count, skipped;
+    uint32_t done = 0;
+    for(int round = 0; round < UPLINK_REPLAY_BATCHES && *pending == 0 && seq_tracker_first_gap(&s_tracker, &gap); round++) {
+        //samples still queued for SD card cannot be read back yet
+        uint32_t written = s_sd_next_seq;
+        if(gap.first >= written) break;
+        if(gap.last >= written) gap.last = written - 1;
+        if(!sd_read_samples(gap.first, gap.last, samples, UPLINK_BATCH_SAMPLES, &count, &skipped)) break;
+        //batch is full => rest of the gap is read in the next round
+        if(count == UPLINK_BATCH_SAMPLES) gap.last = samples[count - 1].seq;
 
+        //numbers which are neither read nor marked as suppressed were dropped before SD card too => give them up
+        uint32_t lost = gap.last - gap.first + 1 - count - skipped;
+        lost += seq_tracker_remove(&s_tracker, gap.first, gap.last);
+        user_metrics_add(METRIC_UPLINK_LOST, lost);
+        done += lost + skipped;
+        if(count == 0) continue;
 
-        file = fopen(MOUNT_POINT"/record.txt", "a+");
-        if(file == NULL) {
-            ESP_LOGE(TAG, "Cannot open file.");
+        ESP_LOGI(TAG, "Replaying %zu samples from SD card, sequence %u to %u", count, gap.first, gap.last);
+        for(size_t i = 0; i < count; i++) {
+            if(backend->enqueue(&samples[i], 1) == ESP_OK) {
+                s_pending_seq[(*pending)++] = samples[i].seq;
+            }
+            //removed from the tracker above => back into a gap or it would never be sent
+            else uplink_gap(samples[i].seq, samples[i].seq);
+        }
+        user_metrics_add(METRIC_UPLINK_REPLAYED, *pending);
+        done += *pending;
+        if(uplink_flush(backend, pending) != ESP_OK) break;
+    }
+    uplink_update_metrics(*pending);
+    return done;
+}
+
+/**
+ * @brief Put the samples of a bus batch which are meant for upload into the backend batch
+ * 
+ * @param pending samples in backend batch
+ * @param event set if an event sample was added
+ */
+static void uplink_collect(const bus_batch_t* batch, const uplink_backend_t* backend, size_t* pending, bool* event) {
+    for(uint32_t i = 0; i < batch->count; i++) {
+        const adc_sample_t* sample = &batch->samples[i];
+        bool wanted = !(sample->flags & SAMPLE_FLAG_SUPPRESSED);
+        //batches dropped from the uplink queue show up as missing numbers
+        if(backend->replay) {
+            uint32_t missing = seq_tracker_receive(&s_tracker, sample->seq);
+            if(missing > 0) uplink_gap(sample->seq - missing, sample->seq - 1);
+        }
+        if(*pending == UPLINK_BATCH_SAMPLES) {
+            //batch is full and could not be flushed => sample is read back from SD card later,
+            //suppressed ones go to the gap too so that it stays one range, they are skipped then
+            if(wanted) user_metrics_inc(METRIC_UPLINK_DROPPED);
+            if(backend->replay) uplink_gap(sample->seq, sample->seq);
             continue;
         }
-        else ESP_LOGI(TAG, "Open file successfully.");
-        /* Start writing to file */
-        user_file_record_value(file, &voltage[0], digital_value);
-        /* Finish writing to file */
-        fclose(file);
+        if(!wanted) continue;
+        if(backend->enqueue(sample, 1) == ESP_OK) {
+            s_pending_seq[(*pending)++] = sample->seq;
+            *event |= (sample->flags & SAMPLE_FLAG_EVENT) != 0;
+        }
+        else {
+            user_metrics_inc(METRIC_UPLINK_DROPPED);
+            if(backend->replay) uplink_gap(sample->seq, sample->seq);
+        }
+    }
+}
+
+#if POWER_SAVE
+//samples of one more bus batch always fit in the backend batch while the radio is off
+_Static_assert(POWER_WINDOW_BACKLOG + BUS_BATCH_SAMPLES <= UPLINK_BATCH_SAMPLES, "POWER_WINDOW_BACKLOG is too large for UPLINK_BATCH_SAMPLES");
 
-        
-        //vTaskDelay(200/portTICK_RATE_MS);
+/**
+ * @brief Samples sent but not acknowledged yet
+ */
+static uint32_t uplink_inflight_samples(void) {
+    uint32_t count = 0;
+    for(int i = 0; i < UPLINK_INFLIGHT_BATCHES; i++) {
+        count += s_inflight[i].count;
     }
+    return count;
 }
 
-void update_thingspeak(void* pvParameters) {
-    vTaskDelay(10000/portTICK_RATE_MS);
-    uint8_t new_val = 0;            //used to mark that new data has been received from Semaphore
-    field_value_t thingspeak_data = {
-        .field_val1 = 0,
-        .field_val2 = 0,
-        .field_val3 = 0,
-        .field_val4 = 0
-    };
+/**
+ * @brief Samples waiting for upload: backend batch, subscriber queue, batches waiting for
+ *        acknowledgement, and one more if a gap can be read back
+ */
+static uint32_t uplink_backlog(const uplink_backend_t* backend, size_t pending) {
+    seq_range_t gap;
+    uint32_t backlog = pending + uxQueueMessagesWaiting(s_uplink_subscriber.queue) * BUS_BATCH_SAMPLES + uplink_inflight_samples();
+    if(backend->replay && seq_tracker_first_gap(&s_tracker, &gap) && gap.first < s_sd_next_seq) backlog++;
+    return backlog;
+}
 
+/**
+ * @brief Upload window: switch radio on, send everything waiting, switch radio off
+ * 
+ * @note Window ends early when sending fails, what is left waits for the next window. Once
+ * everything is sent, it stays open until the batches are acknowledged or the window times out.
+ */
+static void uplink_window(const uplink_backend_t* backend, size_t* pending, bool* event) {
+    static spectrum_burst_t burst;
+    bus_batch_t* batch;
+    bool complete = false;
+
+    //radio is already on for the first window, connected at boot
+    if(!user_power_radio_is_on()) {
+        user_power_radio_on();
+        wifi_radio_on();
+    }
+    if(user_boot_wait(BOOT_WIFI_READY_BIT, user_power_ticks_left_in_window())) {
+        while(!user_power_window_done(uplink_backlog(backend, *pending))) {
+            uplink_poll_acks(backend, *pending);
+            while(xQueueReceive(xQueueSpectrum, &burst, 0) == pdTRUE && backend->send_features != NULL) {
+                backend->send_features(&burst);
+            }
+            while(*pending + BUS_BATCH_SAMPLES <= UPLINK_BATCH_SAMPLES && (batch = bus_receive(&s_uplink_subscriber, 0)) != NULL) {
+                uplink_collect(batch, backend, pending, event);
+                bus_release(batch);
+            }
+            if(*pending > 0 && !uplink_inflight_full(backend)) {
+                if(uplink_flush(backend, pending) != ESP_OK) break;
+                *event = false;
+            }
+            //gaps are filled once live samples are out
+            if(backend->replay && *pending == 0 && uplink_replay(backend, pending) > 0) continue;
+            if(*pending + BUS_BATCH_SAMPLES <= UPLINK_BATCH_SAMPLES && uxQueueMessagesWaiting(s_uplink_subscriber.queue) > 0) continue;
+            //nothing else can be sent now, wait for acknowledgements if there are any
+            if(uplink_inflight_samples() == 0) break;
+            vTaskDelay(UPLINK_ACK_POLL_MS/portTICK_RATE_MS);
+        }
+        complete = *pending == 0 && uplink_inflight_samples() == 0;
+    }
+    else {
+        ESP_LOGW(TAG, "No connection in upload window");
+    }
+    wifi_radio_off();
+    user_boot_clear_ready(BOOT_WIFI_READY_BIT);
+    user_power_radio_off(complete);
+}
+#endif
+
+/*
+ *  @brief: this task collects samples into batches and sends them with the selected uplink backend,
+ *          gaps of the stream are filled from SD card once the backend works.
+ *          With POWER_SAVE, samples are sent in upload windows and radio is off in between
+ *
+ */
+
+void uplink_task(void* pvParameters) {
+#ifdef UPLINK_USE_MQTT
+    const uplink_backend_t* backend = &uplink_mqtt;
+#else
+    const uplink_backend_t* backend = &uplink_thingspeak;
+#endif
+    bus_batch_t* batch;
+    size_t pending = 0;             //number of samples in backend batch
+    bool event = false;             //batch holds an event sample => deliver now
+
+    //batches wait in the subscriber queue while network is coming up, oldest are dropped when it is full
+    user_boot_wait(BOOT_WIFI_READY_BIT, portMAX_DELAY);
+    seq_tracker_init(&s_tracker, user_seq_first());
+    ESP_LOGI(TAG, "Uplink backend: %s", backend->name);
+    if(backend->open() != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot open uplink backend %s", backend->name);
+    }
+
+#if POWER_SAVE
+    while(1) {
+        uplink_window(backend, &pending, &event);
+        //radio is off => collect batches until a window is due, a batch wakes the task only with a new sample
+        while(!user_power_window_due(uplink_backlog(backend, pending), event)) {
+            batch = bus_receive(&s_uplink_subscriber, user_power_ticks_to_window());
+            if(batch != NULL) {
+                user_power_awake_begin();
+                uplink_poll_acks(backend, pending);
+                uplink_collect(batch, backend, &pending, &event);
+                bus_release(batch);
+                user_power_awake_end();
+            }
+        }
+    }
+#else
+    const TickType_t flush_period = UPLINK_FLUSH_PERIOD_MS/portTICK_RATE_MS;
+    static spectrum_burst_t burst;
+    TickType_t last_flush = xTaskGetTickCount(), elapsed;
     while(1) {
-        /*   Try to access to semaphore   */
-        if(xSemaphoreADC != NULL) {
-            /* Check if Semaphore can be taken, if not, wait for 10 ticks before taking */
-            if(xSemaphoreTake(xSemaphoreADC, (TickType_t)10) == pdTRUE) {
-                /* Semaphore is taken, resource is able to be accessed */
-                thingspeak_data.field_val1 = xSemaphoreADC_value[0];
-                thingspeak_data.field_val2 = xSemaphoreADC_value[1];
-                thingspeak_data.field_val3 = xSemaphoreADC_value[2];
-                thingspeak_data.field_val4 = xSemaphoreADC_value[3];
-                ESP_LOGI(TAG, "Received data in semaphore");
-                new_val = 1;
-                xSemaphoreGive(xSemaphoreADC);              //finish taking value, release semaphore
+        uplink_poll_acks(backend, pending);
+        //features are sent on their own, they do not wait for the sample batch
+        if(xQueueReceive(xQueueSpectrum, &burst, 0) == pdTRUE && backend->send_features != NULL && backend->healthy()) {
+            backend->send_features(&burst);
+        }
+        elapsed = xTaskGetTickCount() - last_flush;
+        batch = bus_receive(&s_uplink_subscriber, elapsed >= flush_period ? 0 : flush_period - elapsed);
+        if(batch != NULL) {
+            uplink_collect(batch, backend, &pending, &event);
+            bus_release(batch);
+        }
+        //flush on full batch or event only while backend works, otherwise retry once per period
+        if(((pending >= UPLINK_BATCH_SAMPLES || (pending > 0 && event)) && backend->healthy())
+            || xTaskGetTickCount() - last_flush >= flush_period) {
+            if(uplink_flush(backend, &pending) == ESP_OK) {
+                event = false;
             }
+            last_flush = xTaskGetTickCount();
         }
-        if(new_val) {
-            // ESP_LOGI(TAG,"Start post data to thingspeak");
-            printf("ThingSpeak data: %d %d %d %d\n", thingspeak_data.field_val1,thingspeak_data.field_val2,thingspeak_data.field_val3,thingspeak_data.field_val4);
-            esp_thingspeak_post(&thingspeak_data);
-            new_val = 0;
+        //after an outage, gaps are filled while there is no live sample waiting
+        if(backend->replay && pending == 0 && backend->healthy()) {
+            uplink_replay(backend, &pending);
         }
-        // esp_thingspeak_post(thingspeak_data);
     }
+#endif
 }
 
 void app_main(void)
 {
+    //chip stays awake until every task is started
+    if(user_power_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Power management not configured, chip does not sleep");
+    }
+    ESP_ERROR_CHECK(user_boot_init());
+    //sequence numbers continue from NVS => it is needed before the first sample, Wi-Fi driver needs it too
     ESP_ERROR_CHECK(nvs_flash_init());
+    user_seq_init();
+    xMutexSd = USER_MUTEX_CREATE(xMutexSd);
+    //subscribers are registered before the first batch can be published
+    ESP_ERROR_CHECK(bus_subscribe(&s_sd_subscriber));
+    ESP_ERROR_CHECK(bus_subscribe(&s_uplink_subscriber));
+    xQueueAcquire = USER_QUEUE_CREATE(xQueueAcquire, STAGE_CONDITION_QUEUE, sizeof(adc_sample_t));
+    if(xQueueAcquire == NULL) {
+        ESP_LOGE(TAG, "There is not enough heap memory for Queue");
+    }
+    xQueueSpectrum = USER_QUEUE_CREATE(xQueueSpectrum, UPLINK_QUEUE_BURSTS, sizeof(spectrum_burst_t));
+    if(xQueueSpectrum == NULL) {
+        ESP_LOGE(TAG, "There is not enough heap memory for Queue");
+    }
+    //sampling does not depend on anything else => start it first
+    if(USER_TASK_CREATE(condition_task, "condition task", CONDITION_TASK_STACK, STAGE_CONDITION_PRIO, STAGE_CONDITION_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "There is not enough heap memory for condition task");
+    }
+    if(USER_TASK_CREATE(adc_measure_task, "adc task", ADC_TASK_STACK, STAGE_ACQUIRE_PRIO, STAGE_ACQUIRE_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "There is not enough heap memory for adc task");
+    }
+    //SD card and Wi-Fi are brought up in parallel, each sink waits for its own ready bit
+    if(USER_TASK_CREATE(sd_task, "sd task", SD_TASK_STACK, STAGE_PERSIST_PRIO, STAGE_PERSIST_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "There is not enough heap memory for sd task");
+    }
+    //bursts busy-wait for up to ADC_BURST_POINTS/ADC_BURST_RATE_HZ per channel => lowest priority
+    if(USER_TASK_CREATE(spectrum_task, "spectrum task", SPECTRUM_TASK_STACK, 1, 0) != pdPASS) {
+        ESP_LOGE(TAG, "There is not enough heap memory for spectrum task");
+    }
 
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-
-    ESP_ERROR_CHECK(wifi_connect());
-    xTaskCreatePinnedToCore(&adc_measure_task, "adc task", 4096, NULL, ESP_TASKD_EVENT_PRIO-1, NULL, 0);
-    xTaskCreatePinnedToCore(&update_thingspeak, "thingspeak task", 8192, NULL, ESP_TASK_PRIO_MAX, NULL, 1);
+    if(USER_TASK_CREATE(net_boot_task, "net boot", NET_BOOT_TASK_STACK, ESP_TASKD_EVENT_PRIO-2, 1) != pdPASS) {
+        ESP_LOGE(TAG, "There is not enough heap memory for net boot task");
+    }
+    if(USER_TASK_CREATE(uplink_task, "uplink task", UPLINK_TASK_STACK, STAGE_UPLINK_PRIO, STAGE_UPLINK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "There is not enough heap memory for uplink task");
+    }
+    user_profiler_start();
+    user_memory_report();
+    user_power_awake_end();
 }
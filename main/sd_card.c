@@ -25,7 +25,7 @@ esp_err_t user_sdmmc_card_init(sdmmc_card_t** card, sdmmc_host_t host)
     esp_vfs_fat_sdmmc_mount_config_t mount_config = {
         .format_if_mount_failed = false,                    //do not format SD card if unable to mount
         .max_files = 5,                                     //can only open 5 files at the same time
-        .allocation_unit_size = 16 * 1024                   //dont care if format_if_mount_failed is false
+        .allocation_unit_size = SD_ALLOCATION_UNIT_SIZE     //dont care if format_if_mount_failed is false
     };
 
     // This initializes the slot without card detect (CD) and write protect (WP) signals.
@@ -70,7 +70,7 @@ esp_err_t user_sdspi_card_init(sdmmc_card_t** card, sdmmc_host_t host)
     esp_vfs_fat_sdmmc_mount_config_t mount_config = {
         .format_if_mount_failed = false,                    //do not format SD card if unable to mount
         .max_files = 5,                                     //can only open 5 files at the same time
-        .allocation_unit_size = 16 * 1024                   //dont care if format_if_mount_failed is false
+        .allocation_unit_size = SD_ALLOCATION_UNIT_SIZE     //dont care if format_if_mount_failed is false
     };
     spi_bus_config_t bus_cfg = {
         .mosi_io_num = PIN_NUM_MOSI,
@@ -82,7 +82,8 @@ esp_err_t user_sdspi_card_init(sdmmc_card_t** card, sdmmc_host_t host)
     };
 
     ret = spi_bus_initialize(host.slot, &bus_cfg, SPI_DMA_CHAN);
-    if(ret != ESP_OK) {
+    //ESP_ERR_INVALID_STATE: bus is already initialized by a previous mount attempt
+    if(ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
         ESP_LOGE(TAG, "Failed to initialize SPI bus");
         return ret;
     }
@@ -155,9 +156,58 @@ uint64_t user_file_get_size(FILE* f) {
     return size;
 }
 
-void user_file_record_value(FILE* f, uint32_t* adc_val, uint8_t digital_val) {
-    fprintf(f, "Analog: Chan 0:%dmV, Chan 1:%dmV, Chan 2:%dmV, Chan 3:%d mV.\n", adc_val[0], adc_val[1], adc_val[2], adc_val[3]);
-    fprintf(f, "Digtal: Chan 0: %d, Chan 1: %d, Chan 2: %d, Chan 3: %d\n", (digital_val&0x01), (digital_val>>1)&0x01, (digital_val>>2)&0x01, (digital_val>>3)&0x01);
-    /*  Note that digital value store state of digital input in bit 0 - 3
-     *  we must shift each corresponding bit to bit 0 and read that bit only    */
+size_t user_file_read_chunk(FILE* f, char* buf, size_t size) {
+    return fread(buf, 1, size, f);
+}
+
+/**** Benchmark ****/
+
+esp_err_t user_sd_benchmark(const char* path, size_t total_size) {
+#ifdef USE_SPI_MODE
+    const char* mode = "SPI";
+#else
+    const char* mode = "SDMMC";
+#endif
+    size_t done;
+    int64_t start, write_us, read_us;
+    //one allocation unit is transferred per call so each fwrite/fread covers whole clusters
+    char* buf = malloc(SD_ALLOCATION_UNIT_SIZE);
+    if(buf == NULL) {
+        ESP_LOGE(TAG, "Not enough heap memory for benchmark buffer");
+        return ESP_ERR_NO_MEM;
+    }
+    memset(buf, 0xA5, SD_ALLOCATION_UNIT_SIZE);
+
+    FILE* f = fopen(path, "wb");
+    if(f == NULL) {
+        ESP_LOGE(TAG, "Cannot open benchmark file");
+        free(buf);
+        return ESP_FAIL;
+    }
+    start = esp_timer_get_time();
+    for(done = 0; done < total_size; done += SD_ALLOCATION_UNIT_SIZE) {
+        if(fwrite(buf, 1, SD_ALLOCATION_UNIT_SIZE, f) != SD_ALLOCATION_UNIT_SIZE) break;
+    }
+    fclose(f);                              //include flushing of the last cluster in write time
+    write_us = esp_timer_get_time() - start;
+
+    f = fopen(path, "rb");
+    if(f == NULL) {
+        ESP_LOGE(TAG, "Cannot reopen benchmark file");
+        free(buf);
+        return ESP_FAIL;
+    }
+    start = esp_timer_get_time();
+    while(user_file_read_chunk(f, buf, SD_ALLOCATION_UNIT_SIZE) > 0);
+    read_us = esp_timer_get_time() - start;
+    fclose(f);
+
+    user_file_delete(path);
+    free(buf);
+
+    ESP_LOGI(TAG, "Benchmark (%s mode, %d byte chunks): write %zu KB in %lld ms (%lld KB/s), read in %lld ms (%lld KB/s)",
+        mode, SD_ALLOCATION_UNIT_SIZE, done / 1024,
+        (long long)(write_us / 1000), write_us > 0 ? (long long)done * 1000000 / 1024 / write_us : 0,
+        (long long)(read_us / 1000), read_us > 0 ? (long long)done * 1000000 / 1024 / read_us : 0);
+    return ESP_OK;
 }
@@ -11,11 +11,13 @@
 //Private include
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/unistd.h>
 #include <sys/stat.h>
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_vfs_fat.h"
 #include "driver/sdspi_host.h"
 #include "driver/spi_common.h"
@@ -23,8 +25,22 @@
 #include "sdkconfig.h"
 
 #include "driver/sdmmc_host.h"
+#include "user_metrics.h"
+#include "user_record.h"
 
+//Host simulation (host/) mounts a directory instead and passes its path with -DMOUNT_POINT
+#ifndef MOUNT_POINT
 #define MOUNT_POINT "/sdcard"
+#endif
+
+//FAT allocation unit (cluster) size used when the card is formatted.
+//Reads and writes done in multiples of this size map to whole clusters on the card.
+#define SD_ALLOCATION_UNIT_SIZE     (16 * 1024)
+
+//Uncomment the next line to run the read/write throughput benchmark once after mounting
+// #define SD_RUN_BENCHMARK
+#define SD_BENCHMARK_FILE           MOUNT_POINT"/bench.bin"
+#define SD_BENCHMARK_SIZE           (1024 * 1024)
 
 //Note that ESP can use SDMMC or SPI peripherals for communicating with SD CARD
 //By default, SD MMC is used
@@ -101,6 +117,26 @@ void user_file_read(FILE* f, int size, char* buf);
 
 uint64_t user_file_get_size(FILE* f);
 
-void user_file_record_value(FILE* f, uint32_t* adc_val, uint8_t digital_val);
+/**
+ * @brief Read up to size bytes of raw data from current position of file
+ * 
+ * @param f opened file
+ * @param buf buffer to store data, must be at least size bytes
+ * @param size maximum number of bytes to read
+ * @return size_t number of bytes actually read, 0 at end of file or on error
+ */
+size_t user_file_read_chunk(FILE* f, char* buf, size_t size);
+
+/**
+ * @brief Measure sequential write and read throughput of the mounted card
+ * 
+ * A test file of total_size bytes is written and read back in allocation-unit-sized chunks,
+ * then deleted. Result is printed together with the bus mode (SPI or SDMMC) in use.
+ * 
+ * @param path path of temporary test file
+ * @param total_size number of bytes to transfer in each direction
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NO_MEM or ESP_FAIL otherwise
+ */
+esp_err_t user_sd_benchmark(const char* path, size_t total_size);
 
-#endif
\ No newline at end of file
+#endif
@@ -3,13 +3,45 @@
 static const char *TAG = "ThingSpeak";
 static const char *start_request = "GET https://api.thingspeak.com/update?api_key="THINGSPEAK_API_KEY;
 static const char *end_request = 
-    " HTTP/1.1\n"
+    " HTTP/1.1\r\n"
     "Host: "WEB_SERVER"\r\n"
-    "Connection: close\r\n"
+    "Connection: "THINGSPEAK_CONNECTION"\r\n"
     "User-Agent: esp32 / esp-idf\r\n"
     "\r\n"; 
 
-esp_err_t http_client_request(const char *web_server, const char *request_string) {
+#ifdef THINGSPEAK_CHANNEL_ID
+#ifdef THINGSPEAK_USE_HTTPS
+//Content-Encoding (if any) and the empty line are added by thingspeak_bulk_stream
+static const char bulk_stream_header[] =
+    "POST /channels/"THINGSPEAK_CHANNEL_ID"/bulk_update.json HTTP/1.1\r\n"
+    "Host: "WEB_SERVER"\r\n"
+    "Connection: "THINGSPEAK_CONNECTION"\r\n"
+    "User-Agent: esp32 / esp-idf\r\n"
+    "Content-Type: application/json\r\n"
+    "Transfer-Encoding: chunked\r\n";
+#else
+static const char bulk_header_format[] =
+    "POST /channels/"THINGSPEAK_CHANNEL_ID"/bulk_update.json HTTP/1.1\r\n"
+    "Host: "WEB_SERVER"\r\n"
+    "Connection: "THINGSPEAK_CONNECTION"\r\n"
+    "User-Agent: esp32 / esp-idf\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: %d\r\n"
+    "\r\n";
+#endif
+static const char bulk_body_start[] = "{\"write_api_key\":\""THINGSPEAK_API_KEY"\",\"updates\":[";
+static const char bulk_body_end[] = "]}";
+#endif
+
+/* Count one finished request and its latency */
+static void record_upload(int64_t start, bool ok) {
+    user_metrics_observe(METRIC_UPLOAD_LATENCY, esp_timer_get_time() - start);
+    user_metrics_inc(ok ? METRIC_UPLOADS_SUCCEEDED : METRIC_UPLOADS_FAILED);
+}
+
+#ifndef THINGSPEAK_USE_HTTPS
+/* Plain HTTP over a new TCP connection, status is taken from the response status line */
+static esp_err_t http_plain_request(const char *web_server, const char *request_string, int* status) {
     //structure contains inputs value that set socket and protocol
     const struct addrinfo hints = {
         .ai_family = AF_INET,
@@ -25,7 +57,6 @@ esp_err_t http_client_request(const char *web_server, const char *request_string
     if(err != 0 || res == NULL) {
         ESP_LOGE(TAG, "DNS lookup failed err=%d, res=%p", err, res);
         freeaddrinfo(res);
-        vTaskDelay(1000/portTICK_RATE_MS);
         return ESP_ERR_HTTP_DNS_LOOKUP_FAILED;
     }
     /* Code to print the resolved IP.
@@ -40,7 +71,6 @@ esp_err_t http_client_request(const char *web_server, const char *request_string
     if(s<0) {
         ESP_LOGE(TAG, "...Failed to allocate socket.");
         freeaddrinfo(res);
-        vTaskDelay(1000/portTICK_RATE_MS);
         return ESP_ERR_HTTP_FAILED_TO_ALLOCATE_SOCKET;
     }
     ESP_LOGI(TAG, "Trying to connect socket");
@@ -48,7 +78,6 @@ esp_err_t http_client_request(const char *web_server, const char *request_string
         ESP_LOGE(TAG, "... socket connect failed errno=%d", errno);
         close(s);
         freeaddrinfo(res);
-        vTaskDelay(4000/portTICK_RATE_MS);
         return ESP_ERR_HTTP_SOCKET_CONNECT_FAILED;
     }
 
@@ -58,7 +87,6 @@ esp_err_t http_client_request(const char *web_server, const char *request_string
     if(write(s, request_string, strlen(request_string)) < 0) {
         ESP_LOGE(TAG, "...socket send failed");
         close(s);
-        vTaskDelay(4000/portTICK_RATE_MS);
         return ESP_ERR_HTTP_SOCKET_SEND_FAILED;
     }
     ESP_LOGI(TAG, "...socket send success");
@@ -70,10 +98,9 @@ esp_err_t http_client_request(const char *web_server, const char *request_string
     receiving_timeout.tv_sec = 60;
     receiving_timeout.tv_usec = 0;
 
-    if(setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &receiving_timeout, sizeof(receiving_timeout) < 0)) {
+    if(setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &receiving_timeout, sizeof(receiving_timeout)) < 0) {
         ESP_LOGE(TAG, "...failed to set socket receiving timeout");
         close(s);
-        vTaskDelay(60000/portTICK_RATE_MS);
         return ESP_ERR_HTTP_SOCKET_RECEIVE_TIMEOUT;
     }
     ESP_LOGI(TAG, "...set socket receiving timeout success");
@@ -82,6 +109,10 @@ esp_err_t http_client_request(const char *web_server, const char *request_string
     do {
         bzero(recv_buf, sizeof(recv_buf));
         r = read(s, recv_buf, sizeof(recv_buf)-1);
+        //status line starts the first read
+        if(r > 0 && *status == 0) {
+            sscanf(recv_buf, "HTTP/1.%*d %d", status);
+        }
         for(int i = 0; i < r; i++) {
             putchar(recv_buf[i]);
         }
@@ -90,28 +121,49 @@ esp_err_t http_client_request(const char *web_server, const char *request_string
     ESP_LOGI(TAG, "...done reading from socket. Last read return=%d, errno=%d", r, errno);
     close(s);
 
-    vTaskDelay(60000/portTICK_RATE_MS);
-    return ESP_OK;
+    //r < 0 => response was cut by timeout or error
+    return (r == 0) ? ESP_OK : ESP_ERR_HTTP_SOCKET_RECEIVE_TIMEOUT;
+}
+#endif
+
+esp_err_t http_client_request(const char *web_server, const char *request_string) {
+    esp_err_t err;
+    int status = 0;
+    int64_t start = esp_timer_get_time();
+    user_metrics_inc(METRIC_UPLOADS_ATTEMPTED);
+#ifdef THINGSPEAK_USE_HTTPS
+    err = https_client_request(web_server, WEB_PORT, request_string, strlen(request_string), &status);
+#else
+    err = http_plain_request(web_server, request_string, &status);
+#endif
+    //only a 2xx answer acknowledges the samples, uplink keeps the batch otherwise
+    if(err == ESP_OK && (status < 200 || status >= 300)) {
+        ESP_LOGE(TAG, "Server responded with status %d", status);
+        err = ESP_ERR_THINGSPEAK_POST_FAILED;
+    }
+    record_upload(start, err == ESP_OK);
+    //retry and pacing between posts are done by the uplink task
+    return err;
 }
 
-void esp_thingspeak_post(field_value_t* field_data) {
+esp_err_t esp_thingspeak_post(field_value_t* field_data) {
     int n;
-    printf("ThingSpeak data: %d %d %d %d\n", field_data->field_val1,field_data->field_val2,field_data->field_val3,field_data->field_val4);
-    n = snprintf(NULL, 0, "%d", field_data->field_val1);
+    printf("ThingSpeak data: %u %u %u %u\n", field_data->field_val1,field_data->field_val2,field_data->field_val3,field_data->field_val4);
+    n = snprintf(NULL, 0, "%u", field_data->field_val1);
     char field1[n+1];
-    sprintf(field1, "%d", field_data->field_val1);
+    sprintf(field1, "%u", field_data->field_val1);
 
-    n = snprintf(NULL, 0, "%d", field_data->field_val2);
+    n = snprintf(NULL, 0, "%u", field_data->field_val2);
     char field2[n+1];
-    sprintf(field2, "%d", field_data->field_val2);
+    sprintf(field2, "%u", field_data->field_val2);
 
-    n = snprintf(NULL, 0, "%d", field_data->field_val3);
+    n = snprintf(NULL, 0, "%u", field_data->field_val3);
     char field3[n+1];
-    sprintf(field3, "%d", field_data->field_val3);
+    sprintf(field3, "%u", field_data->field_val3);
 
-    n = snprintf(NULL, 0, "%d", field_data->field_val4);
+    n = snprintf(NULL, 0, "%u", field_data->field_val4);
     char field4[n+1];
-    sprintf(field4, "%d", field_data->field_val4);
+    sprintf(field4, "%u", field_data->field_val4);
 
     printf("Values of 4 fields: %s %s %s %s\n", field1, field2, field3, field4);
     //request string size calculation
@@ -130,7 +182,15 @@ void esp_thingspeak_post(field_value_t* field_data) {
     string_size += 1;                                                   //'\0' terminate character
 
     //assemble request string
-    char* get_request = malloc(string_size);
+    if(string_size > g_http_pool.block_size) {
+        ESP_LOGE(TAG, "Request of %d bytes does not fit in HTTP buffer", string_size);
+        return ESP_ERR_NO_MEM;
+    }
+    char* get_request = pool_alloc(&g_http_pool);
+    if(get_request == NULL) {
+        ESP_LOGE(TAG, "No free HTTP buffer");
+        return ESP_ERR_NO_MEM;
+    }
     strcpy(get_request, start_request);
 
     strcat(get_request, "&field1=");
@@ -149,6 +209,245 @@ void esp_thingspeak_post(field_value_t* field_data) {
 
     ESP_LOGI(TAG, "Set request done. Start posting data to ThingSpeak");
 
-    http_client_request(WEB_SERVER, get_request);
-    free(get_request);
+    esp_err_t err = http_client_request(WEB_SERVER, get_request);
+    pool_free(&g_http_pool, get_request);
+    return err;
+}
+
+#ifdef THINGSPEAK_CHANNEL_ID
+int thingspeak_format_entry(char* buf, size_t size, const adc_sample_t* samples, size_t i) {
+    int64_t prev_us = (i == 0) ? samples[0].timestamp_us : samples[i - 1].timestamp_us;
+    return snprintf(buf, size, "%s{\"delta_t\":%lld,\"field1\":%u,\"field2\":%u,\"field3\":%u,\"field4\":%u,\""THINGSPEAK_SEQ_FIELD"\":%u}",
+        i ? "," : "", (long long)((samples[i].timestamp_us - prev_us) / 1000000),
+        samples[i].voltage[0], samples[i].voltage[1], samples[i].voltage[2], samples[i].voltage[3], samples[i].seq);
+}
+
+#ifdef THINGSPEAK_USE_HTTPS
+/*
+ *  Body is generated entry by entry and sent with chunked transfer encoding, optionally
+ *  through the gzip compressor => neither the plain nor the compressed body is ever held in full.
+ */
+typedef struct {
+    char buf[THINGSPEAK_CHUNK_SIZE];
+    size_t len;
+    bool error;
+} chunk_writer_t;
+
+static chunk_writer_t s_chunk;
+#if UPLINK_COMPRESSION
+static deflate_stream_t s_deflate;
+static bool s_gzip_accepted = true;         //cleared when server answers 415 to a gzip body
+#endif
+
+static bool chunk_flush(chunk_writer_t* w) {
+    char size_line[12];
+    if(w->len == 0 || w->error) return !w->error;
+    int n = snprintf(size_line, sizeof(size_line), "%zx\r\n", w->len);
+    if(https_client_write(size_line, n) != ESP_OK || https_client_write(w->buf, w->len) != ESP_OK
+        || https_client_write("\r\n", 2) != ESP_OK) {
+        w->error = true;
+    }
+    user_metrics_add(METRIC_UPLINK_BYTES_SENT, w->len);
+    w->len = 0;
+    return !w->error;
+}
+
+/* Same signature as deflate_write_cb so compressor output can go straight to the socket */
+static bool chunk_write(void* ctx, const uint8_t* data, size_t len) {
+    chunk_writer_t* w = ctx;
+    while(len > 0 && !w->error) {
+        size_t n = sizeof(w->buf) - w->len;
+        if(n > len) n = len;
+        memcpy(w->buf + w->len, data, n);
+        w->len += n;
+        data += n;
+        len -= n;
+        if(w->len == sizeof(w->buf)) chunk_flush(w);
+    }
+    return !w->error;
+}
+
+static bool body_write(bool gzip, const char* data, size_t len) {
+    user_metrics_add(METRIC_UPLINK_BYTES_PLAIN, len);
+#if UPLINK_COMPRESSION
+    if(gzip) return deflate_write(&s_deflate, data, len);
+#endif
+    return chunk_write(&s_chunk, (const uint8_t*)data, len);
+}
+
+static esp_err_t thingspeak_bulk_stream(const adc_sample_t* samples, size_t count, bool gzip, int* status) {
+    char entry[THINGSPEAK_BULK_ENTRY_MAX];
+    bool ok;
+    esp_err_t err = https_client_begin(WEB_SERVER, WEB_PORT);
+    if(err != ESP_OK) return err;
+    err = https_client_write(bulk_stream_header, strlen(bulk_stream_header));
+    if(err == ESP_OK && gzip) {
+        err = https_client_write("Content-Encoding: gzip\r\n", strlen("Content-Encoding: gzip\r\n"));
+    }
+    if(err == ESP_OK) {
+        err = https_client_write("\r\n", 2);
+    }
+    if(err != ESP_OK) return err;
+
+    s_chunk.len = 0;
+    s_chunk.error = false;
+#if UPLINK_COMPRESSION
+    if(gzip) deflate_init(&s_deflate, DEFLATE_FORMAT_GZIP, chunk_write, &s_chunk);
+#endif
+    ok = body_write(gzip, bulk_body_start, strlen(bulk_body_start));
+    for(size_t i = 0; i < count && ok; i++) {
+        int n = thingspeak_format_entry(entry, sizeof(entry), samples, i);
+        ok = body_write(gzip, entry, n);
+    }
+    ok = ok && body_write(gzip, bulk_body_end, strlen(bulk_body_end));
+#if UPLINK_COMPRESSION
+    if(gzip) ok = ok && deflate_finish(&s_deflate);
+#endif
+    ok = ok && chunk_flush(&s_chunk);
+    //last chunk
+    if(!ok || https_client_write("0\r\n\r\n", 5) != ESP_OK) {
+        //request is half sent, the connection cannot carry another one
+        https_client_close();
+        return ESP_ERR_HTTPS_SEND_FAILED;
+    }
+    return https_client_finish(status);
+}
+
+/**
+ * @brief Send whole batch with one bulk update request
+ * 
+ * Body: {"write_api_key":"...","updates":[{"delta_t":0,"field1":..},{"delta_t":2,"field1":..},...]}
+ * Body is gzip compressed while server accepts it. If server answers a gzip body with 415
+ * Unsupported Media Type (RFC 7694) or 400 Bad Request, the batch is sent again uncompressed, once.
+ * Other statuses (401 bad key, 429 rate limit, ...) do not depend on the encoding and are not resent.
+ * Compression stays off until reboot after 415, or when the uncompressed body is accepted.
+ */
+esp_err_t esp_thingspeak_bulk_post(const adc_sample_t* samples, size_t count) {
+    int status = 0;
+    esp_err_t err;
+    bool gzip = false;
+#if UPLINK_COMPRESSION
+    gzip = s_gzip_accepted;
+#endif
+    int64_t start = esp_timer_get_time();
+    user_metrics_inc(METRIC_UPLOADS_ATTEMPTED);
+    ESP_LOGI(TAG, "Bulk posting %zu samples to ThingSpeak%s", count, gzip ? " (gzip)" : "");
+    err = thingspeak_bulk_stream(samples, count, gzip, &status);
+#if UPLINK_COMPRESSION
+    if(err == ESP_OK && gzip && (status == 415 || status == 400)) {
+        ESP_LOGW(TAG, "Server refused gzip body with status %d, sending uncompressed", status);
+        int gzip_status = status;
+        err = thingspeak_bulk_stream(samples, count, false, &status);
+        if(gzip_status == 415 || (err == ESP_OK && status >= 200 && status < 300)) {
+            s_gzip_accepted = false;
+        }
+    }
+#endif
+    if(err == ESP_OK && (status < 200 || status >= 300)) {
+        ESP_LOGE(TAG, "Server responded with status %d", status);
+        err = ESP_ERR_THINGSPEAK_POST_FAILED;
+    }
+    record_upload(start, err == ESP_OK);
+    return err;
 }
+
+#else
+_Static_assert(sizeof(bulk_header_format) + 16 + sizeof(bulk_body_start) + sizeof(bulk_body_end)
+               + UPLINK_BATCH_SAMPLES * THINGSPEAK_BULK_ENTRY_MAX <= HTTP_POOL_BLOCK_SIZE,
+               "full batch does not fit in one HTTP pool block");
+
+/**
+ * @brief Send whole batch with one bulk update request
+ * 
+ * Body: {"write_api_key":"...","updates":[{"delta_t":0,"field1":..},{"delta_t":2,"field1":..},...]}
+ */
+esp_err_t esp_thingspeak_bulk_post(const adc_sample_t* samples, size_t count) {
+    size_t body_size = sizeof(bulk_body_start) + sizeof(bulk_body_end) + count * THINGSPEAK_BULK_ENTRY_MAX;
+    size_t request_size = sizeof(bulk_header_format) + 16 + body_size;
+    if(request_size > g_http_pool.block_size) {
+        ESP_LOGE(TAG, "Bulk request of %d samples does not fit in HTTP buffer", count);
+        return ESP_ERR_NO_MEM;
+    }
+    char* request = pool_alloc(&g_http_pool);
+    if(request == NULL) {
+        ESP_LOGE(TAG, "No free HTTP buffer for bulk request");
+        return ESP_ERR_NO_MEM;
+    }
+    //body is written after room reserved for header, then header is put right in front of it
+    char* body = request + sizeof(bulk_header_format) + 16;
+    size_t n = snprintf(body, body_size, "%s", bulk_body_start);
+    for(size_t i = 0; i < count; i++) {
+        n += thingspeak_format_entry(body + n, body_size - n, samples, i);
+    }
+    n += snprintf(body + n, body_size - n, "%s", bulk_body_end);
+
+    char header[sizeof(bulk_header_format) + 16];
+    int header_len = snprintf(header, sizeof(header), bulk_header_format, n);
+    char* start = body - header_len;
+    memcpy(start, header, header_len);
+
+    ESP_LOGI(TAG, "Bulk posting %d samples (%d bytes) to ThingSpeak", count, n);
+    esp_err_t err = http_client_request(WEB_SERVER, start);
+    pool_free(&g_http_pool, request);
+    return err;
+}
+#endif
+#endif
+
+/**** Uplink backend ****/
+
+static uplink_batch_t s_batch;
+static bool s_last_post_ok = true;
+
+static esp_err_t thingspeak_open(void) {
+    //connection is opened by the first request and kept alive, see https_client.h
+    return ESP_OK;
+}
+
+static esp_err_t thingspeak_enqueue(const adc_sample_t* samples, size_t count) {
+    return uplink_batch_add(&s_batch, samples, count);
+}
+
+/* Request is answered when flush returns, acked is not needed */
+static esp_err_t thingspeak_flush(int* id) {
+    esp_err_t err;
+    if(s_batch.count == 0) return ESP_OK;
+#ifdef THINGSPEAK_CHANNEL_ID
+    err = esp_thingspeak_bulk_post(s_batch.samples, s_batch.count);
+#else
+    //update API takes one entry per request => only the latest sample is sent, the rest is on SD card
+    const adc_sample_t* latest = &s_batch.samples[s_batch.count - 1];
+    field_value_t field_data = {
+        .field_val1 = latest->voltage[0],
+        .field_val2 = latest->voltage[1],
+        .field_val3 = latest->voltage[2],
+        .field_val4 = latest->voltage[3]
+    };
+    err = esp_thingspeak_post(&field_data);
+#endif
+    s_last_post_ok = (err == ESP_OK);
+    if(s_last_post_ok) {
+        *id = 0;
+        s_batch.count = 0;
+    }
+    return err;
+}
+
+static bool thingspeak_healthy(void) {
+    return s_last_post_ok;
+}
+
+const uplink_backend_t uplink_thingspeak = {
+    .name = "thingspeak",
+    .open = thingspeak_open,
+    .enqueue = thingspeak_enqueue,
+    .flush = thingspeak_flush,
+    .acked = NULL,
+    .healthy = thingspeak_healthy,
+    .send_features = NULL,          //channel fields only hold the sampled values, features stay on SD card
+#ifdef THINGSPEAK_CHANNEL_ID
+    .replay = true,
+#else
+    .replay = false,                //update API only carries the latest sample of a batch, without sequence number
+#endif
+};
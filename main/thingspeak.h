@@ -16,13 +16,35 @@
 #include "lwip/netdb.h"
 #include "lwip/dns.h"
 #include "esp_err.h"
+#include "esp_timer.h"
+#include "user_metrics.h"
+#include "uplink.h"
+#include "https_client.h"
+#include "user_deflate.h"
+#include "user_memory.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
 #define WEB_SERVER "api.thingspeak.com"
+
+//Post over TLS with a kept-alive connection (https_client.c). Comment out to use plain HTTP
+#define THINGSPEAK_USE_HTTPS
+
+#ifdef THINGSPEAK_USE_HTTPS
+#define WEB_PORT "443"
+#define THINGSPEAK_CONNECTION "keep-alive"
+#else
 #define WEB_PORT "80"
+#define THINGSPEAK_CONNECTION "close"
+#endif
 #define THINGSPEAK_API_KEY "J0YKWZFNQPENWSNR"
+//With channel ID, a batch is sent as one bulk update (JSON POST) instead of posting latest sample only
+// #define THINGSPEAK_CHANNEL_ID "0000000"
+#define THINGSPEAK_BULK_ENTRY_MAX               112         //worst case length of one JSON update entry
+//Field of a bulk update entry carrying the sample sequence number (user_seq.h), duplicates can be dropped by it
+#define THINGSPEAK_SEQ_FIELD                    "field5"
+#define THINGSPEAK_CHUNK_SIZE                   512         //size of HTTP chunks of a streamed bulk update
 
 #define ESP_ERR_THINGSPEAK_BASE 0x60000
 #define ESP_ERR_THINGSPEAK_POST_FAILED (ESP_ERR_THINGSPEAK_BASE+1)
@@ -60,6 +82,35 @@ typedef struct {
  * @return esp_err_t 
  */
 esp_err_t http_client_request(const char *web_server, const char *request_string);
-void esp_thingspeak_post(field_value_t* field_data);
+
+/**
+ * @brief Post one value of every field with update API
+ * 
+ * @param field_data value of fields
+ * @return esp_err_t result of http_client_request
+ */
+esp_err_t esp_thingspeak_post(field_value_t* field_data);
+
+#ifdef THINGSPEAK_CHANNEL_ID
+/**
+ * @brief Format update entry of samples[i] for a bulk update body
+ * 
+ * @param buf output, THINGSPEAK_BULK_ENTRY_MAX bytes are always enough
+ * @param size size of buf
+ * @param samples samples in time order
+ * @param i index of entry, entries after the first one start with ','
+ * @return int length of entry, delta_t is the number of seconds since previous entry
+ */
+int thingspeak_format_entry(char* buf, size_t size, const adc_sample_t* samples, size_t i);
+
+/**
+ * @brief Post several samples with one bulk update request
+ * 
+ * @param samples samples in time order
+ * @param count number of samples
+ * @return esp_err_t result of http_client_request, or ESP_ERR_NO_MEM
+ */
+esp_err_t esp_thingspeak_bulk_post(const adc_sample_t* samples, size_t count);
+#endif
 
 #endif
\ No newline at end of file
@@ -0,0 +1,92 @@
+/*
+ *  Header file for uplink backends
+ *  The uplink task does not know how data leaves the device, it only talks to a backend:
+ *      open    -> prepare connection (may return before the connection is up)
+ *      enqueue -> add samples to the pending batch
+ *      flush   -> send pending batch, batch is kept when sending fails. ESP_ERR_INVALID_SIZE:
+ *                 batch can never be sent and was dropped
+ *      acked   -> next batch acknowledged by the server, by the id flush gave it. NULL if the
+ *                 server has answered when flush returns
+ *      healthy -> true if backend is able to send right now
+ *      send_features -> send spectral features of one burst at once, NULL if backend cannot carry them
+ *      replay  -> true if every sample of a batch reaches the server with its sequence number, so
+ *                 samples are tracked and gaps in the uplink stream are read back from SD card
+ *                 (user_seq.h). Otherwise samples are not tracked.
+ *
+ *  A batch is acknowledged by a successful flush, or later through acked. A batch which is not
+ *  acknowledged within UPLINK_ACK_TIMEOUT_MS becomes a gap. Every sample carries its sequence
+ *  number, so a batch sent again after a lost acknowledgement can be dropped by the server.
+ *
+ *  Backends:
+ *      uplink_thingspeak   HTTP to ThingSpeak (thingspeak.c)
+ *      uplink_mqtt         batched payload over one persistent MQTT session (uplink_mqtt.c)
+ */
+
+#ifndef _UPLINK_H_
+#define _UPLINK_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "user_adc.h"
+#include "user_spectrum.h"
+
+//Backend used by the uplink task. To use MQTT, uncomment the next line
+// #define UPLINK_USE_MQTT
+
+#define UPLINK_BATCH_SAMPLES    32          //samples sent in one flush
+#define UPLINK_QUEUE_SAMPLES    64          //samples waiting between ADC task and uplink task
+#define UPLINK_FLUSH_PERIOD_MS  60000       //maximum time a sample waits before being flushed
+#ifndef UPLINK_COMPRESSION
+#define UPLINK_COMPRESSION      1           //gzip batch payloads (user_deflate.h) where the backend supports it
+#endif
+#define UPLINK_QUEUE_BURSTS     2           //spectral feature sets waiting for uplink task
+#define UPLINK_REPLAY_BATCHES   4           //gap batches read back from SD card per round of the uplink task
+#define UPLINK_INFLIGHT_BATCHES 4           //batches waiting for acknowledgement, no flush while all are in use
+#define UPLINK_ACK_TIMEOUT_MS   60000       //batch not acknowledged after this long is read back from SD card
+#define UPLINK_ACK_POLL_MS      100         //wait between checks for acknowledgements in an upload window
+
+typedef struct {
+    const char* name;
+    esp_err_t (*open)(void);
+    esp_err_t (*enqueue)(const adc_sample_t* samples, size_t count);
+    esp_err_t (*flush)(int* id);
+    bool (*acked)(int* id);
+    bool (*healthy)(void);
+    esp_err_t (*send_features)(const spectrum_burst_t* burst);
+    bool replay;
+} uplink_backend_t;
+
+/* Fixed size batch shared by backends */
+typedef struct {
+    adc_sample_t samples[UPLINK_BATCH_SAMPLES];
+    size_t count;
+} uplink_batch_t;
+
+/* Sequence numbers of a batch waiting for acknowledgement, kept by the uplink task */
+typedef struct {
+    int id;                                 //given by flush
+    int64_t flushed_us;
+    size_t count;                           //0: slot is free
+    uint32_t seq[UPLINK_BATCH_SAMPLES];
+} uplink_inflight_t;
+
+/**
+ * @brief Append samples to batch
+ * 
+ * @return esp_err_t ESP_OK, or ESP_ERR_NO_MEM if batch does not have room for all samples (nothing is added)
+ */
+static inline esp_err_t uplink_batch_add(uplink_batch_t* batch, const adc_sample_t* samples, size_t count) {
+    if(batch->count + count > UPLINK_BATCH_SAMPLES) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(&batch->samples[batch->count], samples, count * sizeof(adc_sample_t));
+    batch->count += count;
+    return ESP_OK;
+}
+
+extern const uplink_backend_t uplink_thingspeak;
+extern const uplink_backend_t uplink_mqtt;
+
+#endif
@@ -0,0 +1,269 @@
+/* Source file for MQTT uplink backend */
+#include "uplink_mqtt.h"
+
+static const char* TAG = "MQTT";
+
+static esp_mqtt_client_handle_t s_client = NULL;
+static bool s_connected = false;
+static uplink_batch_t s_batch;
+static char s_topic[48];
+static char s_features_topic[48];
+static char s_payload[MQTT_PAYLOAD_MAX];
+/* Batches published and not acknowledged yet, uplink task only */
+static struct {
+    int msg_id;                             //-1: slot is free
+    int64_t start_us;
+} s_published[UPLINK_INFLIGHT_BATCHES];
+/* Message ids of PUBACKs, written by event handler and read by uplink task */
+static portMUX_TYPE s_ack_lock = portMUX_INITIALIZER_UNLOCKED;
+static int s_acks[MQTT_ACK_QUEUE];
+static uint32_t s_ack_head;                 //next to write
+static uint32_t s_ack_count;
+#if UPLINK_COMPRESSION
+static deflate_stream_t s_deflate;
+#endif
+
+static void mqtt_event_handler(void* arg, esp_event_base_t base, int32_t event_id, void* event_data) {
+    esp_mqtt_event_handle_t event = event_data;
+    switch((esp_mqtt_event_id_t)event_id) {
+        case MQTT_EVENT_CONNECTED:
+            ESP_LOGI(TAG, "Connected to broker, session present: %d", event->session_present);
+            s_connected = true;
+            break;
+        case MQTT_EVENT_DISCONNECTED:
+            ESP_LOGW(TAG, "Disconnected from broker");
+            s_connected = false;
+            break;
+        case MQTT_EVENT_PUBLISHED:
+            //PUBACK of QoS 1 message, matched with the batch by the uplink task
+            portENTER_CRITICAL(&s_ack_lock);
+            s_acks[s_ack_head] = event->msg_id;
+            s_ack_head = (s_ack_head + 1) % MQTT_ACK_QUEUE;
+            if(s_ack_count < MQTT_ACK_QUEUE) s_ack_count++;
+            portEXIT_CRITICAL(&s_ack_lock);
+            break;
+        case MQTT_EVENT_ERROR:
+            ESP_LOGE(TAG, "MQTT error");
+            break;
+        default:
+            break;
+    }
+}
+
+/* Encoded payload is appended to s_payload, directly or through the compressor */
+typedef struct {
+    size_t len;
+    bool overflow;
+} payload_writer_t;
+
+static bool payload_append(void* ctx, const uint8_t* data, size_t len) {
+    payload_writer_t* w = ctx;
+    if(w->len + len > sizeof(s_payload)) {
+        w->overflow = true;
+        return false;
+    }
+    memcpy(s_payload + w->len, data, len);
+    w->len += len;
+    return true;
+}
+
+static bool payload_write(payload_writer_t* w, const void* data, size_t len) {
+    user_metrics_add(METRIC_UPLINK_BYTES_PLAIN, len);
+#if UPLINK_COMPRESSION
+    return deflate_write(&s_deflate, data, len);
+#else
+    return payload_append(w, data, len);
+#endif
+}
+
+/* Encode batch record by record, so only the encoded (and compressed) payload is held in full */
+static size_t mqtt_encode(const uplink_batch_t* batch) {
+    payload_writer_t w = { .len = 0, .overflow = false };
+    int64_t t0_us = batch->samples[0].timestamp_us;
+    bool ok;
+#if UPLINK_COMPRESSION
+    deflate_init(&s_deflate, DEFLATE_FORMAT_GZIP, payload_append, &w);
+#endif
+#if MQTT_PAYLOAD_BINARY
+    mqtt_batch_header_t header = {
+        .version = MQTT_BATCH_VERSION,
+        .channels = ADC_CHANNEL_NUMBER,
+        .count = batch->count,
+        .t0_ms = t0_us / 1000
+    };
+    ok = payload_write(&w, &header, sizeof(header));
+    for(size_t i = 0; i < batch->count && ok; i++) {
+        mqtt_batch_record_t record;
+        record.dt_ms = (batch->samples[i].timestamp_us - t0_us) / 1000;
+        for(int ch = 0; ch < ADC_CHANNEL_NUMBER; ch++) {
+            record.voltage[ch] = batch->samples[i].voltage[ch];
+        }
+        record.digital = batch->samples[i].digital;
+        record.seq = batch->samples[i].seq;
+        ok = payload_write(&w, &record, sizeof(record));
+    }
+#else
+    char record[MQTT_JSON_RECORD_MAX];
+    int n = snprintf(record, sizeof(record), "{\"t0\":%lld,\"s\":[", (long long)(t0_us / 1000));
+    ok = n < sizeof(record) && payload_write(&w, record, n);
+    for(size_t i = 0; i < batch->count && ok; i++) {
+        const adc_sample_t* s = &batch->samples[i];
+        n = snprintf(record, sizeof(record), "%s[%lld,%u,%u,%u,%u,%u,%u]", i ? "," : "",
+            (long long)((s->timestamp_us - t0_us) / 1000), s->voltage[0], s->voltage[1], s->voltage[2], s->voltage[3], s->digital, s->seq);
+        //n is the length the record would have, a cut record is an overflow like a full payload
+        if(n >= sizeof(record)) {
+            w.overflow = true;
+            ok = false;
+        }
+        else ok = payload_write(&w, record, n);
+    }
+    ok = ok && payload_write(&w, "]}", 2);
+#endif
+#if UPLINK_COMPRESSION
+    ok = ok && deflate_finish(&s_deflate);
+#endif
+    if(!ok || w.overflow) {
+        ESP_LOGE(TAG, "Payload does not fit in %zu bytes", sizeof(s_payload));
+        return 0;
+    }
+    user_metrics_add(METRIC_UPLINK_BYTES_SENT, w.len);
+    return w.len;
+}
+
+static esp_err_t mqtt_open(void) {
+    uint8_t mac[6];
+    static char client_id[24];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(client_id, sizeof(client_id), "logger-%02x%02x%02x%02x%02x%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    snprintf(s_topic, sizeof(s_topic), MQTT_TOPIC_PREFIX"%02x%02x%02x%02x%02x%02x/samples%s", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5],
+        UPLINK_COMPRESSION ? MQTT_TOPIC_GZIP_SUFFIX : "");
+    snprintf(s_features_topic, sizeof(s_features_topic), MQTT_TOPIC_PREFIX"%02x%02x%02x%02x%02x%02x/spectrum", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+    for(int i = 0; i < UPLINK_INFLIGHT_BATCHES; i++) {
+        s_published[i].msg_id = -1;
+    }
+    esp_mqtt_client_config_t config = {
+        .uri = MQTT_BROKER_URI,
+        .client_id = client_id,
+        .disable_clean_session = true,          //keep session so QoS 1 messages survive reconnects
+        .keepalive = MQTT_KEEPALIVE_SEC,
+    };
+    s_client = esp_mqtt_client_init(&config);
+    if(s_client == NULL) {
+        ESP_LOGE(TAG, "Cannot create MQTT client");
+        return ESP_ERR_NO_MEM;
+    }
+    esp_mqtt_client_register_event(s_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+    return esp_mqtt_client_start(s_client);
+}
+
+static esp_err_t mqtt_enqueue(const adc_sample_t* samples, size_t count) {
+    return uplink_batch_add(&s_batch, samples, count);
+}
+
+static esp_err_t mqtt_flush(int* id) {
+    if(s_batch.count == 0) return ESP_OK;
+    if(!s_connected) return ESP_ERR_INVALID_STATE;
+
+    size_t len = mqtt_encode(&s_batch);
+    if(len == 0) {
+        //batch can never be encoded, drop it instead of blocking the uplink forever
+        user_metrics_add(METRIC_UPLINK_DROPPED, s_batch.count);
+        s_batch.count = 0;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    user_metrics_inc(METRIC_UPLOADS_ATTEMPTED);
+    int64_t start = esp_timer_get_time();
+    //QoS 1 message is copied to the client outbox and resent until PUBACK => batch can be released
+    int msg_id = esp_mqtt_client_publish(s_client, s_topic, s_payload, len, MQTT_QOS, 0);
+    if(msg_id < 0) {
+        user_metrics_inc(METRIC_UPLOADS_FAILED);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Published %zu samples (%zu bytes), msg_id=%d", s_batch.count, len, msg_id);
+    //free slot, or the oldest one: its batch was given up by the uplink task
+    int slot = 0;
+    for(int i = 1; i < UPLINK_INFLIGHT_BATCHES && s_published[slot].msg_id != -1; i++) {
+        if(s_published[i].msg_id == -1 || s_published[i].start_us < s_published[slot].start_us) slot = i;
+    }
+    s_published[slot].msg_id = msg_id;
+    s_published[slot].start_us = start;
+    *id = msg_id;
+    s_batch.count = 0;
+    return ESP_OK;
+}
+
+static bool mqtt_acked(int* id) {
+    while(1) {
+        int msg_id;
+        portENTER_CRITICAL(&s_ack_lock);
+        bool empty = s_ack_count == 0;
+        if(!empty) {
+            msg_id = s_acks[(s_ack_head + MQTT_ACK_QUEUE - s_ack_count) % MQTT_ACK_QUEUE];
+            s_ack_count--;
+        }
+        portEXIT_CRITICAL(&s_ack_lock);
+        if(empty) return false;
+        //PUBACKs of features and of batches given up are not reported
+        for(int i = 0; i < UPLINK_INFLIGHT_BATCHES; i++) {
+            if(s_published[i].msg_id != msg_id) continue;
+            user_metrics_observe(METRIC_UPLOAD_LATENCY, esp_timer_get_time() - s_published[i].start_us);
+            user_metrics_inc(METRIC_UPLOADS_SUCCEEDED);
+            s_published[i].msg_id = -1;
+            *id = msg_id;
+            return true;
+        }
+    }
+}
+
+static bool mqtt_healthy(void) {
+    return s_connected;
+}
+
+/* Features are small and sent as plain JSON, one message per burst */
+static esp_err_t mqtt_send_features(const spectrum_burst_t* burst) {
+    static char payload[MQTT_FEATURES_MAX];
+    size_t len;
+    int n;
+    if(!s_connected) return ESP_ERR_INVALID_STATE;
+
+    n = snprintf(payload, sizeof(payload), "{\"t\":%lld,\"fs\":%.1f,\"n\":%u,\"ch\":[",
+        (long long)(burst->timestamp_us / 1000), burst->sample_rate_hz, burst->points);
+    len = n;
+    for(int ch = 0, first = 1; ch < SPECTRUM_CHANNELS && len < sizeof(payload); ch++) {
+        const spectrum_features_t* f = &burst->channel[ch];
+        if(!(burst->channel_mask & (1 << ch))) continue;
+        n = snprintf(payload + len, sizeof(payload) - len, "%s{\"i\":%d,\"mean\":%.1f,\"rms\":%.1f,\"pk\":%.1f,\"cf\":%.2f,\"peaks\":[",
+            first ? "" : ",", ch, f->mean_mv, f->rms_mv, f->peak_mv, f->crest);
+        len += n;
+        first = 0;
+        for(int p = 0; p < SPECTRUM_PEAKS && f->peaks[p].amplitude_mv > 0 && len < sizeof(payload); p++) {
+            n = snprintf(payload + len, sizeof(payload) - len, "%s[%.1f,%.1f]", p ? "," : "", f->peaks[p].freq_hz, f->peaks[p].amplitude_mv);
+            len += n;
+        }
+        if(len < sizeof(payload)) {
+            len += snprintf(payload + len, sizeof(payload) - len, "]}");
+        }
+    }
+    if(len < sizeof(payload)) {
+        len += snprintf(payload + len, sizeof(payload) - len, "]}");
+    }
+    if(len >= sizeof(payload)) {
+        ESP_LOGE(TAG, "Features do not fit in %zu bytes", sizeof(payload));
+        return ESP_ERR_NO_MEM;
+    }
+    user_metrics_add(METRIC_UPLINK_BYTES_PLAIN, len);
+    user_metrics_add(METRIC_UPLINK_BYTES_SENT, len);
+    return esp_mqtt_client_publish(s_client, s_features_topic, payload, len, MQTT_QOS, 0) < 0 ? ESP_FAIL : ESP_OK;
+}
+
+const uplink_backend_t uplink_mqtt = {
+    .name = "mqtt",
+    .open = mqtt_open,
+    .enqueue = mqtt_enqueue,
+    .flush = mqtt_flush,
+    .acked = mqtt_acked,
+    .healthy = mqtt_healthy,
+    .send_features = mqtt_send_features,
+    .replay = true,                 //QoS 1 outbox delivers every published batch
+};
@@ -0,0 +1,67 @@
+/*
+ *  Header file for MQTT uplink backend
+ *  Samples are published in batches over one persistent session (clean session disabled)
+ *  with QoS 1, so the broker keeps the session and unacknowledged batches are resent
+ *  by the client after reconnect.
+ *
+ *  Payload is compact JSON by default:
+ *      {"t0":<ms since boot of first sample>,"s":[[<dt ms>,<mV ch0>,<mV ch1>,<mV ch2>,<mV ch3>,<digital>,<seq>],...]}
+ *  or, with MQTT_PAYLOAD_BINARY set to 1, little endian binary:
+ *      mqtt_batch_header_t followed by count * mqtt_batch_record_t
+ *
+ *  seq is the sample sequence number (user_seq.h): a batch read back from SD card after an outage
+ *  has smaller numbers than the batches before it, and a batch may arrive twice.
+ *
+ *  MQTT 3.1.1 has no content encoding, so with UPLINK_COMPRESSION the payload is a gzip
+ *  member and the topic gets MQTT_TOPIC_GZIP_SUFFIX.
+ *
+ *  A batch is acknowledged by the PUBACK of its message. Message ids of PUBACKs are queued by the
+ *  event handler and taken by the uplink task (acked), so several batches may be in flight.
+ */
+
+#ifndef _UPLINK_MQTT_H_
+#define _UPLINK_MQTT_H_
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "mqtt_client.h"
+#include "uplink.h"
+#include "user_metrics.h"
+#include "user_deflate.h"
+
+#define MQTT_BROKER_URI         "mqtt://192.168.1.10:1883"
+#define MQTT_TOPIC_PREFIX       "datalogger/"       //full topic is prefix + MAC address + "/samples" or "/spectrum"
+#define MQTT_TOPIC_GZIP_SUFFIX  ".gz"
+#define MQTT_QOS                1
+#define MQTT_KEEPALIVE_SEC      120
+#define MQTT_ACK_QUEUE          8           //PUBACKs waiting for the uplink task, oldest are dropped
+#ifndef MQTT_PAYLOAD_BINARY
+#define MQTT_PAYLOAD_BINARY     0
+#endif
+
+#define MQTT_BATCH_VERSION      2           //2: records carry seq
+
+typedef struct __attribute__((packed)) {
+    uint8_t version;                //MQTT_BATCH_VERSION
+    uint8_t channels;               //number of analog channels in every record
+    uint16_t count;                 //number of records
+    int64_t t0_ms;                  //time of first sample, ms since boot
+} mqtt_batch_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t dt_ms;                 //time since first sample of batch
+    uint16_t voltage[ADC_CHANNEL_NUMBER];
+    uint8_t digital;
+    uint32_t seq;
+} mqtt_batch_record_t;
+
+//size of one encoded sample: worst case JSON record or binary record
+#define MQTT_JSON_RECORD_MAX    64
+#define MQTT_PAYLOAD_MAX        (32 + UPLINK_BATCH_SAMPLES * MQTT_JSON_RECORD_MAX)
+#define MQTT_FEATURES_MAX       (48 + SPECTRUM_CHANNELS * (80 + SPECTRUM_PEAKS * 24))     //JSON of one burst
+
+#endif
@@ -46,6 +46,59 @@ void user_adc_init(esp_adc_cal_characteristics_t* characteristic) {
     user_adc_print_val_type(val_type);
 }
 
+uint32_t user_adc_read(const adc_channel_config_t* config, const esp_adc_cal_characteristics_t* characteristic) {
+    uint16_t raw[ADC_OVERSAMPLE_MAX];
+    size_t count = config->samples;
+    if(count < 1) count = 1;
+    if(count > ADC_OVERSAMPLE_MAX) count = ADC_OVERSAMPLE_MAX;
+    for(size_t i = 0; i < count; i++) {
+        raw[i] = adc1_get_raw(config->channel);
+    }
+    return esp_adc_cal_raw_to_voltage(user_adc_filter(raw, count, config->filter, config->trim), characteristic);
+}
+
+uint32_t user_adc_filter(uint16_t* raw, size_t count, adc_filter_t filter, uint8_t trim) {
+    size_t first = 0, last = count;
+    uint32_t sum = 0;
+    if(count == 1) return raw[0];
+    if(filter != ADC_FILTER_MEAN) {
+        //insertion sort, count is at most ADC_OVERSAMPLE_MAX
+        for(size_t i = 1; i < count; i++) {
+            uint16_t v = raw[i];
+            size_t j = i;
+            for(; j > 0 && raw[j - 1] > v; j--) raw[j] = raw[j - 1];
+            raw[j] = v;
+        }
+    }
+    if(filter == ADC_FILTER_MEDIAN) {
+        first = (count - 1) / 2;
+        last = count / 2 + 1;
+    }
+    else if(filter == ADC_FILTER_TRIMMED_MEAN) {
+        if(trim > (count - 1) / 2) trim = (count - 1) / 2;
+        first = trim;
+        last = count - trim;
+    }
+    for(size_t i = first; i < last; i++) sum += raw[i];
+    return (sum + (last - first) / 2) / (last - first);
+}
+
+float user_adc_burst(adc1_channel_t channel, const esp_adc_cal_characteristics_t* characteristic,
+                     float* out_mv, size_t count, uint32_t rate_hz) {
+    int64_t interval_us = 1000000 / rate_hz;
+    int64_t first = esp_timer_get_time();
+    int64_t next = first, now = first;
+    for(size_t i = 0; i < count; i++) {
+        //busy wait: one sample is shorter than a tick, vTaskDelay cannot be used
+        while((now = esp_timer_get_time()) < next);
+        if(i == 0) first = now;
+        out_mv[i] = esp_adc_cal_raw_to_voltage(adc1_get_raw(channel), characteristic);
+        next += interval_us;
+    }
+    //count samples span count - 1 intervals
+    return count > 1 && now > first ? (float)(count - 1) * 1000000 / (now - first) : rate_hz;
+}
+
 void user_digital_input_init(void) {
     gpio_pad_select_gpio(DIGITAL_CHAN_0);
     gpio_pad_select_gpio(DIGITAL_CHAN_1);
@@ -16,6 +16,7 @@
 #include "driver/adc.h"
 #include "esp_adc_cal.h"
 #include "driver/gpio.h"
+#include "esp_timer.h"
 
 #define VREF 1100
 
@@ -29,10 +30,89 @@
 #define DIGITAL_CHAN_2 19
 #define DIGITAL_CHAN_3 18
 
+#define ADC_CHANNEL_NUMBER      4
+
+/*
+ *  Oversampling of the periodic samples: every channel is read several times back to back and the
+ *  raw codes are reduced to one before the single calibration to mV, so the occasional spikes of the
+ *  ESP32 ADC are rejected without a calibration per read. The setting of each channel is part of the
+ *  channel table (adc_channel_config_t).
+ */
+#define ADC_OVERSAMPLE_MAX      16          //reads per channel and sample at most
+#ifndef ADC_OVERSAMPLE
+#define ADC_OVERSAMPLE          8           //reads per channel of the default table, 1 = single read
+#endif
+
+typedef enum {
+    ADC_FILTER_MEAN = 0,                    //mean of every read
+    ADC_FILTER_MEDIAN,                      //middle read, mean of the two middle ones for even count
+    ADC_FILTER_TRIMMED_MEAN,                //mean after dropping trim reads at each end
+} adc_filter_t;
+
+typedef struct {
+    adc1_channel_t channel;
+    uint8_t samples;                        //reads per sample, 1 .. ADC_OVERSAMPLE_MAX
+    adc_filter_t filter;
+    uint8_t trim;                           //ADC_FILTER_TRIMMED_MEAN only, less than half of samples
+} adc_channel_config_t;
+
+/* Burst capture used for spectral features (user_spectrum.h) */
+#define ADC_BURST_RATE_HZ       4000        //per channel, channels are captured one after another
+#define ADC_BURST_POINTS        256         //power of 2, at most SPECTRUM_MAX_POINTS
+#define ADC_BURST_PERIOD_MS     60000
+#define ADC_BURST_CHANNEL_MASK  0x0F        //bit n: capture bursts of channel n
+
+/* One reading of every analog and digital channel */
+typedef struct {
+    int64_t timestamp_us;                       //esp_timer time when sample is read
+    uint32_t voltage[ADC_CHANNEL_NUMBER];       //mV
+    uint8_t digital;                            //bit 0: channel 0 ...
+    uint8_t flags;                              //SAMPLE_FLAG_xxx
+    uint32_t period_ms;                         //sampling period in effect until next sample
+    uint32_t seq;                               //sequence number, see user_seq.h
+} adc_sample_t;
+
+#define SAMPLE_FLAG_EVENT       0x01            //sample triggered a rule, send without waiting for batch
+#define SAMPLE_FLAG_RATE_CHANGE 0x02            //period_ms differs from previous sample
+#define SAMPLE_FLAG_SUPPRESSED  0x04            //no rule requires a report, sample is only written to SD card
+
 void user_adc_check_efuse(void);
 void user_adc_print_val_type(esp_adc_cal_value_t val_type);
 void user_adc_init(esp_adc_cal_characteristics_t* characteristic);
 
+/**
+ * @brief Read one channel as set in config, ADC must be initialized by user_adc_init
+ * 
+ * @param config channel and oversampling, samples and trim out of range are clamped
+ * @param characteristic calibration used to convert the reduced raw value
+ * @return uint32_t voltage, mV
+ */
+uint32_t user_adc_read(const adc_channel_config_t* config, const esp_adc_cal_characteristics_t* characteristic);
+
+/**
+ * @brief Reduce raw reads to one raw value, integer math only
+ * 
+ * @param raw count reads, sorted in place for median and trimmed mean
+ * @param count number of reads, at least 1
+ * @param filter reduction
+ * @param trim reads dropped at each end by ADC_FILTER_TRIMMED_MEAN, clamped to (count - 1) / 2
+ * @return uint32_t reduced raw value, rounded
+ */
+uint32_t user_adc_filter(uint16_t* raw, size_t count, adc_filter_t filter, uint8_t trim);
+
+/**
+ * @brief Read count samples of one channel at a fixed rate, ADC must be initialized by user_adc_init
+ * 
+ * @param channel ADC1 channel
+ * @param characteristic calibration used to convert raw values
+ * @param out_mv buffer of count values, mV
+ * @param count number of samples
+ * @param rate_hz requested rate
+ * @return float rate actually achieved, Hz (task may be preempted during burst)
+ */
+float user_adc_burst(adc1_channel_t channel, const esp_adc_cal_characteristics_t* characteristic,
+                     float* out_mv, size_t count, uint32_t rate_hz);
+
 void user_digital_input_init(void);
 uint8_t user_read_digital_channel(void);
 
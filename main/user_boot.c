@@ -0,0 +1,84 @@
+/* Source file for boot orchestration */
+#include "user_boot.h"
+#include "user_memory.h"
+
+static const char* TAG = "Boot";
+
+static EventGroupHandle_t s_boot_events;
+USER_EVENT_GROUP_DEFINE(s_boot_events);
+static int64_t s_phase_us[BOOT_PHASE_NUMBER];
+
+static const char* s_phase_name[BOOT_PHASE_NUMBER] = {
+    "sampling start",
+    "first sample",
+    "sd ready",
+    "wifi ready",
+};
+
+static const user_gauge_t s_phase_metric[BOOT_PHASE_NUMBER] = {
+    METRIC_BOOT_SAMPLING_START_MS,
+    METRIC_BOOT_FIRST_SAMPLE_MS,
+    METRIC_BOOT_SD_READY_MS,
+    METRIC_BOOT_WIFI_READY_MS,
+};
+
+static void print_boot_timing(void) {
+    for(int i = 0; i < BOOT_PHASE_NUMBER; i++) {
+        ESP_LOGI(TAG, "%-16s %lld ms", s_phase_name[i], (long long)(s_phase_us[i] / 1000));
+    }
+}
+
+static void on_got_ip(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
+    user_boot_set_ready(BOOT_WIFI_READY_BIT);
+}
+
+esp_err_t user_boot_init(void) {
+    s_boot_events = USER_EVENT_GROUP_CREATE(s_boot_events);
+    if(s_boot_events == NULL) {
+        ESP_LOGE(TAG, "There is not enough heap memory for Event Group");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t user_boot_net_init(void) {
+    esp_err_t err = esp_netif_init();
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot initialize netif: %s", esp_err_to_name(err));
+        return err;
+    }
+    err = esp_event_loop_create_default();
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot create default event loop: %s", esp_err_to_name(err));
+        return err;
+    }
+    return esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &on_got_ip, NULL);
+}
+
+void user_boot_mark(boot_phase_t phase) {
+    if(s_phase_us[phase] != 0) return;
+    s_phase_us[phase] = esp_timer_get_time();
+    user_metrics_set(s_phase_metric[phase], s_phase_us[phase] / 1000);
+}
+
+void user_boot_set_ready(EventBits_t bit) {
+    if(bit & BOOT_SD_READY_BIT) user_boot_mark(BOOT_PHASE_SD_READY);
+    if(bit & BOOT_WIFI_READY_BIT) user_boot_mark(BOOT_PHASE_WIFI_READY);
+    EventBits_t prev = xEventGroupGetBits(s_boot_events);
+    xEventGroupSetBits(s_boot_events, bit);
+    if((prev & BOOT_ALL_READY_BITS) != BOOT_ALL_READY_BITS && ((prev | bit) & BOOT_ALL_READY_BITS) == BOOT_ALL_READY_BITS) {
+        print_boot_timing();
+    }
+}
+
+void user_boot_clear_ready(EventBits_t bit) {
+    xEventGroupClearBits(s_boot_events, bit);
+}
+
+bool user_boot_is_ready(EventBits_t bits) {
+    return (xEventGroupGetBits(s_boot_events) & bits) == bits;
+}
+
+bool user_boot_wait(EventBits_t bits, TickType_t ticks_to_wait) {
+    return (xEventGroupWaitBits(s_boot_events, bits, pdFALSE, pdTRUE, ticks_to_wait) & bits) == bits;
+}
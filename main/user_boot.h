@@ -0,0 +1,87 @@
+/*
+ *  Header file for boot orchestration
+ *  Sampling starts first and buffers into RAM, SD card mount and Wi-Fi are brought up
+ *  in parallel by their own tasks. Every sink waits for its ready bit and drains the
+ *  RAM buffer once it is ready.
+ *
+ *  Time of every boot phase (since app start) is kept so time-to-first-sample can be
+ *  tracked, it is printed once all phases are done and exported as metrics.
+ */
+
+#ifndef _USER_BOOT_H_
+#define _USER_BOOT_H_
+
+#include <stdio.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "user_metrics.h"
+
+#define BOOT_SD_READY_BIT       BIT0
+#define BOOT_WIFI_READY_BIT     BIT1
+#define BOOT_ALL_READY_BITS     (BOOT_SD_READY_BIT | BOOT_WIFI_READY_BIT)
+
+#define BOOT_SD_RETRY_MS        5000        //delay between two SD mount attempts
+#define BOOT_BUFFER_SAMPLES     128         //samples kept in RAM while SD card is not mounted
+
+typedef enum {
+    BOOT_PHASE_SAMPLING_START = 0,          //ADC and timer are initialized
+    BOOT_PHASE_FIRST_SAMPLE,                //first sample has been read
+    BOOT_PHASE_SD_READY,                    //SD card is mounted
+    BOOT_PHASE_WIFI_READY,                  //IP address is received
+    BOOT_PHASE_NUMBER
+} boot_phase_t;
+
+/**
+ * @brief Create boot event group
+ * 
+ * @note Must be called before any other function of this module. Handler for IP event
+ * is registered by user_boot_net_init because default event loop is created there.
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NO_MEM if event group cannot be created
+ */
+esp_err_t user_boot_init(void);
+
+/**
+ * @brief Initialize netif and default event loop, and register the Wi-Fi ready handler
+ * 
+ * @return esp_err_t ESP_OK on success, otherwise error of the failing step (logged)
+ */
+esp_err_t user_boot_net_init(void);
+
+/**
+ * @brief Record time of a boot phase, only the first call for each phase is kept
+ */
+void user_boot_mark(boot_phase_t phase);
+
+/**
+ * @brief Mark a sink as ready, record its boot phase and wake tasks waiting for it
+ * 
+ * @param bit BOOT_SD_READY_BIT or BOOT_WIFI_READY_BIT
+ */
+void user_boot_set_ready(EventBits_t bit);
+
+/**
+ * @brief Mark a sink as not ready, e.g. Wi-Fi switched off between upload windows
+ */
+void user_boot_clear_ready(EventBits_t bit);
+
+/**
+ * @brief Check without blocking whether all given sinks are ready
+ */
+bool user_boot_is_ready(EventBits_t bits);
+
+/**
+ * @brief Block until all given sinks are ready
+ * 
+ * @param bits ready bits to wait for
+ * @param ticks_to_wait maximum waiting time
+ * @return true if all bits are set
+ */
+bool user_boot_wait(EventBits_t bits, TickType_t ticks_to_wait);
+
+#endif
@@ -0,0 +1,83 @@
+/* Source file for sample bus */
+#include "user_bus.h"
+
+static const char* TAG = "Bus";
+
+POOL_DEFINE(g_bus_pool, sizeof(bus_batch_t), BUS_POOL_BLOCKS);
+
+static bus_subscriber_t* s_subscribers[BUS_MAX_SUBSCRIBERS];
+static atomic_uint_least32_t s_subscriber_count;
+
+esp_err_t bus_subscribe(bus_subscriber_t* sub) {
+    uint32_t n = atomic_load(&s_subscriber_count);
+    if(sub->depth == 0 || sub->depth > BUS_MAX_DEPTH) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if(n >= BUS_MAX_SUBSCRIBERS) {
+        ESP_LOGE(TAG, "Too many subscribers, %s is not registered", sub->name);
+        return ESP_ERR_NO_MEM;
+    }
+#ifdef USE_STATIC_ALLOCATION
+    sub->queue = xQueueCreateStatic(sub->depth, sizeof(bus_batch_t*), sub->queue_storage, &sub->queue_struct);
+#else
+    sub->queue = xQueueCreate(sub->depth, sizeof(bus_batch_t*));
+#endif
+    if(sub->queue == NULL) {
+        ESP_LOGE(TAG, "There is not enough heap memory for Queue");
+        return ESP_ERR_NO_MEM;
+    }
+    //entry is written before count is raised, so publisher never sees a half registered subscriber
+    s_subscribers[n] = sub;
+    atomic_store(&s_subscriber_count, n + 1);
+    return ESP_OK;
+}
+
+bus_batch_t* bus_batch_alloc(void) {
+    bus_batch_t* batch = pool_alloc(&g_bus_pool);
+    if(batch != NULL) {
+        atomic_init(&batch->refs, 1);
+        batch->count = 0;
+    }
+    return batch;
+}
+
+void bus_publish(bus_batch_t* batch) {
+    uint32_t n = atomic_load(&s_subscriber_count);
+    bus_batch_t* old;
+    batch->published_us = esp_timer_get_time();
+    for(uint32_t i = 0; i < n; i++) {
+        bus_subscriber_t* sub = s_subscribers[i];
+        atomic_fetch_add_explicit(&batch->refs, 1, memory_order_relaxed);
+        if(xQueueSend(sub->queue, &batch, 0) == pdTRUE) {
+            user_metrics_set_max(sub->depth_metric, uxQueueMessagesWaiting(sub->queue));
+            continue;
+        }
+        user_metrics_set_max(sub->depth_metric, sub->depth);
+        if(sub->policy == BUS_DROP_OLDEST && xQueueReceive(sub->queue, &old, 0) == pdTRUE) {
+            user_metrics_add(sub->drop_metric, old->count);
+            bus_release(old);
+            //subscriber may have taken a batch meanwhile, either way there is room now
+            if(xQueueSend(sub->queue, &batch, 0) == pdTRUE) {
+                continue;
+            }
+        }
+        user_metrics_add(sub->drop_metric, batch->count);
+        bus_release(batch);
+    }
+    bus_release(batch);             //reference of publisher
+}
+
+bus_batch_t* bus_receive(bus_subscriber_t* sub, TickType_t ticks_to_wait) {
+    bus_batch_t* batch;
+    if(xQueueReceive(sub->queue, &batch, ticks_to_wait) != pdTRUE) {
+        return NULL;
+    }
+    user_metrics_observe(sub->wait_metric, esp_timer_get_time() - batch->published_us);
+    return batch;
+}
+
+void bus_release(bus_batch_t* batch) {
+    if(atomic_fetch_sub_explicit(&batch->refs, 1, memory_order_acq_rel) == 1) {
+        pool_free(&g_bus_pool, batch);
+    }
+}
@@ -0,0 +1,99 @@
+/*
+ *  Header file for sample bus
+ *  Condition stage fills a pooled batch of samples once and publishes it, every subscriber
+ *  gets a pointer to the same batch instead of a copy:
+ *
+ *      condition task --bus_publish--> [sd subscriber queue]     --> sd task     --bus_release
+ *                                  \-> [uplink subscriber queue] --> uplink task --bus_release
+ *
+ *  A batch is reference counted, it goes back to g_bus_pool when the last subscriber releases it.
+ *  Each subscriber has its own queue (its cursor in the stream) and drop policy, so a slow
+ *  subscriber only loses its own batches and never blocks the publisher or other subscribers.
+ *
+ *  Every published batch is held by at most depth + 1 batches per subscriber (queue + one being
+ *  processed), BUS_POOL_BLOCKS must cover that for all subscribers plus the batch being filled.
+ */
+
+#ifndef _USER_BUS_H_
+#define _USER_BUS_H_
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "user_adc.h"
+#include "user_pool.h"
+#include "user_memory.h"
+#include "user_metrics.h"
+
+#define BUS_BATCH_SAMPLES       8           //samples in one published batch
+#define BUS_BATCH_MAX_AGE_MS    15000       //batch is published when its first sample is this old, even if not full
+#define BUS_MAX_SUBSCRIBERS     4
+#define BUS_MAX_DEPTH           16          //largest subscriber queue, batches
+#define BUS_POOL_BLOCKS         28
+
+typedef enum {
+    BUS_DROP_OLDEST = 0,        //full queue => oldest queued batch is released to make room
+    BUS_DROP_NEWEST,            //full queue => new batch is not delivered to this subscriber
+} bus_drop_policy_t;
+
+typedef struct {
+    atomic_uint_least32_t refs;
+    int64_t published_us;           //esp_timer time of bus_publish, used for wait metrics
+    uint32_t count;
+    adc_sample_t samples[BUS_BATCH_SAMPLES];
+} bus_batch_t;
+
+/* Subscriber, filled by caller and kept alive for the whole run (static) */
+typedef struct {
+    const char* name;
+    uint32_t depth;                 //queued batches, at most BUS_MAX_DEPTH
+    bus_drop_policy_t policy;
+    user_counter_t drop_metric;     //counts samples of batches dropped for this subscriber
+    user_summary_t wait_metric;     //time a batch waited in the queue
+    user_gauge_t depth_metric;      //high-water mark of the queue
+    QueueHandle_t queue;
+#ifdef USE_STATIC_ALLOCATION
+    StaticQueue_t queue_struct;
+    uint8_t queue_storage[BUS_MAX_DEPTH * sizeof(bus_batch_t*)];
+#endif
+} bus_subscriber_t;
+
+extern user_pool_t g_bus_pool;
+
+/**
+ * @brief Register subscriber, must be done before first batch is published
+ * 
+ * @return esp_err_t ESP_OK, ESP_ERR_INVALID_ARG if depth is too large,
+ *         ESP_ERR_NO_MEM if there are too many subscribers or queue cannot be created
+ */
+esp_err_t bus_subscribe(bus_subscriber_t* sub);
+
+/**
+ * @brief Take an empty batch for filling, caller owns one reference
+ * 
+ * @return bus_batch_t* NULL if every batch is held by subscribers
+ */
+bus_batch_t* bus_batch_alloc(void);
+
+/**
+ * @brief Deliver batch to every subscriber, reference of caller is handed over
+ */
+void bus_publish(bus_batch_t* batch);
+
+/**
+ * @brief Wait for next batch of subscriber, must be given back with bus_release
+ * 
+ * @return bus_batch_t* NULL on timeout
+ */
+bus_batch_t* bus_receive(bus_subscriber_t* sub, TickType_t ticks_to_wait);
+
+/**
+ * @brief Drop one reference, batch returns to pool with the last one
+ */
+void bus_release(bus_batch_t* batch);
+
+#endif
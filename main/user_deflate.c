@@ -0,0 +1,198 @@
+/* Source file for streaming deflate/gzip compressor */
+#include "user_deflate.h"
+
+/* Base value and extra bits of length codes 257..285 and distance codes 0..29 (RFC 1951 3.2.5) */
+static const uint16_t s_len_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t s_len_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t s_dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t s_dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+uint32_t deflate_crc32(uint32_t crc, const uint8_t* data, size_t len) {
+    //nibble table: 64 bytes of flash instead of 1 KB for the byte table
+    static const uint32_t table[16] = {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+    };
+    crc = ~crc;
+    while(len--) {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ table[crc & 0x0f];
+        crc = (crc >> 4) ^ table[crc & 0x0f];
+    }
+    return ~crc;
+}
+
+static void flush_out(deflate_stream_t* s) {
+    if(s->out_len > 0 && !s->error) {
+        if(!s->write(s->ctx, s->out, s->out_len)) s->error = true;
+    }
+    s->out_len = 0;
+}
+
+static inline void put_byte(deflate_stream_t* s, uint8_t b) {
+    s->out[s->out_len++] = b;
+    if(s->out_len == DEFLATE_OUT_SIZE) flush_out(s);
+}
+
+/* Bits are packed starting from the least significant bit (RFC 1951 3.1.1) */
+static inline void put_bits(deflate_stream_t* s, uint32_t value, int count) {
+    s->bit_buf |= value << s->bit_count;
+    s->bit_count += count;
+    while(s->bit_count >= 8) {
+        put_byte(s, s->bit_buf & 0xff);
+        s->bit_buf >>= 8;
+        s->bit_count -= 8;
+    }
+}
+
+/* Huffman codes are sent most significant bit first => reverse before put_bits */
+static inline uint32_t reverse_bits(uint32_t code, int count) {
+    uint32_t r = 0;
+    while(count--) {
+        r = (r << 1) | (code & 1);
+        code >>= 1;
+    }
+    return r;
+}
+
+/* Fixed Huffman code of literal/length symbol (RFC 1951 3.2.6) */
+static void put_symbol(deflate_stream_t* s, int sym) {
+    if(sym < 144)       put_bits(s, reverse_bits(0x30 + sym, 8), 8);
+    else if(sym < 256)  put_bits(s, reverse_bits(0x190 + sym - 144, 9), 9);
+    else if(sym < 280)  put_bits(s, reverse_bits(sym - 256, 7), 7);
+    else                put_bits(s, reverse_bits(0xc0 + sym - 280, 8), 8);
+}
+
+static void put_match(deflate_stream_t* s, int len, int dist) {
+    int code = 0;
+    while(code < 28 && s_len_base[code + 1] <= len) code++;
+    put_symbol(s, 257 + code);
+    if(s_len_extra[code]) put_bits(s, len - s_len_base[code], s_len_extra[code]);
+
+    code = 0;
+    while(code < 29 && s_dist_base[code + 1] <= dist) code++;
+    put_bits(s, reverse_bits(code, 5), 5);
+    if(s_dist_extra[code]) put_bits(s, dist - s_dist_base[code], s_dist_extra[code]);
+}
+
+static inline uint32_t hash3(const uint8_t* p) {
+    return ((p[0] << 10) ^ (p[1] << 5) ^ p[2]) & (DEFLATE_HASH_SIZE - 1);
+}
+
+static void insert_hash(deflate_stream_t* s, uint32_t pos) {
+    uint32_t h = hash3(&s->buf[pos - s->base]);
+    s->prev[pos & (DEFLATE_WINDOW_SIZE - 1)] = s->head[h];
+    s->head[h] = pos + 1;
+}
+
+/* Encode buffered input, keep DEFLATE_MAX_MATCH bytes of lookahead unless finishing */
+static void compress_block(deflate_stream_t* s, bool finish) {
+    uint32_t limit = finish ? s->end : (s->end > DEFLATE_MAX_MATCH ? s->end - DEFLATE_MAX_MATCH : 0);
+    while(s->pos < limit) {
+        uint32_t avail = s->end - s->pos;
+        int best_len = 0;
+        uint32_t best_dist = 0;
+        if(avail >= DEFLATE_MIN_MATCH) {
+            const uint8_t* cur = &s->buf[s->pos - s->base];
+            uint32_t max_len = avail < DEFLATE_MAX_MATCH ? avail : DEFLATE_MAX_MATCH;
+            uint32_t cand = s->head[hash3(cur)];
+            for(int chain = 0; cand != 0 && chain < DEFLATE_MAX_CHAIN; chain++) {
+                uint32_t cpos = cand - 1;
+                //candidate must still be in buffer and inside the window
+                if(cpos < s->base || s->pos - cpos > DEFLATE_WINDOW_SIZE) break;
+                const uint8_t* p = &s->buf[cpos - s->base];
+                uint32_t len = 0;
+                while(len < max_len && p[len] == cur[len]) len++;
+                if((int)len > best_len) {
+                    best_len = len;
+                    best_dist = s->pos - cpos;
+                    if(len == max_len) break;
+                }
+                uint32_t next = s->prev[cpos & (DEFLATE_WINDOW_SIZE - 1)];
+                if(next >= cand) break;                 //entry was overwritten by a newer position
+                cand = next;
+            }
+        }
+        if(best_len >= DEFLATE_MIN_MATCH) {
+            put_match(s, best_len, best_dist);
+            for(int i = 0; i < best_len; i++) {
+                if(s->end - (s->pos + i) >= DEFLATE_MIN_MATCH) insert_hash(s, s->pos + i);
+            }
+            s->pos += best_len;
+        }
+        else {
+            put_symbol(s, s->buf[s->pos - s->base]);
+            if(avail >= DEFLATE_MIN_MATCH) insert_hash(s, s->pos);
+            s->pos++;
+        }
+    }
+}
+
+void deflate_init(deflate_stream_t* s, deflate_format_t format, deflate_write_cb write, void* ctx) {
+    memset(s->head, 0, sizeof(s->head));
+    s->base = s->pos = s->end = 0;
+    s->bit_buf = 0;
+    s->bit_count = 0;
+    s->out_len = 0;
+    s->crc = 0;
+    s->format = format;
+    s->write = write;
+    s->ctx = ctx;
+    s->error = false;
+    if(format == DEFLATE_FORMAT_GZIP) {
+        //magic, CM = deflate, no flags, no mtime, XFL = 0, OS = unknown
+        static const uint8_t header[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff};
+        for(int i = 0; i < 10; i++) put_byte(s, header[i]);
+    }
+    //whole stream is sent as fixed Huffman blocks, the last (empty) one is added by deflate_finish
+    put_bits(s, 0, 1);              //BFINAL = 0
+    put_bits(s, 1, 2);              //BTYPE = 01, fixed Huffman
+}
+
+bool deflate_write(deflate_stream_t* s, const void* data, size_t len) {
+    const uint8_t* in = data;
+    if(s->format == DEFLATE_FORMAT_GZIP) s->crc = deflate_crc32(s->crc, in, len);
+    while(len > 0 && !s->error) {
+        if(s->end - s->base == sizeof(s->buf)) {
+            //buffer is full => encode what can be encoded and drop the oldest window
+            compress_block(s, false);
+            memmove(s->buf, s->buf + DEFLATE_WINDOW_SIZE, DEFLATE_WINDOW_SIZE);
+            s->base += DEFLATE_WINDOW_SIZE;
+        }
+        size_t room = sizeof(s->buf) - (s->end - s->base);
+        size_t n = len < room ? len : room;
+        memcpy(&s->buf[s->end - s->base], in, n);
+        s->end += n;
+        in += n;
+        len -= n;
+    }
+    return !s->error;
+}
+
+bool deflate_finish(deflate_stream_t* s) {
+    compress_block(s, true);
+    put_symbol(s, 256);             //end of block
+    put_bits(s, 1, 1);              //BFINAL = 1
+    put_bits(s, 1, 2);              //BTYPE = 01
+    put_symbol(s, 256);
+    if(s->bit_count > 0) put_bits(s, 0, 8 - s->bit_count);     //align to byte
+    if(s->format == DEFLATE_FORMAT_GZIP) {
+        uint32_t size = s->end;     //ISIZE is input size modulo 2^32
+        for(int i = 0; i < 4; i++) put_byte(s, s->crc >> (8 * i));
+        for(int i = 0; i < 4; i++) put_byte(s, size >> (8 * i));
+    }
+    flush_out(s);
+    return !s->error;
+}
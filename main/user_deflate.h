@@ -0,0 +1,83 @@
+/*
+ *  Header file for streaming deflate/gzip compressor
+ *  Made for upload bodies on ESP32: small fixed window, fixed Huffman codes, no heap.
+ *  Input is fed in pieces with deflate_write, compressed output is passed to a callback
+ *  as soon as the output buffer is full => caller never holds the whole plain body nor the
+ *  whole compressed body.
+ *
+ *  RAM usage is sizeof(deflate_stream_t), about 9 KB with the default settings.
+ *  The module only depends on the C library so it can be built and checked on a host PC.
+ */
+
+#ifndef _USER_DEFLATE_H_
+#define _USER_DEFLATE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define DEFLATE_WINDOW_BITS     10                          //history window, 1 KB
+#define DEFLATE_WINDOW_SIZE     (1 << DEFLATE_WINDOW_BITS)
+#define DEFLATE_HASH_BITS       9
+#define DEFLATE_HASH_SIZE       (1 << DEFLATE_HASH_BITS)
+#define DEFLATE_MAX_CHAIN       8                           //candidates checked per position
+#define DEFLATE_MIN_MATCH       3
+#define DEFLATE_MAX_MATCH       258
+#define DEFLATE_OUT_SIZE        512                         //compressed bytes passed to callback at once
+
+typedef enum {
+    DEFLATE_FORMAT_RAW = 0,         //raw deflate stream (RFC 1951)
+    DEFLATE_FORMAT_GZIP,            //gzip member (RFC 1952), for Content-Encoding: gzip
+} deflate_format_t;
+
+/**
+ * @brief Output callback
+ * 
+ * @return true if data has been consumed, false to abort compression
+ */
+typedef bool (*deflate_write_cb)(void* ctx, const uint8_t* data, size_t len);
+
+typedef struct {
+    uint8_t buf[2 * DEFLATE_WINDOW_SIZE];   //history window followed by lookahead
+    uint32_t head[DEFLATE_HASH_SIZE];       //last stream position + 1 of every hash, 0 = none
+    uint32_t prev[DEFLATE_WINDOW_SIZE];     //previous position + 1 with same hash
+    uint32_t base;                          //stream position of buf[0]
+    uint32_t pos;                           //next stream position to encode
+    uint32_t end;                           //stream position after last byte in buf
+    uint32_t bit_buf;
+    int bit_count;
+    uint8_t out[DEFLATE_OUT_SIZE];
+    size_t out_len;
+    uint32_t crc;
+    deflate_format_t format;
+    deflate_write_cb write;
+    void* ctx;
+    bool error;
+} deflate_stream_t;
+
+/**
+ * @brief Prepare stream and emit format header
+ */
+void deflate_init(deflate_stream_t* s, deflate_format_t format, deflate_write_cb write, void* ctx);
+
+/**
+ * @brief Compress data, may be called any number of times
+ * 
+ * @return false if output callback has failed
+ */
+bool deflate_write(deflate_stream_t* s, const void* data, size_t len);
+
+/**
+ * @brief Compress remaining input, terminate stream, emit format trailer and flush output
+ * 
+ * @return false if output callback has failed
+ */
+bool deflate_finish(deflate_stream_t* s);
+
+/**
+ * @brief Update CRC-32 (IEEE 802.3, as used by gzip)
+ */
+uint32_t deflate_crc32(uint32_t crc, const uint8_t* data, size_t len);
+
+#endif
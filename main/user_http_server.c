@@ -0,0 +1,209 @@
+/* Source file for on-device HTTP server */
+#include "user_http_server.h"
+
+static const char* TAG = "HTTP Server";
+
+/*
+ *  Buffer reused by every log download. Data is streamed from card to socket one allocation unit
+ *  at a time so a file is never loaded into heap.
+ *  httpd handles requests one by one in its own task => the buffer is never used concurrently.
+ */
+static char s_chunk_buf[SD_ALLOCATION_UNIT_SIZE];
+/* Mutex of the task appending to the log files, set by user_http_server_start */
+static SemaphoreHandle_t s_log_mutex;
+
+/**
+ * @brief Parse "bytes=a-b", "bytes=a-" or "bytes=-n" Range header
+ * 
+ * @param range value of Range header
+ * @param size size of file
+ * @param start first byte to send
+ * @param end last byte to send (inclusive)
+ * @return true if range is valid and satisfiable
+ */
+static bool parse_range(const char* range, uint64_t size, uint64_t* start, uint64_t* end) {
+    char* p;
+    if(strncmp(range, "bytes=", 6) != 0) return false;
+    range += 6;
+    if(*range == '-') {
+        //suffix range: last n bytes
+        uint64_t n = strtoull(range + 1, &p, 10);
+        if(p == range + 1 || n == 0) return false;
+        *start = (n >= size) ? 0 : size - n;
+        *end = size - 1;
+    }
+    else {
+        *start = strtoull(range, &p, 10);
+        if(p == range || *p != '-') return false;
+        range = p + 1;
+        if(*range == '\0' || *range == ',') {
+            *end = size - 1;
+        }
+        else {
+            *end = strtoull(range, &p, 10);
+            if(p == range) return false;
+            if(*end >= size) *end = size - 1;
+        }
+    }
+    return (*start < size) && (*start <= *end);
+}
+
+/* Only accept plain file names in the mount point directory */
+static bool is_valid_name(const char* name) {
+    return name[0] != '\0' && strchr(name, '/') == NULL && strstr(name, "..") == NULL;
+}
+
+/* 416 with the size of the file, as required for an unsatisfiable range */
+static esp_err_t send_not_satisfiable(httpd_req_t* req, uint64_t size) {
+    char header[32];
+    snprintf(header, sizeof(header), "bytes */%llu", (unsigned long long)size);
+    httpd_resp_set_status(req, "416 Range Not Satisfiable");
+    httpd_resp_set_hdr(req, "Content-Range", header);
+    return httpd_resp_send(req, NULL, 0);
+}
+
+static esp_err_t log_get_handler(httpd_req_t* req) {
+    char query[96] = "";
+    char name[HTTP_LOG_MAX_NAME_LEN] = HTTP_LOG_DEFAULT_FILE;
+    char param[24];
+    char path[sizeof(MOUNT_POINT) + HTTP_LOG_MAX_NAME_LEN + 1];
+    char header[64];
+    uint64_t size, start, end, length;
+    bool partial = false;
+    esp_err_t err;
+
+    err = httpd_req_get_url_query_str(req, query, sizeof(query));
+    if(err == ESP_ERR_HTTPD_RESULT_TRUNC) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Query too long");
+    }
+    if(err == ESP_OK && httpd_query_key_value(query, "file", name, sizeof(name)) == ESP_ERR_HTTPD_RESULT_TRUNC) {
+        //a cut name could be another existing file
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "File name too long");
+    }
+    if(!is_valid_name(name)) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid file name");
+    }
+    snprintf(path, sizeof(path), MOUNT_POINT"/%s", name);
+
+    FILE* f = fopen(path, "rb");
+    if(f == NULL) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "File not found");
+    }
+    //a record being appended is not counted until it is complete
+    xSemaphoreTake(s_log_mutex, portMAX_DELAY);
+    size = user_file_get_size(f);
+    xSemaphoreGive(s_log_mutex);
+    start = 0;
+    end = size - 1;
+
+    //offset/length query is an alternative to the Range header for simple clients
+    if(httpd_query_key_value(query, "offset", param, sizeof(param)) == ESP_OK) {
+        start = strtoull(param, NULL, 10);
+        if(start >= size) {
+            fclose(f);
+            return send_not_satisfiable(req, size);
+        }
+        partial = true;
+    }
+    if(httpd_query_key_value(query, "length", param, sizeof(param)) == ESP_OK) {
+        length = strtoull(param, NULL, 10);
+        if(length == 0 || start >= size) {
+            fclose(f);
+            return send_not_satisfiable(req, size);
+        }
+        end = (length > size - start) ? size - 1 : start + length - 1;
+        partial = true;
+    }
+    err = httpd_req_get_hdr_value_str(req, "Range", header, sizeof(header));
+    if(err == ESP_ERR_HTTPD_RESULT_TRUNC) {
+        //a cut range would be served as another one
+        fclose(f);
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Range too long");
+    }
+    if(err == ESP_OK) {
+        if(!parse_range(header, size, &start, &end)) {
+            fclose(f);
+            return send_not_satisfiable(req, size);
+        }
+        partial = true;
+    }
+    if(size == 0) {
+        //empty file without range => empty body
+        fclose(f);
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Accept-Ranges", "bytes");
+    if(partial) {
+        snprintf(header, sizeof(header), "bytes %llu-%llu/%llu",
+            (unsigned long long)start, (unsigned long long)end, (unsigned long long)size);
+        httpd_resp_set_status(req, "206 Partial Content");
+        httpd_resp_set_hdr(req, "Content-Range", header);
+    }
+
+    ESP_LOGI(TAG, "Sending %s bytes %llu-%llu of %llu", name,
+        (unsigned long long)start, (unsigned long long)end, (unsigned long long)size);
+    user_file_move_pointer(f, start);
+    uint64_t remain = end - start + 1;
+    while(remain > 0) {
+        size_t want = remain > sizeof(s_chunk_buf) ? sizeof(s_chunk_buf) : remain;
+        //mutex only held for the read, a slow client must not block the writer
+        xSemaphoreTake(s_log_mutex, portMAX_DELAY);
+        size_t got = user_file_read_chunk(f, s_chunk_buf, want);
+        xSemaphoreGive(s_log_mutex);
+        if(got == 0) break;                 //file has been truncated while sending
+        if(httpd_resp_send_chunk(req, s_chunk_buf, got) != ESP_OK) {
+            ESP_LOGE(TAG, "Client closed connection, %llu bytes not sent", (unsigned long long)remain);
+            fclose(f);
+            return ESP_FAIL;
+        }
+        remain -= got;
+    }
+    fclose(f);
+    return httpd_resp_send_chunk(req, NULL, 0);         //terminate chunked response
+}
+
+static const httpd_uri_t log_uri = {
+    .uri = "/log",
+    .method = HTTP_GET,
+    .handler = log_get_handler,
+    .user_ctx = NULL
+};
+
+static const httpd_uri_t metrics_uri = {
+    .uri = "/metrics",
+    .method = HTTP_GET,
+    .handler = user_metrics_http_handler,
+    .user_ctx = NULL
+};
+
+static const httpd_uri_t profile_uri = {
+    .uri = "/profile",
+    .method = HTTP_GET,
+    .handler = user_profiler_http_handler,
+    .user_ctx = NULL
+};
+
+httpd_handle_t user_http_server_start(SemaphoreHandle_t log_mutex) {
+    httpd_handle_t server = NULL;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = HTTP_SERVER_PORT;
+    s_log_mutex = log_mutex;
+
+    ESP_LOGI(TAG, "Starting server on port %d", config.server_port);
+    if(httpd_start(&server, &config) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start server");
+        return NULL;
+    }
+    httpd_register_uri_handler(server, &log_uri);
+    httpd_register_uri_handler(server, &metrics_uri);
+    httpd_register_uri_handler(server, &profile_uri);
+    return server;
+}
+
+void user_http_server_stop(httpd_handle_t server) {
+    if(server != NULL) {
+        httpd_stop(server);
+    }
+}
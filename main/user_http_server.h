@@ -0,0 +1,52 @@
+/*
+ *  Header file for the on-device HTTP server
+ *  Used to pull data off a deployed unit without removing the SD card
+ *
+ *  GET /log?file=record.txt[&offset=N][&length=N]
+ *      Stream a log file from SD card. HTTP Range header (bytes=a-b, bytes=a-, bytes=-n)
+ *      is supported so interrupted downloads can be resumed. An offset at or past the end, a length
+ *      of 0 or an unsatisfiable range is answered with 416, a file name or Range header too long for the
+ *      buffer with 400. Reads take the mutex of the task appending to the file.
+ *
+ *  GET /metrics
+ *      Pipeline counters in Prometheus text format (see user_metrics.h)
+ *
+ *  GET /profile
+ *      Per-task CPU share, stack high-water marks and heap fragmentation (see user_profiler.h)
+ */
+
+#ifndef _USER_HTTP_SERVER_H_
+#define _USER_HTTP_SERVER_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include <esp_http_server.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "sd_card.h"
+#include "user_metrics.h"
+#include "user_profiler.h"
+
+#define HTTP_SERVER_PORT            80
+#define HTTP_LOG_DEFAULT_FILE       "record.txt"
+#define HTTP_LOG_MAX_NAME_LEN       32
+
+/**
+ * @brief Start HTTP server and register log endpoint
+ * 
+ * @param log_mutex mutex held by the task appending to the log files while it writes
+ * @return httpd_handle_t handle of server, NULL if server cannot be started
+ */
+httpd_handle_t user_http_server_start(SemaphoreHandle_t log_mutex);
+
+/**
+ * @brief Stop HTTP server started by user_http_server_start
+ * 
+ * @param server handle of server
+ */
+void user_http_server_stop(httpd_handle_t server);
+
+#endif
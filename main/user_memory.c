@@ -0,0 +1,74 @@
+/* Source file for memory layout of the data logger */
+#include "user_memory.h"
+#include "sd_card.h"
+#include "user_bus.h"
+#include "user_pipeline.h"
+#include "user_profiler.h"
+#include "user_spectrum.h"
+#include "user_deflate.h"
+#include "uplink.h"
+#include "uplink_mqtt.h"
+#include "user_seq.h"
+
+static const char* TAG = "Memory";
+
+POOL_DEFINE(g_http_pool, HTTP_POOL_BLOCK_SIZE, HTTP_POOL_BLOCKS);
+
+/* Footprint of every subsystem, bytes */
+#define MEM_TASK_STACKS     (ADC_TASK_STACK + CONDITION_TASK_STACK + SD_TASK_STACK + SPECTRUM_TASK_STACK + NET_BOOT_TASK_STACK \
+                             + UPLINK_TASK_STACK + PROFILER_TASK_STACK)
+#define MEM_QUEUES          (STAGE_CONDITION_QUEUE * sizeof(adc_sample_t) + UPLINK_QUEUE_BURSTS * sizeof(spectrum_burst_t) + BUS_MAX_SUBSCRIBERS * sizeof(bus_subscriber_t))
+#define MEM_SAMPLE_BUS      POOL_FOOTPRINT(sizeof(bus_batch_t), BUS_POOL_BLOCKS)
+#define MEM_UPLINK_BATCHES  (2 * sizeof(uplink_batch_t))                //one per backend
+#define MEM_MQTT_PAYLOAD    (MQTT_PAYLOAD_MAX + MQTT_FEATURES_MAX)
+#define MEM_COMPRESSION     (UPLINK_COMPRESSION ? 2 * sizeof(deflate_stream_t) : 0)
+#define MEM_HTTP_POOL       POOL_FOOTPRINT(HTTP_POOL_BLOCK_SIZE, HTTP_POOL_BLOCKS)
+#define MEM_LOG_SERVER      SD_ALLOCATION_UNIT_SIZE
+#define MEM_SPECTRUM        ((2 * ADC_BURST_POINTS + SPECTRUM_MAX_POINTS) * sizeof(float) + 2 * sizeof(spectrum_burst_t))
+#define MEM_PROFILER        (PROFILER_MAX_TASKS * (sizeof(TaskStatus_t) + 2 * sizeof(uint32_t)))
+#define MEM_SEQUENCE        (sizeof(seq_index_t) + sizeof(seq_tracker_t) + UPLINK_BATCH_SAMPLES * (sizeof(adc_sample_t) + sizeof(uint32_t)))
+
+#define MEM_TOTAL           (MEM_TASK_STACKS + MEM_QUEUES + MEM_SAMPLE_BUS + MEM_UPLINK_BATCHES + MEM_MQTT_PAYLOAD \
+                             + MEM_COMPRESSION + MEM_HTTP_POOL + MEM_LOG_SERVER + MEM_SPECTRUM + MEM_PROFILER + MEM_SEQUENCE)
+
+_Static_assert(MEM_TOTAL <= MEMORY_BUDGET_BYTES, "application memory exceeds MEMORY_BUDGET_BYTES");
+
+typedef struct {
+    const char* name;
+    size_t bytes;
+} memory_item_t;
+
+static const memory_item_t s_budget[] = {
+    {"task stacks",     MEM_TASK_STACKS},
+    {"queues",          MEM_QUEUES},
+    {"sample bus",      MEM_SAMPLE_BUS},
+    {"uplink batches",  MEM_UPLINK_BATCHES},
+    {"mqtt payload",    MEM_MQTT_PAYLOAD},
+    {"compression",     MEM_COMPRESSION},
+    {"http pool",       MEM_HTTP_POOL},
+    {"log server",      MEM_LOG_SERVER},
+    {"spectrum",        MEM_SPECTRUM},
+    {"profiler",        MEM_PROFILER},
+    {"sequence",        MEM_SEQUENCE},
+};
+
+static void user_memory_report_pool(user_pool_t* pool) {
+    ESP_LOGI(TAG, "%s: %u/%u blocks of %zu bytes free, min %u, failures %u", pool->name, pool_free_blocks(pool),
+        pool->block_count, pool->block_size, (unsigned)atomic_load(&pool->min_free), (unsigned)atomic_load(&pool->failures));
+}
+
+void user_memory_report(void) {
+#ifdef USE_STATIC_ALLOCATION
+    ESP_LOGI(TAG, "Tasks, queues and event groups: static");
+#else
+    ESP_LOGI(TAG, "Tasks, queues and event groups: heap");
+#endif
+    for(int i = 0; i < sizeof(s_budget) / sizeof(s_budget[0]); i++) {
+        ESP_LOGI(TAG, "%-16s %6zu bytes", s_budget[i].name, s_budget[i].bytes);
+    }
+    ESP_LOGI(TAG, "%-16s %6zu / %d bytes", "total", (size_t)MEM_TOTAL, MEMORY_BUDGET_BYTES);
+    user_memory_report_pool(&g_bus_pool);
+    user_memory_report_pool(&g_http_pool);
+    ESP_LOGI(TAG, "Heap free %zu bytes, largest block %zu bytes", heap_caps_get_free_size(MALLOC_CAP_8BIT),
+        heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+}
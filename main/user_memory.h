@@ -0,0 +1,94 @@
+/*
+ *  Header file for memory layout of the data logger
+ *  With USE_STATIC_ALLOCATION defined, every task stack, queue, event group and mutex created by
+ *  this application lives in static memory (xTaskCreateStaticPinnedToCore and friends), otherwise
+ *  they are taken from heap once at boot. I/O buffers which were taken from heap per request come
+ *  from fixed-block pools (user_pool.h) in both modes, so steady-state operation of application
+ *  code does no heap allocation. ESP-IDF components (Wi-Fi, lwIP, mbedTLS, MQTT) still use heap.
+ *  Deliberate exception: the buffer of user_sd_benchmark (only built with SD_RUN_BENCHMARK) is taken
+ *  from heap once at boot and freed before logging starts, so it costs no static RAM.
+ *
+ *  Footprint of every subsystem is summed at compile time and checked against MEMORY_BUDGET_BYTES,
+ *  user_memory_report() prints the same table at boot.
+ *
+ *  Usage:
+ *      USER_TASK_DEFINE(my_task, MY_TASK_STACK);                   //at file scope
+ *      USER_TASK_CREATE(my_task, "my task", MY_TASK_STACK, prio, core);
+ */
+
+#ifndef _USER_MEMORY_H_
+#define _USER_MEMORY_H_
+
+#include <stdio.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "user_pool.h"
+
+//Allocate tasks, queues and event groups statically. To take them from heap, comment the next line
+#define USE_STATIC_ALLOCATION
+
+#define MEMORY_BUDGET_BYTES     (128*1024)  //static RAM allowed for application buffers and stacks
+
+/* Stack of application tasks, bytes */
+#define ADC_TASK_STACK          4096
+#define CONDITION_TASK_STACK    4096
+#define SD_TASK_STACK           4096
+#define SPECTRUM_TASK_STACK     4096
+#define NET_BOOT_TASK_STACK     4096
+#define UPLINK_TASK_STACK       8192
+
+/* Pool of HTTP request buffers, used by the uploader */
+#define HTTP_POOL_BLOCK_SIZE    4096
+#define HTTP_POOL_BLOCKS        2
+
+#if defined(USE_STATIC_ALLOCATION) && !CONFIG_FREERTOS_SUPPORT_STATIC_ALLOCATION
+#error "USE_STATIC_ALLOCATION requires CONFIG_FREERTOS_SUPPORT_STATIC_ALLOCATION"
+#endif
+
+#ifdef USE_STATIC_ALLOCATION
+//StackType_t is one byte in ESP-IDF, so stack size is in bytes like xTaskCreate
+#define USER_TASK_DEFINE(fn, stack) \
+    static StackType_t fn##_stack[stack]; \
+    static StaticTask_t fn##_tcb
+#define USER_TASK_CREATE(fn, name, stack, prio, core) \
+    (xTaskCreateStaticPinnedToCore(&fn, name, stack, NULL, prio, fn##_stack, &fn##_tcb, core) != NULL ? pdPASS : pdFAIL)
+#define USER_QUEUE_DEFINE(q, length, item_size) \
+    static uint8_t q##_storage[(length) * (item_size)]; \
+    static StaticQueue_t q##_struct
+#define USER_QUEUE_CREATE(q, length, item_size) \
+    xQueueCreateStatic(length, item_size, q##_storage, &q##_struct)
+#define USER_EVENT_GROUP_DEFINE(e) \
+    static StaticEventGroup_t e##_struct
+#define USER_EVENT_GROUP_CREATE(e) \
+    xEventGroupCreateStatic(&e##_struct)
+#define USER_MUTEX_DEFINE(m) \
+    static StaticSemaphore_t m##_struct
+#define USER_MUTEX_CREATE(m) \
+    xSemaphoreCreateMutexStatic(&m##_struct)
+#else
+//forward declarations only, so that the macros can be followed by ';' in both modes
+#define USER_TASK_DEFINE(fn, stack)                 struct fn##_no_static_task
+#define USER_TASK_CREATE(fn, name, stack, prio, core) \
+    xTaskCreatePinnedToCore(&fn, name, stack, NULL, prio, NULL, core)
+#define USER_QUEUE_DEFINE(q, length, item_size)     struct q##_no_static_queue
+#define USER_QUEUE_CREATE(q, length, item_size)     xQueueCreate(length, item_size)
+#define USER_EVENT_GROUP_DEFINE(e)                  struct e##_no_static_event_group
+#define USER_EVENT_GROUP_CREATE(e)                  xEventGroupCreate()
+#define USER_MUTEX_DEFINE(m)                        struct m##_no_static_mutex
+#define USER_MUTEX_CREATE(m)                        xSemaphoreCreateMutex()
+#endif
+
+extern user_pool_t g_http_pool;
+
+/**
+ * @brief Print footprint of every subsystem, pool usage and heap state
+ */
+void user_memory_report(void);
+
+#endif
@@ -0,0 +1,171 @@
+/* Source file for pipeline metrics */
+#include "user_metrics.h"
+
+typedef struct {
+    const char* name;
+    const char* help;
+} metric_desc_t;
+
+typedef struct {
+    uint64_t sum_us;
+    uint32_t count;
+    uint32_t max_us;
+} summary_t;
+
+atomic_uint_least32_t g_metric_counters[METRIC_COUNTER_NUMBER];
+static atomic_uint_least32_t s_gauges[METRIC_GAUGE_NUMBER];
+static summary_t s_summaries[METRIC_SUMMARY_NUMBER];
+/* 64 bit sum cannot be updated atomically on ESP32 => guard summaries with a spinlock */
+static portMUX_TYPE s_summary_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Order of these tables must match enums in user_metrics.h */
+static const metric_desc_t s_counter_desc[METRIC_COUNTER_NUMBER] = {
+    {"samples_acquired_total",  "ADC sample sets read from the channels"},
+    {"samples_dropped_total",   "Sample sets that could not be written to SD card"},
+    {"sd_bytes_written_total",  "Bytes of log records written to SD card"},
+    {"uploads_attempted_total", "Upload requests started"},
+    {"uploads_succeeded_total", "Upload requests completed"},
+    {"uploads_failed_total",    "Upload requests failed"},
+    {"uplink_samples_dropped_total", "Samples not sent because uplink queue or batch was full"},
+    {"uplink_body_plain_bytes_total", "Batch payload bytes before compression"},
+    {"uplink_body_sent_bytes_total",  "Batch payload bytes after compression"},
+    {"wifi_disconnects_total",  "Wi-Fi connection losses"},
+    {"wifi_cache_misses_total", "Connections where cached AP could not be used"},
+    {"tls_full_handshakes_total",    "TLS connections opened with a full handshake"},
+    {"tls_resumed_handshakes_total", "TLS connections opened by resuming previous session"},
+    {"tls_reused_connections_total", "Requests sent on an already open TLS connection"},
+    {"samples_suppressed_total", "Samples not sent because no rule required a report"},
+    {"rule_events_total",        "Samples which crossed a threshold or had a digital edge"},
+    {"spectrum_bursts_total",    "Bursts captured and reduced to spectral features"},
+    {"uplink_gap_samples_total",      "Samples missing from the uplink stream or never acknowledged, to be read back from SD card"},
+    {"uplink_replayed_samples_total", "Samples read back from SD card and sent again"},
+    {"uplink_lost_samples_total",     "Samples given up: not found on SD card, no room to track them, or cannot be encoded"},
+    {"power_awake_milliseconds_total",    "Time some task kept the chip out of light sleep"},
+    {"power_radio_on_milliseconds_total", "Time Wi-Fi was switched on"},
+    {"power_wakeups_total",               "Wakeups from light sleep, boot included"},
+    {"power_radio_windows_total",         "Times Wi-Fi was switched on to upload"},
+};
+
+/* Each summary is exported as <name>_seconds (sum/count) and <name>_max_seconds (gauge) */
+static const metric_desc_t s_summary_desc[METRIC_SUMMARY_NUMBER] = {
+    {"sd_write_latency", "Time to open, write and close the log file"},
+    {"upload_latency",   "Time from DNS lookup to end of server response"},
+    {"wifi_connect_latency", "Time from start or disconnection to IP address received"},
+    {"tls_full_handshake_latency",    "Duration of full TLS handshakes"},
+    {"tls_resumed_handshake_latency", "Duration of resumed TLS handshakes"},
+    {"spectrum_latency", "Time to capture and analyze one burst of every selected channel"},
+    {"adc_read_latency", "Time to read every analog channel of one sample, oversampling included"},
+    {"pipeline_acquire_wait",   "Delay from timer alarm to ADC read"},
+    {"pipeline_condition_wait", "Time a sample waited in the condition stage queue"},
+    {"pipeline_persist_wait",   "Time a batch waited in the SD card subscriber queue"},
+    {"pipeline_uplink_wait",    "Time a batch waited in the uplink subscriber queue"},
+};
+
+static const metric_desc_t s_gauge_desc[METRIC_GAUGE_NUMBER] = {
+    {"heap_free_bytes",     "Current free heap"},
+    {"heap_min_free_bytes", "Minimum free heap since boot"},
+    {"boot_sampling_start_ms", "Time from app start to ADC and timer initialized"},
+    {"boot_first_sample_ms",   "Time from app start to first sample"},
+    {"boot_sd_ready_ms",       "Time from app start to SD card mounted"},
+    {"boot_wifi_ready_ms",     "Time from app start to IP address received"},
+    {"wifi_fast_path",         "1 if connecting with cached BSSID and channel"},
+    {"pipeline_condition_queue_max", "Highest number of samples in condition stage queue"},
+    {"pipeline_persist_queue_max",   "Highest number of batches in SD card subscriber queue"},
+    {"pipeline_uplink_queue_max",    "Highest number of batches in uplink subscriber queue"},
+    {"sample_sequence_next",   "Sequence number of the next sample"},
+    {"uplink_ack_watermark",   "Every sample below this sequence number is acknowledged or not meant for upload"},
+    {"uplink_unacked_ranges",  "Ranges of missing samples above the watermark, to be read back from SD card"},
+    {"power_wakeups_per_hour", "Average wakeups from light sleep per hour since boot"},
+};
+
+void user_metrics_observe(user_summary_t id, uint32_t us) {
+    portENTER_CRITICAL(&s_summary_lock);
+    s_summaries[id].sum_us += us;
+    s_summaries[id].count++;
+    if(us > s_summaries[id].max_us) {
+        s_summaries[id].max_us = us;
+    }
+    portEXIT_CRITICAL(&s_summary_lock);
+}
+
+void user_metrics_set(user_gauge_t id, uint32_t value) {
+    atomic_store_explicit(&s_gauges[id], value, memory_order_relaxed);
+}
+
+void user_metrics_set_max(user_gauge_t id, uint32_t value) {
+    uint32_t old = atomic_load_explicit(&s_gauges[id], memory_order_relaxed);
+    //on failure old is reloaded, loop ends once stored value is not lower
+    while(old < value && !atomic_compare_exchange_weak_explicit(&s_gauges[id], &old, value,
+                                                                memory_order_relaxed, memory_order_relaxed));
+}
+
+uint32_t user_metrics_get_gauge(user_gauge_t id) {
+    return atomic_load_explicit(&s_gauges[id], memory_order_relaxed);
+}
+
+void user_metrics_get_summary(user_summary_t id, uint64_t* sum_us, uint32_t* count, uint32_t* max_us) {
+    portENTER_CRITICAL(&s_summary_lock);
+    *sum_us = s_summaries[id].sum_us;
+    *count = s_summaries[id].count;
+    *max_us = s_summaries[id].max_us;
+    portEXIT_CRITICAL(&s_summary_lock);
+}
+
+/* Longest line is a HELP line: prefix, name and help text */
+#define METRICS_LINE_MAX    256
+
+/**
+ * @brief Format one line of the text format and send it as a chunk
+ *
+ * @note A line longer than METRICS_LINE_MAX is sent cut rather than with bytes past the buffer
+ */
+static esp_err_t send_line(httpd_req_t* req, const char* format, ...) {
+    char line[METRICS_LINE_MAX];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if(n < 0) return ESP_FAIL;
+    if((size_t)n >= sizeof(line)) n = sizeof(line) - 1;
+    return httpd_resp_send_chunk(req, line, n);
+}
+
+esp_err_t user_metrics_http_handler(httpd_req_t* req) {
+    summary_t snap;
+
+    //heap gauges are sampled at scrape time
+    user_metrics_set(METRIC_HEAP_FREE, esp_get_free_heap_size());
+    user_metrics_set(METRIC_HEAP_MIN_FREE, esp_get_minimum_free_heap_size());
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+
+    //one chunk per line keeps the line buffer small
+    for(int i = 0; i < METRIC_COUNTER_NUMBER; i++) {
+        const char* name = s_counter_desc[i].name;
+        send_line(req, "# HELP "METRICS_PREFIX"%s %s\n", name, s_counter_desc[i].help);
+        send_line(req, "# TYPE "METRICS_PREFIX"%s counter\n", name);
+        send_line(req, METRICS_PREFIX"%s %u\n", name,
+            (unsigned)atomic_load_explicit(&g_metric_counters[i], memory_order_relaxed));
+    }
+    for(int i = 0; i < METRIC_SUMMARY_NUMBER; i++) {
+        portENTER_CRITICAL(&s_summary_lock);
+        snap = s_summaries[i];
+        portEXIT_CRITICAL(&s_summary_lock);
+        const char* name = s_summary_desc[i].name;
+        send_line(req, "# HELP "METRICS_PREFIX"%s_seconds %s\n", name, s_summary_desc[i].help);
+        send_line(req, "# TYPE "METRICS_PREFIX"%s_seconds summary\n", name);
+        send_line(req, METRICS_PREFIX"%s_seconds_sum %llu.%06llu\n", name,
+            (unsigned long long)(snap.sum_us / 1000000), (unsigned long long)(snap.sum_us % 1000000));
+        send_line(req, METRICS_PREFIX"%s_seconds_count %u\n", name, snap.count);
+        send_line(req, "# TYPE "METRICS_PREFIX"%s_max_seconds gauge\n", name);
+        send_line(req, METRICS_PREFIX"%s_max_seconds %u.%06u\n", name, snap.max_us / 1000000, snap.max_us % 1000000);
+    }
+    for(int i = 0; i < METRIC_GAUGE_NUMBER; i++) {
+        const char* name = s_gauge_desc[i].name;
+        send_line(req, "# HELP "METRICS_PREFIX"%s %s\n", name, s_gauge_desc[i].help);
+        send_line(req, "# TYPE "METRICS_PREFIX"%s gauge\n", name);
+        send_line(req, METRICS_PREFIX"%s %u\n", name,
+            (unsigned)atomic_load_explicit(&s_gauges[i], memory_order_relaxed));
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
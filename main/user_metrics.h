@@ -0,0 +1,144 @@
+/*
+ *  Header file for pipeline metrics
+ *  Counters and latency summaries are updated from hot paths (ADC task, SD writer, uploader)
+ *  and exported in Prometheus text format on GET /metrics of the on-device HTTP server.
+ *
+ *  Counter update is a single relaxed atomic add => safe from any task and cheap enough
+ *  to be called once per sample.
+ */
+
+#ifndef _USER_METRICS_H_
+#define _USER_METRICS_H_
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <esp_http_server.h>
+
+#define METRICS_PREFIX "datalogger_"
+
+/* Monotonic counters, exported with _total suffix */
+typedef enum {
+    METRIC_SAMPLES_ACQUIRED = 0,
+    METRIC_SAMPLES_DROPPED,
+    METRIC_SD_BYTES_WRITTEN,
+    METRIC_UPLOADS_ATTEMPTED,
+    METRIC_UPLOADS_SUCCEEDED,
+    METRIC_UPLOADS_FAILED,
+    METRIC_UPLINK_DROPPED,
+    METRIC_UPLINK_BYTES_PLAIN,
+    METRIC_UPLINK_BYTES_SENT,
+    METRIC_WIFI_DISCONNECTS,
+    METRIC_WIFI_CACHE_MISSES,
+    METRIC_TLS_FULL_HANDSHAKES,
+    METRIC_TLS_RESUMED_HANDSHAKES,
+    METRIC_TLS_REUSED_CONNECTIONS,
+    METRIC_SAMPLES_SUPPRESSED,
+    METRIC_RULE_EVENTS,
+    METRIC_SPECTRUM_BURSTS,
+    METRIC_UPLINK_GAP_SAMPLES,
+    METRIC_UPLINK_REPLAYED,
+    METRIC_UPLINK_LOST,
+    METRIC_POWER_AWAKE_MS,
+    METRIC_POWER_RADIO_ON_MS,
+    METRIC_POWER_WAKEUPS,
+    METRIC_POWER_RADIO_WINDOWS,
+    METRIC_COUNTER_NUMBER
+} user_counter_t;
+
+/* Latency summaries, observed in microseconds and exported in seconds */
+typedef enum {
+    METRIC_SD_WRITE_LATENCY = 0,
+    METRIC_UPLOAD_LATENCY,
+    METRIC_WIFI_CONNECT_LATENCY,
+    METRIC_TLS_FULL_HANDSHAKE_LATENCY,
+    METRIC_TLS_RESUMED_HANDSHAKE_LATENCY,
+    METRIC_SPECTRUM_LATENCY,
+    METRIC_ADC_READ_LATENCY,
+    METRIC_STAGE_ACQUIRE_WAIT,
+    METRIC_STAGE_CONDITION_WAIT,
+    METRIC_STAGE_PERSIST_WAIT,
+    METRIC_STAGE_UPLINK_WAIT,
+    METRIC_SUMMARY_NUMBER
+} user_summary_t;
+
+/* Gauges, last written value is exported */
+typedef enum {
+    METRIC_HEAP_FREE = 0,
+    METRIC_HEAP_MIN_FREE,
+    METRIC_BOOT_SAMPLING_START_MS,
+    METRIC_BOOT_FIRST_SAMPLE_MS,
+    METRIC_BOOT_SD_READY_MS,
+    METRIC_BOOT_WIFI_READY_MS,
+    METRIC_WIFI_FAST_PATH,
+    METRIC_STAGE_CONDITION_QUEUE_MAX,
+    METRIC_STAGE_PERSIST_QUEUE_MAX,
+    METRIC_STAGE_UPLINK_QUEUE_MAX,
+    METRIC_SEQ_NEXT,
+    METRIC_UPLINK_ACK_WATERMARK,
+    METRIC_UPLINK_UNACKED_RANGES,
+    METRIC_POWER_WAKEUPS_PER_HOUR,
+    METRIC_GAUGE_NUMBER
+} user_gauge_t;
+
+extern atomic_uint_least32_t g_metric_counters[METRIC_COUNTER_NUMBER];
+
+/**
+ * @brief Add n to a counter
+ */
+static inline void user_metrics_add(user_counter_t id, uint32_t n) {
+    atomic_fetch_add_explicit(&g_metric_counters[id], n, memory_order_relaxed);
+}
+
+/**
+ * @brief Increase a counter by one
+ */
+static inline void user_metrics_inc(user_counter_t id) {
+    user_metrics_add(id, 1);
+}
+
+/**
+ * @brief Record one latency observation
+ * 
+ * @param id summary to update
+ * @param us latency in microseconds, usually esp_timer_get_time() difference
+ */
+void user_metrics_observe(user_summary_t id, uint32_t us);
+
+/**
+ * @brief Set value of a gauge
+ */
+void user_metrics_set(user_gauge_t id, uint32_t value);
+
+/**
+ * @brief Raise a gauge to value if it is lower (high-water mark)
+ */
+void user_metrics_set_max(user_gauge_t id, uint32_t value);
+
+/**
+ * @brief Read current value of a gauge
+ */
+uint32_t user_metrics_get_gauge(user_gauge_t id);
+
+/**
+ * @brief Read a latency summary, all three values are taken at the same time
+ * 
+ * @param id summary to read
+ * @param sum_us sum of observations in microseconds
+ * @param count number of observations
+ * @param max_us largest observation
+ */
+void user_metrics_get_summary(user_summary_t id, uint64_t* sum_us, uint32_t* count, uint32_t* max_us);
+
+/**
+ * @brief Handler of GET /metrics, write every metric in Prometheus text exposition format
+ */
+esp_err_t user_metrics_http_handler(httpd_req_t* req);
+
+#endif
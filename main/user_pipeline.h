@@ -0,0 +1,39 @@
+/*
+ *  Header file for pipeline topology
+ *  Samples go through four stages, each one is a task with a bounded queue in front of it:
+ *
+ *      acquire ----xQueueAcquire----> condition --sample bus--> persist (SD card)
+ *      (timer, ADC, DI)               (rate control,        \-> uplink
+ *                                      rules, batching)
+ *
+ *  No stage ever blocks on the queue of the next stage: acquire drops the newest sample when
+ *  the condition queue is full, the sample bus applies the drop policy of each subscriber.
+ *  So SD card or network stalls show up in queue depth, wait time and drop metrics, never
+ *  in the timing of ADC reads.
+ *
+ *  Per stage metrics:
+ *      pipeline_<stage>_wait_seconds       time an item waited before the stage took it
+ *                                          (acquire: delay from timer alarm to ADC read)
+ *      pipeline_<stage>_queue_max          highest number of items seen in the stage input queue
+ */
+
+#ifndef _USER_PIPELINE_H_
+#define _USER_PIPELINE_H_
+
+#include "freertos/FreeRTOS.h"
+#include "esp_task.h"
+
+/* Placement of stages:     core    priority */
+#define STAGE_ACQUIRE_CORE      0
+#define STAGE_ACQUIRE_PRIO      (ESP_TASKD_EVENT_PRIO-1)
+#define STAGE_CONDITION_CORE    1
+#define STAGE_CONDITION_PRIO    (ESP_TASKD_EVENT_PRIO-2)
+#define STAGE_PERSIST_CORE      0
+#define STAGE_PERSIST_PRIO      (ESP_TASKD_EVENT_PRIO-2)
+#define STAGE_UPLINK_CORE       1
+#define STAGE_UPLINK_PRIO       (ESP_TASKD_EVENT_PRIO-3)     //below condition: TLS handshakes and compression are long CPU bursts
+
+/* Queue in front of condition stage, samples. Queues of persist and uplink are bus subscribers */
+#define STAGE_CONDITION_QUEUE   16
+
+#endif
@@ -0,0 +1,39 @@
+/* Source file for fixed-block memory pool */
+#include "user_pool.h"
+
+static uint32_t popcount32(uint32_t x) {
+    uint32_t n = 0;
+    for(; x; x &= x - 1) n++;
+    return n;
+}
+
+void* pool_alloc(user_pool_t* pool) {
+    uint32_t all = pool->block_count == 32 ? 0xFFFFFFFFu : (1u << pool->block_count) - 1;
+    uint32_t used = atomic_load_explicit(&pool->used, memory_order_relaxed);
+    while(1) {
+        uint32_t free_mask = ~used & all;
+        if(free_mask == 0) {
+            atomic_fetch_add_explicit(&pool->failures, 1, memory_order_relaxed);
+            return NULL;
+        }
+        uint32_t bit = free_mask & -free_mask;          //lowest free block
+        //on failure, used is reloaded and the search is repeated
+        if(atomic_compare_exchange_weak_explicit(&pool->used, &used, used | bit, memory_order_acquire, memory_order_relaxed)) {
+            uint32_t free_now = pool->block_count - popcount32(used | bit);
+            uint32_t min = atomic_load_explicit(&pool->min_free, memory_order_relaxed);
+            while(free_now < min && !atomic_compare_exchange_weak_explicit(&pool->min_free, &min, free_now,
+                                                                           memory_order_relaxed, memory_order_relaxed));
+            return pool->storage + (size_t)popcount32(bit - 1) * pool->block_size;
+        }
+    }
+}
+
+void pool_free(user_pool_t* pool, void* block) {
+    if(block == NULL) return;
+    size_t index = ((uint8_t*)block - pool->storage) / pool->block_size;
+    atomic_fetch_and_explicit(&pool->used, ~(1u << index), memory_order_release);
+}
+
+uint32_t pool_free_blocks(user_pool_t* pool) {
+    return pool->block_count - popcount32(atomic_load_explicit(&pool->used, memory_order_relaxed));
+}
@@ -0,0 +1,59 @@
+/*
+ *  Header file for fixed-block memory pool
+ *  Storage of a pool is a static array, blocks are taken and given back without heap:
+ *      POOL_DEFINE(my_pool, 512, 4);           //4 blocks of 512 bytes
+ *      void* buf = pool_alloc(&my_pool);       //NULL when every block is used
+ *      pool_free(&my_pool, buf);
+ *
+ *  Allocation state is one atomic bitmap, so alloc/free are lock-free and can be used
+ *  from any task. The module only depends on the C library so it can be built on a host PC.
+ */
+
+#ifndef _USER_POOL_H_
+#define _USER_POOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#define POOL_MAX_BLOCKS         32          //one bit of the bitmap per block
+#define POOL_ALIGN              8
+#define POOL_ALIGN_UP(size)     (((size) + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1))
+
+typedef struct {
+    const char* name;
+    uint8_t* storage;
+    size_t block_size;
+    uint32_t block_count;
+    atomic_uint_least32_t used;             //bit n: block n is allocated
+    atomic_uint_least32_t min_free;         //lowest number of free blocks seen
+    atomic_uint_least32_t failures;         //pool_alloc calls which found no free block
+} user_pool_t;
+
+/* Define a pool with its own static storage */
+#define POOL_DEFINE(var, size, count) \
+    _Static_assert((count) > 0 && (count) <= POOL_MAX_BLOCKS, "pool must have 1 to POOL_MAX_BLOCKS blocks"); \
+    static uint8_t var##_storage[(count) * POOL_ALIGN_UP(size)] __attribute__((aligned(POOL_ALIGN))); \
+    user_pool_t var = { #var, var##_storage, POOL_ALIGN_UP(size), (count), 0, (count), 0 }
+
+/* Bytes of static storage used by a pool */
+#define POOL_FOOTPRINT(size, count)     ((count) * POOL_ALIGN_UP(size))
+
+/**
+ * @brief Take one block
+ * 
+ * @return void* block of pool->block_size bytes, NULL if pool is empty
+ */
+void* pool_alloc(user_pool_t* pool);
+
+/**
+ * @brief Give block back, NULL is ignored
+ */
+void pool_free(user_pool_t* pool, void* block);
+
+/**
+ * @brief Number of free blocks right now
+ */
+uint32_t pool_free_blocks(user_pool_t* pool);
+
+#endif
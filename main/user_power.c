@@ -0,0 +1,210 @@
+/* Source file for power-aware scheduling */
+#include "user_power.h"
+
+static const char* TAG = "Power";
+
+static const power_config_t s_config = {
+    .window_period_ms = POWER_WINDOW_PERIOD_MS,
+    .window_max_ms = POWER_WINDOW_MAX_MS,
+    .backlog_samples = POWER_WINDOW_BACKLOG,
+    .min_sleep_ms = POWER_MIN_SLEEP_MS,
+    .event_window = true,
+};
+static power_state_t s_state;
+/* Energy proxies already added to the metric counters */
+static power_stats_t s_reported;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t s_awake_lock;
+#endif
+
+static TickType_t us_to_ticks(int64_t us) {
+    if(us <= 0) return 0;
+    return (us + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000);
+}
+
+/* Counters only increase => add what was accumulated since last update, called under s_lock */
+static void power_update_metrics(int64_t now_us) {
+    power_stats_t stats;
+    power_stats(&s_state, now_us, &stats);
+    user_metrics_add(METRIC_POWER_AWAKE_MS, stats.awake_us / 1000 - s_reported.awake_us / 1000);
+    user_metrics_add(METRIC_POWER_RADIO_ON_MS, stats.radio_us / 1000 - s_reported.radio_us / 1000);
+    user_metrics_add(METRIC_POWER_WAKEUPS, stats.wakeups - s_reported.wakeups);
+    user_metrics_add(METRIC_POWER_RADIO_WINDOWS, stats.windows - s_reported.windows);
+    user_metrics_set(METRIC_POWER_WAKEUPS_PER_HOUR, stats.wakeups_per_hour);
+    s_reported = stats;
+}
+
+esp_err_t user_power_init(void) {
+    esp_err_t err = ESP_OK;
+    power_init(&s_config, &s_state, esp_timer_get_time());
+#if CONFIG_PM_ENABLE
+    //work in progress must not be interrupted by light sleep, it is also what awake time measures
+    err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "awake", &s_awake_lock);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot create power management lock: %s", esp_err_to_name(err));
+        return err;
+    }
+    esp_pm_lock_acquire(s_awake_lock);
+    esp_pm_config_esp32_t pm_config = {
+        .max_freq_mhz = POWER_MAX_FREQ_MHZ,
+        .min_freq_mhz = POWER_MIN_FREQ_MHZ,
+        .light_sleep_enable = POWER_SAVE,
+    };
+    err = esp_pm_configure(&pm_config);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot configure power management: %s", esp_err_to_name(err));
+    }
+#elif POWER_SAVE
+    ESP_LOGW(TAG, "CONFIG_PM_ENABLE is not set, radio windows only");
+#endif
+    return err;
+}
+
+void user_power_awake_begin(void) {
+    portENTER_CRITICAL(&s_lock);
+    bool first = power_awake_begin(&s_config, &s_state, esp_timer_get_time());
+    portEXIT_CRITICAL(&s_lock);
+#if CONFIG_PM_ENABLE
+    if(first) esp_pm_lock_acquire(s_awake_lock);
+#endif
+}
+
+void user_power_awake_end(void) {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    bool last = power_awake_end(&s_state, now);
+    if(last) power_update_metrics(now);
+    portEXIT_CRITICAL(&s_lock);
+#if CONFIG_PM_ENABLE
+    if(last) esp_pm_lock_release(s_awake_lock);
+#endif
+}
+
+void user_power_radio_on(void) {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    bool changed = !s_state.radio_on;
+    if(changed) power_window_begin(&s_state, now);
+    portEXIT_CRITICAL(&s_lock);
+    //chip does not sleep while radio is on
+    if(changed) user_power_awake_begin();
+}
+
+void user_power_radio_off(bool complete) {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    bool changed = s_state.radio_on;
+    if(changed) power_window_end(&s_config, &s_state, now, complete);
+    portEXIT_CRITICAL(&s_lock);
+    if(changed) user_power_awake_end();
+}
+
+bool user_power_radio_is_on(void) {
+    return s_state.radio_on;
+}
+
+bool user_power_window_due(uint32_t backlog, bool event) {
+    portENTER_CRITICAL(&s_lock);
+    bool due = power_window_due(&s_config, &s_state, esp_timer_get_time(), backlog, event);
+    portEXIT_CRITICAL(&s_lock);
+    return due;
+}
+
+bool user_power_window_done(uint32_t backlog) {
+    portENTER_CRITICAL(&s_lock);
+    bool done = power_window_done(&s_config, &s_state, esp_timer_get_time(), backlog);
+    portEXIT_CRITICAL(&s_lock);
+    return done;
+}
+
+TickType_t user_power_ticks_to_window(void) {
+    return us_to_ticks(s_state.next_window_us - esp_timer_get_time());
+}
+
+TickType_t user_power_ticks_left_in_window(void) {
+    return us_to_ticks(s_state.window_start_us + s_config.window_max_ms * 1000LL - esp_timer_get_time());
+}
+
+void user_power_stats(power_stats_t* stats) {
+    portENTER_CRITICAL(&s_lock);
+    power_stats(&s_state, esp_timer_get_time(), stats);
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/**** Policy and accounting ****/
+
+void power_init(const power_config_t* config, power_state_t* state, int64_t now_us) {
+    memset(state, 0, sizeof(*state));
+    state->start_us = now_us;
+    state->next_window_us = now_us;
+    state->holders = 1;
+    state->awake_start_us = now_us;
+    state->awake_end_us = now_us;
+    state->wakeups = 1;
+}
+
+bool power_window_due(const power_config_t* config, power_state_t* state, int64_t now_us, uint32_t backlog, bool event) {
+    if(state->radio_on || backlog == 0) {
+        //nothing to send => scheduled window is skipped
+        if(!state->radio_on && now_us >= state->next_window_us) {
+            state->next_window_us = now_us + config->window_period_ms * 1000LL;
+        }
+        return false;
+    }
+    if(now_us >= state->next_window_us) return true;
+    if(state->backoff) return false;
+    if(event && config->event_window) return true;
+    return config->backlog_samples != 0 && backlog >= config->backlog_samples;
+}
+
+bool power_window_done(const power_config_t* config, const power_state_t* state, int64_t now_us, uint32_t backlog) {
+    return backlog == 0 || now_us - state->window_start_us >= config->window_max_ms * 1000LL;
+}
+
+void power_window_begin(power_state_t* state, int64_t now_us) {
+    state->radio_on = true;
+    state->backoff = false;
+    state->window_start_us = now_us;
+    state->windows++;
+}
+
+void power_window_end(const power_config_t* config, power_state_t* state, int64_t now_us, bool complete) {
+    state->radio_on = false;
+    state->backoff = !complete;
+    state->radio_us += now_us - state->window_start_us;
+    //windows keep their period even if one was late or long
+    state->next_window_us = state->window_start_us + config->window_period_ms * 1000LL;
+    if(state->next_window_us <= now_us) {
+        state->next_window_us = now_us + config->window_period_ms * 1000LL;
+    }
+}
+
+bool power_awake_begin(const power_config_t* config, power_state_t* state, int64_t now_us) {
+    if(state->holders++ != 0) return false;
+    if(now_us - state->awake_end_us < config->min_sleep_ms * 1000LL) {
+        //too short to sleep => chip stayed awake since the last period
+        state->awake_us += now_us - state->awake_end_us;
+    }
+    else {
+        state->wakeups++;
+    }
+    state->awake_start_us = now_us;
+    return true;
+}
+
+bool power_awake_end(power_state_t* state, int64_t now_us) {
+    if(state->holders == 0 || --state->holders != 0) return false;
+    state->awake_us += now_us - state->awake_start_us;
+    state->awake_end_us = now_us;
+    return true;
+}
+
+void power_stats(const power_state_t* state, int64_t now_us, power_stats_t* stats) {
+    stats->elapsed_us = now_us - state->start_us;
+    stats->awake_us = state->awake_us + (state->holders != 0 ? now_us - state->awake_start_us : 0);
+    stats->radio_us = state->radio_us + (state->radio_on ? now_us - state->window_start_us : 0);
+    stats->wakeups = state->wakeups;
+    stats->windows = state->windows;
+    stats->wakeups_per_hour = stats->elapsed_us > 0 ? (uint32_t)(state->wakeups * 3600000000LL / stats->elapsed_us) : 0;
+}
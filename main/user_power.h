@@ -0,0 +1,206 @@
+/*
+ *  Header file for power-aware scheduling
+ *  POWER_SAVE is off by default: the radio is switched off between windows, so /metrics, /profile
+ *  and /log can only be reached during a window. Set it for battery powered loggers.
+ *  With POWER_SAVE, the chip light-sleeps whenever no task has work (esp_pm automatic light sleep,
+ *  needs CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE, see sdkconfig.defaults):
+ *      - sampling is paced by the FreeRTOS tick instead of the hardware timer, which stops in
+ *        light sleep, tickless idle wakes the chip for the next sample
+ *      - Wi-Fi is only switched on for upload windows. Between windows samples wait in the backend
+ *        batch and the uplink subscriber queue, light sleep keeps all internal RAM powered so
+ *        they are retained without being copied to RTC memory
+ *  A window opens every POWER_WINDOW_PERIOD_MS if samples are waiting, at once for an event sample
+ *  or when POWER_WINDOW_BACKLOG samples are waiting. It closes when everything is sent, gaps
+ *  included (user_seq.h), or after POWER_WINDOW_MAX_MS. After a window which could not send
+ *  everything, only the scheduled window opens the radio again; samples which do not fit in the
+ *  backend batch meanwhile are read back from SD card later.
+ *
+ *  Energy proxies, also kept without POWER_SAVE:
+ *      awake time      time some task keeps the chip awake (user_power_awake_begin/end), idle gaps
+ *                      shorter than POWER_MIN_SLEEP_MS are counted as awake
+ *      radio-on time   time Wi-Fi is switched on, from start of connection to switch off
+ *      wakeups         awake periods following a gap long enough to sleep, the boot is the first one
+ *
+ *  Window policy and accounting (power_*) only depend on the C library and take the time as
+ *  argument, so they can be driven by a simulated clock. Callers serialize access.
+ */
+
+#ifndef _USER_POWER_H_
+#define _USER_POWER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "freertos/FreeRTOS.h"
+#include "user_metrics.h"
+
+#ifndef POWER_SAVE
+#define POWER_SAVE              0           //1: light sleep between samples, radio only in upload windows
+#endif
+#define POWER_WINDOW_PERIOD_MS  60000       //waiting samples are sent this often
+#define POWER_WINDOW_MAX_MS     20000       //radio is switched off after this long, even if samples are left
+#define POWER_WINDOW_BACKLOG    24          //waiting samples which open a window early, 0 = never
+#define POWER_MIN_SLEEP_MS      30          //shorter idle gaps cannot enter light sleep (3 ticks at 100 Hz)
+#define POWER_MAX_FREQ_MHZ      240
+#if POWER_SAVE
+#define POWER_MIN_FREQ_MHZ      40          //XTAL frequency, sampling is paced by the tick
+#else
+#define POWER_MIN_FREQ_MHZ      POWER_MAX_FREQ_MHZ  //no frequency scaling: the sample timer counts APB cycles (user_timer.h)
+#endif
+
+typedef struct {
+    uint32_t window_period_ms;
+    uint32_t window_max_ms;
+    uint32_t backlog_samples;
+    uint32_t min_sleep_ms;
+    bool event_window;                      //an event sample opens a window at once
+} power_config_t;
+
+typedef struct {
+    int64_t start_us;                       //start of accounting
+    /* Upload windows */
+    bool radio_on;
+    int64_t window_start_us;                //start of current or last window
+    int64_t next_window_us;                 //next scheduled window
+    int64_t radio_us;                       //radio-on time of finished windows
+    uint32_t windows;
+    bool backoff;                           //last window failed => wait for the scheduled one
+    /* Awake periods */
+    uint32_t holders;                       //tasks keeping the chip awake
+    int64_t awake_start_us;                 //start of current awake period
+    int64_t awake_end_us;                   //end of last awake period
+    int64_t awake_us;                       //time of finished awake periods
+    uint32_t wakeups;
+} power_state_t;
+
+typedef struct {
+    int64_t elapsed_us;
+    int64_t awake_us;
+    int64_t radio_us;
+    uint32_t wakeups;
+    uint32_t windows;
+    uint32_t wakeups_per_hour;
+} power_stats_t;
+
+/**
+ * @brief Initialize power management, the chip is awake until user_power_awake_end
+ *
+ * @note Called first in app_main. Light sleep and frequency scaling are only enabled with POWER_SAVE
+ * and CONFIG_PM_ENABLE, without POWER_SAVE the CPU stays at POWER_MAX_FREQ_MHZ.
+ * @return ESP_OK, or the error of esp_pm, the chip then runs without power management
+ */
+esp_err_t user_power_init(void);
+
+/**
+ * @brief Keep the chip awake until user_power_awake_end, calls may be nested and come from any task
+ */
+void user_power_awake_begin(void);
+
+/**
+ * @brief End of work started with user_power_awake_begin
+ */
+void user_power_awake_end(void);
+
+/**
+ * @brief Account radio switched on, the chip is kept awake until user_power_radio_off
+ *
+ * @note Only accounting, Wi-Fi itself is switched by the caller (user_wifi.h)
+ */
+void user_power_radio_on(void);
+
+/**
+ * @brief Account radio switched off
+ *
+ * @param complete everything waiting was sent. If not, backlog and events do not open
+ * a window before the next scheduled one, so a broken link or server is not retried at once
+ */
+void user_power_radio_off(bool complete);
+
+/**
+ * @brief Check whether radio is accounted as on
+ */
+bool user_power_radio_is_on(void);
+
+/**
+ * @brief Check whether an upload window should open now, see power_window_due
+ */
+bool user_power_window_due(uint32_t backlog, bool event);
+
+/**
+ * @brief Check whether the open upload window should close, see power_window_done
+ */
+bool user_power_window_done(uint32_t backlog);
+
+/**
+ * @brief Ticks until the next scheduled window, 0 if it is due
+ */
+TickType_t user_power_ticks_to_window(void);
+
+/**
+ * @brief Ticks left in the open window, 0 if it is over
+ */
+TickType_t user_power_ticks_left_in_window(void);
+
+/**
+ * @brief Read energy proxies up to now
+ */
+void user_power_stats(power_stats_t* stats);
+
+/**
+ * @brief Start accounting, radio is off and the chip is awake with one holder (the boot)
+ */
+void power_init(const power_config_t* config, power_state_t* state, int64_t now_us);
+
+/**
+ * @brief Check whether an upload window should open
+ *
+ * @note When the scheduled window is due without anything to send, it is skipped and the next
+ * one is scheduled one period later.
+ * @param backlog samples waiting for upload
+ * @param event an event sample is waiting
+ * @return true if radio should be switched on now
+ */
+bool power_window_due(const power_config_t* config, power_state_t* state, int64_t now_us, uint32_t backlog, bool event);
+
+/**
+ * @brief Check whether the open window should close: nothing left to send or window is too long
+ */
+bool power_window_done(const power_config_t* config, const power_state_t* state, int64_t now_us, uint32_t backlog);
+
+/**
+ * @brief Account radio switched on
+ */
+void power_window_begin(power_state_t* state, int64_t now_us);
+
+/**
+ * @brief Account radio switched off, next window is one period after the start of this one
+ *
+ * @param complete everything waiting was sent, see user_power_radio_off
+ */
+void power_window_end(const power_config_t* config, power_state_t* state, int64_t now_us, bool complete);
+
+/**
+ * @brief Account a task starting work
+ *
+ * @return true if it is the first holder, i.e. the chip was allowed to sleep before
+ */
+bool power_awake_begin(const power_config_t* config, power_state_t* state, int64_t now_us);
+
+/**
+ * @brief Account a task finishing work
+ *
+ * @return true if it was the last holder, i.e. the chip may sleep now
+ */
+bool power_awake_end(power_state_t* state, int64_t now_us);
+
+/**
+ * @brief Energy proxies up to now, open awake period and window included
+ */
+void power_stats(const power_state_t* state, int64_t now_us, power_stats_t* stats);
+
+#endif
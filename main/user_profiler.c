@@ -0,0 +1,143 @@
+/* Source file for task profiler */
+#include "user_profiler.h"
+#include "user_memory.h"
+
+static const char* TAG = "Profiler";
+
+/* Periodic task and HTTP handler share the snapshot below */
+static SemaphoreHandle_t s_lock;
+USER_MUTEX_DEFINE(s_lock);
+USER_TASK_DEFINE(profiler_task, PROFILER_TASK_STACK);
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+
+/* Runtime counter of every task at previous sample, used to compute CPU share */
+typedef struct {
+    UBaseType_t number;
+    uint32_t runtime;
+} task_snapshot_t;
+
+static task_snapshot_t s_prev[PROFILER_MAX_TASKS];
+static UBaseType_t s_prev_count;
+static uint32_t s_prev_total;
+static TaskStatus_t s_status[PROFILER_MAX_TASKS];
+
+static uint32_t prev_runtime(UBaseType_t number) {
+    for(UBaseType_t i = 0; i < s_prev_count; i++) {
+        if(s_prev[i].number == number) return s_prev[i].runtime;
+    }
+    return 0;                       //task created after previous sample
+}
+
+static int task_core(const TaskStatus_t* status) {
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+    return (status->xCoreID == tskNO_AFFINITY) ? -1 : (int)status->xCoreID;
+#else
+    return -1;
+#endif
+}
+
+esp_err_t user_profiler_report(profiler_write_cb write, void* ctx) {
+    char line[96];
+    uint32_t total;
+    uint32_t idle[portNUM_PROCESSORS] = {0};
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    UBaseType_t count = uxTaskGetSystemState(s_status, PROFILER_MAX_TASKS, &total);
+    if(count == 0) {
+        xSemaphoreGive(s_lock);
+        ESP_LOGE(TAG, "More than %d tasks, increase PROFILER_MAX_TASKS", PROFILER_MAX_TASKS);
+        return ESP_ERR_NO_MEM;
+    }
+    /* Runtime counter is per core, elapsed time is the same for every core */
+    uint32_t elapsed = total - s_prev_total;
+    if(elapsed == 0) elapsed = 1;
+
+    for(UBaseType_t i = 0; i < count; i++) {
+        int core = task_core(&s_status[i]);
+        if(core >= 0 && strncmp(s_status[i].pcTaskName, "IDLE", 4) == 0) {
+            idle[core] = s_status[i].ulRunTimeCounter - prev_runtime(s_status[i].xTaskNumber);
+        }
+    }
+
+    size_t heap_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t heap_largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    int n = snprintf(line, sizeof(line), "window %ums, cpu", elapsed / 1000);
+    for(int core = 0; core < portNUM_PROCESSORS; core++) {
+        uint32_t busy = (idle[core] >= elapsed) ? 0 : 100 - (uint32_t)((uint64_t)idle[core] * 100 / elapsed);
+        n += snprintf(line + n, sizeof(line) - n, " c%d:%u%%", core, busy);
+    }
+    write(ctx, line);
+    snprintf(line, sizeof(line), "heap free %zu largest %zu frag %u%% min %u",
+        heap_free, heap_largest, heap_free ? 100 - (unsigned)(heap_largest * 100 / heap_free) : 0,
+        esp_get_minimum_free_heap_size());
+    write(ctx, line);
+
+    for(UBaseType_t i = 0; i < count; i++) {
+        uint32_t delta = s_status[i].ulRunTimeCounter - prev_runtime(s_status[i].xTaskNumber);
+        uint32_t permille = (uint32_t)((uint64_t)delta * 1000 / elapsed);
+        int core = task_core(&s_status[i]);
+        snprintf(line, sizeof(line), "%-16s c%c p%-2u cpu %3u.%u%% stack_min %u",
+            s_status[i].pcTaskName, core < 0 ? '*' : '0' + core, s_status[i].uxCurrentPriority,
+            permille / 10, permille % 10, s_status[i].usStackHighWaterMark);
+        write(ctx, line);
+    }
+
+    /* Save this sample as base of the next report */
+    for(UBaseType_t i = 0; i < count; i++) {
+        s_prev[i].number = s_status[i].xTaskNumber;
+        s_prev[i].runtime = s_status[i].ulRunTimeCounter;
+    }
+    s_prev_count = count;
+    s_prev_total = total;
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+#else
+
+esp_err_t user_profiler_report(profiler_write_cb write, void* ctx) {
+    write(ctx, "runtime stats disabled, enable CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
+
+static void log_write(void* ctx, const char* line) {
+    ESP_LOGI(TAG, "%s", line);
+}
+
+static void http_write(void* ctx, const char* line) {
+    httpd_req_t* req = (httpd_req_t*)ctx;
+    httpd_resp_send_chunk(req, line, strlen(line));
+    httpd_resp_send_chunk(req, "\n", 1);
+}
+
+static void profiler_task(void* pvParameters) {
+    while(1) {
+        vTaskDelay(PROFILER_PERIOD_MS/portTICK_RATE_MS);
+        user_profiler_report(log_write, NULL);
+    }
+}
+
+esp_err_t user_profiler_start(void) {
+    s_lock = USER_MUTEX_CREATE(s_lock);
+    if(s_lock == NULL) {
+        ESP_LOGE(TAG, "There is not enough heap memory for Mutex");
+        return ESP_ERR_NO_MEM;
+    }
+    if(USER_TASK_CREATE(profiler_task, "profiler", PROFILER_TASK_STACK, PROFILER_TASK_PRIO, tskNO_AFFINITY) != pdPASS) {
+        ESP_LOGE(TAG, "There is not enough heap memory for profiler task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t user_profiler_http_handler(httpd_req_t* req) {
+    if(s_lock == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Profiler not started");
+    }
+    httpd_resp_set_type(req, "text/plain");
+    user_profiler_report(http_write, req);
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
@@ -0,0 +1,56 @@
+/*
+ *  Header file for task profiler
+ *  Periodically samples FreeRTOS runtime statistics to report for every task:
+ *      - CPU share on the core it runs on since previous sample
+ *      - stack high-water mark (minimum free stack ever, in bytes)
+ *  and for the heap: free size, largest free block and fragmentation.
+ *
+ *  Requires CONFIG_FREERTOS_USE_TRACE_FACILITY, CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+ *  and CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID (see sdkconfig.defaults).
+ *  Report is printed every PROFILER_PERIOD_MS and is available on GET /profile.
+ */
+
+#ifndef _USER_PROFILER_H_
+#define _USER_PROFILER_H_
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <esp_http_server.h>
+
+#define PROFILER_PERIOD_MS      60000       //period of compact report in log
+#define PROFILER_MAX_TASKS      24          //maximum number of tasks that can be tracked
+#define PROFILER_TASK_STACK     3072
+#define PROFILER_TASK_PRIO      1
+
+/* Callback used to output report, one line per call */
+typedef void (*profiler_write_cb)(void* ctx, const char* line);
+
+/**
+ * @brief Create profiler task which prints a compact report every PROFILER_PERIOD_MS
+ * 
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NO_MEM if task cannot be created
+ */
+esp_err_t user_profiler_start(void);
+
+/**
+ * @brief Take a sample now and write report covering time since previous sample
+ * 
+ * @param write callback called for every line of the report
+ * @param ctx argument passed to callback
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NOT_SUPPORTED if runtime stats are disabled
+ */
+esp_err_t user_profiler_report(profiler_write_cb write, void* ctx);
+
+/**
+ * @brief Handler of GET /profile, write on-demand report as plain text
+ */
+esp_err_t user_profiler_http_handler(httpd_req_t* req);
+
+#endif
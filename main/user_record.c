@@ -0,0 +1,91 @@
+/* Source file for log record format */
+#include "user_record.h"
+
+void user_file_record_value(FILE* f, const uint32_t* adc_val, uint8_t digital_val, uint32_t seq, bool suppressed) {
+    int n1, n2;
+    n1 = fprintf(f, "Analog: Chan 0:%umV, Chan 1:%umV, Chan 2:%umV, Chan 3:%u mV. Seq %u%s\n", adc_val[0], adc_val[1], adc_val[2], adc_val[3], seq,
+        suppressed ? RECORD_SUPPRESSED : "");
+    n2 = fprintf(f, "Digtal: Chan 0: %d, Chan 1: %d, Chan 2: %d, Chan 3: %d\n", (digital_val&0x01), (digital_val>>1)&0x01, (digital_val>>2)&0x01, (digital_val>>3)&0x01);
+    if(n1 > 0 && n2 > 0) {
+        user_metrics_add(METRIC_SD_BYTES_WRITTEN, n1 + n2);
+    }
+    /*  Note that digital value store state of digital input in bit 0 - 3
+     *  we must shift each corresponding bit to bit 0 and read that bit only    */
+}
+
+void user_file_record_period(FILE* f, int64_t timestamp_us, uint32_t period_ms) {
+    int n = fprintf(f, "Period: %u ms from %lld us\n", period_ms, (long long)timestamp_us);
+    if(n > 0) {
+        user_metrics_add(METRIC_SD_BYTES_WRITTEN, n);
+    }
+}
+
+void user_file_record_spectrum(FILE* f, const spectrum_burst_t* burst) {
+    int n, total;
+    total = fprintf(f, "Spectrum: %lld us, %.1f Hz, %u points\n", (long long)burst->timestamp_us, burst->sample_rate_hz, burst->points);
+    for(int ch = 0; ch < SPECTRUM_CHANNELS; ch++) {
+        const spectrum_features_t* feat = &burst->channel[ch];
+        if(!(burst->channel_mask & (1 << ch))) continue;
+        n = fprintf(f, "Chan %d: mean %.1f mV, rms %.1f mV, peak %.1f mV, crest %.2f, peaks:", ch, feat->mean_mv, feat->rms_mv, feat->peak_mv, feat->crest);
+        if(n > 0) total += n;
+        for(int p = 0; p < SPECTRUM_PEAKS && feat->peaks[p].amplitude_mv > 0; p++) {
+            n = fprintf(f, " %.1f Hz %.1f mV", feat->peaks[p].freq_hz, feat->peaks[p].amplitude_mv);
+            if(n > 0) total += n;
+        }
+        if(fputc('\n', f) != EOF) total++;
+    }
+    if(total > 0) {
+        user_metrics_add(METRIC_SD_BYTES_WRITTEN, total);
+    }
+}
+
+size_t user_file_read_values(FILE* f, const seq_index_entry_t* start, uint32_t first_seq, uint32_t last_seq,
+                             adc_sample_t* out, size_t max, size_t* skipped) {
+    char line[128];
+    int64_t base_us = start->timestamp_us;
+    uint32_t period_ms = start->period_ms;
+    uint32_t base_seq = start->seq;     //sample taken at base_us
+    bool rebase = false;                //Period line read, base_us is the time of the next record
+    size_t count = 0;
+    adc_sample_t* sample = NULL;        //last record read, its Digtal line comes next
+    *skipped = 0;
+    if(fseek(f, start->offset, SEEK_SET) != 0) return 0;
+
+    while(fgets(line, sizeof(line), f) != NULL) {
+        uint32_t v[ADC_CHANNEL_NUMBER], seq, period;
+        long long timestamp;
+        if(sscanf(line, "Period: %u ms from %lld us", &period, &timestamp) == 2) {
+            base_us = timestamp;
+            period_ms = period;
+            rebase = true;
+        }
+        else if(sscanf(line, "Analog: Chan 0:%umV, Chan 1:%umV, Chan 2:%umV, Chan 3:%u mV. Seq %u", &v[0], &v[1], &v[2], &v[3], &seq) == 5) {
+            //samples dropped before the SD card leave no record, so time follows the numbers, not the records
+            if(rebase) {
+                base_seq = seq;
+                rebase = false;
+            }
+            int64_t timestamp_us = base_us + (int64_t)(int32_t)(seq - base_seq) * period_ms * 1000;
+            sample = NULL;
+            if(seq > last_seq || count == max) break;
+            if(seq < first_seq) continue;
+            if(strstr(line, RECORD_SUPPRESSED) != NULL) {
+                (*skipped)++;
+                continue;
+            }
+            sample = &out[count++];
+            memset(sample, 0, sizeof(adc_sample_t));
+            memcpy(sample->voltage, v, sizeof(sample->voltage));
+            sample->timestamp_us = timestamp_us;
+            sample->period_ms = period_ms;
+            sample->seq = seq;
+        }
+        else if(sample != NULL && sscanf(line, "Digtal: Chan 0: %u, Chan 1: %u, Chan 2: %u, Chan 3: %u", &v[0], &v[1], &v[2], &v[3]) == 4) {
+            for(int ch = 0; ch < ADC_CHANNEL_NUMBER; ch++) {
+                sample->digital |= (v[ch] & 0x01) << ch;
+            }
+            sample = NULL;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,71 @@
+/*
+ *  Header file for log record format
+ *  Lines written to the SD card log (record.txt, spectrum.txt):
+ *      Period: <ms> ms from <us> us                    sampling period of the following records
+ *      Analog: Chan 0:<mV>mV, ... Chan 3:<mV> mV. Seq <n>   one sample, two lines, n: sequence number,
+ *                                                      followed by ", suppressed" if not meant for upload
+ *      Digtal: Chan 0: <0/1>, ... Chan 3: <0/1>
+ *      Spectrum: <us> us, <Hz> Hz, <n> points          features of one burst, then one line per channel
+ *
+ *  Only stdio is used, so the same format code runs on the device and in the host build (host/).
+ */
+
+#ifndef _USER_RECORD_H_
+#define _USER_RECORD_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "user_metrics.h"
+#include "user_spectrum.h"
+#include "user_adc.h"
+#include "user_seq.h"
+
+#define RECORD_SUPPRESSED       ", suppressed"      //end of the Analog line of a sample not meant for upload
+
+/**
+ * @brief Write one sample as an Analog and a Digtal line
+ * 
+ * @param f opened file
+ * @param adc_val voltage of 4 analog channels, mV
+ * @param digital_val state of digital channels, bit 0: channel 0 ...
+ * @param seq sequence number of the sample
+ * @param suppressed sample is not meant for upload (SAMPLE_FLAG_SUPPRESSED), it is never read back
+ */
+void user_file_record_value(FILE* f, const uint32_t* adc_val, uint8_t digital_val, uint32_t seq, bool suppressed);
+
+/**
+ * @brief Write a sampling period marker, records after it are period_ms apart
+ *        until the next marker
+ * 
+ * @param f opened file
+ * @param timestamp_us esp_timer time of the first record with this period
+ * @param period_ms sampling period
+ */
+void user_file_record_period(FILE* f, int64_t timestamp_us, uint32_t period_ms);
+
+/**
+ * @brief Write spectral features of one burst, one line per channel
+ * 
+ * @param f opened file
+ * @param burst features of every channel in burst->channel_mask
+ */
+void user_file_record_spectrum(FILE* f, const spectrum_burst_t* burst);
+
+/**
+ * @brief Read samples back from the log by sequence number
+ * 
+ * @param f log opened for reading
+ * @param start indexed record at or before first_seq (seq_index_find), reading starts there
+ * @param first_seq first wanted sample
+ * @param last_seq last wanted sample
+ * @param out samples in log order, time is rebuilt from start and the Period lines
+ * @param max size of out, reading stops before the next record once it is full
+ * @param skipped output, number of suppressed records up to the last record read
+ * @return size_t number of samples read, numbers which are not in the log and suppressed records
+ * are skipped
+ */
+size_t user_file_read_values(FILE* f, const seq_index_entry_t* start, uint32_t first_seq, uint32_t last_seq,
+                             adc_sample_t* out, size_t max, size_t* skipped);
+
+#endif
@@ -0,0 +1,86 @@
+/* Source file for report-by-exception rule engine */
+#include "user_rules.h"
+
+void rules_init(rules_state_t* state) {
+    memset(state, 0, sizeof(*state));
+}
+
+static bool outside_deadband(const rule_analog_t* rule, uint32_t value, uint32_t reported) {
+    uint32_t diff = value > reported ? value - reported : reported - value;
+    if(rule->deadband_mv == RULES_DISABLED && rule->deadband_permille == RULES_DISABLED) {
+        return true;                //no deadband => every sample is reported
+    }
+    if(rule->deadband_mv != RULES_DISABLED && diff >= rule->deadband_mv) {
+        return true;
+    }
+    //compare in integer: diff / reported >= permille / 1000, every change from 0 is relative infinity
+    if(rule->deadband_permille != RULES_DISABLED && diff > 0
+        && (uint64_t)diff * 1000 >= (uint64_t)rule->deadband_permille * reported) {
+        return true;
+    }
+    return false;
+}
+
+rules_result_t rules_evaluate(const rules_config_t* config, rules_state_t* state,
+                              const uint32_t* voltage, uint8_t digital, int64_t now_us) {
+    rules_result_t result = { .report = false, .event = false, .high_mask = 0, .low_mask = 0, .edge_mask = 0 };
+
+    for(int ch = 0; ch < RULES_ANALOG_CHANNELS; ch++) {
+        const rule_analog_t* rule = &config->analog[ch];
+        uint8_t bit = 1 << ch;
+        uint32_t v = voltage[ch];
+
+        if(rule->high_mv != RULES_DISABLED) {
+            if(!(state->high_active & bit) && v >= rule->high_mv) {
+                state->high_active |= bit;
+                result.high_mask |= bit;
+            }
+            else if((state->high_active & bit) && (uint64_t)v + rule->hysteresis_mv < rule->high_mv) {
+                state->high_active &= ~bit;
+                result.high_mask |= bit;
+            }
+        }
+        if(rule->low_mv != RULES_DISABLED) {
+            if(!(state->low_active & bit) && v <= rule->low_mv) {
+                state->low_active |= bit;
+                result.low_mask |= bit;
+            }
+            else if((state->low_active & bit) && v > (uint64_t)rule->low_mv + rule->hysteresis_mv) {
+                state->low_active &= ~bit;
+                result.low_mask |= bit;
+            }
+        }
+        if(state->initialized && outside_deadband(rule, v, state->reported[ch])) {
+            result.report = true;
+        }
+    }
+
+    if(state->initialized) {
+        uint8_t rising = digital & ~state->digital;
+        uint8_t falling = ~digital & state->digital;
+        for(int ch = 0; ch < RULES_DIGITAL_CHANNELS; ch++) {
+            uint8_t bit = 1 << ch;
+            if(((config->digital[ch] & RULE_EDGE_RISING) && (rising & bit))
+                || ((config->digital[ch] & RULE_EDGE_FALLING) && (falling & bit))) {
+                result.edge_mask |= bit;
+            }
+        }
+    }
+    state->digital = digital;
+
+    result.event = (result.high_mask | result.low_mask | result.edge_mask) != 0;
+    if(!state->initialized || result.event) {
+        result.report = true;
+    }
+    if(config->heartbeat_ms != RULES_DISABLED && now_us - state->reported_us >= (int64_t)config->heartbeat_ms * 1000) {
+        result.report = true;
+    }
+
+    if(result.report) {
+        //deadband is relative to what the server has last seen
+        memcpy(state->reported, voltage, sizeof(state->reported));
+        state->reported_us = now_us;
+        state->initialized = true;
+    }
+    return result;
+}
@@ -0,0 +1,86 @@
+/*
+ *  Header file for report-by-exception rule engine
+ *  Evaluated for every sample in the sampling loop, decides whether a sample is sent to the
+ *  uplink and whether it is an event that must be delivered without waiting for the batch.
+ *
+ *  Per analog channel:
+ *      - deadband: report only when value moved by deadband_mv or deadband_permille
+ *        from the last reported value
+ *      - high/low thresholds with hysteresis: crossing and returning are events
+ *  Per digital channel:
+ *      - edge rule: rising and/or falling edge is an event
+ *  A heartbeat reports a sample at least every heartbeat_ms even if nothing changed.
+ *
+ *  SD card always records every sample, rules only apply to the uplink.
+ *  The module only depends on the C library so it can be built and checked on a host PC.
+ */
+
+#ifndef _USER_RULES_H_
+#define _USER_RULES_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define RULES_ANALOG_CHANNELS   4
+#define RULES_DIGITAL_CHANNELS  4
+
+#define RULES_DISABLED          UINT32_MAX  //value of a threshold/deadband that is not used, 0 is a valid value
+
+typedef enum {
+    RULE_EDGE_NONE = 0,
+    RULE_EDGE_RISING = 1,
+    RULE_EDGE_FALLING = 2,
+    RULE_EDGE_BOTH = 3,
+} rule_edge_t;
+
+typedef struct {
+    uint32_t deadband_mv;           //absolute change needed to report
+    uint32_t deadband_permille;     //relative change needed to report, 0.1 % unit, any change from 0 mV
+    uint32_t high_mv;               //alarm when value >= high_mv
+    uint32_t low_mv;                //alarm when value <= low_mv
+    uint32_t hysteresis_mv;         //alarm clears when value is back by this margin
+} rule_analog_t;
+
+typedef struct {
+    rule_analog_t analog[RULES_ANALOG_CHANNELS];
+    rule_edge_t digital[RULES_DIGITAL_CHANNELS];
+    uint32_t heartbeat_ms;          //maximum time without report, RULES_DISABLED = never forced
+} rules_config_t;
+
+typedef struct {
+    bool initialized;
+    uint32_t reported[RULES_ANALOG_CHANNELS];   //values of last reported sample
+    int64_t reported_us;                        //time of last reported sample
+    uint8_t digital;                            //digital state of previous sample
+    uint8_t high_active;                        //bit n: channel n is above high threshold
+    uint8_t low_active;                         //bit n: channel n is below low threshold
+} rules_state_t;
+
+typedef struct {
+    bool report;                    //sample must be sent to uplink
+    bool event;                     //sample must be delivered immediately
+    uint8_t high_mask;              //channels which crossed or left high threshold
+    uint8_t low_mask;               //channels which crossed or left low threshold
+    uint8_t edge_mask;              //digital channels with a configured edge
+} rules_result_t;
+
+/**
+ * @brief Reset state, next sample is always reported
+ */
+void rules_init(rules_state_t* state);
+
+/**
+ * @brief Evaluate rules for one sample and update state
+ * 
+ * @param config rules of every channel
+ * @param state state kept between samples
+ * @param voltage value of analog channels, mV
+ * @param digital state of digital channels, bit 0: channel 0 ...
+ * @param now_us time of sample
+ * @return rules_result_t decision for this sample
+ */
+rules_result_t rules_evaluate(const rules_config_t* config, rules_state_t* state,
+                              const uint32_t* voltage, uint8_t digital, int64_t now_us);
+
+#endif
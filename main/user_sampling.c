@@ -0,0 +1,54 @@
+/* Source file for adaptive sampling rate controller */
+#include <string.h>
+#include "user_sampling.h"
+
+void sampling_init(const sampling_config_t* config, sampling_state_t* state) {
+    memset(state, 0, sizeof(*state));
+    state->period_ms = config->max_period_ms;
+}
+
+bool sampling_update(const sampling_config_t* config, sampling_state_t* state,
+                     const uint32_t* voltage, int64_t now_us) {
+    uint32_t old_period = state->period_ms;
+    bool active = false;
+
+    if(!state->initialized) {
+        for(int ch = 0; ch < SAMPLING_CHANNELS; ch++) {
+            state->prev[ch] = voltage[ch];
+            state->mean[ch] = voltage[ch];
+            state->var[ch] = 0;
+        }
+        state->prev_us = now_us;
+        state->initialized = true;
+        return false;
+    }
+
+    int64_t dt_ms = (now_us - state->prev_us) / 1000;
+    if(dt_ms < 1) dt_ms = 1;
+    for(int ch = 0; ch < SAMPLING_CHANNELS; ch++) {
+        uint32_t diff = voltage[ch] > state->prev[ch] ? voltage[ch] - state->prev[ch] : state->prev[ch] - voltage[ch];
+        if(config->slope_mv_per_s != 0 && (int64_t)diff * 1000 >= (int64_t)config->slope_mv_per_s * dt_ms) {
+            active = true;
+        }
+        //exponentially weighted mean and variance
+        float d = (float)voltage[ch] - state->mean[ch];
+        state->mean[ch] += SAMPLING_EWMA_ALPHA * d;
+        state->var[ch] = (1.0f - SAMPLING_EWMA_ALPHA) * (state->var[ch] + SAMPLING_EWMA_ALPHA * d * d);
+        if(config->stddev_mv != 0 && state->var[ch] >= (float)config->stddev_mv * config->stddev_mv) {
+            active = true;
+        }
+        state->prev[ch] = voltage[ch];
+    }
+    state->prev_us = now_us;
+
+    if(active) {
+        state->period_ms = config->min_period_ms;
+        state->quiet = 0;
+    }
+    else if(state->period_ms < config->max_period_ms && ++state->quiet >= config->quiet_samples) {
+        //decay back to floor rate one step at a time
+        state->period_ms = state->period_ms * 2 > config->max_period_ms ? config->max_period_ms : state->period_ms * 2;
+        state->quiet = 0;
+    }
+    return state->period_ms != old_period;
+}
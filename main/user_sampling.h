@@ -0,0 +1,57 @@
+/*
+ *  Header file for adaptive sampling rate controller
+ *  Sampling period is shortened to min_period_ms as soon as any analog channel is active:
+ *      - slope between two samples >= slope_mv_per_s, or
+ *      - running standard deviation (exponentially weighted) >= stddev_mv
+ *  When every channel is quiet for quiet_samples samples the period is doubled,
+ *  until it is back to the floor rate max_period_ms.
+ *
+ *  The module only depends on the C library so it can be built and checked on a host PC
+ *  with synthetic signals.
+ */
+
+#ifndef _USER_SAMPLING_H_
+#define _USER_SAMPLING_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SAMPLING_CHANNELS       4
+#define SAMPLING_EWMA_ALPHA     0.125f      //weight of new sample in running mean and variance
+
+typedef struct {
+    uint32_t min_period_ms;         //period used while signal is active
+    uint32_t max_period_ms;         //floor rate, used while signal is quiet
+    uint32_t slope_mv_per_s;        //0 = slope is not checked
+    uint32_t stddev_mv;             //0 = deviation is not checked
+    uint16_t quiet_samples;         //quiet samples before period is doubled
+} sampling_config_t;
+
+typedef struct {
+    bool initialized;
+    uint32_t period_ms;             //period currently in effect
+    uint16_t quiet;                 //quiet samples since last change
+    int64_t prev_us;
+    uint32_t prev[SAMPLING_CHANNELS];
+    float mean[SAMPLING_CHANNELS];
+    float var[SAMPLING_CHANNELS];
+} sampling_state_t;
+
+/**
+ * @brief Reset controller, period starts at floor rate
+ */
+void sampling_init(const sampling_config_t* config, sampling_state_t* state);
+
+/**
+ * @brief Feed one sample to the controller
+ * 
+ * @param config controller parameters
+ * @param state controller state, state->period_ms holds the period to use for next sample
+ * @param voltage value of analog channels, mV
+ * @param now_us time of sample
+ * @return true if period has changed
+ */
+bool sampling_update(const sampling_config_t* config, sampling_state_t* state,
+                     const uint32_t* voltage, int64_t now_us);
+
+#endif
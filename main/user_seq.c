@@ -0,0 +1,164 @@
+/* Source file for sample sequence numbers and upload acknowledgement */
+#include "user_seq.h"
+
+static const char* TAG = "Sequence";
+
+static uint32_t s_first;
+static uint32_t s_next;
+static uint32_t s_reserved;                 //numbers below this are stored as used in NVS
+
+static esp_err_t seq_reserve(uint32_t reserved) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(SEQ_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if(err != ESP_OK) return err;
+    err = nvs_set_u32(handle, SEQ_NVS_KEY, reserved);
+    if(err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t user_seq_init(void) {
+    nvs_handle_t handle;
+    uint32_t reserved = 0;
+    //namespace does not exist before the first reservation => start from 0
+    if(nvs_open(SEQ_NVS_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        nvs_get_u32(handle, SEQ_NVS_KEY, &reserved);
+        nvs_close(handle);
+    }
+    s_first = s_next = reserved;
+    s_reserved = reserved + SEQ_RESERVE_BLOCK;
+    esp_err_t err = seq_reserve(s_reserved);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot reserve sequence numbers in NVS: %s", esp_err_to_name(err));
+    }
+    ESP_LOGI(TAG, "Sequence numbers of this boot start at %u", s_first);
+    user_metrics_set(METRIC_SEQ_NEXT, s_next);
+    return err;
+}
+
+uint32_t user_seq_next(void) {
+    if(s_next == s_reserved) {
+        s_reserved += SEQ_RESERVE_BLOCK;
+        if(seq_reserve(s_reserved) != ESP_OK) {
+            ESP_LOGE(TAG, "Cannot reserve sequence numbers in NVS");
+        }
+    }
+    user_metrics_set(METRIC_SEQ_NEXT, s_next + 1);
+    return s_next++;
+}
+
+uint32_t user_seq_first(void) {
+    return s_first;
+}
+
+/**** Tracker ****/
+
+void seq_tracker_init(seq_tracker_t* tracker, uint32_t first) {
+    tracker->next = first;
+    tracker->count = 0;
+}
+
+uint32_t seq_tracker_receive(seq_tracker_t* tracker, uint32_t seq) {
+    uint32_t missing;
+    if(seq < tracker->next) return 0;          //not from the live stream of this boot
+    missing = seq - tracker->next;
+    tracker->next = seq + 1;
+    return missing;
+}
+
+bool seq_tracker_gap(seq_tracker_t* tracker, uint32_t first, uint32_t last) {
+    uint32_t i = 0, j;
+    //first range which does not end before the new one, ranges which only touch it are merged too
+    while(i < tracker->count && tracker->gaps[i].last + 1 < first) i++;
+    seq_range_t* r = &tracker->gaps[i];
+    if(i < tracker->count && r->first <= last + 1) {
+        if(first < r->first) r->first = first;
+        if(last > r->last) r->last = last;
+        for(j = i + 1; j < tracker->count && tracker->gaps[j].first <= r->last + 1; j++) {
+            if(tracker->gaps[j].last > r->last) r->last = tracker->gaps[j].last;
+        }
+        memmove(r + 1, &tracker->gaps[j], (tracker->count - j) * sizeof(seq_range_t));
+        tracker->count -= j - i - 1;
+        return true;
+    }
+    //merging samples which were sent would send them again => no room, no tracking
+    if(tracker->count == SEQ_MAX_RANGES) return false;
+    memmove(r + 1, r, (tracker->count - i) * sizeof(seq_range_t));
+    *r = (seq_range_t){ .first = first, .last = last };
+    tracker->count++;
+    return true;
+}
+
+uint32_t seq_tracker_remove(seq_tracker_t* tracker, uint32_t first, uint32_t last) {
+    uint32_t lost = 0;
+    for(uint32_t i = 0; i < tracker->count; ) {
+        seq_range_t* r = &tracker->gaps[i];
+        if(r->last < first || r->first > last) {
+            i++;
+        }
+        else if(r->first >= first && r->last <= last) {
+            //whole range acknowledged
+            memmove(r, r + 1, (tracker->count - i - 1) * sizeof(seq_range_t));
+            tracker->count--;
+        }
+        else if(r->first >= first) {
+            r->first = last + 1;
+            i++;
+        }
+        else if(r->last <= last) {
+            r->last = first - 1;
+            i++;
+        }
+        else {
+            //middle of the range, split it if there is room, otherwise the part above is given up
+            if(tracker->count < SEQ_MAX_RANGES) {
+                memmove(r + 2, r + 1, (tracker->count - i - 1) * sizeof(seq_range_t));
+                r[1] = (seq_range_t){ .first = last + 1, .last = r->last };
+                tracker->count++;
+            }
+            else {
+                lost = r->last - last;
+            }
+            r->last = first - 1;
+            break;
+        }
+    }
+    return lost;
+}
+
+uint32_t seq_tracker_watermark(const seq_tracker_t* tracker, uint32_t oldest) {
+    uint32_t watermark = tracker->count ? tracker->gaps[0].first : tracker->next;
+    return oldest < watermark ? oldest : watermark;
+}
+
+bool seq_tracker_first_gap(const seq_tracker_t* tracker, seq_range_t* range) {
+    if(tracker->count == 0) return false;
+    *range = tracker->gaps[0];
+    return true;
+}
+
+/**** Log index ****/
+
+void seq_index_add(seq_index_t* index, const seq_index_entry_t* entry) {
+    if(index->count > 0) {
+        const seq_index_entry_t* newest = &index->entries[(index->head + SEQ_INDEX_ENTRIES - 1) % SEQ_INDEX_ENTRIES];
+        if(entry->seq < newest->seq + SEQ_INDEX_STRIDE) return;
+    }
+    index->entries[index->head] = *entry;
+    index->head = (index->head + 1) % SEQ_INDEX_ENTRIES;
+    if(index->count < SEQ_INDEX_ENTRIES) index->count++;
+}
+
+bool seq_index_find(const seq_index_t* index, uint32_t seq, seq_index_entry_t* entry) {
+    //newest first, entries increase in ring order
+    for(uint32_t i = 1; i <= index->count; i++) {
+        const seq_index_entry_t* e = &index->entries[(index->head + SEQ_INDEX_ENTRIES - i) % SEQ_INDEX_ENTRIES];
+        if(e->seq <= seq) {
+            *entry = *e;
+            return true;
+        }
+    }
+    return false;
+}
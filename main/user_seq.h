@@ -0,0 +1,140 @@
+/*
+ *  Header file for sample sequence numbers and upload acknowledgement
+ *  Every sample put on the sample bus gets the next sequence number. Numbers only increase, also
+ *  across reboots: they are reserved in NVS SEQ_RESERVE_BLOCK at a time, so flash is written once
+ *  per block, and a reboot resumes at the next block (the rest of the last block held no samples).
+ *  The number is written with every record on SD card (user_record.h) and sent with every uploaded
+ *  sample, so the server side can drop samples of a retried request it has already stored.
+ *
+ *  Uplink keeps a tracker of the samples of this boot:
+ *      watermark   every sample below it is acknowledged by the server or not meant for upload
+ *      gaps        ranges from the watermark on which are neither sent nor waiting to be sent:
+ *                  dropped from a full uplink queue or batch, or never acknowledged
+ *  Samples of the backend batch and of batches waiting for acknowledgement are kept by the uplink,
+ *  they are not in the tracker. Once the backend works again, only the gaps are read back from the
+ *  SD card log and sent. Records of samples not meant for upload are marked in the log (user_record.h)
+ *  and skipped. When every range is in use, a new gap is given up and its samples count as lost.
+ *  Records are found through an index of (sequence number, file offset) kept by the SD writer.
+ *
+ *  Tracker and index only depend on the C library, callers serialize access.
+ */
+
+#ifndef _USER_SEQ_H_
+#define _USER_SEQ_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "user_metrics.h"
+
+#define SEQ_NVS_NAMESPACE       "sample_seq"
+#define SEQ_NVS_KEY             "reserved"
+#define SEQ_RESERVE_BLOCK       1024        //numbers reserved per NVS write
+
+#define SEQ_MAX_RANGES          48          //gap ranges, a gap which does not fit is given up
+#define SEQ_INDEX_ENTRIES       128         //log positions kept by the SD writer
+#define SEQ_INDEX_STRIDE        32          //samples between two log positions
+
+/* Inclusive range of sequence numbers */
+typedef struct {
+    uint32_t first;
+    uint32_t last;
+} seq_range_t;
+
+typedef struct {
+    uint32_t next;                          //one past the highest sequence number received
+    uint32_t count;                         //ranges in use
+    seq_range_t gaps[SEQ_MAX_RANGES];       //increasing, not adjacent
+} seq_tracker_t;
+
+/* Position of a record in the SD card log, with the time base needed to rebuild sample times */
+typedef struct {
+    uint32_t seq;
+    uint32_t offset;                        //file offset of the record, or of its Period line
+    int64_t timestamp_us;
+    uint32_t period_ms;
+} seq_index_entry_t;
+
+typedef struct {
+    seq_index_entry_t entries[SEQ_INDEX_ENTRIES];
+    uint32_t head;                          //next entry to write
+    uint32_t count;
+} seq_index_t;
+
+/**
+ * @brief Load sequence counter from NVS and reserve the first block of this boot
+ * 
+ * @note NVS must be initialized. Numbering still works from RAM if NVS fails, but is not
+ * guaranteed to increase across the next reboot.
+ */
+esp_err_t user_seq_init(void);
+
+/**
+ * @brief Take next sequence number, called by the condition stage only
+ */
+uint32_t user_seq_next(void);
+
+/**
+ * @brief First sequence number of this boot
+ */
+uint32_t user_seq_first(void);
+
+/**
+ * @brief Start tracking at first, samples below it are not tracked
+ */
+void seq_tracker_init(seq_tracker_t* tracker, uint32_t first);
+
+/**
+ * @brief Account a sample received by the uplink, in increasing order
+ * 
+ * @return uint32_t number of samples missing between the previous one and this one, they end
+ * at seq - 1 and are not added to the gaps (seq_tracker_gap)
+ */
+uint32_t seq_tracker_receive(seq_tracker_t* tracker, uint32_t seq);
+
+/**
+ * @brief Add a range to the gaps, merged with the ranges it touches
+ * 
+ * @return false if every range is in use: the range is not tracked, its samples are lost
+ */
+bool seq_tracker_gap(seq_tracker_t* tracker, uint32_t first, uint32_t last);
+
+/**
+ * @brief Remove a range from the gaps: sent again, or not found in the log
+ * 
+ * @return uint32_t number of samples given up beside the range, when a gap had to be split
+ * and every range was in use
+ */
+uint32_t seq_tracker_remove(seq_tracker_t* tracker, uint32_t first, uint32_t last);
+
+/**
+ * @brief Every sample below the watermark is acknowledged or not meant for upload
+ * 
+ * @param oldest oldest sample which waits in the backend batch or for acknowledgement,
+ * UINT32_MAX if there is none
+ */
+uint32_t seq_tracker_watermark(const seq_tracker_t* tracker, uint32_t oldest);
+
+/**
+ * @brief Oldest gap
+ * 
+ * @return true if a range is returned
+ */
+bool seq_tracker_first_gap(const seq_tracker_t* tracker, seq_range_t* range);
+
+/**
+ * @brief Remember log position of a record, kept only every SEQ_INDEX_STRIDE samples
+ */
+void seq_index_add(seq_index_t* index, const seq_index_entry_t* entry);
+
+/**
+ * @brief Find last indexed record at or before seq
+ * 
+ * @return true if found, false if seq is older than every entry
+ */
+bool seq_index_find(const seq_index_t* index, uint32_t seq, seq_index_entry_t* entry);
+
+#endif
@@ -0,0 +1,113 @@
+/* Source file for spectral features of ADC bursts */
+#include <math.h>
+#include <string.h>
+#include "user_spectrum.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* cos/sin of -2*pi*k/SPECTRUM_MAX_POINTS, smaller FFT sizes use every (MAX/n)th entry */
+static float s_cos[SPECTRUM_MAX_POINTS / 2];
+static float s_sin[SPECTRUM_MAX_POINTS / 2];
+
+void spectrum_init(void) {
+    for(int k = 0; k < SPECTRUM_MAX_POINTS / 2; k++) {
+        double angle = -2.0 * M_PI * k / SPECTRUM_MAX_POINTS;
+        s_cos[k] = (float)cos(angle);
+        s_sin[k] = (float)sin(angle);
+    }
+}
+
+bool spectrum_fft(float* re, float* im, size_t n) {
+    if(n < 2 || n > SPECTRUM_MAX_POINTS || (n & (n - 1)) != 0) {
+        return false;
+    }
+    //bit reversal permutation
+    for(size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for(; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if(i < j) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    //butterflies, twiddle of stage with span len is table[k * MAX / len]
+    for(size_t len = 2; len <= n; len <<= 1) {
+        size_t half = len >> 1;
+        size_t step = SPECTRUM_MAX_POINTS / len;
+        for(size_t start = 0; start < n; start += len) {
+            for(size_t k = 0; k < half; k++) {
+                float wr = s_cos[k * step];
+                float wi = s_sin[k * step];
+                size_t a = start + k;
+                size_t b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+    return true;
+}
+
+static void insert_peak(spectrum_peak_t* peaks, float freq_hz, float amplitude_mv) {
+    int i = SPECTRUM_PEAKS - 1;
+    if(amplitude_mv <= peaks[i].amplitude_mv) return;
+    //keep list sorted from largest to smallest amplitude
+    for(; i > 0 && peaks[i - 1].amplitude_mv < amplitude_mv; i--) {
+        peaks[i] = peaks[i - 1];
+    }
+    peaks[i].freq_hz = freq_hz;
+    peaks[i].amplitude_mv = amplitude_mv;
+}
+
+bool spectrum_analyze(float* re, float* im, size_t n, float sample_rate_hz, spectrum_features_t* out) {
+    float sum = 0, sum_sq = 0, peak = 0;
+    memset(out, 0, sizeof(*out));
+    if(n < 4 || n > SPECTRUM_MAX_POINTS || (n & (n - 1)) != 0) {
+        return false;
+    }
+
+    /* Time domain features */
+    for(size_t i = 0; i < n; i++) {
+        sum += re[i];
+    }
+    out->mean_mv = sum / n;
+    size_t step = SPECTRUM_MAX_POINTS / n;
+    for(size_t i = 0; i < n; i++) {
+        float x = re[i] - out->mean_mv;
+        float ax = fabsf(x);
+        sum_sq += x * x;
+        if(ax > peak) peak = ax;
+        //Hann window from twiddle table: 0.5 - 0.5*cos(2*pi*i/n)
+        re[i] = x * (0.5f - 0.5f * (i < n / 2 ? s_cos[i * step] : -s_cos[(i - n / 2) * step]));
+        im[i] = 0;
+    }
+    out->rms_mv = sqrtf(sum_sq / n);
+    out->peak_mv = peak;
+    out->crest = out->rms_mv > 0 ? peak / out->rms_mv : 0;
+
+    /* Frequency domain features */
+    spectrum_fft(re, im, n);
+    //single sided magnitude, Hann window coherent gain is 0.5 => sine amplitude = 4*|X|/n
+    for(size_t k = 0; k <= n / 2; k++) {
+        re[k] = 4.0f * sqrtf(re[k] * re[k] + im[k] * im[k]) / n;
+    }
+    float bin_hz = sample_rate_hz / n;
+    for(size_t k = 1; k < n / 2; k++) {
+        if(re[k] >= SPECTRUM_PEAK_MIN_MV && re[k] > re[k - 1] && re[k] >= re[k + 1]) {
+            //parabolic interpolation between neighbour bins
+            float denom = re[k - 1] - 2.0f * re[k] + re[k + 1];
+            float delta = denom != 0 ? 0.5f * (re[k - 1] - re[k + 1]) / denom : 0;
+            insert_peak(out->peaks, (k + delta) * bin_hz, re[k] - 0.25f * (re[k - 1] - re[k + 1]) * delta);
+        }
+    }
+    return true;
+}
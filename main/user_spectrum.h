@@ -0,0 +1,74 @@
+/*
+ *  Header file for spectral features of ADC bursts
+ *  A burst of n samples (n power of 2) of one channel is reduced to a few numbers:
+ *      - mean, RMS of AC part, peak deviation from mean and crest factor (peak / RMS)
+ *      - top SPECTRUM_PEAKS spectral peaks (frequency, amplitude) of Hann windowed FFT
+ *
+ *  FFT is an in-place iterative radix-2 on float, ESP32 has a single precision FPU so
+ *  only float operations are used, twiddle factors are computed once by spectrum_init.
+ *  The module only depends on the C library so it can be validated on a host PC
+ *  against a reference DFT.
+ */
+
+#ifndef _USER_SPECTRUM_H_
+#define _USER_SPECTRUM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SPECTRUM_MAX_POINTS     1024        //largest FFT size, must be power of 2
+#define SPECTRUM_PEAKS          4           //spectral peaks kept per channel
+#define SPECTRUM_CHANNELS       4
+#define SPECTRUM_PEAK_MIN_MV    1.0f        //smaller local maxima are leakage/noise, not peaks
+
+typedef struct {
+    float freq_hz;
+    float amplitude_mv;             //amplitude of sine at this frequency
+} spectrum_peak_t;
+
+typedef struct {
+    float mean_mv;
+    float rms_mv;                   //RMS of signal with mean removed
+    float peak_mv;                  //largest deviation from mean
+    float crest;                    //peak_mv / rms_mv, 0 for a flat signal
+    spectrum_peak_t peaks[SPECTRUM_PEAKS];      //sorted by amplitude, unused entries are 0
+} spectrum_features_t;
+
+/* Features of one burst on every selected channel */
+typedef struct {
+    int64_t timestamp_us;           //start of burst
+    float sample_rate_hz;           //measured rate of burst
+    uint16_t points;
+    uint8_t channel_mask;           //bit n: channel[n] is valid
+    spectrum_features_t channel[SPECTRUM_CHANNELS];
+} spectrum_burst_t;
+
+/**
+ * @brief Compute twiddle table, must be called once before other functions
+ */
+void spectrum_init(void);
+
+/**
+ * @brief In-place forward FFT
+ * 
+ * @param re real part, n values
+ * @param im imaginary part, n values
+ * @param n number of points, power of 2, at most SPECTRUM_MAX_POINTS
+ * @return false if n is not supported
+ */
+bool spectrum_fft(float* re, float* im, size_t n);
+
+/**
+ * @brief Compute features of one burst
+ * 
+ * @param re burst samples in mV, used as workspace (content is destroyed)
+ * @param im workspace of n values
+ * @param n number of samples, power of 2, at most SPECTRUM_MAX_POINTS
+ * @param sample_rate_hz rate of burst
+ * @param out features
+ * @return false if n is not supported
+ */
+bool spectrum_analyze(float* re, float* im, size_t n, float sample_rate_hz, spectrum_features_t* out);
+
+#endif
@@ -19,8 +19,10 @@
 #define TIMER_DIVIDER   16      // Hardware timer clock divider
 #define TIMER_SCALE     (TIMER_BASE_CLK / TIMER_DIVIDER)    // convert counter value to second
 //TIMER_BASE_CLK = 40MHz
-#define ADC_PERIOD      2       //seconds        
+#define ADC_PERIOD      2       //seconds, floor rate of adaptive sampling
+#define ADC_MIN_PERIOD_MS       250     //period used while a signal is changing
 #define TIMER_FINISH_BIT BIT0
+#define TIMER_PERIOD_BIT BIT1           //sampling period has changed, used when paced by the tick (user_power.h)
 
 /*
  *  A sample structure to pass data back
@@ -49,4 +51,13 @@ typedef struct {
 
 void group0_timer_init(int timer_idx, double timer_interval_sec);
 
+/**
+ * @brief Change alarm period of a running timer of group 0
+ * 
+ * @param timer_idx index of timer in group 0 (0 or 1)
+ * @param timer_interval_sec new time interval, takes effect from the next alarm
+ */
+
+void group0_timer_set_period(int timer_idx, double timer_interval_sec);
+
 #endif
@@ -12,9 +12,18 @@ static esp_ip4_addr_t s_ip_addr;
 
 static const char* TAG = "Wifi Connection";
 
+static wifi_cache_t s_cache;
+static bool s_cache_valid = false;
+static bool s_fast_path = false;         //true while connecting to cached BSSID/channel
+static esp_timer_handle_t s_retry_timer = NULL;
+static uint8_t s_retry_attempt = 0;
+static int64_t s_connect_start;         //time of first connect attempt since last disconnection
+static bool s_radio_off = false;        //switched off on purpose => disconnection is not a loss
+
 /* Static Function */
-static esp_netif_t* wifi_start(void);
-static void wifi_stop(void);
+static esp_err_t wifi_start(void);
+static esp_err_t wifi_stop(void);
+static esp_err_t wifi_apply_config(bool use_cache);
 
 /**
  * @brief Checks the netif description if it contains specified prefix.
@@ -25,16 +34,87 @@ static bool is_our_netif(const char* prefix, esp_netif_t* netif) {
     return strncmp(prefix, esp_netif_get_desc(netif), strlen(prefix)-1==0);
 }
 
-/* set up connection, Wi-Fi */
-static void start(void) {
-    s_esp_netif = wifi_start();
-}
-
-/* disconenct wifi */
+/* disconenct wifi, registered as shutdown handler */
 static void stop(void) {
     wifi_stop();
 }
 
+/**
+ * @brief These functions keep last good connection in NVS
+ * 
+ */
+static void wifi_cache_load(void) {
+    nvs_handle_t handle;
+    size_t len = sizeof(s_cache);
+    s_cache_valid = false;
+    if(nvs_open(WIFI_CACHE_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) return;
+    if(nvs_get_blob(handle, WIFI_CACHE_KEY, &s_cache, &len) == ESP_OK && len == sizeof(s_cache)) {
+        s_cache_valid = true;
+    }
+    nvs_close(handle);
+}
+
+static void wifi_cache_save(void) {
+    nvs_handle_t handle;
+    if(nvs_open(WIFI_CACHE_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot open NVS to save connection cache");
+        return;
+    }
+    if(nvs_set_blob(handle, WIFI_CACHE_KEY, &s_cache, sizeof(s_cache)) == ESP_OK) {
+        nvs_commit(handle);
+        s_cache_valid = true;
+    }
+    nvs_close(handle);
+}
+
+static void wifi_cache_clear(void) {
+    nvs_handle_t handle;
+    s_cache_valid = false;
+    if(nvs_open(WIFI_CACHE_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) return;
+    nvs_erase_key(handle, WIFI_CACHE_KEY);
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+/**
+ * @brief These functions handle connection attempts
+ * 
+ */
+static void wifi_try_connect(void) {
+    esp_err_t err = esp_wifi_connect();
+    if(err != ESP_OK && err != ESP_ERR_WIFI_NOT_STARTED) {
+        //do not abort here, next disconnect event schedules another attempt
+        ESP_LOGE(TAG, "esp_wifi_connect failed (%s)", esp_err_to_name(err));
+    }
+}
+
+static void on_retry_timer(void* arg) {
+    ESP_LOGI(TAG, "Reconnect attempt %d", s_retry_attempt);
+    wifi_try_connect();
+}
+
+/* Exponential backoff with jitter so a fleet does not hammer the AP at the same time */
+static uint32_t wifi_backoff_ms(uint8_t attempt) {
+    uint32_t delay = WIFI_BACKOFF_MAX_MS;
+    if(attempt < 16 && (WIFI_BACKOFF_BASE_MS << attempt) < WIFI_BACKOFF_MAX_MS) {
+        delay = WIFI_BACKOFF_BASE_MS << attempt;
+    }
+    return delay / 2 + esp_random() % (delay / 2 + 1);
+}
+
+/* Stop using cached AP, following attempts do a full scan and DHCP */
+static void wifi_leave_fast_path(void) {
+    ESP_LOGW(TAG, "Cached AP not reachable, falling back to full scan");
+    s_fast_path = false;
+    wifi_cache_clear();
+    user_metrics_inc(METRIC_WIFI_CACHE_MISSES);
+    user_metrics_set(METRIC_WIFI_FAST_PATH, 0);
+    wifi_apply_config(false);
+#if WIFI_CACHE_STATIC_IP
+    esp_netif_dhcpc_start(s_esp_netif);
+#endif
+}
+
 /**
  * @brief These function are event handler for Wifi usage
  * 
@@ -46,14 +126,50 @@ static void on_got_ip(void* arg, esp_event_base_t event_base, int32_t event_id,
     ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
     ESP_LOGI(TAG, "Got ipv4 address: Interface \"%s\" address:" IPSTR, esp_netif_get_desc(event->esp_netif), IP2STR(&event->ip_info.ip));
     memcpy(&s_ip_addr, &event->ip_info.ip, sizeof(s_ip_addr));
+
+    uint32_t connect_us = esp_timer_get_time() - s_connect_start;
+    ESP_LOGI(TAG, "Connected in %u ms (%s)", connect_us / 1000, s_fast_path ? "cached AP" : "full scan");
+    user_metrics_observe(METRIC_WIFI_CONNECT_LATENCY, connect_us);
+    s_retry_attempt = 0;
+#if WIFI_CACHE_STATIC_IP
+    if(!s_cache.ip_valid || memcmp(&s_cache.ip, &event->ip_info, sizeof(s_cache.ip)) != 0) {
+        s_cache.ip = event->ip_info;
+        s_cache.ip_valid = true;
+        wifi_cache_save();
+    }
+#endif
+}
+
+/* Associated with AP event, remember AP for next start */
+static void on_wifi_connected(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
+    wifi_event_sta_connected_t* event = (wifi_event_sta_connected_t*) event_data;
+    //only write flash when AP has changed
+    if(!s_cache_valid || memcmp(s_cache.bssid, event->bssid, sizeof(s_cache.bssid)) != 0 || s_cache.channel != event->channel) {
+        memcpy(s_cache.bssid, event->bssid, sizeof(s_cache.bssid));
+        s_cache.channel = event->channel;
+        s_cache.ip_valid = false;
+        wifi_cache_save();
+        ESP_LOGI(TAG, "Cached AP "MACSTR" channel %d", MAC2STR(s_cache.bssid), s_cache.channel);
+    }
 }
 
 /* Wifi disconnect event */
 static void on_wifi_disconnect(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
-    ESP_LOGI(TAG, "Wifi disconnected. Trying to reconnect...");
-    esp_err_t err = esp_wifi_connect();
-    if(err == ESP_ERR_WIFI_NOT_STARTED) return;
-    ESP_ERROR_CHECK(err);
+    wifi_event_sta_disconnected_t* event = (wifi_event_sta_disconnected_t*) event_data;
+    if(s_radio_off) return;
+    if(s_retry_attempt == 0) {
+        //connection was up until now => connect time is counted from here
+        s_connect_start = esp_timer_get_time();
+        user_metrics_inc(METRIC_WIFI_DISCONNECTS);
+    }
+    if(s_fast_path && (event->reason == WIFI_REASON_NO_AP_FOUND || s_retry_attempt + 1 >= WIFI_FAST_PATH_MAX_ATTEMPTS)) {
+        wifi_leave_fast_path();
+    }
+    uint32_t delay = wifi_backoff_ms(s_retry_attempt);
+    if(s_retry_attempt < UINT8_MAX) s_retry_attempt++;
+    ESP_LOGI(TAG, "Wifi disconnected (reason %d). Trying to reconnect in %u ms...", event->reason, delay);
+    //timer may already be running if several disconnect events arrive, keep the pending attempt
+    esp_timer_start_once(s_retry_timer, (uint64_t)delay * 1000);
 }
 
 /**
@@ -62,8 +178,13 @@ static void on_wifi_disconnect(void* arg, esp_event_base_t event_base, int32_t e
  */
 /* Normal Function */
 esp_err_t wifi_connect(void) {
-    start();
-    ESP_ERROR_CHECK(esp_register_shutdown_handler(&stop));
+    esp_err_t err = wifi_start();
+    if(err != ESP_OK) return err;
+    err = esp_register_shutdown_handler(&stop);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot register shutdown handler (%s)", esp_err_to_name(err));
+        return err;
+    }
     ESP_LOGI(TAG, "Waiting for IP(s).");
 
     esp_netif_t* netif = NULL;
@@ -72,16 +193,43 @@ esp_err_t wifi_connect(void) {
         netif = esp_netif_next(netif);
         if(is_our_netif(TAG, netif)) {
             ESP_LOGI(TAG, "Connected to %s.", esp_netif_get_desc(netif));
-            ESP_ERROR_CHECK(esp_netif_get_ip_info(netif, &ip));
-            ESP_LOGI(TAG, "- IPv4 Address: "IPSTR, IP2STR(&ip.ip));
+            if(esp_netif_get_ip_info(netif, &ip) == ESP_OK) {
+                ESP_LOGI(TAG, "- IPv4 Address: "IPSTR, IP2STR(&ip.ip));
+            }
         }
     }
     return ESP_OK;
 }
 
 esp_err_t wifi_disconnect(void) {
-    stop();
-    ESP_ERROR_CHECK(esp_unregister_shutdown_handler(&stop));
+    esp_err_t err = wifi_stop();
+    if(err != ESP_OK) return err;
+    return esp_unregister_shutdown_handler(&stop);
+}
+
+esp_err_t wifi_radio_off(void) {
+    s_radio_off = true;
+    if(s_retry_timer != NULL) {
+        esp_timer_stop(s_retry_timer);
+    }
+    return esp_wifi_stop();
+}
+
+esp_err_t wifi_radio_on(void) {
+    s_radio_off = false;
+    s_retry_attempt = 0;
+    esp_err_t err = esp_wifi_start();
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_wifi_start failed (%s)", esp_err_to_name(err));
+        return err;
+    }
+    //AP cached or forgotten during the last window applies to this connection
+    s_fast_path = s_cache_valid;
+    user_metrics_set(METRIC_WIFI_FAST_PATH, s_fast_path);
+    err = wifi_apply_config(s_fast_path);
+    if(err != ESP_OK) return err;
+    s_connect_start = esp_timer_get_time();
+    wifi_try_connect();
     return ESP_OK;
 }
 
@@ -91,17 +239,15 @@ esp_netif_t* get_connection_netif(void) {
 
 esp_netif_t* get_netif_from_desc(const char* desc) {
     esp_netif_t* netif = NULL;
-    char* expected_desc;        //store description of current netif
-    asprintf(&expected_desc, "%s %s", TAG, desc);
+    char expected_desc[WIFI_NETIF_DESC_MAX];        //store description of current netif
+    snprintf(expected_desc, sizeof(expected_desc), "%s %s", TAG, desc);
 
     /* find if current netif is stored in data to free and return back that netif */
     while((netif = esp_netif_next(netif)) != NULL) {
         if(strcmp(esp_netif_get_desc(netif), expected_desc) == 0) {
-            free(expected_desc);
             return netif;
         }
     }
-    free(expected_desc);
     return netif;
 }
 
@@ -110,58 +256,135 @@ esp_netif_t* get_netif_from_desc(const char* desc) {
  * 
  */
 
-/* This function returns type of netif that is used to connect */
-static esp_netif_t *wifi_start(void) {
-    char* desc;     /* description of netif */
+/* This function creates the netif that is used to connect (s_esp_netif) and starts connecting */
+static esp_err_t wifi_start(void) {
+    char desc[WIFI_NETIF_DESC_MAX];     /* description of netif, copied by esp_netif_create_wifi */
+    esp_err_t err;
 
     /* init wifi driver */
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    err = esp_wifi_init(&cfg);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot initialize Wi-Fi driver (%s)", esp_err_to_name(err));
+        return err;
+    }
     //netif interface
     esp_netif_inherent_config_t esp_netif_config = ESP_NETIF_INHERENT_DEFAULT_WIFI_STA();
 
     // Prefix the interface description with the module TAG
     // Warning: the interface desc is used in tests to capture actual connection details (IP, gw, mask)
-    asprintf(&desc, "%s %s", TAG, esp_netif_config.if_desc);
+    snprintf(desc, sizeof(desc), "%s %s", TAG, esp_netif_config.if_desc);
     esp_netif_config.if_desc = desc;
     esp_netif_config.route_prio = 128;
 
     /* create and init wifi interface */
     esp_netif_t* netif = esp_netif_create_wifi(WIFI_IF_STA, &esp_netif_config);
-    free(desc);
-    esp_wifi_set_default_wifi_sta_handlers();
+    if(netif == NULL) {
+        ESP_LOGE(TAG, "Cannot create Wi-Fi station interface");
+        return ESP_FAIL;
+    }
+    s_esp_netif = netif;
+    err = esp_wifi_set_default_wifi_sta_handlers();
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot set default Wi-Fi handlers (%s)", esp_err_to_name(err));
+        return err;
+    }
 
     /* register wifi event to handle */
-    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &on_wifi_disconnect, NULL));
-    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &on_got_ip, NULL));
+    if((err = esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &on_wifi_disconnect, NULL)) != ESP_OK
+        || (err = esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, &on_wifi_connected, NULL)) != ESP_OK
+        || (err = esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &on_got_ip, NULL)) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot register Wi-Fi event handlers (%s)", esp_err_to_name(err));
+        return err;
+    }
+
+    const esp_timer_create_args_t retry_timer_args = {
+        .callback = &on_retry_timer,
+        .name = "wifi retry"
+    };
+    err = esp_timer_create(&retry_timer_args, &s_retry_timer);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot create retry timer (%s)", esp_err_to_name(err));
+        return err;
+    }
+
+    wifi_cache_load();
+    s_fast_path = s_cache_valid;
+    user_metrics_set(METRIC_WIFI_FAST_PATH, s_fast_path);
+#if WIFI_CACHE_STATIC_IP
+    if(s_fast_path && s_cache.ip_valid) {
+        //skip DHCP, lease is verified by the AP accepting traffic; dropped with cache on failure
+        esp_netif_dhcpc_stop(netif);
+        esp_netif_set_ip_info(netif, &s_cache.ip);
+    }
+#endif
 
-    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+    //our own cache is kept in NVS, driver does not need to write config to flash
+    if((err = esp_wifi_set_storage(WIFI_STORAGE_RAM)) != ESP_OK || (err = esp_wifi_set_mode(WIFI_MODE_STA)) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot configure Wi-Fi station (%s)", esp_err_to_name(err));
+        return err;
+    }
+    err = wifi_apply_config(s_fast_path);
+    if(err != ESP_OK) return err;
+    err = esp_wifi_start();
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_wifi_start failed (%s)", esp_err_to_name(err));
+        return err;
+    }
+    s_connect_start = esp_timer_get_time();
+    wifi_try_connect();
+    return ESP_OK;
+}
+
+/* Set station config, use_cache: connect directly to cached BSSID on cached channel */
+static esp_err_t wifi_apply_config(bool use_cache) {
     wifi_config_t wifi_config = {
         .sta = {
             .ssid = CONFIG_WIFI_SSID,
             .password = CONFIG_WIFI_PASS
         }
     };
-    ESP_LOGI(TAG, "Connected to %s...", wifi_config.sta.ssid);
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-    ESP_ERROR_CHECK(esp_wifi_start());
-    esp_wifi_connect();
-    return netif;
+    if(use_cache) {
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, s_cache.bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.channel = s_cache.channel;
+        ESP_LOGI(TAG, "Connected to %s (cached AP "MACSTR", channel %d)...", wifi_config.sta.ssid, MAC2STR(s_cache.bssid), s_cache.channel);
+    }
+    else {
+        ESP_LOGI(TAG, "Connected to %s...", wifi_config.sta.ssid);
+    }
+    esp_err_t err = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_wifi_set_config failed (%s)", esp_err_to_name(err));
+    }
+    return err;
 }
 
-static void wifi_stop(void) {
+static esp_err_t wifi_stop(void) {
     esp_netif_t* wifi_netif = get_netif_from_desc("sta");
+    esp_err_t err;
     /* unregister event handler */
-    ESP_ERROR_CHECK(esp_event_handler_unregister(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &on_wifi_disconnect));
-    ESP_ERROR_CHECK(esp_event_handler_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, &on_got_ip));
-    esp_err_t err = esp_wifi_stop();
+    if((err = esp_event_handler_unregister(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, &on_wifi_disconnect)) != ESP_OK
+        || (err = esp_event_handler_unregister(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED, &on_wifi_connected)) != ESP_OK
+        || (err = esp_event_handler_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, &on_got_ip)) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot unregister Wi-Fi event handlers (%s)", esp_err_to_name(err));
+        return err;
+    }
+    if(s_retry_timer != NULL) {
+        esp_timer_stop(s_retry_timer);
+        esp_timer_delete(s_retry_timer);
+        s_retry_timer = NULL;
+    }
+    err = esp_wifi_stop();
     if(err == ESP_ERR_WIFI_NOT_INIT) {
-        return;
+        return ESP_OK;
+    }
+    if(err != ESP_OK || (err = esp_wifi_deinit()) != ESP_OK
+        || (err = esp_wifi_clear_default_wifi_driver_and_handlers(wifi_netif)) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot stop Wi-Fi driver (%s)", esp_err_to_name(err));
+        return err;
     }
-    ESP_ERROR_CHECK(err);
-    ESP_ERROR_CHECK(esp_wifi_deinit());
-    ESP_ERROR_CHECK(esp_wifi_clear_default_wifi_driver_and_handlers(wifi_netif));
     esp_netif_destroy(wifi_netif);  /* destroy netif object */
     s_esp_netif = NULL;
+    return ESP_OK;
 }
\ No newline at end of file
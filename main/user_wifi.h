@@ -19,25 +19,68 @@
 #include "freertos/event_groups.h"
 #include "lwip/err.h"
 #include "lwip/sys.h"
+#include "nvs.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "user_metrics.h"
 
 /* Private Define */
 #define EXAMPLE_INTERFACE   get_connection_netif()
 #define CONFIG_WIFI_SSID    "LeTao"
 #define CONFIG_WIFI_PASS    "visualstd"
+#define WIFI_NETIF_DESC_MAX 32              //module TAG + " " + interface description, e.g. "sta"
+
+/*
+ *  Fast reconnect
+ *  BSSID and channel of last successful connection are kept in NVS and used at next start
+ *  so the station connects without a full channel scan. If the cached AP cannot be found,
+ *  cache is dropped and a normal scan is done.
+ *  If WIFI_CACHE_STATIC_IP is 1, last DHCP lease is also reused as static IP on the fast path.
+ */
+#define WIFI_CACHE_NAMESPACE        "wifi_cache"
+#define WIFI_CACHE_KEY              "last_ap"
+#define WIFI_CACHE_STATIC_IP        0
+#define WIFI_FAST_PATH_MAX_ATTEMPTS 2       //failed attempts with cached AP before falling back to scan
+
+/* Reconnect delay grows as BASE * 2^attempt up to MAX, then random jitter of up to 50% is applied */
+#define WIFI_BACKOFF_BASE_MS        500
+#define WIFI_BACKOFF_MAX_MS         60000
+
+/* Last good connection, stored as one blob in NVS */
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+    bool ip_valid;
+    esp_netif_ip_info_t ip;
+} wifi_cache_t;
 
 /* Function Prototype */
 /**
- * @brief Configure Wi-Fi, connect, wait for IP
+ * @brief Configure Wi-Fi and start connecting, IP_EVENT_STA_GOT_IP follows once connected
  *
- * @return ESP_OK on successful connection
+ * @return ESP_OK if the driver is started, else the error of the driver call which failed
  */
 esp_err_t wifi_connect(void);
 
 /**
  * Counterpart to wifi_connect, de-initializes Wi-Fi 
+ *
+ * @return ESP_OK if the driver is stopped or was not started
  */
 esp_err_t wifi_disconnect(void);
 
+/**
+ * @brief Switch radio off between upload windows, station does not reconnect until wifi_radio_on
+ */
+esp_err_t wifi_radio_off(void);
+
+/**
+ * @brief Switch radio on again after wifi_radio_off and connect, cached AP is used (fast reconnect)
+ *
+ * @note Returns before the connection is up, IP_EVENT_STA_GOT_IP follows like at boot
+ */
+esp_err_t wifi_radio_on(void);
+
 /**
  * @brief Returns esp-netif pointer created by wifi_connect()
  *